@@ -17,6 +17,7 @@
 #include "audio_handler.h"
 #include "esp32_main.h"
 #include "uart_handler.h"
+#include "task_sched.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -98,7 +99,7 @@ esp_err_t audio_handler_init(void)
     }
     
     // ==================== 创建音频播放任务 ====================
-    if (xTaskCreate(audio_play_task, "audio_play", 4096, NULL, 5, &audio_task_handle) != pdPASS) {
+    if (task_sched_create(audio_play_task, "audio_play", 4096, NULL, TASK_CLASS_AUDIO, &audio_task_handle) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create audio playback task");
         vQueueDelete(audio_queue);
         audio_queue = NULL;
@@ -299,6 +300,18 @@ bool audio_is_playing(void)
     return (current_state == AUDIO_STATE_PLAYING || current_state == AUDIO_STATE_RECEIVING);
 }
 
+/****************************************************************************
+ * @brief 获取音频队列剩余槽位（用于向后端报告发送额度）
+ * @return 可再接收的音频包数量
+ */
+int audio_stream_free_slots(void)
+{
+    if (audio_queue == NULL) {
+        return 0;
+    }
+    return (int)uxQueueSpacesAvailable(audio_queue);
+}
+
 /****************************************************************************
  * @brief 反初始化音频处理模块
  * @return ESP_OK - 成功，ESP_FAIL - 失败
@@ -60,6 +60,12 @@ esp_err_t audio_stop(void);
  */
 bool audio_is_playing(void);
 
+/***
+ * @brief 获取音频队列剩余槽位（用于向后端报告发送额度）
+ * @return 可再接收的音频包数量
+ */
+int audio_stream_free_slots(void);
+
 /***
  * @brief 反初始化音频处理模块
  * @return ESP_OK - 成功，ESP_FAIL - 失败
@@ -35,6 +35,9 @@
 #define CMD_AUDIO_STREAM_DATA   0xA4   // 音频流数据包
 #define CMD_AUDIO_STREAM_END    0xA5   // 结束音频流传输
 #define CMD_DEVICE_DISCOVERY    0xA6   // 设备发现请求
+#define CMD_QUERY_TASK_STATS    0xA7   // 查询各任务CPU占用
+#define CMD_QUERY_TEMP_HISTORY  0xA8   // 查询温度历史（CMD + 分辨率 + 起始时间4字节 + 结束时间4字节，大端）
+#define CMD_SET_TIME            0xA9   // 设置系统时间（CMD + Unix秒4字节，大端，无响应）
 
 // ESP32→上位机响应（TCP发送）
 #define RESP_THRESHOLD1_REACHED 0xD1   // 阈值1到达通知
@@ -43,14 +46,21 @@
 #define RESP_TEMP_UPDATE        0xD3   // 温度定期更新
 #define RESP_STATUS_OK          0xD4   // 状态正常
 #define RESP_AUDIO_ACK          0xD5   // 音频接收确认
-#define RESP_DEVICE_INFO        0xD6   // 设备信息响应
+#define RESP_DEVICE_INFO        0xD6   // 设备信息响应（RESP + 长度1字节 + 设备名）
+#define RESP_TASK_STATS         0xD7   // 任务CPU占用报告（RESP + 长度高字节 + 长度低字节 + 文本）
+#define RESP_TEMP_HISTORY       0xD8   // 温度历史分片（RESP + 长度2字节 + 分辨率 + N×10字节记录，长度为1表示结束）
+#define RESP_AUDIO_CREDIT       0xD9   // 音频发送额度（RESP + 音频队列剩余槽位1字节），兼作数据确认
 #define RESP_ERROR              0xDF   // 错误响应
 
 // ==================== 网络配置 ====================
 #define TCP_SERVER_PORT         8080   // TCP服务器端口
 #define MAX_CONNECTIONS         5      // 最大连接数
-#define MDNS_HOSTNAME           "esp32-temp-monitor"  // mDNS主机名
+#define MDNS_HOSTNAME_PREFIX    "esp32-temp"          // mDNS主机名前缀（后接MAC后3字节，如esp32-temp-a1b2c3）
 #define MDNS_INSTANCE           "ESP32 Temperature Monitor"  // mDNS实例名
+#define MDNS_SERVICE_TYPE       "_esp32temp"          // mDNS服务类型
+#define MDNS_SERVICE_PROTO      "_tcp"                // mDNS服务协议
+#define PROTOCOL_VERSION        "3"                   // TCP命令协议版本（TXT记录proto）
+#define FIRMWARE_VERSION        "0.2"                 // 固件版本（TXT记录version）
 
 // ==================== UART配置 ====================
 #define UART_NUM                UART_NUM_1
@@ -63,5 +73,12 @@
 #define AUDIO_BUFFER_SIZE       4096   // 音频缓冲区大小
 #define AUDIO_STREAM_TIMEOUT_MS 5000   // 音频流超时（毫秒）
 
+// ==================== 调度统计配置 ====================
+#define TASK_STATS_REPORT_SIZE  1536   // 任务CPU占用报告最大长度
+
+// ==================== 温度历史配置 ====================
+#define TEMP_HISTORY_RECORD_SIZE 10    // 每条记录：时间4字节 + 最小值/最大值/平均值各2字节
+#define TEMP_HISTORY_FRAME_RECS  64    // 每帧最多记录数
+
 #endif // ESP32_MAIN_H
 
@@ -3,86 +3,280 @@
  * @author bearbox <apuirbox@gmail.com>
  * @date 2025-11-05
  * @brief mDNS服务实现（设备发现）
- * 
- * @version 0.1
- * 
+ *
+ * @version 0.2
+ *
  * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
- * 
+ *
  * @lastEditors bearbox <apuirbox@gmail.com>
- * @lastEditTime 2025-11-05
+ * @lastEditTime 2025-11-14
  * @filePath mdns_service.c
  * @projectType Embedded
  */
 
  #include "mdns_service.h"
  #include "esp_log.h"
+ #include "esp_mac.h"
  #include "mdns.h"
  #include "esp32_main.h"
- 
+ #include "freertos/FreeRTOS.h"
+ #include "freertos/task.h"
+ #include "freertos/timers.h"
+ #include <stdio.h>
+ #include <string.h>
+
  static const char *TAG = "MDNS_SERVICE";
- 
+
+ // 设备运行状态（TXT记录中的动态部分）
+ typedef struct {
+     bool streaming;
+     uint8_t alarm;
+     uint8_t clients;
+ } mdns_device_state_t;
+
+ static char hostname[32] = MDNS_HOSTNAME_PREFIX;
+ static char instance[64] = MDNS_INSTANCE;
+ static char mac_str[13] = "";
+
+ static volatile mdns_device_state_t current_state;     // 最新状态（任意任务写入）
+ static mdns_device_state_t published_state;            // 已发布状态（仅定时器任务访问）
+ static TimerHandle_t publish_timer = NULL;
+ static TickType_t last_publish_tick = 0;
+ static bool mdns_running = false;
+
+ /****************************************************************************
+  * @brief 发布一条TXT记录
+  * @param key 键
+  * @param value 值
+  */
+ static void publish_txt_item(const char *key, const char *value)
+ {
+     esp_err_t err = mdns_service_txt_item_set(MDNS_SERVICE_TYPE, MDNS_SERVICE_PROTO, key, value);
+     if (err != ESP_OK) {
+         ESP_LOGW(TAG, "Failed to update TXT %s=%s: %s", key, value, esp_err_to_name(err));
+     }
+ }
+
+ /****************************************************************************
+  * @brief 发布定时器回调：仅发布与上次不同的TXT项
+  * @param timer 定时器句柄
+  *
+  * 所有TXT更新都在定时器任务中串行执行，每个间隔内的多次状态变化合并为一次重新通告。
+  */
+ static void publish_timer_callback(TimerHandle_t timer)
+ {
+     mdns_device_state_t state = {
+         .streaming = current_state.streaming,
+         .alarm = current_state.alarm,
+         .clients = current_state.clients,
+     };
+     char value[8];
+
+     if (!mdns_running) {
+         return;
+     }
+
+     if (state.streaming != published_state.streaming) {
+         publish_txt_item("streaming", state.streaming ? "1" : "0");
+     }
+     if (state.alarm != published_state.alarm) {
+         snprintf(value, sizeof(value), "%u", state.alarm);
+         publish_txt_item("alarm", value);
+     }
+     if (state.clients != published_state.clients) {
+         snprintf(value, sizeof(value), "%u", state.clients);
+         publish_txt_item("clients", value);
+     }
+
+     published_state = state;
+     last_publish_tick = xTaskGetTickCount();
+     ESP_LOGD(TAG, "TXT state published: streaming=%d alarm=%u clients=%u",
+              state.streaming, state.alarm, state.clients);
+ }
+
+ /****************************************************************************
+  * @brief 状态变化后安排一次限频发布
+  *
+  * 距上次发布已超过最小间隔时在下一个tick发布，否则延迟到间隔结束；
+  * 定时器已在等待时不重复安排，等待期间的变化会在那次发布中一并带上。
+  */
+ static void schedule_publish(void)
+ {
+     if (publish_timer == NULL || xTimerIsTimerActive(publish_timer)) {
+         return;
+     }
+
+     TickType_t interval = pdMS_TO_TICKS(CONFIG_MDNS_TXT_MIN_INTERVAL_MS);
+     TickType_t elapsed = xTaskGetTickCount() - last_publish_tick;
+     TickType_t delay = (elapsed >= interval) ? 1 : interval - elapsed;
+     xTimerChangePeriod(publish_timer, delay, 0);
+ }
+
  /****************************************************************************
   * @brief 初始化mDNS服务
   * @return esp_err_t ESP_OK成功，其他失败
   */
  esp_err_t mdns_service_init(void)
  {
+     // ==================== 由MAC派生唯一主机名 ====================
+     uint8_t mac[6] = {0};
+     if (esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK) {
+         snprintf(mac_str, sizeof(mac_str), "%02x%02x%02x%02x%02x%02x",
+                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+         snprintf(hostname, sizeof(hostname), "%s-%02x%02x%02x",
+                  MDNS_HOSTNAME_PREFIX, mac[3], mac[4], mac[5]);
+     } else {
+         ESP_LOGW(TAG, "Failed to read MAC, using default hostname");
+     }
+
+     // 实例名优先使用床位/房间号，便于在浏览列表中辨认
+     if (strlen(CONFIG_DEVICE_ROOM_ID) > 0 && strlen(CONFIG_DEVICE_BED_ID) > 0) {
+         snprintf(instance, sizeof(instance), "%s Room %s Bed %s", MDNS_INSTANCE,
+                  CONFIG_DEVICE_ROOM_ID, CONFIG_DEVICE_BED_ID);
+     } else if (strlen(CONFIG_DEVICE_BED_ID) > 0) {
+         snprintf(instance, sizeof(instance), "%s Bed %s", MDNS_INSTANCE, CONFIG_DEVICE_BED_ID);
+     } else {
+         snprintf(instance, sizeof(instance), "%s %s", MDNS_INSTANCE, hostname);
+     }
+
      // ==================== 初始化mDNS ====================
      esp_err_t err = mdns_init();
      if (err != ESP_OK) {
          ESP_LOGE(TAG, "Failed to initialize mDNS: %s", esp_err_to_name(err));
          return err;
      }
-     
+
      // ==================== 设置主机名 ====================
-     err = mdns_hostname_set(MDNS_HOSTNAME);
+     err = mdns_hostname_set(hostname);
      if (err != ESP_OK) {
          ESP_LOGE(TAG, "Failed to set mDNS hostname: %s", esp_err_to_name(err));
          mdns_free();
          return err;
      }
-     
+
      // ==================== 设置实例名 ====================
-     err = mdns_instance_name_set(MDNS_INSTANCE);
+     err = mdns_instance_name_set(instance);
      if (err != ESP_OK) {
          ESP_LOGE(TAG, "Failed to set mDNS instance name: %s", esp_err_to_name(err));
          mdns_free();
          return err;
      }
-     
+
      // ==================== 添加服务 ====================
      // 添加TCP服务，端口8080，服务类型"_esp32temp"
-     err = mdns_service_add(NULL, "_esp32temp", "_tcp", TCP_SERVER_PORT, NULL, 0);
+     err = mdns_service_add(NULL, MDNS_SERVICE_TYPE, MDNS_SERVICE_PROTO, TCP_SERVER_PORT, NULL, 0);
      if (err != ESP_OK) {
          ESP_LOGE(TAG, "Failed to add mDNS service: %s", esp_err_to_name(err));
          mdns_free();
          return err;
      }
-     
+
      // ==================== 添加服务TXT记录 ====================
+     // 静态部分：设备能力；动态部分：streaming/alarm/clients，之后按状态变化限频更新
+     published_state.streaming = current_state.streaming;
+     published_state.alarm = current_state.alarm;
+     published_state.clients = current_state.clients;
+
+     char alarm_str[4];
+     char clients_str[4];
+     snprintf(alarm_str, sizeof(alarm_str), "%u", published_state.alarm);
+     snprintf(clients_str, sizeof(clients_str), "%u", published_state.clients);
+
      mdns_txt_item_t serviceTxtData[] = {
          {"board", "ESP32-S3"},
          {"service", "temperature"},
-         {"version", "0.1"}
+         {"version", FIRMWARE_VERSION},
+         {"proto", PROTOCOL_VERSION},
+         {"mac", mac_str},
+         {"codecs", "pcm_s16le"},
+         {"rates", "44100"},
+         {"channels", "2"},
+         {"features", "history,taskstats,settime,credit"},
+         {"bed", CONFIG_DEVICE_BED_ID},
+         {"room", CONFIG_DEVICE_ROOM_ID},
+         {"streaming", published_state.streaming ? "1" : "0"},
+         {"alarm", alarm_str},
+         {"clients", clients_str},
      };
-     
-     err = mdns_service_txt_set("_esp32temp", "_tcp", serviceTxtData, 3);
+
+     err = mdns_service_txt_set(MDNS_SERVICE_TYPE, MDNS_SERVICE_PROTO, serviceTxtData,
+                                sizeof(serviceTxtData) / sizeof(serviceTxtData[0]));
      if (err != ESP_OK) {
          ESP_LOGW(TAG, "Failed to set mDNS TXT records: %s", esp_err_to_name(err));
          // 不是致命错误，继续运行
      }
-     
-     ESP_LOGI(TAG, "mDNS service started: %s.local", MDNS_HOSTNAME);
-     ESP_LOGI(TAG, "Service type: _esp32temp._tcp, port: %d", TCP_SERVER_PORT);
-     
+
+     // ==================== 创建限频发布定时器 ====================
+     last_publish_tick = xTaskGetTickCount();
+     publish_timer = xTimerCreate("mdns_txt", pdMS_TO_TICKS(CONFIG_MDNS_TXT_MIN_INTERVAL_MS),
+                                  pdFALSE, NULL, publish_timer_callback);
+     if (publish_timer == NULL) {
+         ESP_LOGW(TAG, "Failed to create TXT publish timer, state updates disabled");
+     }
+     mdns_running = true;
+
+     ESP_LOGI(TAG, "mDNS service started: %s.local (%s)", hostname, instance);
+     ESP_LOGI(TAG, "Service type: %s.%s, port: %d", MDNS_SERVICE_TYPE, MDNS_SERVICE_PROTO, TCP_SERVER_PORT);
+
      return ESP_OK;
  }
- 
+
  /****************************************************************************
   * @brief 停止mDNS服务
   */
  void mdns_service_stop(void)
  {
+     mdns_running = false;
+     if (publish_timer != NULL) {
+         xTimerDelete(publish_timer, portMAX_DELAY);
+         publish_timer = NULL;
+     }
      mdns_free();
      ESP_LOGI(TAG, "mDNS service stopped");
- }
\ No newline at end of file
+ }
+
+ /****************************************************************************
+  * @brief 获取本机mDNS主机名（由MAC地址派生，不含.local）
+  * @return 主机名字符串
+  */
+ const char *mdns_service_hostname(void)
+ {
+     return hostname;
+ }
+
+ /****************************************************************************
+  * @brief 更新音频流状态（TXT记录streaming，限频发布）
+  * @param streaming true - 正在播放
+  */
+ void mdns_service_set_streaming(bool streaming)
+ {
+     if (current_state.streaming != streaming) {
+         current_state.streaming = streaming;
+         schedule_publish();
+     }
+ }
+
+ /****************************************************************************
+  * @brief 更新告警等级（TXT记录alarm，限频发布）
+  * @param level 告警等级
+  */
+ void mdns_service_set_alarm(mdns_alarm_level_t level)
+ {
+     if (current_state.alarm != (uint8_t)level) {
+         current_state.alarm = (uint8_t)level;
+         schedule_publish();
+     }
+ }
+
+ /****************************************************************************
+  * @brief 更新已连接客户端数（TXT记录clients，限频发布）
+  * @param count 客户端数量
+  */
+ void mdns_service_set_clients(int count)
+ {
+     uint8_t clients = (count < 0) ? 0 : (count > 255 ? 255 : (uint8_t)count);
+     if (current_state.clients != clients) {
+         current_state.clients = clients;
+         schedule_publish();
+     }
+ }
@@ -3,13 +3,13 @@
  * @author bearbox <apuirbox@gmail.com>
  * @date 2025-11-05
  * @brief mDNS设备发现服务头文件
- * 
- * @version 0.1
- * 
+ *
+ * @version 0.2
+ *
  * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
- * 
+ *
  * @lastEditors bearbox <apuirbox@gmail.com>
- * @lastEditTime 2025-11-05
+ * @lastEditTime 2025-11-14
  * @filePath mdns_service.h
  * @projectType Embedded
  */
@@ -18,6 +18,15 @@
 #define MDNS_SERVICE_H
 
 #include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 告警等级（TXT记录alarm）
+typedef enum {
+    MDNS_ALARM_NORMAL = 0,      // 温度正常
+    MDNS_ALARM_THRESHOLD1 = 1,  // 达到阈值1
+    MDNS_ALARM_THRESHOLD2 = 2,  // 达到阈值2
+} mdns_alarm_level_t;
 
 /***
  * @brief 初始化mDNS服务
@@ -30,5 +39,28 @@ esp_err_t mdns_service_init(void);
  */
 void mdns_service_stop(void);
 
-#endif // MDNS_SERVICE_H
+/***
+ * @brief 获取本机mDNS主机名（由MAC地址派生，不含.local）
+ * @return 主机名字符串
+ */
+const char *mdns_service_hostname(void);
+
+/***
+ * @brief 更新音频流状态（TXT记录streaming，限频发布）
+ * @param streaming true - 正在播放
+ */
+void mdns_service_set_streaming(bool streaming);
 
+/***
+ * @brief 更新告警等级（TXT记录alarm，限频发布）
+ * @param level 告警等级
+ */
+void mdns_service_set_alarm(mdns_alarm_level_t level);
+
+/***
+ * @brief 更新已连接客户端数（TXT记录clients，限频发布）
+ * @param count 客户端数量
+ */
+void mdns_service_set_clients(int count);
+
+#endif // MDNS_SERVICE_H
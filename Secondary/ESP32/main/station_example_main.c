@@ -15,6 +15,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -31,7 +32,11 @@
 #include "tcp_server.h"
 #include "audio_handler.h"
 #include "mdns_service.h"
+#include "task_sched.h"
+#include "temp_store.h"
+#include "esp_netif_sntp.h"
 #include "driver/gpio.h"
+#include <sys/time.h>
 
 // ==================== WiFi配置 ====================
 #define EXAMPLE_ESP_WIFI_SSID      CONFIG_ESP_WIFI_SSID
@@ -173,6 +178,12 @@ static void uart_command_callback(uint32_t cmd_with_temp)
     
     ESP_LOGI(TAG, "T5L Command Received: 0x%02X, Temp: %d.%d°C", cmd, temp_value/10, temp_value%10);
     
+    // 所有温度命令都携带当前温度，统一写入历史存储
+    if (cmd == CMD_TEMP_THRESHOLD1 || cmd == CMD_TEMP_THRESHOLD2 ||
+        cmd == CMD_TEMP_NORMAL || cmd == CMD_TEMP_UPDATE) {
+        temp_store_add((int16_t)temp_value);
+    }
+    
     // 构建响应包：响应码 + 温度高字节 + 温度低字节（3字节）
     response[0] = 0;  // 将在switch中设置
     response[1] = (temp_value >> 8) & 0xFF;  // 温度高字节
@@ -183,6 +194,7 @@ static void uart_command_callback(uint32_t cmd_with_temp)
             // ==================== 温度达到阈值1 ====================
             ESP_LOGI(TAG, "Temperature Alert: Threshold 1 reached at %d.%d°C", temp_value/10, temp_value%10);
             response[0] = RESP_THRESHOLD1_REACHED;
+            mdns_service_set_alarm(MDNS_ALARM_THRESHOLD1);
             if (wifi_connected) {
                 tcp_server_send(response, 3, -1);  // 广播到所有客户端（3字节）
                 ESP_LOGI(TAG, "Broadcast threshold 1 notification with temp data to all clients");
@@ -193,6 +205,7 @@ static void uart_command_callback(uint32_t cmd_with_temp)
             // ==================== 温度达到阈值2 ====================
             ESP_LOGI(TAG, "Temperature Alert: Threshold 2 reached at %d.%d°C", temp_value/10, temp_value%10);
             response[0] = RESP_THRESHOLD2_REACHED;
+            mdns_service_set_alarm(MDNS_ALARM_THRESHOLD2);
             if (wifi_connected) {
                 tcp_server_send(response, 3, -1);  // 广播到所有客户端（3字节）
                 ESP_LOGI(TAG, "Broadcast threshold 2 notification with temp data to all clients");
@@ -203,6 +216,7 @@ static void uart_command_callback(uint32_t cmd_with_temp)
             // ==================== 温度恢复正常 ====================
             ESP_LOGI(TAG, "Temperature Status: Returned to normal at %d.%d°C", temp_value/10, temp_value%10);
             response[0] = RESP_TEMP_NORMAL;
+            mdns_service_set_alarm(MDNS_ALARM_NORMAL);
             if (wifi_connected) {
                 tcp_server_send(response, 3, -1);  // 广播到所有客户端（3字节）
                 ESP_LOGI(TAG, "Broadcast temperature normal notification with temp data to all clients");
@@ -225,6 +239,55 @@ static void uart_command_callback(uint32_t cmd_with_temp)
     }
 }
 
+// 温度历史查询发送上下文
+typedef struct {
+    int socket;
+    uint8_t resolution;
+    uint8_t *frame;   // 3字节帧头 + 分辨率 + 记录
+} temp_history_ctx_t;
+
+/****************************************************************************
+| * @brief 温度历史查询结果回调（每批记录打包为一个RESP_TEMP_HISTORY帧）
+| * @param recs 记录数组
+| * @param count 记录数
+| * @param ctx 发送上下文
+| * @return 0 - 继续，-1 - 发送失败
+| */
+static int temp_history_sink(const temp_record_t *recs, size_t count, void *ctx)
+{
+    temp_history_ctx_t *hc = (temp_history_ctx_t *)ctx;
+    
+    while (count > 0) {
+        size_t n = (count > TEMP_HISTORY_FRAME_RECS) ? TEMP_HISTORY_FRAME_RECS : count;
+        uint8_t *p = &hc->frame[4];
+        for (size_t i = 0; i < n; i++) {
+            const temp_record_t *r = &recs[i];
+            *p++ = (r->ts >> 24) & 0xFF;
+            *p++ = (r->ts >> 16) & 0xFF;
+            *p++ = (r->ts >> 8) & 0xFF;
+            *p++ = r->ts & 0xFF;
+            *p++ = ((uint16_t)r->min >> 8) & 0xFF;
+            *p++ = (uint16_t)r->min & 0xFF;
+            *p++ = ((uint16_t)r->max >> 8) & 0xFF;
+            *p++ = (uint16_t)r->max & 0xFF;
+            *p++ = ((uint16_t)r->avg >> 8) & 0xFF;
+            *p++ = (uint16_t)r->avg & 0xFF;
+        }
+        
+        size_t payload = 1 + n * TEMP_HISTORY_RECORD_SIZE;
+        hc->frame[0] = RESP_TEMP_HISTORY;
+        hc->frame[1] = (payload >> 8) & 0xFF;
+        hc->frame[2] = payload & 0xFF;
+        hc->frame[3] = hc->resolution;
+        if (tcp_server_send(hc->frame, payload + 3, hc->socket) < 0) {
+            return -1;
+        }
+        recs += n;
+        count -= n;
+    }
+    return 0;
+}
+
 /****************************************************************************
 | * @brief TCP数据处理回调
 | * @param data 接收到的数据
@@ -258,6 +321,7 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
             // ==================== 开始音频流 ====================
             ESP_LOGI(TAG, "CMD_AUDIO_STREAM_START: Starting audio stream");
             if (audio_stream_start() == ESP_OK) {
+                mdns_service_set_streaming(true);
                 uint8_t ack = RESP_AUDIO_ACK;
                 tcp_server_send(&ack, 1, socket);
                 ESP_LOGI(TAG, "Audio stream started successfully");
@@ -272,15 +336,15 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
             // ==================== 音频流数据 ====================
             if (len > 1) {
                 ESP_LOGD(TAG, "CMD_AUDIO_STREAM_DATA: %d bytes", len - 1);
-                if (audio_stream_feed(data + 1, len - 1) == ESP_OK) {
-                    // 定期发送ACK（每10个包发送一次）
-                    static int packet_count = 0;
-                    if (++packet_count >= 10) {
-                        uint8_t ack = RESP_AUDIO_ACK;
-                        tcp_server_send(&ack, 1, socket);
-                        ESP_LOGD(TAG, "Sent ACK after %d packets", packet_count);
-                        packet_count = 0;
-                    }
+                // 定期报告发送额度（每10个包一次，队列满丢包时立即报告）
+                static int packet_count = 0;
+                bool fed = (audio_stream_feed(data + 1, len - 1) == ESP_OK);
+                if (++packet_count >= 10 || !fed) {
+                    int slots = audio_stream_free_slots();
+                    uint8_t credit[2] = {RESP_AUDIO_CREDIT, (uint8_t)(slots > 255 ? 255 : slots)};
+                    tcp_server_send(credit, sizeof(credit), socket);
+                    ESP_LOGD(TAG, "Sent credit %d after %d packets", slots, packet_count);
+                    packet_count = 0;
                 }
             }
             break;
@@ -289,6 +353,7 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
             // ==================== 结束音频流 ====================
             ESP_LOGI(TAG, "CMD_AUDIO_STREAM_END: Stopping audio stream");
             audio_stream_end();
+            mdns_service_set_streaming(false);
             {
                 uint8_t ack = RESP_AUDIO_ACK;
                 tcp_server_send(&ack, 1, socket);
@@ -300,6 +365,7 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
             // ==================== 停止音频播放 ====================
             ESP_LOGI(TAG, "CMD_STOP_AUDIO: Stopping audio playback");
             audio_stop();
+            mdns_service_set_streaming(false);
             {
                 uint8_t ack = RESP_AUDIO_ACK;
                 tcp_server_send(&ack, 1, socket);
@@ -331,10 +397,11 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
                 int pos = 0;
                 response[pos++] = RESP_DEVICE_INFO;
                 
-                // 添加设备信息（简单格式）
+                // 添加设备信息（长度1字节 + 设备名）
                 const char *device_name = "ESP32-S3 Temp Monitor";
                 size_t name_len = strlen(device_name);
                 if (name_len > 60) name_len = 60;
+                response[pos++] = (uint8_t)name_len;
                 memcpy(&response[pos], device_name, name_len);
                 pos += name_len;
                 
@@ -343,6 +410,75 @@ static void tcp_data_callback(const uint8_t *data, size_t len, int socket)
             }
             break;
             
+        case CMD_QUERY_TASK_STATS:
+            // ==================== 查询任务CPU占用 ====================
+            {
+                uint8_t *response = (uint8_t *)malloc(TASK_STATS_REPORT_SIZE + 3);
+                if (response == NULL) {
+                    uint8_t err = RESP_ERROR;
+                    tcp_server_send(&err, 1, socket);
+                    break;
+                }
+                int report_len = task_sched_report((char *)&response[3], TASK_STATS_REPORT_SIZE);
+                response[0] = RESP_TASK_STATS;
+                response[1] = (report_len >> 8) & 0xFF;
+                response[2] = report_len & 0xFF;
+                tcp_server_send(response, report_len + 3, socket);
+                ESP_LOGI(TAG, "CMD_QUERY_TASK_STATS: Sent %d bytes report", report_len);
+                free(response);
+            }
+            break;
+            
+        case CMD_QUERY_TEMP_HISTORY:
+            // ==================== 查询温度历史 ====================
+            {
+                if (len < 10) {
+                    uint8_t err = RESP_ERROR;
+                    tcp_server_send(&err, 1, socket);
+                    break;
+                }
+                uint32_t start = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) |
+                                 ((uint32_t)data[4] << 8) | data[5];
+                uint32_t end = ((uint32_t)data[6] << 24) | ((uint32_t)data[7] << 16) |
+                               ((uint32_t)data[8] << 8) | data[9];
+                
+                temp_history_ctx_t hc = {
+                    .socket = socket,
+                    .resolution = data[1],
+                    .frame = (uint8_t *)malloc(4 + TEMP_HISTORY_FRAME_RECS * TEMP_HISTORY_RECORD_SIZE),
+                };
+                if (hc.frame == NULL) {
+                    uint8_t err = RESP_ERROR;
+                    tcp_server_send(&err, 1, socket);
+                    break;
+                }
+                
+                int count = temp_store_query((temp_resolution_t)data[1], start, end, temp_history_sink, &hc);
+                if (count >= 0) {
+                    // 空记录帧表示结束
+                    uint8_t end_frame[4] = {RESP_TEMP_HISTORY, 0, 1, data[1]};
+                    tcp_server_send(end_frame, sizeof(end_frame), socket);
+                    ESP_LOGI(TAG, "CMD_QUERY_TEMP_HISTORY: res=%d, %d records", data[1], count);
+                } else {
+                    uint8_t err = RESP_ERROR;
+                    tcp_server_send(&err, 1, socket);
+                    ESP_LOGW(TAG, "CMD_QUERY_TEMP_HISTORY: query failed");
+                }
+                free(hc.frame);
+            }
+            break;
+            
+        case CMD_SET_TIME:
+            // ==================== 设置系统时间 ====================
+            if (len >= 5) {
+                uint32_t epoch = ((uint32_t)data[1] << 24) | ((uint32_t)data[2] << 16) |
+                                 ((uint32_t)data[3] << 8) | data[4];
+                struct timeval tv = { .tv_sec = epoch, .tv_usec = 0 };
+                settimeofday(&tv, NULL);
+                ESP_LOGI(TAG, "CMD_SET_TIME: %lu", (unsigned long)epoch);
+            }
+            break;
+            
         default:
             ESP_LOGW(TAG, "Unknown TCP command: 0x%02X", cmd);
             {
@@ -379,11 +515,23 @@ void app_main(void)
     ESP_LOGI(TAG, "Free Heap: %lu bytes", esp_get_free_heap_size());
     ESP_LOGI(TAG, "========================================");
     
+    // ==================== 任务调度配置 ====================
+    task_sched_init();
+    
     // ==================== WiFi初始化 ====================
     ESP_LOGI(TAG, "Step 1: WiFi Initialization");
     wifi_init_sta();
     ESP_LOGI(TAG, "WiFi initialization completed (Connected: %s)", wifi_connected ? "YES" : "NO");
     
+    // ==================== 时间同步与历史存储 ====================
+    if (wifi_connected) {
+        esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_TEMP_STORE_SNTP_SERVER);
+        esp_netif_sntp_init(&sntp_config);
+    }
+    if (temp_store_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Temperature store running without flash persistence");
+    }
+    
     // ==================== UART初始化 ====================
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Step 2: UART Communication Setup");
@@ -422,8 +570,8 @@ void app_main(void)
     ESP_LOGI(TAG, "Step 4: mDNS Service Setup");
     if (wifi_connected) {
         if (mdns_service_init() == ESP_OK) {
-            ESP_LOGI(TAG, "mDNS service started: %s.local", MDNS_HOSTNAME);
-            ESP_LOGI(TAG, "Service type: _esp32temp._tcp, Port: %d", TCP_SERVER_PORT);
+            ESP_LOGI(TAG, "mDNS service started: %s.local", mdns_service_hostname());
+            ESP_LOGI(TAG, "Service type: %s.%s, Port: %d", MDNS_SERVICE_TYPE, MDNS_SERVICE_PROTO, TCP_SERVER_PORT);
         } else {
             ESP_LOGW(TAG, "Failed to start mDNS service");
         }
@@ -437,6 +585,7 @@ void app_main(void)
     if (wifi_connected) {
         ESP_LOGI(TAG, "Starting TCP server on port %d...", TCP_SERVER_PORT);
         tcp_server_register_callback(tcp_data_callback);
+        tcp_server_register_client_callback(mdns_service_set_clients);
         if (tcp_server_start() == ESP_OK) {
             ESP_LOGI(TAG, "TCP server started successfully");
             ESP_LOGI(TAG, "Listening for connections...");
@@ -0,0 +1,276 @@
+/***
+ * @file task_sched.c
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-12
+ * @brief 任务调度配置模块（核心绑定+优先级+CPU占用统计）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-12
+ * @filePath task_sched.c
+ * @projectType Embedded
+ */
+
+#include "task_sched.h"
+#include "esp_log.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TASK_SCHED";
+
+#define TASK_SCHED_SPARE_SLOTS  4    // 快照缓冲区在当前任务数之外预留的位置（取数与快照之间可能新建任务）
+
+// 任务类别描述
+typedef struct {
+    const char *name;
+    uint32_t budget_ms;   // 延迟预算（毫秒）
+    bool audio_core;      // true - 绑定音频核心，false - 绑定网络核心
+    UBaseType_t priority; // 由预算推导出的优先级
+} task_class_info_t;
+
+static task_class_info_t class_table[TASK_CLASS_MAX] = {
+    [TASK_CLASS_AUDIO]      = {"audio",      CONFIG_TASK_SCHED_BUDGET_AUDIO_MS,      true,  0},
+    [TASK_CLASS_UART]       = {"uart",       CONFIG_TASK_SCHED_BUDGET_UART_MS,       false, 0},
+    [TASK_CLASS_TCP_CLIENT] = {"tcp_client", CONFIG_TASK_SCHED_BUDGET_TCP_CLIENT_MS, false, 0},
+    [TASK_CLASS_TCP_ACCEPT] = {"tcp_accept", CONFIG_TASK_SCHED_BUDGET_TCP_ACCEPT_MS, false, 0},
+    [TASK_CLASS_STORAGE]    = {"storage",    CONFIG_TASK_SCHED_BUDGET_STORAGE_MS,    false, 0},
+};
+
+static bool sched_initialized = false;
+static SemaphoreHandle_t report_mutex = NULL;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// 上一次报告时的运行时间快照
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} task_runtime_t;
+
+// 运行时间计数器为1MHz（esp_timer）；32位计数器约71.6分钟回绕一次，
+// 无符号相减可跨过一次回绕，两次报告间隔超过一个回绕周期时增量不可信
+#define TASK_SCHED_COUNTER_PERIOD_MS ((uint64_t)((configRUN_TIME_COUNTER_TYPE)-1) / 1000 + 1)
+
+// 快照缓冲区按任务数增长，不缩小
+static TaskStatus_t *status_buf = NULL;
+static task_runtime_t *prev_runtime = NULL;
+static UBaseType_t buf_capacity = 0;
+static UBaseType_t prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE prev_total = 0;
+static TickType_t prev_tick = 0;
+
+/****************************************************************************
+ * @brief 确保快照缓冲区至少容纳n个任务
+ * @return true - 成功，false - 内存不足（原缓冲区保持不变）
+ */
+static bool ensure_capacity(UBaseType_t n)
+{
+    if (n <= buf_capacity) {
+        return true;
+    }
+    TaskStatus_t *status = (TaskStatus_t *)realloc(status_buf, n * sizeof(TaskStatus_t));
+    if (status == NULL) {
+        return false;
+    }
+    status_buf = status;
+    task_runtime_t *runtime = (task_runtime_t *)realloc(prev_runtime, n * sizeof(task_runtime_t));
+    if (runtime == NULL) {
+        return false;
+    }
+    prev_runtime = runtime;
+    buf_capacity = n;
+    return true;
+}
+#endif
+
+/****************************************************************************
+ * @brief 初始化调度配置（根据延迟预算计算各类任务优先级）
+ *
+ * 采用截止期单调（deadline-monotonic）分配：预算越短优先级越高，
+ * 最短预算取CONFIG_TASK_SCHED_PRIO_CEILING，其余逐级递减，预算相同则优先级相同。
+ */
+void task_sched_init(void)
+{
+    if (sched_initialized) {
+        return;
+    }
+
+    for (int i = 0; i < TASK_CLASS_MAX; i++) {
+        UBaseType_t rank = 0;
+        for (int j = 0; j < TASK_CLASS_MAX; j++) {
+            if (class_table[j].budget_ms < class_table[i].budget_ms) {
+                rank++;
+            }
+        }
+        UBaseType_t prio = (rank < CONFIG_TASK_SCHED_PRIO_CEILING) ? CONFIG_TASK_SCHED_PRIO_CEILING - rank : 1;
+        class_table[i].priority = prio;
+    }
+
+    report_mutex = xSemaphoreCreateMutex();
+    sched_initialized = true;
+
+    for (int i = 0; i < TASK_CLASS_MAX; i++) {
+        ESP_LOGI(TAG, "Class %-10s budget=%lums prio=%u core=%d",
+                 class_table[i].name, class_table[i].budget_ms,
+                 class_table[i].priority, task_sched_core((task_class_t)i));
+    }
+}
+
+/****************************************************************************
+ * @brief 获取任务类别对应的优先级
+ * @param cls 任务类别
+ * @return FreeRTOS任务优先级
+ */
+UBaseType_t task_sched_priority(task_class_t cls)
+{
+    task_sched_init();
+    if (cls >= TASK_CLASS_MAX) {
+        return 1;
+    }
+    return class_table[cls].priority;
+}
+
+/****************************************************************************
+ * @brief 获取任务类别绑定的核心
+ * @param cls 任务类别
+ * @return 核心编号，tskNO_AFFINITY表示不绑定
+ */
+BaseType_t task_sched_core(task_class_t cls)
+{
+#if CONFIG_TASK_SCHED_PROFILE_SPLIT && !CONFIG_FREERTOS_UNICORE
+    if (cls < TASK_CLASS_MAX && class_table[cls].audio_core) {
+        return CONFIG_TASK_SCHED_AUDIO_CORE;
+    }
+    return CONFIG_TASK_SCHED_NET_CORE;
+#else
+    (void)cls;
+    return tskNO_AFFINITY;
+#endif
+}
+
+/****************************************************************************
+ * @brief 按调度配置创建任务
+ * @param fn 任务函数
+ * @param name 任务名
+ * @param stack_size 栈大小（字节）
+ * @param arg 任务参数
+ * @param cls 任务类别
+ * @param handle 任务句柄输出（可为NULL）
+ * @return pdPASS - 成功，其他 - 失败
+ */
+BaseType_t task_sched_create(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                             void *arg, task_class_t cls, TaskHandle_t *handle)
+{
+    UBaseType_t prio = task_sched_priority(cls);
+    BaseType_t core = task_sched_core(cls);
+
+    ESP_LOGD(TAG, "Creating task %s (prio=%u, core=%d)", name, prio, core);
+    return xTaskCreatePinnedToCore(fn, name, stack_size, arg, prio, handle, core);
+}
+
+/****************************************************************************
+ * @brief 生成各任务CPU占用报告（自上次调用以来的增量）
+ * @param buf 输出缓冲区
+ * @param len 缓冲区长度
+ * @return 写入的字节数（不含结尾'\0'）
+ *
+ * 输出为文本，每行一个任务：名称 核心 优先级 CPU占用(%，单核百分比) 栈余量(字节)。
+ */
+int task_sched_report(char *buf, size_t len)
+{
+    if (buf == NULL || len == 0) {
+        return 0;
+    }
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    task_sched_init();
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+
+    // 缓冲区不足时uxTaskGetSystemState返回0，按当前任务数增长后重试一次
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = 0;
+    for (int attempt = 0; attempt < 2 && count == 0; attempt++) {
+        UBaseType_t needed = uxTaskGetNumberOfTasks() + TASK_SCHED_SPARE_SLOTS;
+        if (!ensure_capacity(needed)) {
+            ESP_LOGW(TAG, "No memory for a %u-task snapshot", (unsigned)needed);
+            break;
+        }
+        count = uxTaskGetSystemState(status_buf, buf_capacity, &total);
+    }
+    if (count == 0) {
+        ESP_LOGW(TAG, "Task snapshot overflowed (%u tasks, %u slots)",
+                 (unsigned)uxTaskGetNumberOfTasks(), (unsigned)buf_capacity);
+        xSemaphoreGive(report_mutex);
+        int pos = snprintf(buf, len, "task snapshot failed (%u tasks)\n", (unsigned)uxTaskGetNumberOfTasks());
+        return (pos >= (int)len) ? (int)len - 1 : pos;
+    }
+
+    // 计数器差值按无符号回绕计算；间隔超过一个回绕周期时本次只重置基准
+    TickType_t now = xTaskGetTickCount();
+    bool stale = prev_count > 0 &&
+                 (uint64_t)(TickType_t)(now - prev_tick) * portTICK_PERIOD_MS >= TASK_SCHED_COUNTER_PERIOD_MS;
+    configRUN_TIME_COUNTER_TYPE window = total - prev_total;
+    if (window == 0) {
+        window = 1;
+    }
+
+    int pos;
+    if (stale) {
+        pos = snprintf(buf, len, "window exceeds run-time counter period (%lus), baseline reset tasks=%u\n",
+                       (unsigned long)(TASK_SCHED_COUNTER_PERIOD_MS / 1000), (unsigned)count);
+    } else {
+        pos = snprintf(buf, len, "window_ms=%lu tasks=%u\n",
+                       (unsigned long)(window / 1000), (unsigned)count);
+    }
+
+    for (UBaseType_t i = 0; !stale && i < count && pos < (int)len; i++) {
+        TaskStatus_t *st = &status_buf[i];
+
+        // ==================== 计算与上次快照的运行时间差 ====================
+        configRUN_TIME_COUNTER_TYPE delta = st->ulRunTimeCounter;
+        for (UBaseType_t j = 0; j < prev_count; j++) {
+            if (prev_runtime[j].handle == st->xHandle) {
+                delta = st->ulRunTimeCounter - prev_runtime[j].runtime;
+                break;
+            }
+        }
+
+        // 上次快照之后新建的任务取其全部运行时间，不超过窗口
+        uint64_t permille = (uint64_t)delta * 1000 / window;
+        if (permille > 1000) {
+            permille = 1000;
+        }
+        int core = -1;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        core = (st->xCoreID == tskNO_AFFINITY) ? -1 : (int)st->xCoreID;
+#endif
+        pos += snprintf(buf + pos, len - pos, "%-16s %2d %2u %3lu.%lu%% %5lu\n",
+                        st->pcTaskName, core, (unsigned)st->uxCurrentPriority,
+                        (unsigned long)(permille / 10), (unsigned long)(permille % 10),
+                        (unsigned long)st->usStackHighWaterMark);
+    }
+
+    // ==================== 保存快照供下次计算增量 ====================
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev_runtime[i].handle = status_buf[i].xHandle;
+        prev_runtime[i].runtime = status_buf[i].ulRunTimeCounter;
+    }
+    prev_count = count;
+    prev_total = total;
+    prev_tick = now;
+
+    xSemaphoreGive(report_mutex);
+
+    if (pos >= (int)len) {
+        pos = len - 1;
+    }
+    return pos;
+#else
+    int pos = snprintf(buf, len, "run-time stats disabled (enable FREERTOS_GENERATE_RUN_TIME_STATS)\n");
+    return (pos >= (int)len) ? (int)len - 1 : pos;
+#endif
+}
@@ -0,0 +1,76 @@
+/***
+ * @file task_sched.h
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-12
+ * @brief 任务调度配置模块头文件（核心绑定+优先级+CPU占用统计）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-12
+ * @filePath task_sched.h
+ * @projectType Embedded
+ */
+
+#ifndef TASK_SCHED_H
+#define TASK_SCHED_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// 任务类别（每类对应一个延迟预算，优先级按预算由短到长依次递减）
+typedef enum {
+    TASK_CLASS_AUDIO = 0,    // 音频播放（I2S DMA供数）
+    TASK_CLASS_UART,         // UART事件处理（T5L温度命令）
+    TASK_CLASS_TCP_CLIENT,   // TCP客户端收发
+    TASK_CLASS_TCP_ACCEPT,   // TCP监听/接受连接
+    TASK_CLASS_STORAGE,      // Flash存储（温度历史落盘）
+    TASK_CLASS_MAX,
+} task_class_t;
+
+/***
+ * @brief 初始化调度配置（根据延迟预算计算各类任务优先级）
+ */
+void task_sched_init(void);
+
+/***
+ * @brief 获取任务类别对应的优先级
+ * @param cls 任务类别
+ * @return FreeRTOS任务优先级
+ */
+UBaseType_t task_sched_priority(task_class_t cls);
+
+/***
+ * @brief 获取任务类别绑定的核心
+ * @param cls 任务类别
+ * @return 核心编号，tskNO_AFFINITY表示不绑定
+ */
+BaseType_t task_sched_core(task_class_t cls);
+
+/***
+ * @brief 按调度配置创建任务
+ * @param fn 任务函数
+ * @param name 任务名
+ * @param stack_size 栈大小（字节）
+ * @param arg 任务参数
+ * @param cls 任务类别
+ * @param handle 任务句柄输出（可为NULL）
+ * @return pdPASS - 成功，其他 - 失败
+ */
+BaseType_t task_sched_create(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                             void *arg, task_class_t cls, TaskHandle_t *handle);
+
+/***
+ * @brief 生成各任务CPU占用报告（自上次调用以来的增量）
+ * @param buf 输出缓冲区
+ * @param len 缓冲区长度
+ * @return 写入的字节数（不含结尾'\0'）
+ */
+int task_sched_report(char *buf, size_t len);
+
+#endif // TASK_SCHED_H
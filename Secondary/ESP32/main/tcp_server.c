@@ -16,6 +16,7 @@
 
 #include "tcp_server.h"
 #include "esp32_main.h"
+#include "task_sched.h"
 #include "esp_log.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
@@ -35,6 +36,7 @@ typedef struct {
 static int server_socket = -1;
 static client_info_t clients[MAX_CONNECTIONS];
 static tcp_data_callback_t g_data_callback = NULL;
+static tcp_client_callback_t g_client_callback = NULL;
 static bool server_running = false;
 
 /****************************************************************************
@@ -51,6 +53,16 @@ static int find_free_client_slot(void)
     return -1;
 }
 
+/****************************************************************************
+ * @brief 通知客户端数量变化
+ */
+static void notify_client_change(void)
+{
+    if (g_client_callback != NULL) {
+        g_client_callback(tcp_server_client_count());
+    }
+}
+
 /****************************************************************************
  * @brief 客户端处理任务
  * @param pvParameters 客户端索引指针
@@ -95,6 +107,7 @@ static void client_handler_task(void *pvParameters)
     close(client->socket);
     client->active = false;
     client->socket = -1;
+    notify_client_change();
     
     ESP_LOGI(TAG, "Client handler terminated for socket index %d", client_idx);
     vTaskDelete(NULL);
@@ -182,13 +195,15 @@ static void tcp_server_task(void *pvParameters)
         char task_name[32];
         snprintf(task_name, sizeof(task_name), "tcp_client_%d", slot);
         // 增加栈大小到8192，防止栈溢出
-        if (xTaskCreate(client_handler_task, task_name, 8192, slot_ptr, 5, NULL) != pdPASS) {
+        if (task_sched_create(client_handler_task, task_name, 8192, slot_ptr, TASK_CLASS_TCP_CLIENT, NULL) != pdPASS) {
             ESP_LOGE(TAG, "Failed to create client handler task");
             close(client_sock);
             clients[slot].active = false;
             clients[slot].socket = -1;
             free(slot_ptr);
+            continue;
         }
+        notify_client_change();
     }
     
     // ==================== 清理所有连接 ====================
@@ -217,7 +232,7 @@ esp_err_t tcp_server_start(void)
         return ESP_OK;
     }
     
-    if (xTaskCreate(tcp_server_task, "tcp_server", 8192, NULL, 5, NULL) != pdPASS) {
+    if (task_sched_create(tcp_server_task, "tcp_server", 8192, NULL, TASK_CLASS_TCP_ACCEPT, NULL) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create TCP server task");
         return ESP_FAIL;
     }
@@ -261,6 +276,30 @@ void tcp_server_register_callback(tcp_data_callback_t callback)
     g_data_callback = callback;
 }
 
+/****************************************************************************
+ * @brief 注册客户端数量变化回调函数（连接建立或断开时调用）
+ * @param callback 回调函数指针
+ */
+void tcp_server_register_client_callback(tcp_client_callback_t callback)
+{
+    g_client_callback = callback;
+}
+
+/****************************************************************************
+ * @brief 获取当前已连接的客户端数量
+ * @return 客户端数量
+ */
+int tcp_server_client_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (clients[i].active) {
+            count++;
+        }
+    }
+    return count;
+}
+
 /****************************************************************************
  * @brief 发送数据到指定客户端
  * @param data 数据指针
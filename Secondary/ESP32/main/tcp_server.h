@@ -24,6 +24,9 @@
 // TCP数据回调函数类型
 typedef void (*tcp_data_callback_t)(const uint8_t *data, size_t len, int socket);
 
+// 客户端数量变化回调函数类型
+typedef void (*tcp_client_callback_t)(int client_count);
+
 /***
  * @brief 启动TCP服务器
  * @return ESP_OK - 成功，ESP_FAIL - 失败
@@ -41,6 +44,18 @@ void tcp_server_stop(void);
  */
 void tcp_server_register_callback(tcp_data_callback_t callback);
 
+/***
+ * @brief 注册客户端数量变化回调函数（连接建立或断开时调用）
+ * @param callback 回调函数指针
+ */
+void tcp_server_register_client_callback(tcp_client_callback_t callback);
+
+/***
+ * @brief 获取当前已连接的客户端数量
+ * @return 客户端数量
+ */
+int tcp_server_client_count(void);
+
 /***
  * @brief 发送数据到指定客户端
  * @param data 数据指针
@@ -0,0 +1,681 @@
+/***
+ * @file temp_store.c
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-13
+ * @brief 温度时间序列存储模块（RAM差分编码+Flash分级汇总）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-13
+ * @filePath temp_store.c
+ * @projectType Embedded
+ */
+
+#include "temp_store.h"
+#include "task_sched.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "TEMP_STORE";
+
+// ==================== 内部配置 ====================
+#define SEC_BLOCK_CAPACITY  63           // 每个秒级块的增量槽位数
+#define SEC_GAP_MARKER      INT8_MIN     // 缺失样本标记
+#define SECTOR_SIZE         4096
+#define SECTOR_MAGIC        0x50534D54   // "TMSP"
+#define RECORD_EMPTY_TS     0xFFFFFFFF   // 擦除后的Flash内容
+#define PENDING_CAPACITY    (CONFIG_TEMP_STORE_FLUSH_INTERVAL_MIN * 2 + 8)
+#define QUERY_BATCH         64           // 每批回调的记录数
+#define FLUSH_TASK_STACK    3072
+
+// Flash扇区头（16字节），其后紧跟汇总记录
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;        // 扇区写入序号，最大者为当前写入扇区
+    uint8_t res;         // 分辨率（temp_resolution_t）
+    uint8_t reserved[7];
+} sector_header_t;
+
+#define RECS_PER_SECTOR     ((SECTOR_SIZE - sizeof(sector_header_t)) / sizeof(temp_record_t))
+
+// 秒级差分编码块：首样本完整保存，后续每秒一个int8增量
+typedef struct {
+    uint32_t t0;                         // 首样本时间
+    int16_t v0;                          // 首样本值
+    uint8_t n;                           // 已用增量槽位数（第i个槽位对应t0+i+1）
+    int8_t delta[SEC_BLOCK_CAPACITY];
+} sec_block_t;
+
+// 汇总累加器
+typedef struct {
+    uint32_t ts;
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint16_t count;
+} rollup_acc_t;
+
+// 待落盘记录缓冲
+typedef struct {
+    temp_record_t recs[PENDING_CAPACITY];
+    size_t count;
+    uint32_t base;       // 首元素的累计序号（用于落盘后精确移除）
+} pending_buf_t;
+
+// Flash环形区
+typedef struct {
+    uint32_t base_sector;  // 在分区内的起始扇区
+    uint32_t sectors;      // 扇区数
+    uint32_t head;         // 当前写入扇区（相对）
+    uint32_t slot;         // 当前扇区下一个写入槽位
+    uint32_t seq;          // 当前扇区序号
+    uint8_t res;
+} flash_ring_t;
+
+// 查询批处理上下文
+typedef struct {
+    temp_record_t buf[QUERY_BATCH];
+    size_t n;
+    int total;
+    temp_record_sink_t sink;
+    void *ctx;
+    temp_record_t tail[PENDING_CAPACITY + 2];  // 汇总查询的RAM部分快照（随上下文在堆上分配）
+} query_ctx_t;
+
+static SemaphoreHandle_t store_mutex = NULL;
+static TaskHandle_t flush_task_handle = NULL;
+
+// 秒级RAM环
+static sec_block_t sec_blocks[CONFIG_TEMP_STORE_SEC_BLOCKS];
+static uint32_t sec_head = 0;
+static uint32_t sec_used = 0;
+static uint32_t last_t = 0;
+static int16_t last_v = 0;
+
+// 汇总
+static rollup_acc_t minute_acc;
+static rollup_acc_t hour_acc;
+static pending_buf_t pending[2];         // [0] - 分钟，[1] - 小时
+static flash_ring_t rings[2];            // [0] - 分钟，[1] - 小时
+
+// Flash分区
+static const esp_partition_t *store_part = NULL;
+static const uint8_t *store_map = NULL;
+static esp_partition_mmap_handle_t store_map_handle;
+
+// ==================== 秒级差分编码 ====================
+
+static void sec_new_block(uint32_t t, int16_t v)
+{
+    if (sec_used > 0) {
+        sec_head = (sec_head + 1) % CONFIG_TEMP_STORE_SEC_BLOCKS;
+    }
+    if (sec_used < CONFIG_TEMP_STORE_SEC_BLOCKS) {
+        sec_used++;
+    }
+    sec_block_t *b = &sec_blocks[sec_head];
+    b->t0 = t;
+    b->v0 = v;
+    b->n = 0;
+    last_t = t;
+    last_v = v;
+}
+
+static void sec_append(uint32_t t, int16_t v)
+{
+    if (sec_used == 0) {
+        sec_new_block(t, v);
+        return;
+    }
+    if (t == last_t) {
+        return;  // 同一秒内的重复样本，保留首个
+    }
+    if (t < last_t) {
+        // 时钟回拨：秒级数据不再单调，直接丢弃
+        ESP_LOGW(TAG, "Clock moved backwards (%lu -> %lu), resetting 1s tier",
+                 (unsigned long)last_t, (unsigned long)t);
+        sec_used = 0;
+        sec_head = 0;
+        sec_new_block(t, v);
+        return;
+    }
+
+    sec_block_t *b = &sec_blocks[sec_head];
+    uint32_t gap = t - last_t - 1;
+    int32_t delta = (int32_t)v - last_v;
+    if (delta <= SEC_GAP_MARKER || delta > INT8_MAX || b->n + gap + 1 > SEC_BLOCK_CAPACITY) {
+        sec_new_block(t, v);
+        return;
+    }
+
+    while (gap--) {
+        b->delta[b->n++] = SEC_GAP_MARKER;
+    }
+    b->delta[b->n++] = (int8_t)delta;
+    last_t = t;
+    last_v = v;
+}
+
+// ==================== 汇总累加 ====================
+
+static void acc_add(rollup_acc_t *acc, uint32_t ts, int16_t v)
+{
+    if (acc->count == 0) {
+        acc->ts = ts;
+        acc->min = v;
+        acc->max = v;
+        acc->sum = 0;
+    }
+    if (v < acc->min) acc->min = v;
+    if (v > acc->max) acc->max = v;
+    acc->sum += v;
+    acc->count++;
+}
+
+static void acc_merge(rollup_acc_t *dst, const rollup_acc_t *src)
+{
+    if (src->count == 0) {
+        return;
+    }
+    if (dst->count == 0) {
+        *dst = *src;
+        return;
+    }
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->sum += src->sum;
+    dst->count += src->count;
+}
+
+static void acc_to_record(const rollup_acc_t *acc, temp_record_t *rec)
+{
+    rec->ts = acc->ts;
+    rec->min = acc->min;
+    rec->max = acc->max;
+    rec->avg = (int16_t)(acc->sum / (int32_t)acc->count);
+    rec->count = acc->count;
+}
+
+static void pending_push(pending_buf_t *p, const temp_record_t *rec)
+{
+    if (p->count == PENDING_CAPACITY) {
+        // Flash长时间不可写时丢弃最旧的记录
+        memmove(&p->recs[0], &p->recs[1], (PENDING_CAPACITY - 1) * sizeof(temp_record_t));
+        p->count--;
+        p->base++;
+        ESP_LOGW(TAG, "Pending buffer full, dropped oldest record");
+    }
+    p->recs[p->count++] = *rec;
+}
+
+static void rollup_add(uint32_t t, int16_t v)
+{
+    uint32_t minute = t - t % 60;
+
+    if (minute_acc.count > 0 && minute != minute_acc.ts) {
+        temp_record_t rec;
+        acc_to_record(&minute_acc, &rec);
+        pending_push(&pending[0], &rec);
+
+        // 小时汇总由完成的分钟汇总合并而来
+        uint32_t hour = minute_acc.ts - minute_acc.ts % 3600;
+        if (hour_acc.count > 0 && hour != hour_acc.ts) {
+            acc_to_record(&hour_acc, &rec);
+            pending_push(&pending[1], &rec);
+            hour_acc.count = 0;
+        }
+        acc_merge(&hour_acc, &minute_acc);
+        hour_acc.ts = hour;
+        minute_acc.count = 0;
+    }
+
+    acc_add(&minute_acc, minute, v);
+}
+
+// ==================== Flash环形区 ====================
+
+static const sector_header_t *ring_header(const flash_ring_t *r, uint32_t sector)
+{
+    return (const sector_header_t *)(store_map + (r->base_sector + sector) * SECTOR_SIZE);
+}
+
+static const temp_record_t *ring_records(const flash_ring_t *r, uint32_t sector)
+{
+    return (const temp_record_t *)(store_map + (r->base_sector + sector) * SECTOR_SIZE +
+                                   sizeof(sector_header_t));
+}
+
+static esp_err_t ring_open_sector(flash_ring_t *r, uint32_t sector, uint32_t seq)
+{
+    size_t offset = (r->base_sector + sector) * SECTOR_SIZE;
+    esp_err_t ret = esp_partition_erase_range(store_part, offset, SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    sector_header_t header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = SECTOR_MAGIC;
+    header.seq = seq;
+    header.res = r->res;
+    ret = esp_partition_write(store_part, offset, &header, sizeof(header));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    r->head = sector;
+    r->slot = 0;
+    r->seq = seq;
+    return ESP_OK;
+}
+
+static esp_err_t ring_mount(flash_ring_t *r)
+{
+    bool found = false;
+    uint32_t best = 0;
+    uint32_t best_seq = 0;
+
+    for (uint32_t s = 0; s < r->sectors; s++) {
+        const sector_header_t *h = ring_header(r, s);
+        if (h->magic == SECTOR_MAGIC && h->res == r->res && (!found || h->seq > best_seq)) {
+            found = true;
+            best = s;
+            best_seq = h->seq;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "Formatting ring (res=%d, %lu sectors)", r->res, (unsigned long)r->sectors);
+        return ring_open_sector(r, 0, 1);
+    }
+
+    // 扫描当前扇区找到第一个空槽位
+    const temp_record_t *recs = ring_records(r, best);
+    uint32_t slot = 0;
+    while (slot < RECS_PER_SECTOR && recs[slot].ts != RECORD_EMPTY_TS) {
+        slot++;
+    }
+    r->head = best;
+    r->slot = slot;
+    r->seq = best_seq;
+    return ESP_OK;
+}
+
+static esp_err_t ring_append(flash_ring_t *r, const temp_record_t *rec)
+{
+    if (r->slot >= RECS_PER_SECTOR) {
+        esp_err_t ret = ring_open_sector(r, (r->head + 1) % r->sectors, r->seq + 1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    size_t offset = (r->base_sector + r->head) * SECTOR_SIZE + sizeof(sector_header_t) +
+                    r->slot * sizeof(temp_record_t);
+    esp_err_t ret = esp_partition_write(store_part, offset, rec, sizeof(*rec));
+    if (ret == ESP_OK) {
+        r->slot++;
+    }
+    return ret;
+}
+
+// ==================== 落盘 ====================
+
+static void flush_pending(void)
+{
+    // 待写记录快照：PENDING_CAPACITY随落盘间隔增长，放在落盘任务栈上会溢出；只有落盘任务调用，静态缓冲无需加锁
+    static temp_record_t recs[PENDING_CAPACITY];
+
+    if (store_part == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        size_t count;
+        uint32_t base;
+        flash_ring_t ring;
+
+        // 快照待写记录和环状态，写Flash期间不持有锁
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+        count = pending[i].count;
+        base = pending[i].base;
+        memcpy(recs, pending[i].recs, count * sizeof(temp_record_t));
+        ring = rings[i];
+        xSemaphoreGive(store_mutex);
+
+        if (count == 0) {
+            continue;
+        }
+
+        size_t written = 0;
+        while (written < count) {
+            esp_err_t ret = ring_append(&ring, &recs[written]);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(ret));
+                break;
+            }
+            written++;
+        }
+
+        // 提交环状态并移除已写入的记录（期间可能有旧记录因溢出被丢弃）
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+        rings[i] = ring;
+        uint32_t done_end = base + written;
+        if (done_end > pending[i].base) {
+            size_t remove = done_end - pending[i].base;
+            if (remove > pending[i].count) {
+                remove = pending[i].count;
+            }
+            memmove(&pending[i].recs[0], &pending[i].recs[remove],
+                    (pending[i].count - remove) * sizeof(temp_record_t));
+            pending[i].count -= remove;
+            pending[i].base += remove;
+        }
+        xSemaphoreGive(store_mutex);
+
+        ESP_LOGD(TAG, "Flushed %u records (res=%d)", (unsigned)written, rings[i].res);
+    }
+}
+
+static void temp_store_flush_task(void *arg)
+{
+    const TickType_t interval = pdMS_TO_TICKS(CONFIG_TEMP_STORE_FLUSH_INTERVAL_MIN * 60 * 1000);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, interval);
+        flush_pending();
+    }
+}
+
+// ==================== 查询 ====================
+
+static int query_emit(query_ctx_t *q, const temp_record_t *rec)
+{
+    q->buf[q->n++] = *rec;
+    q->total++;
+    if (q->n == QUERY_BATCH) {
+        size_t n = q->n;
+        q->n = 0;
+        return q->sink(q->buf, n, q->ctx);
+    }
+    return 0;
+}
+
+static int query_finish(query_ctx_t *q)
+{
+    if (q->n > 0 && q->sink(q->buf, q->n, q->ctx) < 0) {
+        return -1;
+    }
+    return q->total;
+}
+
+static int query_seconds(query_ctx_t *q, uint32_t start, uint32_t end)
+{
+    // 只复制与查询区间重叠的块，解码在锁外进行
+    sec_block_t *blocks = (sec_block_t *)malloc(CONFIG_TEMP_STORE_SEC_BLOCKS * sizeof(sec_block_t));
+    if (blocks == NULL) {
+        return -1;
+    }
+
+    size_t count = 0;
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    uint32_t oldest = (sec_head + CONFIG_TEMP_STORE_SEC_BLOCKS + 1 - sec_used) % CONFIG_TEMP_STORE_SEC_BLOCKS;
+    for (uint32_t i = 0; i < sec_used; i++) {
+        const sec_block_t *b = &sec_blocks[(oldest + i) % CONFIG_TEMP_STORE_SEC_BLOCKS];
+        if (b->t0 + b->n >= start && b->t0 <= end) {
+            blocks[count++] = *b;
+        }
+    }
+    xSemaphoreGive(store_mutex);
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret >= 0; i++) {
+        const sec_block_t *b = &blocks[i];
+        temp_record_t rec = {.count = 1};
+        int16_t v = b->v0;
+        if (b->t0 >= start && b->t0 <= end) {
+            rec.ts = b->t0;
+            rec.min = rec.max = rec.avg = v;
+            ret = query_emit(q, &rec);
+        }
+        for (uint8_t k = 0; k < b->n && ret >= 0; k++) {
+            if (b->delta[k] == SEC_GAP_MARKER) {
+                continue;
+            }
+            v += b->delta[k];
+            uint32_t ts = b->t0 + k + 1;
+            if (ts < start) {
+                continue;
+            }
+            if (ts > end) {
+                break;
+            }
+            rec.ts = ts;
+            rec.min = rec.max = rec.avg = v;
+            ret = query_emit(q, &rec);
+        }
+    }
+    free(blocks);
+
+    return (ret < 0) ? -1 : query_finish(q);
+}
+
+static int query_rollup(query_ctx_t *q, temp_resolution_t res, uint32_t start, uint32_t end)
+{
+    int idx = (res == TEMP_RES_MINUTE) ? 0 : 1;
+    temp_record_t *tail = q->tail;
+    size_t tail_count;
+    flash_ring_t ring;
+
+    // ==================== 快照：环位置 + 待落盘记录 + 未完成区间 ====================
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    ring = rings[idx];
+    tail_count = pending[idx].count;
+    memcpy(tail, pending[idx].recs, tail_count * sizeof(temp_record_t));
+    if (res == TEMP_RES_MINUTE) {
+        if (minute_acc.count > 0) {
+            acc_to_record(&minute_acc, &tail[tail_count++]);
+        }
+    } else if (minute_acc.count > 0 || hour_acc.count > 0) {
+        rollup_acc_t partial = hour_acc;
+        uint32_t cur_hour = minute_acc.ts - minute_acc.ts % 3600;
+        if (partial.count > 0 && minute_acc.count > 0 && partial.ts != cur_hour) {
+            acc_to_record(&partial, &tail[tail_count++]);
+            partial.count = 0;
+        }
+        acc_merge(&partial, &minute_acc);
+        if (minute_acc.count > 0) {
+            partial.ts = cur_hour;
+        }
+        acc_to_record(&partial, &tail[tail_count++]);
+    }
+    xSemaphoreGive(store_mutex);
+
+    // ==================== Flash部分：从最旧扇区开始，按首尾时间跳过整扇区 ====================
+    if (store_map != NULL && ring.sectors > 0) {
+        for (uint32_t i = 1; i <= ring.sectors; i++) {
+            uint32_t s = (ring.head + i) % ring.sectors;
+            const sector_header_t *h = ring_header(&ring, s);
+            if (h->magic != SECTOR_MAGIC || h->res != ring.res || h->seq > ring.seq ||
+                ring.seq - h->seq >= ring.sectors) {
+                continue;
+            }
+
+            const temp_record_t *recs = ring_records(&ring, s);
+            uint32_t n = (s == ring.head) ? ring.slot : RECS_PER_SECTOR;
+            while (n > 0 && recs[n - 1].ts == RECORD_EMPTY_TS) {
+                n--;
+            }
+            if (n == 0 || recs[0].ts > end || recs[n - 1].ts < start) {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < n; k++) {
+                if (recs[k].ts >= start && recs[k].ts <= end) {
+                    if (query_emit(q, &recs[k]) < 0) {
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    // ==================== RAM部分 ====================
+    for (size_t k = 0; k < tail_count; k++) {
+        if (tail[k].ts >= start && tail[k].ts <= end) {
+            if (query_emit(q, &tail[k]) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return query_finish(q);
+}
+
+/****************************************************************************
+ * @brief 初始化温度存储（挂载Flash分区并启动落盘任务）
+ * @return ESP_OK - 成功，其他 - 失败（此时仅保留RAM秒级数据）
+ *
+ * 分区前TEMP_STORE_HOUR_SECTORS个扇区之后为分钟环，其余为小时环。
+ * 每条记录12字节、每扇区340条，192KB分区的分钟环可保存约9天数据。
+ */
+esp_err_t temp_store_init(void)
+{
+    if (store_mutex != NULL) {
+        return ESP_OK;
+    }
+
+    store_mutex = xSemaphoreCreateMutex();
+    if (store_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // ==================== 挂载Flash分区 ====================
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY,
+                                                           TEMP_STORE_PARTITION_LABEL);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    uint32_t total_sectors = part ? part->size / SECTOR_SIZE : 0;
+    if (part == NULL || total_sectors <= TEMP_STORE_HOUR_SECTORS + 1) {
+        ESP_LOGW(TAG, "Partition '%s' missing or too small, RAM-only mode", TEMP_STORE_PARTITION_LABEL);
+    } else {
+        const void *map = NULL;
+        ret = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &store_map_handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Partition mmap failed: %s", esp_err_to_name(ret));
+        } else {
+            store_part = part;
+            store_map = (const uint8_t *)map;
+
+            rings[0] = (flash_ring_t){.base_sector = 0,
+                                      .sectors = total_sectors - TEMP_STORE_HOUR_SECTORS,
+                                      .res = TEMP_RES_MINUTE};
+            rings[1] = (flash_ring_t){.base_sector = total_sectors - TEMP_STORE_HOUR_SECTORS,
+                                      .sectors = TEMP_STORE_HOUR_SECTORS,
+                                      .res = TEMP_RES_HOUR};
+            for (int i = 0; i < 2 && ret == ESP_OK; i++) {
+                ret = ring_mount(&rings[i]);
+            }
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Ring mount failed: %s", esp_err_to_name(ret));
+                esp_partition_munmap(store_map_handle);
+                store_part = NULL;
+                store_map = NULL;
+            } else {
+                ESP_LOGI(TAG, "Mounted: minute ring %lu recs, hour ring %lu recs",
+                         (unsigned long)((rings[0].sectors - 1) * RECS_PER_SECTOR),
+                         (unsigned long)((rings[1].sectors - 1) * RECS_PER_SECTOR));
+            }
+        }
+    }
+
+    // ==================== 启动落盘任务 ====================
+    if (store_part != NULL &&
+        task_sched_create(temp_store_flush_task, "temp_store", FLUSH_TASK_STACK, NULL,
+                          TASK_CLASS_STORAGE, &flush_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create flush task");
+        ret = ESP_FAIL;
+    }
+
+    return ret;
+}
+
+/****************************************************************************
+ * @brief 系统时间是否已校准
+ * @return true - 已校准
+ */
+bool temp_store_time_valid(void)
+{
+    return time(NULL) >= (time_t)TEMP_STORE_MIN_VALID_EPOCH;
+}
+
+/****************************************************************************
+ * @brief 添加一个温度样本（时间戳取当前系统时间）
+ * @param value 温度值（0.1°C）
+ */
+void temp_store_add(int16_t value)
+{
+    if (store_mutex == NULL) {
+        return;
+    }
+    if (!temp_store_time_valid()) {
+        ESP_LOGD(TAG, "Clock not set, sample dropped");
+        return;
+    }
+
+    uint32_t t = (uint32_t)time(NULL);
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    sec_append(t, value);
+    rollup_add(t, value);
+    xSemaphoreGive(store_mutex);
+}
+
+/****************************************************************************
+ * @brief 按时间范围查询历史数据
+ * @param res 分辨率
+ * @param start 起始时间（Unix秒，含）
+ * @param end 结束时间（Unix秒，含）
+ * @param sink 结果回调
+ * @param ctx 回调用户参数
+ * @return 返回的记录数，负数表示失败或被回调中止
+ *
+ * Flash部分直接从内存映射读取，不复制，一天的分钟数据（1440条）只需扫描约5个扇区。
+ */
+int temp_store_query(temp_resolution_t res, uint32_t start, uint32_t end,
+                     temp_record_sink_t sink, void *ctx)
+{
+    if (store_mutex == NULL || sink == NULL || start > end || res > TEMP_RES_HOUR) {
+        return -1;
+    }
+
+    query_ctx_t *q = (query_ctx_t *)calloc(1, sizeof(query_ctx_t));
+    if (q == NULL) {
+        return -1;
+    }
+    q->sink = sink;
+    q->ctx = ctx;
+
+    int ret = (res == TEMP_RES_SECOND) ? query_seconds(q, start, end)
+                                       : query_rollup(q, res, start, end);
+    free(q);
+    return ret;
+}
+
+/****************************************************************************
+ * @brief 立即将缓冲的汇总数据写入Flash（通知落盘任务，不阻塞调用者）
+ */
+void temp_store_flush(void)
+{
+    if (flush_task_handle != NULL) {
+        xTaskNotifyGive(flush_task_handle);
+    }
+}
@@ -0,0 +1,90 @@
+/***
+ * @file temp_store.h
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-13
+ * @brief 温度时间序列存储模块头文件（RAM差分编码+Flash分级汇总）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-13
+ * @filePath temp_store.h
+ * @projectType Embedded
+ */
+
+#ifndef TEMP_STORE_H
+#define TEMP_STORE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ==================== 存储配置 ====================
+#define TEMP_STORE_PARTITION_LABEL  "tempstore"   // 数据分区名称（见partitions.csv）
+#define TEMP_STORE_HOUR_SECTORS     8             // 小时汇总占用的扇区数，其余扇区用于分钟汇总
+#define TEMP_STORE_MIN_VALID_EPOCH  1700000000UL  // 系统时间早于此值视为未校时，样本丢弃
+
+// 查询分辨率
+typedef enum {
+    TEMP_RES_SECOND = 0,   // 1秒原始样本（RAM，约1小时）
+    TEMP_RES_MINUTE = 1,   // 1分钟汇总（Flash，7天以上）
+    TEMP_RES_HOUR   = 2,   // 1小时汇总（Flash，约3个月）
+} temp_resolution_t;
+
+// 汇总记录（同时也是Flash中的存储格式，12字节）
+typedef struct {
+    uint32_t ts;      // 区间起始时间（Unix秒）
+    int16_t min;      // 最小值（0.1°C）
+    int16_t max;      // 最大值（0.1°C）
+    int16_t avg;      // 平均值（0.1°C）
+    uint16_t count;   // 区间内样本数
+} temp_record_t;
+
+/***
+ * @brief 查询结果回调（按时间升序分批调用）
+ * @param recs 记录数组
+ * @param count 记录数
+ * @param ctx 用户参数
+ * @return 0 - 继续，负数 - 中止查询
+ */
+typedef int (*temp_record_sink_t)(const temp_record_t *recs, size_t count, void *ctx);
+
+/***
+ * @brief 初始化温度存储（挂载Flash分区并启动落盘任务）
+ * @return ESP_OK - 成功，其他 - 失败（此时仅保留RAM秒级数据）
+ */
+esp_err_t temp_store_init(void);
+
+/***
+ * @brief 添加一个温度样本（时间戳取当前系统时间）
+ * @param value 温度值（0.1°C）
+ */
+void temp_store_add(int16_t value);
+
+/***
+ * @brief 系统时间是否已校准
+ * @return true - 已校准
+ */
+bool temp_store_time_valid(void);
+
+/***
+ * @brief 按时间范围查询历史数据
+ * @param res 分辨率
+ * @param start 起始时间（Unix秒，含）
+ * @param end 结束时间（Unix秒，含）
+ * @param sink 结果回调
+ * @param ctx 回调用户参数
+ * @return 返回的记录数，负数表示失败或被回调中止
+ */
+int temp_store_query(temp_resolution_t res, uint32_t start, uint32_t end,
+                     temp_record_sink_t sink, void *ctx);
+
+/***
+ * @brief 立即将缓冲的汇总数据写入Flash
+ */
+void temp_store_flush(void);
+
+#endif // TEMP_STORE_H
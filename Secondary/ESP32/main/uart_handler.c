@@ -16,6 +16,7 @@
 
 #include "uart_handler.h"
 #include "esp32_main.h"
+#include "task_sched.h"
 #include "esp_log.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
@@ -167,7 +168,7 @@ esp_err_t uart_handler_init(void)
     
     // ==================== 创建UART事件处理任务 ====================
     ESP_LOGI(TAG, "Creating UART event task...");
-    BaseType_t task_ret = xTaskCreate(uart_event_task, "uart_event_task", 4096, NULL, 12, NULL);
+    BaseType_t task_ret = task_sched_create(uart_event_task, "uart_event_task", 4096, NULL, TASK_CLASS_UART, NULL);
     if (task_ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create UART event task");
         return ESP_FAIL;
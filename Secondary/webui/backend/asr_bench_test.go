@@ -0,0 +1,216 @@
+/***
+ * @file asr_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-24
+ * @brief 参考音频识别基准测试（每请求一个进程 vs 常驻识别进程；并发请求逐个识别 vs 合批识别）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-24
+ * @filePath asr_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"context"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"log"
+	"math"
+	"os"
+	"strconv"
+	"sync"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkASR$' -benchtime 1x [-asr-requests 10] [-asr-batch 4] [-asr-stub]
+//
+// 冷启动：每个请求启动一个新进程，等待模型加载后识别一次再退出，与原先每次调用voxcpm_helper.py相同；
+// 常驻：一个进程先完成加载，之后依次识别全部请求；
+// 并发：同时发起asrBenchConcurrency个请求，分别由逐个识别（batch 1）与合批识别（-asr-batch）的常驻进程处理。
+// 请求音频为3秒16kHz单声道WAV（合成的谐波音），与常见的参考音频长度相当。
+// 占位模型（-asr-stub）不加载权重，冷启动只包含解释器启动与进程通信；识别耗时按asrBenchStubRTF模拟。
+
+func BenchmarkASR(b *testing.B) {
+	argv, dir, err := voxcpmASRCommand(*asrStub)
+	skipWithoutWorker(b, argv, dir, benchASRModel, err)
+	runBenchOnce(b, func() { runASRBenchmark(*benchASRRequests, *asrBatch, *asrStub) })
+}
+
+const (
+	asrBenchSeconds     = 3
+	asrBenchConcurrency = 8
+	asrBenchStubRTF     = 0.03 // SenseVoiceSmall在CPU上的量级（假定）
+	asrBenchStubCost    = 0.2  // 批次中每多一个请求增加的耗时比例（假定）
+)
+
+// 3秒谐波音的WAV文件内容
+func asrBenchWAV() []byte {
+	const rate = 16000
+	n := asrBenchSeconds * rate
+	var buf bytes.Buffer
+	buf.WriteString("RIFF")
+	binary.Write(&buf, binary.LittleEndian, uint32(36+n*2))
+	buf.WriteString("WAVEfmt ")
+	// binary.Write不接受[]any，fmt块各字段逐个写入
+	for _, v := range []any{uint32(16), uint16(1), uint16(1), uint32(rate), uint32(rate * 2), uint16(2), uint16(16)} {
+		binary.Write(&buf, binary.LittleEndian, v)
+	}
+	buf.WriteString("data")
+	binary.Write(&buf, binary.LittleEndian, uint32(n*2))
+	samples := make([]int16, n)
+	for i := range samples {
+		t := float64(i) / rate
+		v := 0.0
+		for k := 1.0; k <= 4; k++ {
+			v += math.Sin(2*math.Pi*150*k*t) / k
+		}
+		samples[i] = int16(v * 0.25 * math.MaxInt16 * (0.5 + 0.5*math.Sin(2*math.Pi*3*t)))
+	}
+	binary.Write(&buf, binary.LittleEndian, samples)
+	return buf.Bytes()
+}
+
+func startASRBenchWorker(argv []string, dir string, batch int) (*ASRWorker, time.Duration, error) {
+	w := NewASRWorker(argv, dir, batch)
+	start := time.Now()
+	w.Start()
+	ctx, cancel := context.WithTimeout(context.Background(), asrWorkerReadyTimeout)
+	defer cancel()
+	if _, err := w.w.current(ctx); err != nil {
+		w.Stop()
+		return nil, 0, err
+	}
+	return w, time.Since(start), nil
+}
+
+// 同时发起n个请求，返回各请求延迟、总耗时与批次大小的平均值
+func runASRConcurrent(w *ASRWorker, audio []byte, n int) ([]time.Duration, time.Duration, float64, error) {
+	lat := make([]time.Duration, n)
+	batches := make([]int, n)
+	errs := make([]error, n)
+	var wg sync.WaitGroup
+	start := time.Now()
+	for i := 0; i < n; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			res, err := w.Recognize(context.Background(), audio)
+			lat[i], batches[i], errs[i] = time.Since(start), res.Batch, err
+		}(i)
+	}
+	wg.Wait()
+	wall := time.Since(start)
+	sum := 0
+	for i := range errs {
+		if errs[i] != nil {
+			return nil, 0, 0, errs[i]
+		}
+		sum += batches[i]
+	}
+	return lat, wall, float64(sum) / float64(n), nil
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runASRBenchmark(n, batch int, stub bool) {
+	argv, dir, err := voxcpmASRCommand(stub)
+	if err != nil {
+		fmt.Println("asr benchmark:", err)
+		return
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mode := "SenseVoiceSmall on CPU"
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(asrBenchStubRTF, 'f', -1, 64),
+			"--stub-batch-cost", strconv.FormatFloat(asrBenchStubCost, 'f', -1, 64))
+		mode = fmt.Sprintf("stub model (no weights loaded) at RTF %.2f, each extra request in a batch adds %.0f%% (assumed)",
+			asrBenchStubRTF, asrBenchStubCost*100)
+	}
+	batch = max(batch, 2)
+	audio := asrBenchWAV()
+	fmt.Printf("ASR benchmark: %d requests of %ds audio (%d KB WAV), %s\n\n", n, asrBenchSeconds, len(audio)>>10, mode)
+
+	// 冷启动：每个请求一个进程，计时包含解释器启动、导入与模型加载
+	var cold []ttsBenchSample
+	var coldLoad, coldRSS float64
+	for i := 0; i < n; i++ {
+		w := NewASRWorker(argv, dir, 1)
+		start := time.Now()
+		w.Start()
+		ctx, cancel := context.WithTimeout(context.Background(), asrWorkerReadyTimeout)
+		_, err := w.Recognize(ctx, audio)
+		cancel()
+		total := time.Since(start)
+		st := w.Stats()
+		w.Stop()
+		if err != nil {
+			fmt.Printf("cold request %d failed: %v\n", i, err)
+			return
+		}
+		cold = append(cold, ttsBenchSample{total: total, ttfb: total})
+		coldLoad += st.LoadMs
+		coldRSS = max(coldRSS, st.RSSMB)
+	}
+
+	// 常驻：启动一次，等待就绪后依次识别
+	w, startup, err := startASRBenchWorker(argv, dir, 1)
+	if err != nil {
+		fmt.Println("warm worker failed to start:", err)
+		return
+	}
+	var warm []ttsBenchSample
+	for i := 0; i < n; i++ {
+		start := time.Now()
+		if _, err := w.Recognize(context.Background(), audio); err != nil {
+			fmt.Printf("warm request %d failed: %v\n", i, err)
+			w.Stop()
+			return
+		}
+		warm = append(warm, ttsBenchSample{total: time.Since(start), ttfb: time.Since(start)})
+	}
+	st := w.Stats()
+
+	fmt.Printf("%-6s | %-12s | %-12s | %-22s | %s\n", "mode", "p50 latency", "mean latency", "model load per request", "resident between requests")
+	p50, mean, _ := summarizeTTSBench(cold)
+	fmt.Printf("%-6s | %-12s | %-12s | %-22s | 0 MB (process exits; %.0f MB while running)\n", "cold",
+		benchMs(p50), benchMs(mean), fmt.Sprintf("%.0fms", coldLoad/float64(n)), coldRSS)
+	p50, mean, _ = summarizeTTSBench(warm)
+	fmt.Printf("%-6s | %-12s | %-12s | %-22s | %.0f MB\n", "warm",
+		benchMs(p50), benchMs(mean), "0ms (once at startup)", st.RSSMB)
+	fmt.Printf("\nwarm worker startup: %v (model load %.0fms, warmup %.0fms)\n\n",
+		startup.Round(time.Millisecond), st.LoadMs, st.WarmupMs)
+
+	// 并发：逐个识别 vs 合批识别
+	fmt.Printf("%d concurrent requests:\n", asrBenchConcurrency)
+	fmt.Printf("%-5s | %-23s | %-10s | %s\n", "batch", "latency mean / max", "wall", "mean batch size")
+	for _, b := range []int{1, batch} {
+		if b != 1 {
+			w.Stop()
+			if w, _, err = startASRBenchWorker(argv, dir, b); err != nil {
+				fmt.Printf("%-5d | failed to start worker: %v\n", b, err)
+				return
+			}
+		}
+		runASRConcurrent(w, audio, b) // 预热批量路径
+		lat, wall, size, err := runASRConcurrent(w, audio, asrBenchConcurrency)
+		if err != nil {
+			fmt.Printf("%-5d | failed: %v\n", b, err)
+			continue
+		}
+		latMean, latMax := meanMax(lat)
+		fmt.Printf("%-5d | %-23s | %-10s | %.1f\n", b, benchMs(latMean)+" / "+benchMs(latMax), benchMs(wall), size)
+	}
+	w.Stop()
+	fmt.Println("\ncold = new process per request (as voxcpm_helper.py was spawned): interpreter start, imports, model load, recognition;")
+	fmt.Println("audio bytes are piped to the worker, no temp file; resident = worker RSS after model load and warmup.")
+}
@@ -0,0 +1,129 @@
+/***
+ * @file asr_worker.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-27
+ * @brief 常驻识别进程（voxcpm_asr_worker.py）：复用合成进程的监管与JSON行协议，识别结果与状态快照独立
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-27
+ * @filePath asr_worker.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"path/filepath"
+	"time"
+)
+
+const (
+	asrMaxAudioBytes      = 32 << 20        // 上传识别音频的最大字节数，超过时拒绝而不读入内存
+	asrWorkerReadyTimeout = 2 * time.Minute // SenseVoiceSmall加载 + 预热的最长时间（远小于合成模型）
+)
+
+// 全局常驻识别进程（-asr-worker）；为nil时每次识别启动voxcpm_helper.py
+var asrWorker *ASRWorker
+
+// 常驻识别进程：启动、健康检查、超时重启由TTSWorker完成，只对外提供识别
+type ASRWorker struct {
+	w *TTSWorker
+}
+
+// 识别结果
+type ASRResult struct {
+	Text        string
+	AudioMs     float64
+	RecognizeMs float64 // 进程内所在批次的识别耗时
+	Batch       int     // 与之一起识别的请求数（含自身）
+	Elapsed     time.Duration
+}
+
+// 快照（/api/tts/status 的 asr 字段）
+type ASRWorkerStats struct {
+	State         string  `json:"state"`
+	PID           int     `json:"pid"`
+	LoadMs        float64 `json:"load_ms"`
+	WarmupMs      float64 `json:"warmup_ms"`
+	UptimeSec     float64 `json:"uptime_sec"`
+	Restarts      uint64  `json:"restarts"`
+	Requests      uint64  `json:"requests"`
+	Failures      uint64  `json:"failures"`
+	LastRequestMs float64 `json:"last_request_ms"`
+	ModelVersion  string  `json:"model_version"`
+	Batch         int     `json:"batch"`  // 一批识别的最大请求数
+	RSSMB         float64 `json:"rss_mb"` // 就绪时进程的常驻内存
+}
+
+// batch>1时已到达的识别请求（最多batch个）合为一批识别
+func NewASRWorker(argv []string, dir string, batch int) *ASRWorker {
+	w := NewBatchedTTSWorker(argv, dir, batch)
+	w.name = "ASR worker"
+	w.failure = "recognition failed"
+	w.cancelGrace = 0 // 识别进程不支持取消
+	w.readyTimeout = asrWorkerReadyTimeout
+	return &ASRWorker{w: w}
+}
+
+// 与原voxcpm_helper.py相同，经uv在VoxCPM目录的环境中运行（模型路径相对该目录）；stub模式直接用系统python3且不加载模型
+func voxcpmASRCommand(stub bool) ([]string, string, error) {
+	script, err := filepath.Abs(filepath.Join(".", "voxcpm_asr_worker.py"))
+	if err != nil {
+		return nil, "", err
+	}
+	if stub {
+		return []string{"python3", script, "--stub"}, "", nil
+	}
+	dir, err := filepath.Abs(filepath.Join("..", "..", "..", "VoxCPM"))
+	if err != nil {
+		return nil, "", err
+	}
+	return []string{"uv", "run", "--directory", dir, "python", script}, dir, nil
+}
+
+func (a *ASRWorker) Start() {
+	a.w.Start()
+}
+
+func (a *ASRWorker) Stop() {
+	a.w.Stop()
+}
+
+// 识别上传的音频（文件内容原样经管道传给进程，不写临时文件）
+func (a *ASRWorker) Recognize(ctx context.Context, audio []byte) (ASRResult, error) {
+	ev, _, elapsed, err := a.w.exchange(ctx, ttsWorkerRequest{Op: "recognize", Bytes: len(audio), Audio: audio}, nil)
+	if err != nil {
+		return ASRResult{}, err
+	}
+	return ASRResult{Text: ev.Text, AudioMs: ev.AudioMs, RecognizeMs: ev.RecognizeMs, Batch: ev.Batch, Elapsed: elapsed}, nil
+}
+
+// ==================== 状态快照 ====================
+func (a *ASRWorker) Stats() ASRWorkerStats {
+	s := a.w.Stats()
+	var rss float64
+	a.w.mu.Lock()
+	if a.w.proc != nil {
+		rss = a.w.info.RSSMB
+	}
+	a.w.mu.Unlock()
+	return ASRWorkerStats{
+		State:         s.State,
+		PID:           s.PID,
+		LoadMs:        s.LoadMs,
+		WarmupMs:      s.WarmupMs,
+		UptimeSec:     s.UptimeSec,
+		Restarts:      s.Restarts,
+		Requests:      s.Requests,
+		Failures:      s.Failures,
+		LastRequestMs: s.LastRequestMs,
+		ModelVersion:  s.ModelVersion,
+		Batch:         s.Batch,
+		RSSMB:         rss,
+	}
+}
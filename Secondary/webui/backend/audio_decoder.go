@@ -0,0 +1,355 @@
+/***
+ * @file audio_decoder.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-19
+ * @brief 上传音频流式解码（WAV原生解析 + 线性插值重采样，其他格式经ffmpeg管道；合成PCM流重采样）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-19
+ * @filePath audio_decoder.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"os/exec"
+	"strconv"
+)
+
+// ==================== 输出格式（与前端AUDIO_CONFIG、设备I2S一致） ====================
+const (
+	pcmChunkBytes       = 3000 // 每个0xA4帧的PCM字节数（750个立体声采样）
+	decodeBlockFrames   = 4096 // 每次解码的源采样帧数
+	wavMaxHeaderBytes   = 64 * 1024
+	wavFormatPCM        = 0x0001
+	wavFormatFloat      = 0x0003
+	wavFormatExtensible = 0xFFFE
+)
+
+var errUnsupportedAudio = errors.New("unsupported audio format")
+
+// ==================== 打开解码流 ====================
+// 返回44.1kHz立体声16位小端PCM流，按读取进度解码，内存占用与文件长度无关。
+// WAV（PCM 8/16/24/32位、32/64位浮点）在进程内解析；其他格式或WAV内的压缩编码交给ffmpeg（需已安装）。
+func newPCMStream(r io.Reader) (io.ReadCloser, string, error) {
+	br := bufio.NewReaderSize(r, 32*1024)
+	magic, _ := br.Peek(12)
+	if len(magic) == 12 && string(magic[0:4]) == "RIFF" && string(magic[8:12]) == "WAVE" {
+		// 头部读取过程中记录已消费的字节，WAV内为压缩编码、或元数据块过大在限制内找不到data块时原样交给ffmpeg
+		var header bytes.Buffer
+		s, err := newWAVStream(io.TeeReader(io.LimitReader(br, wavMaxHeaderBytes), &header), br)
+		if err == nil {
+			return s, s.describe(), nil
+		}
+		if !errors.Is(err, errUnsupportedAudio) && header.Len() < wavMaxHeaderBytes {
+			return nil, "", err
+		}
+		return newFFmpegStream(io.MultiReader(&header, br))
+	}
+	return newFFmpegStream(br)
+}
+
+// ==================== WAV解码流 ====================
+type wavStream struct {
+	r         io.Reader
+	remaining int64 // data块剩余字节，-1表示未知（流式写出的WAV长度字段为0或0xFFFFFFFF）
+
+	format     uint16
+	channels   int
+	sampleRate int
+	bits       int
+	blockAlign int
+
+	raw     []byte
+	carry   int  // raw开头残留的不完整采样帧字节
+	partial bool // 有多少读多少（实时产生的PCM流），否则凑满一块再解码
+	rs      linearResampler
+	out     []byte
+	pos     int
+	eof     bool
+}
+
+// ==================== 裸PCM流 ====================
+// 用于合成进程实时输出的整数PCM（无文件头、长度未知），到达多少解码多少，不等待凑满一块
+func newRawPCMStream(r io.Reader, sampleRate, channels, bits int) *wavStream {
+	s := &wavStream{
+		r:          r,
+		remaining:  -1,
+		format:     wavFormatPCM,
+		channels:   channels,
+		sampleRate: sampleRate,
+		bits:       bits,
+		blockAlign: channels * bits / 8,
+		partial:    true,
+	}
+	s.raw = make([]byte, decodeBlockFrames*s.blockAlign)
+	s.rs.init(s.sampleRate, defaultSampleRate)
+	return s
+}
+
+// 解析RIFF头直到data块；hdr用于读取头部（带记录），body用于之后的采样数据
+func newWAVStream(hdr io.Reader, body io.Reader) (*wavStream, error) {
+	var riff [12]byte
+	if _, err := io.ReadFull(hdr, riff[:]); err != nil {
+		return nil, err
+	}
+
+	s := &wavStream{r: body}
+	haveFmt := false
+	for {
+		var ch [8]byte
+		if _, err := io.ReadFull(hdr, ch[:]); err != nil {
+			return nil, fmt.Errorf("wav: missing data chunk: %w", err)
+		}
+		id := string(ch[0:4])
+		size := int64(binary.LittleEndian.Uint32(ch[4:8]))
+
+		if id == "data" {
+			if !haveFmt {
+				return nil, errors.New("wav: data chunk before fmt chunk")
+			}
+			s.remaining = size
+			if size == 0 || size == 0xFFFFFFFF {
+				s.remaining = -1
+			}
+			break
+		}
+
+		if id == "fmt " {
+			if size < 16 || size > 1024 {
+				return nil, errors.New("wav: invalid fmt chunk")
+			}
+			b := make([]byte, size+size&1)
+			if _, err := io.ReadFull(hdr, b); err != nil {
+				return nil, err
+			}
+			s.format = binary.LittleEndian.Uint16(b[0:2])
+			s.channels = int(binary.LittleEndian.Uint16(b[2:4]))
+			s.sampleRate = int(binary.LittleEndian.Uint32(b[4:8]))
+			s.blockAlign = int(binary.LittleEndian.Uint16(b[12:14]))
+			s.bits = int(binary.LittleEndian.Uint16(b[14:16]))
+			if s.format == wavFormatExtensible && size >= 40 {
+				s.format = binary.LittleEndian.Uint16(b[24:26]) // 子格式GUID前两字节
+			}
+			haveFmt = true
+			continue
+		}
+
+		// 跳过LIST等其他块（块长度为奇数时有1字节填充）
+		if _, err := io.CopyN(io.Discard, hdr, size+size&1); err != nil {
+			return nil, fmt.Errorf("wav: truncated %q chunk: %w", id, err)
+		}
+	}
+
+	if s.channels < 1 || s.sampleRate < 1 || s.blockAlign != s.channels*s.bits/8 {
+		return nil, errors.New("wav: invalid format fields")
+	}
+	switch {
+	case s.format == wavFormatPCM && (s.bits == 8 || s.bits == 16 || s.bits == 24 || s.bits == 32):
+	case s.format == wavFormatFloat && (s.bits == 32 || s.bits == 64):
+	default:
+		return nil, fmt.Errorf("%w: wav format 0x%04x, %d bits", errUnsupportedAudio, s.format, s.bits)
+	}
+
+	s.raw = make([]byte, decodeBlockFrames*s.blockAlign)
+	s.rs.init(s.sampleRate, defaultSampleRate)
+	return s, nil
+}
+
+func (s *wavStream) describe() string {
+	kind := "pcm"
+	if s.format == wavFormatFloat {
+		kind = "float"
+	}
+	return "wav " + kind + strconv.Itoa(s.bits) + " " + strconv.Itoa(s.sampleRate) + "Hz " + strconv.Itoa(s.channels) + "ch"
+}
+
+// ==================== 读取输出PCM ====================
+func (s *wavStream) Read(p []byte) (int, error) {
+	for s.pos == len(s.out) {
+		if s.eof {
+			return 0, io.EOF
+		}
+		if err := s.decodeBlock(); err != nil {
+			return 0, err
+		}
+	}
+	n := copy(p, s.out[s.pos:])
+	s.pos += n
+	return n, nil
+}
+
+func (s *wavStream) Close() error {
+	return nil
+}
+
+// 读取一块源采样，转为立体声浮点后重采样为16位输出
+func (s *wavStream) decodeBlock() error {
+	want := len(s.raw) - s.carry
+	if s.remaining >= 0 && int64(want) > s.remaining {
+		want = int(s.remaining)
+	}
+	var n int
+	var err error
+	if s.partial {
+		n, err = s.r.Read(s.raw[s.carry : s.carry+want])
+	} else {
+		n, err = io.ReadFull(s.r, s.raw[s.carry:s.carry+want])
+	}
+	if s.remaining >= 0 {
+		s.remaining -= int64(n)
+	}
+	if err == io.EOF || err == io.ErrUnexpectedEOF || s.remaining == 0 {
+		s.eof = true
+	} else if err != nil {
+		return err
+	}
+
+	s.out = s.out[:0]
+	s.pos = 0
+	n += s.carry
+	frames := n / s.blockAlign
+	for i := 0; i < frames; i++ {
+		frame := s.raw[i*s.blockAlign:]
+		l := s.sample(frame, 0)
+		r := l
+		if s.channels > 1 {
+			r = s.sample(frame, 1)
+		}
+		s.out = s.rs.push(s.out, l, r)
+	}
+	// 不完整的采样帧留到下一块（分段到达的裸PCM），流结束时丢弃
+	s.carry = copy(s.raw, s.raw[frames*s.blockAlign:n])
+	return nil
+}
+
+// 读取一个采样帧中第ch声道的值，归一化到[-1, 1]
+func (s *wavStream) sample(frame []byte, ch int) float32 {
+	switch s.bits {
+	case 8:
+		return float32(int(frame[ch])-128) / 128
+	case 16:
+		return float32(int16(binary.LittleEndian.Uint16(frame[ch*2:]))) / 32768
+	case 24:
+		b := frame[ch*3:]
+		v := int32(uint32(b[0])<<8|uint32(b[1])<<16|uint32(b[2])<<24) >> 8
+		return float32(v) / 8388608
+	case 32:
+		v := binary.LittleEndian.Uint32(frame[ch*4:])
+		if s.format == wavFormatFloat {
+			return math.Float32frombits(v)
+		}
+		return float32(float64(int32(v)) / 2147483648)
+	default: // 64位浮点
+		return float32(math.Float64frombits(binary.LittleEndian.Uint64(frame[ch*8:])))
+	}
+}
+
+// ==================== 流式线性插值重采样 ====================
+// 跨块保留上一采样帧与小数位置，输出与一次性处理完全一致；
+// 同采样率时每个输入帧恰好输出一帧（延迟一帧）
+type linearResampler struct {
+	step         float64 // 每个输出帧前进的源帧数
+	frac         float64
+	prevL, prevR float32
+	primed       bool
+}
+
+func (rs *linearResampler) init(srcRate, dstRate int) {
+	rs.step = float64(srcRate) / float64(dstRate)
+}
+
+func (rs *linearResampler) push(out []byte, l, r float32) []byte {
+	if !rs.primed {
+		rs.prevL, rs.prevR, rs.primed = l, r, true
+		return out
+	}
+	for rs.frac < 1 {
+		f := float32(rs.frac)
+		out = appendPCM16(out, rs.prevL+(l-rs.prevL)*f)
+		out = appendPCM16(out, rs.prevR+(r-rs.prevR)*f)
+		rs.frac += rs.step
+	}
+	rs.frac -= 1
+	rs.prevL, rs.prevR = l, r
+	return out
+}
+
+// 与前端audioBufferToPCM相同的量化方式
+func appendPCM16(out []byte, v float32) []byte {
+	var s int16
+	switch {
+	case v >= 1:
+		s = 0x7FFF
+	case v <= -1:
+		s = -0x8000
+	case v < 0:
+		s = int16(v * 0x8000)
+	default:
+		s = int16(v * 0x7FFF)
+	}
+	return append(out, byte(s), byte(uint16(s)>>8))
+}
+
+// ==================== ffmpeg解码流 ====================
+type ffmpegStream struct {
+	io.ReadCloser
+	cmd *exec.Cmd
+	eof bool // 已读到输出结尾，进程正在或已经正常退出
+}
+
+func newFFmpegStream(r io.Reader) (io.ReadCloser, string, error) {
+	path, err := exec.LookPath("ffmpeg")
+	if err != nil {
+		return nil, "", fmt.Errorf("%w: non-WAV input requires ffmpeg", errUnsupportedAudio)
+	}
+	cmd := exec.Command(path, "-hide_banner", "-loglevel", "error", "-i", "pipe:0",
+		"-f", "s16le", "-acodec", "pcm_s16le",
+		"-ar", strconv.Itoa(defaultSampleRate), "-ac", strconv.Itoa(defaultChannels), "pipe:1")
+	stdin, err := cmd.StdinPipe()
+	if err != nil {
+		return nil, "", err
+	}
+	stdout, err := cmd.StdoutPipe()
+	if err != nil {
+		return nil, "", err
+	}
+	if err := cmd.Start(); err != nil {
+		return nil, "", err
+	}
+	// 自行拷贝输入：请求体读取阻塞时Close不必等待拷贝结束
+	go func() {
+		io.Copy(stdin, r)
+		stdin.Close()
+	}()
+	return &ffmpegStream{ReadCloser: stdout, cmd: cmd}, "ffmpeg", nil
+}
+
+func (s *ffmpegStream) Read(p []byte) (int, error) {
+	n, err := s.ReadCloser.Read(p)
+	if err == io.EOF {
+		s.eof = true
+	}
+	return n, err
+}
+
+// 读完输出时等待进程退出并返回其退出状态；提前关闭（客户端断开、设备停止）时才结束进程
+func (s *ffmpegStream) Close() error {
+	if !s.eof {
+		s.ReadCloser.Close()
+		s.cmd.Process.Kill()
+	}
+	return s.cmd.Wait()
+}
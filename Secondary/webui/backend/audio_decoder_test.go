@@ -0,0 +1,273 @@
+/***
+ * @file audio_decoder_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief 音频解码测试（WAV头解析与各采样格式、流式重采样、裸PCM分段到达、量化）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath audio_decoder_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"io"
+	"math"
+	"os/exec"
+	"slices"
+	"testing"
+	"testing/iotest"
+)
+
+// 构造WAV文件：fmt块之前可插入其他块，dataSize<0时按实际长度填写
+func buildTestWAV(format uint16, channels, rate, bits int, data []byte, dataSize int64, extra ...[]byte) []byte {
+	var b bytes.Buffer
+	b.WriteString("RIFF")
+	binary.Write(&b, binary.LittleEndian, uint32(0))
+	b.WriteString("WAVE")
+	for _, c := range extra {
+		b.Write(c)
+	}
+	blockAlign := channels * bits / 8
+	put := func(vs ...any) {
+		for _, v := range vs {
+			binary.Write(&b, binary.LittleEndian, v)
+		}
+	}
+	b.WriteString("fmt ")
+	if format == wavFormatExtensible {
+		put(uint32(40), uint16(format), uint16(channels), uint32(rate), uint32(rate*blockAlign), uint16(blockAlign), uint16(bits))
+		put(uint16(22), uint16(bits), uint32(3), uint16(wavFormatPCM))
+		b.Write(make([]byte, 14)) // 子格式GUID其余部分
+	} else {
+		put(uint32(16), uint16(format), uint16(channels), uint32(rate), uint32(rate*blockAlign), uint16(blockAlign), uint16(bits))
+	}
+	if dataSize < 0 {
+		dataSize = int64(len(data))
+	}
+	b.WriteString("data")
+	binary.Write(&b, binary.LittleEndian, uint32(dataSize))
+	b.Write(data)
+	return b.Bytes()
+}
+
+func testChunk(id string, payload []byte) []byte {
+	b := append([]byte(id), 0, 0, 0, 0)
+	binary.LittleEndian.PutUint32(b[4:], uint32(len(payload)))
+	b = append(b, payload...)
+	if len(payload)%2 == 1 {
+		b = append(b, 0)
+	}
+	return b
+}
+
+// 16位立体声PCM转为int16采样
+func pcmSamples(b []byte) []int16 {
+	s := make([]int16, len(b)/2)
+	for i := range s {
+		s[i] = int16(binary.LittleEndian.Uint16(b[i*2:]))
+	}
+	return s
+}
+
+func decodeTestWAV(t *testing.T, wav []byte) ([]int16, string) {
+	t.Helper()
+	s, desc, err := newPCMStream(bytes.NewReader(wav))
+	if err != nil {
+		t.Fatalf("newPCMStream: %v", err)
+	}
+	defer s.Close()
+	out, err := io.ReadAll(s)
+	if err != nil {
+		t.Fatalf("read: %v", err)
+	}
+	return pcmSamples(out), desc
+}
+
+// 44.1kHz下各采样格式解码为相同的16位立体声（同采样率时延迟一帧，最后一帧不输出）
+func TestWAVFormats(t *testing.T) {
+	values := []float64{0, 0.5, -0.5, 0.25, -1, 0.75}
+	want := []int16{0, 0, 16383, 16383, -16384, -16384, 8191, 8191, -32768, -32768}
+
+	encode := func(bits int, float bool) []byte {
+		var b bytes.Buffer
+		for _, v := range values {
+			switch {
+			case float && bits == 32:
+				binary.Write(&b, binary.LittleEndian, float32(v))
+			case float:
+				binary.Write(&b, binary.LittleEndian, v)
+			case bits == 8:
+				b.WriteByte(byte(int(v*128) + 128))
+			case bits == 16:
+				binary.Write(&b, binary.LittleEndian, int16(v*32768))
+			case bits == 24:
+				x := int32(v * 8388608)
+				b.Write([]byte{byte(x), byte(x >> 8), byte(x >> 16)})
+			default:
+				binary.Write(&b, binary.LittleEndian, int32(v*2147483648))
+			}
+		}
+		return b.Bytes()
+	}
+	tests := []struct {
+		name   string
+		format uint16
+		bits   int
+		float  bool
+		desc   string
+	}{
+		{"pcm8", wavFormatPCM, 8, false, "wav pcm8 44100Hz 1ch"},
+		{"pcm16", wavFormatPCM, 16, false, "wav pcm16 44100Hz 1ch"},
+		{"pcm24", wavFormatPCM, 24, false, "wav pcm24 44100Hz 1ch"},
+		{"pcm32", wavFormatPCM, 32, false, "wav pcm32 44100Hz 1ch"},
+		{"float32", wavFormatFloat, 32, true, "wav float32 44100Hz 1ch"},
+		{"float64", wavFormatFloat, 64, true, "wav float64 44100Hz 1ch"},
+		{"extensible pcm16", wavFormatExtensible, 16, false, "wav pcm16 44100Hz 1ch"},
+	}
+	for _, tt := range tests {
+		got, desc := decodeTestWAV(t, buildTestWAV(tt.format, 1, 44100, tt.bits, encode(tt.bits, tt.float), -1))
+		if desc != tt.desc {
+			t.Errorf("%s: describe = %q, want %q", tt.name, desc, tt.desc)
+		}
+		if len(got) != len(want) {
+			t.Errorf("%s: %d samples, want %d", tt.name, len(got), len(want))
+			continue
+		}
+		for i := range got {
+			// 8位采样精度只有1/128
+			if d := int(got[i]) - int(want[i]); d < -1 || d > 1 {
+				t.Errorf("%s: sample %d = %d, want %d", tt.name, i, got[i], want[i])
+				break
+			}
+		}
+	}
+}
+
+// 其他块（含奇数长度的填充字节）被跳过；长度字段为0时读到文件结尾；立体声声道不混合
+func TestWAVChunksAndLength(t *testing.T) {
+	// 负值按0x8000量化，解码后与输入完全相同
+	var buf bytes.Buffer
+	binary.Write(&buf, binary.LittleEndian, []int16{-100, -200, -300, -400, -500, -600}) // 3个立体声采样帧
+	data := buf.Bytes()
+	extra := [][]byte{testChunk("LIST", []byte("INFOabc")), testChunk("bext", make([]byte, 10))}
+	want := []int16{-100, -200, -300, -400}
+	for _, size := range []int64{-1, 0, 0xFFFFFFFF} {
+		got, _ := decodeTestWAV(t, buildTestWAV(wavFormatPCM, 2, 44100, 16, data, size, extra...))
+		if !slices.Equal(got, want) {
+			t.Errorf("data size %d: samples %v, want %v", size, got, want)
+		}
+	}
+	// data块长度短于文件内容：只解码声明的长度
+	got, _ := decodeTestWAV(t, append(buildTestWAV(wavFormatPCM, 2, 44100, 16, data, 8), 9, 9, 9, 9))
+	if !slices.Equal(got, want[:2]) {
+		t.Errorf("declared 8 bytes: samples %v, want %v", got, want[:2])
+	}
+}
+
+func TestWAVErrors(t *testing.T) {
+	pcm := make([]byte, 16)
+	dataFirst := append([]byte("RIFF\x00\x00\x00\x00WAVE"), testChunk("data", pcm)...)
+	badAlign := buildTestWAV(wavFormatPCM, 2, 44100, 16, pcm, -1)
+	binary.LittleEndian.PutUint16(badAlign[32:], 3)
+	tests := []struct {
+		name        string
+		wav         []byte
+		unsupported bool
+	}{
+		{"data before fmt", dataFirst, false},
+		{"block align mismatch", badAlign, false},
+		{"zero channels", buildTestWAV(wavFormatPCM, 0, 44100, 16, pcm, -1), false},
+		{"no data chunk", buildTestWAV(wavFormatPCM, 1, 44100, 16, nil, -1)[:36], false},
+		{"12-bit pcm", buildTestWAV(wavFormatPCM, 1, 44100, 12, pcm, -1), true},
+		{"16-bit float", buildTestWAV(wavFormatFloat, 1, 44100, 16, pcm, -1), true},
+		{"compressed", buildTestWAV(0x0055, 1, 44100, 16, pcm, -1), true},
+	}
+	for _, tt := range tests {
+		_, err := newWAVStream(bytes.NewReader(tt.wav), bytes.NewReader(nil))
+		if err == nil {
+			t.Errorf("%s: no error", tt.name)
+			continue
+		}
+		if errors.Is(err, errUnsupportedAudio) != tt.unsupported {
+			t.Errorf("%s: err %v, unsupported=%v", tt.name, err, tt.unsupported)
+		}
+	}
+	if _, err := exec.LookPath("ffmpeg"); err != nil {
+		if _, _, err := newPCMStream(bytes.NewReader([]byte("ID3\x04not a wav file"))); !errors.Is(err, errUnsupportedAudio) {
+			t.Errorf("non-WAV without ffmpeg: err %v, want errUnsupportedAudio", err)
+		}
+	}
+}
+
+// 22.05kHz上采样到44.1kHz：线性输入插值后仍为线性，输出约为输入的两倍
+func TestWAVResample(t *testing.T) {
+	const n = 1000
+	var data bytes.Buffer
+	for i := 0; i < n; i++ {
+		binary.Write(&data, binary.LittleEndian, int16(i*16))
+	}
+	got, _ := decodeTestWAV(t, buildTestWAV(wavFormatPCM, 1, 22050, 16, data.Bytes(), -1))
+	frames := len(got) / 2
+	if frames != 2*(n-1) {
+		t.Fatalf("%d output frames, want %d", frames, 2*(n-1))
+	}
+	for i := 0; i < frames; i++ {
+		want := float64(i) * 8 // 每个输出帧前进半个源采样
+		if l, r := got[2*i], got[2*i+1]; l != r || math.Abs(float64(l)-want) > 1 {
+			t.Fatalf("frame %d = %d/%d, want %.0f", i, l, r, want)
+		}
+	}
+}
+
+// 裸PCM分段到达（含半个采样帧）与一次到达的输出完全相同
+func TestRawPCMStreamChunking(t *testing.T) {
+	var data bytes.Buffer
+	for i := 0; i < 3*decodeBlockFrames; i++ {
+		v := int16(10000 * math.Sin(float64(i)/30))
+		binary.Write(&data, binary.LittleEndian, []int16{v, -v})
+	}
+	read := func(r io.Reader) []byte {
+		out, err := io.ReadAll(newRawPCMStream(r, 24000, 2, 16))
+		if err != nil {
+			t.Fatalf("read: %v", err)
+		}
+		return out
+	}
+	whole := read(bytes.NewReader(data.Bytes()))
+	for _, r := range []io.Reader{
+		iotest.OneByteReader(bytes.NewReader(data.Bytes())),
+		iotest.HalfReader(bytes.NewReader(data.Bytes())),
+	} {
+		if got := read(r); !bytes.Equal(got, whole) {
+			t.Errorf("chunked read: %d bytes, differs from whole read (%d bytes)", len(got), len(whole))
+		}
+	}
+	if want := 4 * ((3*decodeBlockFrames - 1) * defaultSampleRate / 24000); len(whole) < want-8 || len(whole) > want+8 {
+		t.Errorf("output %d bytes, want about %d", len(whole), want)
+	}
+}
+
+func TestAppendPCM16(t *testing.T) {
+	tests := []struct {
+		in   float32
+		want int16
+	}{
+		{0, 0}, {1, 0x7FFF}, {1.5, 0x7FFF}, {-1, -0x8000}, {-2, -0x8000},
+		{0.5, 16383}, {-0.5, -16384}, {float32(1) / 0x7FFF, 1},
+	}
+	for _, tt := range tests {
+		if got := pcmSamples(appendPCM16(nil, tt.in))[0]; got != tt.want {
+			t.Errorf("appendPCM16(%v) = %d, want %d", tt.in, got, tt.want)
+		}
+	}
+}
@@ -0,0 +1,214 @@
+/***
+ * @file audio_pacer.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-18
+ * @brief 音频实时节拍器（按采样率发放令牌，根据设备额度反馈调整提前量）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-18
+ * @filePath audio_pacer.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"strconv"
+	"sync/atomic"
+	"time"
+)
+
+// ==================== 节拍配置 ====================
+// ESP32音频队列只有10个槽位（约170ms的3000字节块），提前量需小于此值
+const (
+	pacerMinLead      = 40 * time.Millisecond
+	pacerMaxLead      = 400 * time.Millisecond
+	pacerLeadStep     = 10 * time.Millisecond
+	deviceAudioSlots  = 10 // 设备音频队列槽位数（audio_handler.c）
+	defaultSampleRate = 44100
+	defaultChannels   = 2
+	defaultSampleSize = 2 // 16位
+)
+
+// 0xA4帧没有长度字段，固件按recv()边界切分命令：背靠背发送的帧可能在同一TCP段中到达而被合并，
+// 因此补足提前量时连续发送最多pacerMaxBurst帧，之后每帧间隔pacerBurstGap（仍快于实时，提前量逐步建立）
+const (
+	pacerMaxBurst = 1 // 连续发送（间隔小于pacerBurstGap）的音频帧上限
+	pacerBurstGap = 5 * time.Millisecond
+)
+
+// 默认目标提前量，由 -audio-lead 设置；<=0 表示不节拍（按到达顺序立即发送）
+var audioLeadDefault = 120 * time.Millisecond
+
+// ==================== 节拍器 ====================
+// 令牌桶：令牌按设备播放速率（字节/秒）累积，桶容量即提前量。
+// 以流开始时刻为播放时钟原点，已发送时长 - 已播放时长 = 当前提前量，
+// 提前量未达目标时立即发送，否则等待到时钟追上。
+// 只在设备发送协程中访问，指标字段使用原子变量供统计读取。
+type audioPacer struct {
+	lead     time.Duration
+	minLead  time.Duration
+	maxLead  time.Duration
+	disabled bool
+
+	active    bool
+	clock     time.Time // 播放时钟原点
+	sentBytes int64
+	lastAcks  uint64
+	lastSend  time.Time // 上一帧的发送时刻
+	burst     int       // 连续发送的帧数
+
+	sendLeadNs atomic.Int64  // 最近一次发送后的实际提前量
+	leadNs     atomic.Int64  // 当前目标提前量
+	bursts     atomic.Uint64 // 设备报告音频队列已满（发送过快）
+	stalls     atomic.Uint64 // 播放时钟超过已发送数据（设备欠载）
+	rateBps    atomic.Int64  // 字节/秒（可由其他协程在连接后设置）
+}
+
+func newAudioPacer(lead time.Duration) *audioPacer {
+	p := &audioPacer{minLead: pacerMinLead, maxLead: pacerMaxLead}
+	if lead <= 0 {
+		p.disabled = true
+	} else {
+		if lead < p.minLead {
+			p.minLead = lead
+		}
+		if lead > p.maxLead {
+			p.maxLead = lead
+		}
+	}
+	p.setLead(lead)
+	p.setFormat(defaultSampleRate, defaultChannels, defaultSampleSize)
+	return p
+}
+
+// ==================== 设置音频格式（由设备TXT记录协商） ====================
+func (p *audioPacer) setFormat(sampleRate, channels, sampleSize int) {
+	if sampleRate <= 0 || channels <= 0 || sampleSize <= 0 {
+		return
+	}
+	p.rateBps.Store(int64(sampleRate * channels * sampleSize))
+}
+
+func (p *audioPacer) setLead(lead time.Duration) {
+	p.lead = lead
+	p.leadNs.Store(int64(lead))
+}
+
+func (p *audioPacer) bytesToDuration(n int64) time.Duration {
+	return time.Duration(float64(n) / float64(p.rateBps.Load()) * float64(time.Second))
+}
+
+// ==================== 流开始/结束 ====================
+func (p *audioPacer) start(now time.Time) {
+	p.active = true
+	p.clock = now
+	p.sentBytes = 0
+}
+
+func (p *audioPacer) stop() {
+	p.active = false
+	p.sendLeadNs.Store(0)
+}
+
+// ==================== 计算发送下一块前需等待的时间 ====================
+func (p *audioPacer) delay(now time.Time) time.Duration {
+	if p.disabled {
+		return 0
+	}
+	if !p.active {
+		// 未收到开始命令的音频，以当前时刻为时钟原点
+		p.start(now)
+	}
+
+	ahead := p.bytesToDuration(p.sentBytes) - now.Sub(p.clock)
+	if ahead < 0 {
+		// 数据断流，设备已播完缓冲：记一次欠载，时钟重新对齐，避免之后突发补发
+		if p.sentBytes > 0 {
+			p.stalls.Add(1)
+		}
+		p.clock = now.Add(-p.bytesToDuration(p.sentBytes))
+		ahead = 0
+	}
+	if ahead >= p.lead {
+		return ahead - p.lead
+	}
+	if since := now.Sub(p.lastSend); p.burst >= pacerMaxBurst && since < pacerBurstGap {
+		return pacerBurstGap - since
+	}
+	return 0
+}
+
+// ==================== 记录已发送 ====================
+func (p *audioPacer) sent(n int, now time.Time) {
+	if now.Sub(p.lastSend) < pacerBurstGap {
+		p.burst++
+	} else {
+		p.burst = 1
+	}
+	p.lastSend = now
+	p.sentBytes += int64(n)
+	if p.active {
+		p.sendLeadNs.Store(int64(p.bytesToDuration(p.sentBytes) - now.Sub(p.clock)))
+	}
+}
+
+// ==================== 设备反馈：按剩余槽位调整提前量 ====================
+// 槽位耗尽说明发送过快，大幅缩短提前量；槽位接近全空说明设备缓冲见底，逐步加长
+func (p *audioPacer) feedback(flow *audioFlow) {
+	acks := flow.acks.Load()
+	if p.disabled || acks == p.lastAcks {
+		return
+	}
+	p.lastAcks = acks
+
+	credit := flow.Credit()
+	switch {
+	case credit < 0:
+		return
+	case credit == 0:
+		p.bursts.Add(1)
+		p.setLead(p.clampLead(p.lead * 3 / 4))
+	case credit <= 2:
+		p.setLead(p.clampLead(p.lead - pacerLeadStep))
+	case credit >= deviceAudioSlots-2:
+		p.setLead(p.clampLead(p.lead + pacerLeadStep))
+	}
+}
+
+func (p *audioPacer) clampLead(lead time.Duration) time.Duration {
+	if lead < p.minLead {
+		return p.minLead
+	}
+	if lead > p.maxLead {
+		return p.maxLead
+	}
+	return lead
+}
+
+// ==================== 由TXT记录解析音频格式 ====================
+// rates可能为逗号分隔列表，取第一个
+func formatFromTXT(txt map[string]string) (sampleRate, channels int) {
+	sampleRate, channels = defaultSampleRate, defaultChannels
+	if v, ok := txt["rates"]; ok {
+		for i := 0; i < len(v); i++ {
+			if v[i] == ',' {
+				v = v[:i]
+				break
+			}
+		}
+		if n, err := strconv.Atoi(v); err == nil && n > 0 {
+			sampleRate = n
+		}
+	}
+	if v, ok := txt["channels"]; ok {
+		if n, err := strconv.Atoi(v); err == nil && n > 0 {
+			channels = n
+		}
+	}
+	return sampleRate, channels
+}
@@ -0,0 +1,146 @@
+/***
+ * @file audio_pacer_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief 音频节拍器测试（提前量建立与保持、欠载重新对齐、额度反馈、TXT音频格式）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath audio_pacer_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"testing"
+	"time"
+)
+
+// 按节拍器给出的等待时间发送n帧，返回每帧的发送时刻
+func runPacer(p *audioPacer, now time.Time, n int) []time.Time {
+	sends := make([]time.Time, n)
+	for i := range sends {
+		now = now.Add(p.delay(now))
+		p.sent(pcmChunkBytes, now)
+		sends[i] = now
+	}
+	return sends
+}
+
+// 默认格式下一帧3000字节约17ms：提前量按不短于pacerBurstGap的间隔建立，之后按播放速率发送
+func TestAudioPacerLead(t *testing.T) {
+	lead := 120 * time.Millisecond
+	p := newAudioPacer(lead)
+	t0 := time.Unix(1000, 0)
+	p.start(t0)
+	sends := runPacer(p, t0, 200)
+	frame := p.bytesToDuration(pcmChunkBytes)
+
+	for i := 1; i < len(sends); i++ {
+		if gap := sends[i].Sub(sends[i-1]); gap < pacerBurstGap {
+			t.Fatalf("frames %d and %d sent %v apart, want at least %v", i-1, i, gap, pacerBurstGap)
+		}
+	}
+	last := sends[len(sends)-1]
+	ahead := p.bytesToDuration(p.sentBytes) - last.Sub(t0)
+	if ahead < lead || ahead > lead+frame+time.Microsecond {
+		t.Errorf("lead after %d frames = %v, want %v..%v", len(sends), ahead, lead, lead+frame)
+	}
+	if got := time.Duration(p.sendLeadNs.Load()); got != ahead {
+		t.Errorf("sendLead metric = %v, want %v", got, ahead)
+	}
+	// 稳态：每帧间隔等于一帧的播放时长
+	if gap := sends[len(sends)-1].Sub(sends[len(sends)-2]); gap < frame-time.Microsecond || gap > frame+time.Microsecond {
+		t.Errorf("steady-state gap = %v, want %v", gap, frame)
+	}
+	if p.stalls.Load() != 0 {
+		t.Errorf("stalls = %d, want 0", p.stalls.Load())
+	}
+}
+
+// 断流超过已发送数据：记一次欠载，时钟重新对齐，之后不突发补发
+func TestAudioPacerStall(t *testing.T) {
+	p := newAudioPacer(120 * time.Millisecond)
+	t0 := time.Unix(1000, 0)
+	p.start(t0)
+	sends := runPacer(p, t0, 20)
+
+	resume := sends[len(sends)-1].Add(5 * time.Second)
+	if d := p.delay(resume); d != 0 {
+		t.Errorf("delay after stall = %v, want 0", d)
+	}
+	if p.stalls.Load() != 1 {
+		t.Errorf("stalls = %d, want 1", p.stalls.Load())
+	}
+	after := runPacer(p, resume, 5)
+	for i := 1; i < len(after); i++ {
+		if gap := after[i].Sub(after[i-1]); gap < pacerBurstGap {
+			t.Errorf("frame %d after resume sent %v after the previous one", i, gap)
+		}
+	}
+}
+
+func TestAudioPacerDisabled(t *testing.T) {
+	p := newAudioPacer(0)
+	now := time.Unix(1000, 0)
+	for i := 0; i < 100; i++ {
+		if d := p.delay(now); d != 0 {
+			t.Fatalf("disabled pacer delayed frame %d by %v", i, d)
+		}
+		p.sent(pcmChunkBytes, now)
+	}
+}
+
+func TestAudioPacerFeedback(t *testing.T) {
+	tests := []struct {
+		name   string
+		lead   time.Duration
+		credit int32
+		want   time.Duration
+		bursts uint64
+	}{
+		{"queue full", 120 * time.Millisecond, 0, 90 * time.Millisecond, 1},
+		{"queue full at minimum", pacerMinLead, 0, pacerMinLead, 1},
+		{"nearly full", 120 * time.Millisecond, 2, 110 * time.Millisecond, 0},
+		{"comfortable", 120 * time.Millisecond, 5, 120 * time.Millisecond, 0},
+		{"nearly empty", 120 * time.Millisecond, deviceAudioSlots - 2, 130 * time.Millisecond, 0},
+		{"nearly empty at maximum", pacerMaxLead, deviceAudioSlots, pacerMaxLead, 0},
+		{"not reported", 120 * time.Millisecond, -1, 120 * time.Millisecond, 0},
+	}
+	for _, tt := range tests {
+		p := newAudioPacer(tt.lead)
+		flow := &audioFlow{}
+		flow.credit.Store(tt.credit)
+		flow.acks.Store(1)
+		p.feedback(flow)
+		// 没有新的额度报告时不重复调整
+		p.feedback(flow)
+		if p.lead != tt.want || time.Duration(p.leadNs.Load()) != tt.want || p.bursts.Load() != tt.bursts {
+			t.Errorf("%s: lead %v (metric %v), bursts %d; want %v, %d", tt.name,
+				p.lead, time.Duration(p.leadNs.Load()), p.bursts.Load(), tt.want, tt.bursts)
+		}
+	}
+}
+
+func TestFormatFromTXT(t *testing.T) {
+	tests := []struct {
+		txt      map[string]string
+		rate, ch int
+	}{
+		{nil, defaultSampleRate, defaultChannels},
+		{map[string]string{"rates": "48000", "channels": "1"}, 48000, 1},
+		{map[string]string{"rates": "16000,22050,44100"}, 16000, defaultChannels},
+		{map[string]string{"rates": "", "channels": "0"}, defaultSampleRate, defaultChannels},
+		{map[string]string{"rates": "fast", "channels": "-2"}, defaultSampleRate, defaultChannels},
+	}
+	for _, tt := range tests {
+		if rate, ch := formatFromTXT(tt.txt); rate != tt.rate || ch != tt.ch {
+			t.Errorf("formatFromTXT(%v) = %d, %d; want %d, %d", tt.txt, rate, ch, tt.rate, tt.ch)
+		}
+	}
+}
@@ -0,0 +1,716 @@
+/***
+ * @file connection_manager.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-15
+ * @brief ESP32连接池（每设备独立发送/读取协程，共享缓冲扇出，实时节拍，响应分发）
+ *
+ * @version 0.3
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-18
+ * @filePath connection_manager.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// ==================== 连接池配置 ====================
+const (
+	deviceQueueLen      = 512             // 每设备发送队列长度（帧），音频按实时节拍发出，可缓冲约8秒
+	deviceWriteTimeout  = 5 * time.Second // 单帧写超时，超时视为连接失效
+	controlEnqueueWait  = 2 * time.Second // 控制命令入队最长等待
+	audioEnqueueWait    = 1 * time.Second // 音频入队最长等待（队列满时的有界等待，超时丢弃该帧或请求报错）
+	sharedFrameMaxPool  = 64 * 1024       // 超过此容量的缓冲不回收
+	sharedFrameInitSize = 4096
+)
+
+var (
+	errDeviceClosed   = errors.New("device connection closed")
+	errRequestTimeout = errors.New("device request timed out")
+	errDeviceError    = errors.New("device returned error response")
+)
+
+// ==================== 共享帧缓冲 ====================
+// 同一帧被扇出到多个设备时只保存一份，引用计数归零后回收到池中
+type sharedFrame struct {
+	data []byte
+	refs atomic.Int32
+}
+
+var sharedFramePool = sync.Pool{
+	New: func() interface{} {
+		return &sharedFrame{data: make([]byte, 0, sharedFrameInitSize)}
+	},
+}
+
+// 单目标发送时直接设置引用计数为1
+func newSharedFrameWithRefs(cmd byte, payload []byte) *sharedFrame {
+	f := newSharedFrame(cmd, payload)
+	f.refs.Store(1)
+	return f
+}
+
+func newSharedFrame(cmd byte, payload []byte) *sharedFrame {
+	f := sharedFramePool.Get().(*sharedFrame)
+	f.data = append(f.data[:0], cmd)
+	f.data = append(f.data, payload...)
+	return f
+}
+
+// 从reader直接读入池化缓冲（命令字节 + 全部数据），避免中间拷贝
+func newSharedFrameFromReader(cmd byte, r io.Reader) (*sharedFrame, error) {
+	f := sharedFramePool.Get().(*sharedFrame)
+	f.data = append(f.data[:0], cmd)
+	for {
+		if len(f.data) == cap(f.data) {
+			f.data = append(f.data, 0)[:len(f.data)]
+		}
+		n, err := r.Read(f.data[len(f.data):cap(f.data)])
+		f.data = f.data[:len(f.data)+n]
+		if err == io.EOF {
+			return f, nil
+		}
+		if err != nil {
+			f.refs.Store(1)
+			f.release()
+			return nil, err
+		}
+	}
+}
+
+func (f *sharedFrame) release() {
+	if f.refs.Add(-1) == 0 && cap(f.data) <= sharedFrameMaxPool {
+		sharedFramePool.Put(f)
+	}
+}
+
+// ==================== 音频流控状态（读取协程写入，发送方读取） ====================
+type audioFlow struct {
+	acks   atomic.Uint64 // 收到的ACK/额度帧数
+	errors atomic.Uint64 // 未匹配到请求的错误响应
+	credit atomic.Int32  // 设备最近报告的音频队列剩余槽位，-1表示尚未报告
+	signal chan struct{} // 每次ACK/额度更新时通知（容量1，合并通知）
+}
+
+func (a *audioFlow) notify() {
+	select {
+	case a.signal <- struct{}{}:
+	default:
+	}
+}
+
+// 最近报告的剩余槽位，-1表示未知
+func (a *audioFlow) Credit() int {
+	return int(a.credit.Load())
+}
+
+// ACK/额度更新通知
+func (a *audioFlow) Updated() <-chan struct{} {
+	return a.signal
+}
+
+// ==================== 挂起的请求（按发送顺序匹配响应） ====================
+// 设备响应不带请求编号，同类型响应按FIFO交给最早的等待者
+type pendingRequest struct {
+	expect byte
+	data   []byte
+	err    error
+	done   chan struct{}
+}
+
+// ==================== 单设备连接 ====================
+type outboundFrame struct {
+	frame    *sharedFrame
+	enqueued time.Time
+	gen      uint32 // 入队时的音频代数，停止命令会使之前的音频帧失效
+}
+
+type DeviceConn struct {
+	ID          string // "ip:port"
+	IP          string
+	conn        net.Conn
+	queue       chan outboundFrame
+	done        chan struct{}
+	closeOnce   sync.Once
+	connectedAt time.Time
+	manager     *ConnectionManager
+	flow        audioFlow
+	pacer       *audioPacer
+	audioGen    atomic.Uint32
+	lagging     atomic.Bool // 等待入队超时后置位，队列排空一半前不再等待，避免卡住的设备拖慢其他设备
+
+	pendingMu sync.Mutex
+	pending   []*pendingRequest
+
+	framesSent    atomic.Uint64
+	bytesSent     atomic.Uint64
+	framesDropped atomic.Uint64
+	lastLatencyNs atomic.Int64 // 最近一帧入队到写完的耗时
+	maxLatencyNs  atomic.Int64
+	framesFlushed atomic.Uint64 // 停止播放时丢弃的已缓冲音频帧
+	framesRecv    atomic.Uint64
+	unsolicited   atomic.Uint64 // 无等待者的应答帧
+	unknownBytes  atomic.Uint64
+}
+
+// 设备连接统计
+type DeviceConnStats struct {
+	ID            string  `json:"id"`
+	IP            string  `json:"ip"`
+	ConnectedAt   int64   `json:"connected_at"`
+	QueueDepth    int     `json:"queue_depth"`
+	FramesSent    uint64  `json:"frames_sent"`
+	BytesSent     uint64  `json:"bytes_sent"`
+	FramesDropped uint64  `json:"frames_dropped"`
+	LastLatencyMs float64 `json:"last_latency_ms"`
+	MaxLatencyMs  float64 `json:"max_latency_ms"`
+	FramesFlushed uint64  `json:"frames_flushed"`
+	SendLeadMs    float64 `json:"send_lead_ms"`
+	TargetLeadMs  float64 `json:"target_lead_ms"`
+	Bursts        uint64  `json:"bursts"`
+	Stalls        uint64  `json:"stalls"`
+	ByteRate      int64   `json:"byte_rate"`
+	FramesRecv    uint64  `json:"frames_received"`
+	Acks          uint64  `json:"acks"`
+	Credit        int     `json:"credit"`
+	Unsolicited   uint64  `json:"unsolicited"`
+	UnknownBytes  uint64  `json:"unknown_bytes"`
+}
+
+// ==================== 发送协程：按顺序写出队列中的帧 ====================
+// 控制命令立即发送；音频帧（0xA4）由节拍器按播放速率放行，队首音频未到时间时后续帧一并等待以保持顺序
+func (d *DeviceConn) writer() {
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+
+next:
+	for {
+		var out outboundFrame
+		select {
+		case out = <-d.queue:
+		case <-d.done:
+			d.drainQueue()
+			return
+		}
+
+		cmd := out.frame.data[0]
+		if cmd == 0xA4 {
+			for {
+				// 停止命令之前入队的音频直接丢弃
+				if out.gen != d.audioGen.Load() {
+					out.frame.release()
+					d.framesFlushed.Add(1)
+					continue next
+				}
+				d.pacer.feedback(&d.flow)
+				wait := d.pacer.delay(time.Now())
+				if wait <= 0 {
+					break
+				}
+				timer.Reset(wait)
+				select {
+				case <-timer.C:
+				case <-d.done:
+					out.frame.release()
+					d.drainQueue()
+					return
+				}
+			}
+		}
+
+		d.conn.SetWriteDeadline(time.Now().Add(deviceWriteTimeout))
+		n, err := d.conn.Write(out.frame.data)
+		out.frame.release()
+		if err != nil {
+			log.Printf("Device %s write failed: %v", d.ID, err)
+			d.manager.remove(d)
+			d.Close()
+			return
+		}
+
+		now := time.Now()
+		switch cmd {
+		case 0xA3:
+			d.pacer.start(now)
+		case 0xA4:
+			d.pacer.sent(n-1, now)
+		case 0xA0, 0xA5:
+			d.pacer.stop()
+		}
+
+		latency := now.Sub(out.enqueued).Nanoseconds()
+		d.lastLatencyNs.Store(latency)
+		if latency > d.maxLatencyNs.Load() {
+			d.maxLatencyNs.Store(latency)
+		}
+		d.framesSent.Add(1)
+		d.bytesSent.Add(uint64(n))
+	}
+}
+
+// 释放队列中剩余帧的引用
+func (d *DeviceConn) drainQueue() {
+	for {
+		select {
+		case out := <-d.queue:
+			out.frame.release()
+		default:
+			return
+		}
+	}
+}
+
+// ==================== 设置音频格式（决定节拍速率） ====================
+func (d *DeviceConn) SetAudioFormat(sampleRate, channels int) {
+	d.pacer.setFormat(sampleRate, channels, defaultSampleSize)
+}
+
+// ==================== 读取协程：解码响应帧并分发 ====================
+func (d *DeviceConn) reader() {
+	dec := NewFrameDecoder(d.conn)
+	for {
+		f, err := dec.Next()
+		if err != nil {
+			select {
+			case <-d.done:
+			default:
+				log.Printf("Device %s read stopped: %v", d.ID, err)
+			}
+			d.unknownBytes.Store(dec.Unknown)
+			d.manager.remove(d)
+			d.Close()
+			d.failPending(errDeviceClosed)
+			return
+		}
+		d.dispatch(f)
+		d.unknownBytes.Store(dec.Unknown)
+	}
+}
+
+// ==================== 帧分发 ====================
+// ACK/额度 -> 音频发送方；温度遥测 -> 告警广播；其余应答 -> 挂起的请求
+func (d *DeviceConn) dispatch(f Frame) {
+	d.framesRecv.Add(1)
+	switch f.Type {
+	case respAudioAck:
+		d.flow.acks.Add(1)
+		d.flow.notify()
+
+	case respAudioCredit:
+		d.flow.acks.Add(1)
+		d.flow.credit.Store(int32(f.Payload[0]))
+		d.flow.notify()
+
+	case respTempNormal, respThreshold1, respThreshold2, respTempUpdate:
+		if h := d.manager.OnTelemetry; h != nil {
+			h(d, f)
+		}
+
+	case respStatusOK, respDeviceInfo, respTaskStats, respTempHistory, respError:
+		if !d.resolvePending(f) {
+			d.unsolicited.Add(1)
+			if f.Type == respError {
+				d.flow.errors.Add(1)
+			}
+		}
+	}
+}
+
+// ==================== 将应答交给最早的匹配请求 ====================
+func (d *DeviceConn) resolvePending(f Frame) bool {
+	d.pendingMu.Lock()
+	defer d.pendingMu.Unlock()
+
+	for i, p := range d.pending {
+		// 错误响应交给最早的请求
+		if f.Type != p.expect && f.Type != respError {
+			continue
+		}
+		if f.Type == respError {
+			p.err = errDeviceError
+		} else if f.Type == respTempHistory && len(f.Payload) > 1 {
+			// 历史记录分多帧返回，累积到结束帧（仅含分辨率字节）
+			p.data = append(p.data, f.Payload[1:]...)
+			return true
+		} else if f.Type != respTempHistory {
+			p.data = append(p.data[:0], f.Payload...)
+		}
+		d.pending = append(d.pending[:i], d.pending[i+1:]...)
+		close(p.done)
+		return true
+	}
+	return false
+}
+
+func (d *DeviceConn) failPending(err error) {
+	d.pendingMu.Lock()
+	pending := d.pending
+	d.pending = nil
+	d.pendingMu.Unlock()
+
+	for _, p := range pending {
+		p.err = err
+		close(p.done)
+	}
+}
+
+// ==================== 发送请求并等待应答 ====================
+// expect为期望的响应码；返回应答负载（不含响应码和长度字段）
+func (d *DeviceConn) Request(cmd byte, payload []byte, expect byte, timeout time.Duration) ([]byte, error) {
+	p := &pendingRequest{expect: expect, done: make(chan struct{})}
+	d.pendingMu.Lock()
+	d.pending = append(d.pending, p)
+	d.pendingMu.Unlock()
+
+	if err := d.enqueue(newSharedFrameWithRefs(cmd, payload), controlEnqueueWait); err != nil {
+		d.cancelPending(p)
+		return nil, err
+	}
+
+	timer := time.NewTimer(timeout)
+	defer timer.Stop()
+	select {
+	case <-p.done:
+		return p.data, p.err
+	case <-timer.C:
+		if d.cancelPending(p) {
+			return nil, fmt.Errorf("%w: 0x%02X", errRequestTimeout, cmd)
+		}
+		// 超时的同时应答到达
+		<-p.done
+		return p.data, p.err
+	}
+}
+
+func (d *DeviceConn) cancelPending(p *pendingRequest) bool {
+	d.pendingMu.Lock()
+	defer d.pendingMu.Unlock()
+	for i, q := range d.pending {
+		if q == p {
+			d.pending = append(d.pending[:i], d.pending[i+1:]...)
+			return true
+		}
+	}
+	return false
+}
+
+// ==================== 入队（wait为0时队列满直接丢弃） ====================
+func (d *DeviceConn) enqueue(f *sharedFrame, wait time.Duration) error {
+	if f.data[0] == 0xA0 {
+		// 停止播放：使已缓冲的音频失效
+		d.audioGen.Add(1)
+	}
+	out := outboundFrame{frame: f, enqueued: time.Now(), gen: d.audioGen.Load()}
+	select {
+	case d.queue <- out:
+		return nil
+	case <-d.done:
+		f.release()
+		return errDeviceClosed
+	default:
+	}
+
+	if wait > 0 && d.lagging.Load() && len(d.queue) < cap(d.queue)/2 {
+		d.lagging.Store(false)
+	}
+	if wait > 0 && !d.lagging.Load() {
+		timer := time.NewTimer(wait)
+		defer timer.Stop()
+		select {
+		case d.queue <- out:
+			return nil
+		case <-d.done:
+			f.release()
+			return errDeviceClosed
+		case <-timer.C:
+			d.lagging.Store(true)
+		}
+	}
+
+	d.framesDropped.Add(1)
+	f.release()
+	return errors.New("device queue full")
+}
+
+// ==================== 关闭连接 ====================
+func (d *DeviceConn) Close() {
+	d.closeOnce.Do(func() {
+		close(d.done)
+		d.conn.Close()
+	})
+}
+
+// ==================== 音频流控状态 ====================
+func (d *DeviceConn) Flow() *audioFlow {
+	return &d.flow
+}
+
+func (d *DeviceConn) Stats() DeviceConnStats {
+	return DeviceConnStats{
+		ID:            d.ID,
+		IP:            d.IP,
+		ConnectedAt:   d.connectedAt.Unix(),
+		QueueDepth:    len(d.queue),
+		FramesSent:    d.framesSent.Load(),
+		BytesSent:     d.bytesSent.Load(),
+		FramesDropped: d.framesDropped.Load(),
+		LastLatencyMs: float64(d.lastLatencyNs.Load()) / 1e6,
+		MaxLatencyMs:  float64(d.maxLatencyNs.Load()) / 1e6,
+		FramesFlushed: d.framesFlushed.Load(),
+		SendLeadMs:    float64(d.pacer.sendLeadNs.Load()) / 1e6,
+		TargetLeadMs:  float64(d.pacer.leadNs.Load()) / 1e6,
+		Bursts:        d.pacer.bursts.Load(),
+		Stalls:        d.pacer.stalls.Load(),
+		ByteRate:      d.pacer.rateBps.Load(),
+		FramesRecv:    d.framesRecv.Load(),
+		Acks:          d.flow.acks.Load(),
+		Credit:        d.flow.Credit(),
+		Unsolicited:   d.unsolicited.Load(),
+		UnknownBytes:  d.unknownBytes.Load(),
+	}
+}
+
+// ==================== 连接池 ====================
+type ConnectionManager struct {
+	mu       sync.RWMutex
+	devices  map[string]*DeviceConn
+	queueLen int
+
+	// 温度遥测帧回调（在设备读取协程中调用，Payload仅在回调期间有效）
+	OnTelemetry func(d *DeviceConn, f Frame)
+}
+
+// 扇出结果
+type FanoutResult struct {
+	Targets int `json:"targets"`
+	Queued  int `json:"queued"`
+	Failed  int `json:"failed"`
+}
+
+var connManager = NewConnectionManager(deviceQueueLen)
+
+func NewConnectionManager(queueLen int) *ConnectionManager {
+	return &ConnectionManager{
+		devices:  make(map[string]*DeviceConn),
+		queueLen: queueLen,
+	}
+}
+
+// ==================== 建立连接（同一地址已连接时替换旧连接） ====================
+func (m *ConnectionManager) Connect(address string) (*DeviceConn, error) {
+	conn, err := net.DialTimeout("tcp", address, 5*time.Second)
+	if err != nil {
+		return nil, err
+	}
+	if tcp, ok := conn.(*net.TCPConn); ok {
+		tcp.SetNoDelay(true)
+	}
+
+	host, _, _ := net.SplitHostPort(address)
+	d := &DeviceConn{
+		ID:          address,
+		IP:          host,
+		conn:        conn,
+		queue:       make(chan outboundFrame, m.queueLen),
+		done:        make(chan struct{}),
+		connectedAt: time.Now(),
+		manager:     m,
+		flow:        audioFlow{signal: make(chan struct{}, 1)},
+		pacer:       newAudioPacer(audioLeadDefault),
+	}
+	d.flow.credit.Store(-1)
+
+	m.mu.Lock()
+	old := m.devices[address]
+	m.devices[address] = d
+	m.mu.Unlock()
+	if old != nil {
+		old.Close()
+	}
+
+	go d.writer()
+	go d.reader()
+	return d, nil
+}
+
+// ==================== 从池中移除（仅当仍是同一连接时） ====================
+func (m *ConnectionManager) remove(d *DeviceConn) {
+	m.mu.Lock()
+	if m.devices[d.ID] == d {
+		delete(m.devices, d.ID)
+	}
+	m.mu.Unlock()
+}
+
+// ==================== 断开指定设备（target为ip或ip:port） ====================
+func (m *ConnectionManager) Disconnect(target string) int {
+	devs := m.Resolve([]string{target})
+	for _, d := range devs {
+		m.remove(d)
+		d.Close()
+	}
+	return len(devs)
+}
+
+// ==================== 断开全部设备 ====================
+func (m *ConnectionManager) DisconnectAll() int {
+	m.mu.Lock()
+	devs := m.devices
+	m.devices = make(map[string]*DeviceConn)
+	m.mu.Unlock()
+
+	for _, d := range devs {
+		d.Close()
+	}
+	return len(devs)
+}
+
+// ==================== 已连接设备数 ====================
+func (m *ConnectionManager) Count() int {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	return len(m.devices)
+}
+
+// ==================== 解析目标列表（空列表表示全部设备） ====================
+func (m *ConnectionManager) Resolve(targets []string) []*DeviceConn {
+	// 容量不预估：读取len(m.devices)须持锁，由appendResolved在锁内追加
+	return m.appendResolved(nil, targets)
+}
+
+func (m *ConnectionManager) appendResolved(devs []*DeviceConn, targets []string) []*DeviceConn {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+
+	for _, d := range m.devices {
+		if d.matches(targets) {
+			devs = append(devs, d)
+		}
+	}
+	return devs
+}
+
+func (d *DeviceConn) matches(targets []string) bool {
+	if len(targets) == 0 {
+		return true
+	}
+	for _, t := range targets {
+		if t == d.ID || t == d.IP {
+			return true
+		}
+	}
+	return false
+}
+
+// ==================== 发送命令到目标设备 ====================
+// 帧只构建一次，所有目标共享同一缓冲；wait为0时慢设备队列满即丢帧，不拖慢其他设备
+func (m *ConnectionManager) Send(targets []string, cmd byte, payload []byte, wait time.Duration) FanoutResult {
+	return m.SendFrame(targets, newSharedFrame(cmd, payload), wait)
+}
+
+// ==================== 发送已构建的共享帧（调用后帧所有权转移） ====================
+func (m *ConnectionManager) SendFrame(targets []string, f *sharedFrame, wait time.Duration) FanoutResult {
+	if wait == 0 {
+		return m.sendFrameNoWait(targets, f)
+	}
+
+	// 等待期间不能持有读锁，先复制目标列表（常见设备数内使用栈上数组）
+	var local [8]*DeviceConn
+	devs := m.appendResolved(local[:0], targets)
+	res := FanoutResult{Targets: len(devs)}
+	if len(devs) == 0 {
+		f.refs.Store(1)
+		f.release()
+		return res
+	}
+
+	f.refs.Store(int32(len(devs)))
+	for _, d := range devs {
+		if err := d.enqueue(f, wait); err != nil {
+			res.Failed++
+		} else {
+			res.Queued++
+		}
+	}
+	return res
+}
+
+// ==================== 不等待入队：在读锁内直接遍历，避免每帧分配目标列表 ====================
+func (m *ConnectionManager) sendFrameNoWait(targets []string, f *sharedFrame) FanoutResult {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+
+	var res FanoutResult
+	for _, d := range m.devices {
+		if d.matches(targets) {
+			res.Targets++
+		}
+	}
+	if res.Targets == 0 {
+		f.refs.Store(1)
+		f.release()
+		return res
+	}
+
+	f.refs.Store(int32(res.Targets))
+	for _, d := range m.devices {
+		if !d.matches(targets) {
+			continue
+		}
+		if err := d.enqueue(f, 0); err != nil {
+			res.Failed++
+		} else {
+			res.Queued++
+		}
+	}
+	return res
+}
+
+// ==================== 按ID或IP查找单个设备 ====================
+func (m *ConnectionManager) Get(target string) *DeviceConn {
+	devs := m.Resolve([]string{target})
+	if len(devs) == 0 {
+		return nil
+	}
+	return devs[0]
+}
+
+// ==================== 连接统计快照 ====================
+func (m *ConnectionManager) Snapshot() []DeviceConnStats {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+
+	stats := make([]DeviceConnStats, 0, len(m.devices))
+	for _, d := range m.devices {
+		stats = append(stats, d.Stats())
+	}
+	return stats
+}
+
+// ==================== 解析请求中的目标设备（?targets=ip1,ip2:8080） ====================
+func parseTargets(raw string) []string {
+	if raw == "" {
+		return nil
+	}
+	var targets []string
+	for _, t := range strings.Split(raw, ",") {
+		if t = strings.TrimSpace(t); t != "" {
+			targets = append(targets, t)
+		}
+	}
+	return targets
+}
@@ -0,0 +1,212 @@
+/***
+ * @file decode_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-16
+ * @brief 响应帧解码基准测试（混合帧流，统计吞吐与每帧分配）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-16
+ * @filePath decode_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"os"
+	"runtime"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkDecode$' -benchtime 1x
+//
+// 构造与设备实际输出比例相近的混合帧流（温度更新、额度、ACK、告警、状态、任务报告、历史分片），
+// 经真实的FrameDecoder + DeviceConn.dispatch解码分发：
+//   1. 内存：按1460字节（以太网MSS）切片送入，帧会跨读取边界，测纯解码开销；
+//   2. 回环TCP：模拟设备全速写入，测端到端读取速率。
+// 每帧分配数由runtime.MemStats.Mallocs差值计算。
+
+func BenchmarkDecode(b *testing.B) {
+	runBenchOnce(b, func() { runDecodeBenchmark() })
+}
+
+const (
+	decodeBenchFrames  = 5_000_000
+	decodeBenchSegment = 1460
+)
+
+// ==================== 构造混合帧流（一个周期100帧） ====================
+func buildMixedStream() (stream []byte, frames int) {
+	put := func(b ...byte) {
+		stream = append(stream, b...)
+		frames++
+	}
+	tasks := make([]byte, 200)
+	for i := range tasks {
+		tasks[i] = 'a' + byte(i%26)
+	}
+	history := make([]byte, 1+64*10)
+
+	for i := 0; i < 40; i++ {
+		put(respTempUpdate, 0x01, byte(i)) // 25.x°C
+	}
+	for i := 0; i < 30; i++ {
+		put(respAudioCredit, byte(i%10))
+	}
+	for i := 0; i < 10; i++ {
+		put(respAudioAck)
+	}
+	for i := 0; i < 5; i++ {
+		put(respThreshold1+byte(i%2), 0x01, 0x20)
+	}
+	for i := 0; i < 5; i++ {
+		put(respStatusOK, 1, 1)
+	}
+	for i := 0; i < 5; i++ {
+		put(append([]byte{respTaskStats, 0, byte(len(tasks))}, tasks...)...)
+	}
+	for i := 0; i < 5; i++ {
+		put(append([]byte{respTempHistory, byte(len(history) >> 8), byte(len(history))}, history...)...)
+	}
+	return stream, frames
+}
+
+// 循环输出同一帧流，每次最多返回一个分段
+type segmentReader struct {
+	data []byte
+	pos  int
+}
+
+func (r *segmentReader) Read(p []byte) (int, error) {
+	if len(p) > decodeBenchSegment {
+		p = p[:decodeBenchSegment]
+	}
+	n := 0
+	for n < len(p) {
+		c := copy(p[n:], r.data[r.pos:])
+		n += c
+		r.pos = (r.pos + c) % len(r.data)
+	}
+	return n, nil
+}
+
+// ==================== 单次运行 ====================
+type decodeBenchResult struct {
+	frames  int
+	unknown uint64
+	elapsed time.Duration
+	mallocs uint64
+	telem   int
+}
+
+func benchDecodeRun(r io.Reader, d *DeviceConn, target int) (decodeBenchResult, error) {
+	var res decodeBenchResult
+	dec := NewFrameDecoder(r)
+
+	var before, after runtime.MemStats
+	runtime.GC()
+	runtime.ReadMemStats(&before)
+	start := time.Now()
+	for res.frames < target {
+		f, err := dec.Next()
+		if err != nil {
+			return res, err
+		}
+		d.dispatch(f)
+		res.frames++
+	}
+	res.elapsed = time.Since(start)
+	runtime.ReadMemStats(&after)
+	res.mallocs = after.Mallocs - before.Mallocs
+	res.unknown = dec.Unknown
+	return res, nil
+}
+
+func newBenchDevice(telem *int) *DeviceConn {
+	m := NewConnectionManager(deviceQueueLen)
+	m.OnTelemetry = func(d *DeviceConn, f Frame) {
+		*telem++
+	}
+	d := &DeviceConn{ID: "bench", manager: m, flow: audioFlow{signal: make(chan struct{}, 1)}}
+	d.flow.credit.Store(-1)
+	return d
+}
+
+func printDecodeResult(name string, r decodeBenchResult, streamBytes, streamFrames int) {
+	bytes := float64(r.frames) / float64(streamFrames) * float64(streamBytes)
+	fmt.Printf("%-10s %9d frames  %7.1f ns/frame  %6.2f M frames/s  %7.1f MB/s  %.4f allocs/frame  (telemetry %d)\n",
+		name, r.frames, float64(r.elapsed.Nanoseconds())/float64(r.frames),
+		float64(r.frames)/r.elapsed.Seconds()/1e6, bytes/r.elapsed.Seconds()/1e6,
+		float64(r.mallocs)/float64(r.frames), r.telem)
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runDecodeBenchmark() {
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	stream, perCycle := buildMixedStream()
+	fmt.Println("Frame decode benchmark (mixed device stream)")
+	fmt.Printf("cycle: %d frames / %d bytes (40%% temp, 30%% credit, 10%% ack, 5%% alert, 5%% status, 5%% task report, 5%% history)\n\n",
+		perCycle, len(stream))
+
+	// ==================== 内存分段 ====================
+	var telem int
+	d := newBenchDevice(&telem)
+	res, err := benchDecodeRun(&segmentReader{data: stream}, d, decodeBenchFrames)
+	res.telem = telem
+	if err != nil {
+		fmt.Printf("in-memory run failed: %v\n", err)
+		return
+	}
+	printDecodeResult("in-memory", res, len(stream), perCycle)
+
+	// ==================== 回环TCP ====================
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		fmt.Printf("loopback run skipped: %v\n", err)
+		return
+	}
+	defer l.Close()
+	go func() {
+		c, err := l.Accept()
+		if err != nil {
+			return
+		}
+		defer c.Close()
+		for {
+			if _, err := c.Write(stream); err != nil {
+				return
+			}
+		}
+	}()
+	conn, err := net.Dial("tcp4", l.Addr().String())
+	if err != nil {
+		fmt.Printf("loopback run skipped: %v\n", err)
+		return
+	}
+	defer conn.Close()
+
+	telem = 0
+	d = newBenchDevice(&telem)
+	res, err = benchDecodeRun(conn, d, decodeBenchFrames)
+	res.telem = telem
+	if err != nil {
+		fmt.Printf("loopback run failed: %v\n", err)
+		return
+	}
+	printDecodeResult("loopback", res, len(stream), perCycle)
+
+	fmt.Printf("\nrouted: acks %d, credit %d, unsolicited replies %d, unknown bytes %d\n",
+		d.flow.acks.Load(), d.flow.Credit(), d.unsolicited.Load(), res.unknown)
+	fmt.Println("loopback allocations include the simulated device's writer goroutine.")
+}
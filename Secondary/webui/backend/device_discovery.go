@@ -2,9 +2,9 @@
  * @file device_discovery.go
  * @author bearbox <apuirbox@gmail.com>
  * @date 2025-11-05
- * @brief 设备发现服务（mDNS + TCP扫描）
+ * @brief 设备发现服务（mDNS浏览，TCP扫描为可选后备）
  * 
- * @version 0.1
+ * @version 0.2
  * 
  * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
  * 
@@ -21,7 +21,9 @@ import (
 	"fmt"
 	"log"
 	"net"
+	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 )
 
@@ -35,6 +37,9 @@ type Device struct {
 	Online    bool      `json:"online"`
 	IsESP32   bool      `json:"is_esp32"`   // 是否确认为ESP32设备
 	Manual    bool      `json:"manual"`     // 是否手动添加
+	Source    string    `json:"source"`     // 发现来源："mdns"、"scan"、"manual"
+	Hostname  string    `json:"hostname,omitempty"` // mDNS主机名
+	TXT       map[string]string `json:"txt,omitempty"` // mDNS TXT记录（能力、床位、实时状态）
 }
 
 // ==================== 设备发现服务 ====================
@@ -46,16 +51,20 @@ type DeviceDiscovery struct {
 	cancel     context.CancelFunc
 	paused     bool           // 扫描是否暂停
 	pauseMu    sync.RWMutex   // 暂停状态锁
+	scanFallback bool         // 是否启用/24端口扫描后备
+	browser    *MDNSBrowser   // mDNS浏览器（创建失败时为nil）
 }
 
 // ==================== 创建设备发现服务 ====================
-func NewDeviceDiscovery() *DeviceDiscovery {
+// scanFallback为true时，除mDNS外还定期扫描本机/24网段的8080端口
+func NewDeviceDiscovery(scanFallback bool) *DeviceDiscovery {
 	ctx, cancel := context.WithCancel(context.Background())
 	return &DeviceDiscovery{
-		devices:    make(map[string]*Device),
-		scanTicker: time.NewTicker(10 * time.Second),
-		ctx:        ctx,
-		cancel:     cancel,
+		devices:      make(map[string]*Device),
+		scanTicker:   time.NewTicker(10 * time.Second),
+		ctx:          ctx,
+		cancel:       cancel,
+		scanFallback: scanFallback,
 	}
 }
 
@@ -63,8 +72,23 @@ func NewDeviceDiscovery() *DeviceDiscovery {
 func (d *DeviceDiscovery) Start() {
 	log.Println("Device discovery service started")
 	
+	// 启动mDNS浏览，失败时自动启用端口扫描
+	browser, err := NewMDNSBrowser(mdnsServiceName)
+	if err != nil {
+		log.Printf("mDNS browser unavailable (%v), falling back to port scan", err)
+		d.scanFallback = true
+	} else {
+		browser.OnUpdate = d.upsertMDNSDevice
+		browser.OnRemove = d.markMDNSDeviceOffline
+		d.browser = browser
+		go browser.Run(d.ctx)
+		log.Printf("mDNS browsing %s", mdnsServiceName)
+	}
+	
 	// 立即执行一次扫描
-	d.scanNetwork()
+	if d.scanFallback {
+		d.scanNetwork()
+	}
 	
 	// 定期扫描
 	for {
@@ -78,7 +102,9 @@ func (d *DeviceDiscovery) Start() {
 			isPaused := d.paused
 			d.pauseMu.RUnlock()
 			
-			if !isPaused {
+			if !d.scanFallback {
+				d.cleanupOfflineDevices()
+			} else if !isPaused {
 				d.scanNetwork()
 			} else {
 				log.Println("Device scanning paused (audio streaming in progress)")
@@ -139,10 +165,23 @@ func (d *DeviceDiscovery) scanNetwork() {
 	
 	log.Printf("Scanning network segment: %d.%d.%d.0/24", network[0], network[1], network[2])
 	
+	foundCount := d.scanSubnet(network.To4(), 8080)
+	
+	// 清理离线设备（排除手动添加的）
+	d.cleanupOfflineDevices()
+	
+	d.mu.RLock()
+	total := len(d.devices)
+	d.mu.RUnlock()
+	log.Printf("Network scan completed, found %d online hosts, %d total devices", foundCount, total)
+}
+
+// ==================== 扫描/24网段的指定端口 ====================
+func (d *DeviceDiscovery) scanSubnet(network net.IP, port int) int {
 	// 并发扫描
 	var wg sync.WaitGroup
+	var foundCount atomic.Int32
 	semaphore := make(chan struct{}, 50) // 限制并发数
-	foundCount := 0
 	
 	for i := 1; i < 255; i++ {
 		wg.Add(1)
@@ -154,18 +193,68 @@ func (d *DeviceDiscovery) scanNetwork() {
 			targetIP := fmt.Sprintf("%d.%d.%d.%d", network[0], network[1], network[2], hostNum)
 			
 			// 只检查端口是否开放，不尝试识别设备（避免ESP32崩溃）
-			if d.checkHostOnlineOnly(targetIP, 8080) {
-				foundCount++
+			if d.checkHostOnlineOnly(targetIP, port) {
+				foundCount.Add(1)
 			}
 		}(i)
 	}
 	
 	wg.Wait()
+	return int(foundCount.Load())
+}
+
+// ==================== mDNS实例更新 ====================
+func (d *DeviceDiscovery) upsertMDNSDevice(inst mdnsInstance) {
+	name := strings.TrimSuffix(inst.Name, "."+mdnsServiceName)
 	
-	// 清理离线设备（排除手动添加的）
-	d.cleanupOfflineDevices()
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	
+	device, exists := d.devices[inst.IP]
+	if exists && device.Manual {
+		// 手动添加的设备保留手动属性，仅补充mDNS信息
+		device.Hostname = inst.Host
+		device.TXT = inst.TXT
+		device.LastSeen = time.Now()
+		device.Online = true
+		return
+	}
+	if !exists || !device.Online || device.Source != "mdns" {
+		log.Printf("✓ mDNS: %s at %s:%d", name, inst.IP, inst.Port)
+	}
+	
+	d.devices[inst.IP] = &Device{
+		Name:     name,
+		IP:       inst.IP,
+		Port:     inst.Port,
+		Type:     "ESP32-S3",
+		LastSeen: time.Now(),
+		Online:   true,
+		IsESP32:  true,
+		Manual:   false,
+		Source:   "mdns",
+		Hostname: inst.Host,
+		TXT:      inst.TXT,
+	}
+}
+
+// ==================== mDNS实例下线 ====================
+func (d *DeviceDiscovery) markMDNSDeviceOffline(inst mdnsInstance) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
 	
-	log.Printf("Network scan completed, found %d online hosts, %d total devices", foundCount, len(d.devices))
+	if device, exists := d.devices[inst.IP]; exists && device.Source == "mdns" && device.Online {
+		device.Online = false
+		log.Printf("mDNS: %s (%s) went offline", device.Name, inst.IP)
+	}
+}
+
+// ==================== 获取mDNS统计 ====================
+func (d *DeviceDiscovery) MDNSStats() (MDNSStats, bool) {
+	if d.browser == nil {
+		return MDNSStats{}, false
+	}
+	return d.browser.Stats(), true
 }
 
 // ==================== 只检查主机是否在线（不发送命令） ====================
@@ -189,6 +278,7 @@ func (d *DeviceDiscovery) checkHostOnlineOnly(ip string, port int) bool {
 			Online:   true,
 			IsESP32:  false,
 			Manual:   false,
+			Source:   "scan",
 		}
 		log.Printf("Found device at %s (port %d open)", ip, port)
 	} else {
@@ -229,6 +319,7 @@ func (d *DeviceDiscovery) probeDevice(ip string, port int) {
 				Online:   true,
 				IsESP32:  false,
 				Manual:   false,
+				Source:   "scan",
 			}
 			log.Printf("Found unknown device at %s (connection failed)", ip)
 		} else {
@@ -255,24 +346,24 @@ func (d *DeviceDiscovery) probeDevice(ip string, port int) {
 	// 设置较长的读取超时（ESP32可能需要时间处理）
 	conn.SetReadDeadline(time.Now().Add(5 * time.Second))
 	
-	// 读取响应
-	buf := make([]byte, 64)
-	n, err := conn.Read(buf)
+	// 读取响应帧（设备可能先推送温度帧，跳过直到设备信息响应）
+	dec := NewFrameDecoder(conn)
+	var frame Frame
+	for {
+		frame, err = dec.Next()
+		if err != nil || frame.Type == respDeviceInfo || frame.Type == respError {
+			break
+		}
+	}
 	if err != nil {
 		log.Printf("No valid response from %s: %v (may not be ESP32)", ip, err)
 		d.updateDeviceAsUnknown(ip, port)
 		return
 	}
 	
-	if n < 1 {
-		log.Printf("Empty response from %s", ip)
-		d.updateDeviceAsUnknown(ip, port)
-		return
-	}
-	
-	// 检查响应码 0xD5
-	if buf[0] == 0xD5 && n > 1 {
-		deviceName := string(buf[1:n])
+	// 检查响应码 0xD6（长度 + 设备名）
+	if frame.Type == respDeviceInfo && len(frame.Payload) > 0 {
+		deviceName := string(frame.Payload)
 		log.Printf("✓ Found ESP32 device: %s at %s", deviceName, ip)
 		
 		d.mu.Lock()
@@ -285,10 +376,11 @@ func (d *DeviceDiscovery) probeDevice(ip string, port int) {
 			Online:   true,
 			IsESP32:  true,
 			Manual:   false,
+			Source:   "scan",
 		}
 		d.mu.Unlock()
 	} else {
-		log.Printf("Unexpected response from %s: 0x%02X (length: %d)", ip, buf[0], n)
+		log.Printf("Unexpected response from %s: 0x%02X (length: %d)", ip, frame.Type, len(frame.Payload))
 		d.updateDeviceAsUnknown(ip, port)
 	}
 }
@@ -314,6 +406,7 @@ func (d *DeviceDiscovery) updateDeviceAsUnknown(ip string, port int) {
 			Online:   true,
 			IsESP32:  false,
 			Manual:   false,
+			Source:   "scan",
 		}
 	}
 }
@@ -327,8 +420,8 @@ func (d *DeviceDiscovery) cleanupOfflineDevices() {
 	now := time.Now()
 	
 	for ip, device := range d.devices {
-		// 手动添加的设备不自动标记为离线
-		if device.Manual {
+		// 手动添加的设备不自动标记为离线，mDNS设备由记录TTL管理
+		if device.Manual || device.Source == "mdns" {
 			continue
 		}
 		
@@ -377,6 +470,7 @@ func (d *DeviceDiscovery) AddDevice(ip string, port int, name string) error {
 		Online:   true,
 		IsESP32:  false,
 		Manual:   true,
+		Source:   "manual",
 	}
 	
 	log.Printf("Manually added device: %s at %s:%d", name, ip, port)
@@ -399,9 +493,11 @@ func (d *DeviceDiscovery) GetDevices() []*Device {
 	d.mu.RLock()
 	defer d.mu.RUnlock()
 	
+	// 返回副本，避免序列化时与发现协程并发读写
 	devices := make([]*Device, 0, len(d.devices))
 	for _, device := range d.devices {
-		devices = append(devices, device)
+		cp := *device
+		devices = append(devices, &cp)
 	}
 	
 	return devices
@@ -0,0 +1,293 @@
+/***
+ * @file fanout_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-15
+ * @brief 多设备音频扇出基准测试（回环TCP模拟设备）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-15
+ * @filePath fanout_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"os"
+	"runtime"
+	"runtime/metrics"
+	"sort"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkFanout$' -benchtime 1x [-fanout-devices 100]
+//
+// 在回环地址上启动N个模拟设备，经connManager以44.1kHz/16bit/立体声的实时速率
+// 推送约10秒音频（每块3000字节，与前端分块一致）。每块负载前16字节写入序号和发送时间，
+// 设备侧记录到达时间，统计同一块在各设备间的到达偏差（skew）和端到端延迟。
+// 额外加入一个读取很慢的设备，验证其队列溢出只丢自己的帧，不拖慢其他设备。
+// 模拟设备与后端在同一进程内，CPU时间包含设备侧读取开销，是上界。
+
+func BenchmarkFanout(b *testing.B) {
+	runBenchOnce(b, func() { runFanoutBenchmark(*benchFanoutDevices) })
+}
+
+const (
+	fanoutChunkBytes = 3000
+	fanoutDuration   = 10 * time.Second
+	fanoutByteRate   = 44100 * 2 * 2 // 采样率 × 声道 × 字节
+	fanoutSlowDelay  = 200 * time.Millisecond
+	fanoutSlowBuffer = 4096 // 慢设备接收缓冲，模拟ESP32较小的TCP窗口
+)
+
+// ==================== 模拟设备 ====================
+type fanoutDevice struct {
+	listener net.Listener
+	slow     bool
+	arrivals []int64         // 按块序号记录到达时间（UnixNano），0表示未收到
+	latency  []time.Duration // 按块序号记录发送到到达的延迟
+	received atomic.Int64
+	done     chan struct{}
+}
+
+func newFanoutDevice(chunks int, slow bool) (*fanoutDevice, error) {
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		return nil, err
+	}
+	d := &fanoutDevice{
+		listener: l,
+		slow:     slow,
+		arrivals: make([]int64, chunks),
+		latency:  make([]time.Duration, chunks),
+		done:     make(chan struct{}),
+	}
+	go d.serve()
+	return d, nil
+}
+
+func (d *fanoutDevice) serve() {
+	defer close(d.done)
+	c, err := d.listener.Accept()
+	if err != nil {
+		return
+	}
+	defer c.Close()
+	if d.slow {
+		c.(*net.TCPConn).SetReadBuffer(fanoutSlowBuffer)
+	}
+
+	buf := make([]byte, 1+fanoutChunkBytes)
+	for {
+		// 控制命令只有1字节，音频帧为 0xA4 + 固定长度负载
+		if _, err := io.ReadFull(c, buf[:1]); err != nil {
+			return
+		}
+		if buf[0] != 0xA4 {
+			continue
+		}
+		if _, err := io.ReadFull(c, buf[1:]); err != nil {
+			return
+		}
+		now := time.Now().UnixNano()
+		seq := binary.BigEndian.Uint64(buf[1:9])
+		if seq < uint64(len(d.arrivals)) {
+			d.arrivals[seq] = now
+			d.latency[seq] = time.Duration(now - int64(binary.BigEndian.Uint64(buf[9:17])))
+		}
+		d.received.Add(1)
+		if d.slow {
+			time.Sleep(fanoutSlowDelay)
+		}
+	}
+}
+
+func (d *fanoutDevice) address() string {
+	return d.listener.Addr().String()
+}
+
+// ==================== 统计辅助 ====================
+func percentile(sorted []time.Duration, p float64) time.Duration {
+	if len(sorted) == 0 {
+		return 0
+	}
+	idx := int(float64(len(sorted)-1) * p)
+	return sorted[idx]
+}
+
+func sortDurations(d []time.Duration) {
+	sort.Slice(d, func(i, j int) bool { return d[i] < d[j] })
+}
+
+// runtime/metrics的CPU分类统计只在GC时更新，读取前先触发一次GC；
+// total包含空闲的P，实际占用 = total - idle
+func cpuSeconds() float64 {
+	runtime.GC()
+	samples := []metrics.Sample{
+		{Name: "/cpu/classes/total:cpu-seconds"},
+		{Name: "/cpu/classes/idle:cpu-seconds"},
+	}
+	metrics.Read(samples)
+	for _, s := range samples {
+		if s.Value.Kind() != metrics.KindFloat64 {
+			return 0
+		}
+	}
+	return samples[0].Value.Float64() - samples[1].Value.Float64()
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runFanoutBenchmark(n int) {
+	if n < 1 {
+		n = 1
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	interval := time.Second * fanoutChunkBytes / fanoutByteRate
+	chunks := int(fanoutDuration / interval)
+
+	// N个正常设备 + 1个慢设备
+	devices := make([]*fanoutDevice, 0, n+1)
+	for i := 0; i <= n; i++ {
+		d, err := newFanoutDevice(chunks, i == n)
+		if err != nil {
+			fmt.Printf("Failed to start simulated device: %v\n", err)
+			return
+		}
+		devices = append(devices, d)
+		if _, err := connManager.Connect(d.address()); err != nil {
+			fmt.Printf("Failed to connect simulated device: %v\n", err)
+			return
+		}
+	}
+	defer func() {
+		for _, d := range devices {
+			d.listener.Close()
+		}
+	}()
+
+	fmt.Println("Fan-out benchmark (simulated devices on loopback)")
+	fmt.Printf("devices: %d + 1 slow reader (%v/frame), chunk: %d bytes every %v, chunks: %d\n\n",
+		n, fanoutSlowDelay, fanoutChunkBytes, interval.Round(10*time.Microsecond), chunks)
+
+	runtime.GC()
+	var memBefore runtime.MemStats
+	runtime.ReadMemStats(&memBefore)
+	cpuBefore := cpuSeconds()
+	goroutinesPeak := runtime.NumGoroutine()
+
+	connManager.Send(nil, 0xA3, nil, controlEnqueueWait)
+
+	payload := make([]byte, fanoutChunkBytes)
+	var heapPeak uint64
+	var enqueueTotal time.Duration
+	var queuedTotal, failedTotal int
+	start := time.Now()
+	ticker := time.NewTicker(interval)
+	for seq := 0; seq < chunks; seq++ {
+		<-ticker.C
+		binary.BigEndian.PutUint64(payload[0:8], uint64(seq))
+		binary.BigEndian.PutUint64(payload[8:16], uint64(time.Now().UnixNano()))
+
+		t0 := time.Now()
+		res := connManager.Send(nil, 0xA4, payload, 0)
+		enqueueTotal += time.Since(t0)
+		queuedTotal += res.Queued
+		failedTotal += res.Failed
+
+		if seq%64 == 0 {
+			var ms runtime.MemStats
+			runtime.ReadMemStats(&ms)
+			if ms.HeapAlloc > heapPeak {
+				heapPeak = ms.HeapAlloc
+			}
+			if g := runtime.NumGoroutine(); g > goroutinesPeak {
+				goroutinesPeak = g
+			}
+		}
+	}
+	ticker.Stop()
+	elapsed := time.Since(start)
+
+	// 等待正常设备收完队列中的帧
+	time.Sleep(200 * time.Millisecond)
+	cpuUsed := cpuSeconds() - cpuBefore
+	var memAfter runtime.MemStats
+	runtime.ReadMemStats(&memAfter)
+
+	stats := make(map[string]DeviceConnStats)
+	for _, s := range connManager.Snapshot() {
+		stats[s.ID] = s
+	}
+
+	// 断开后等待正常设备的读取协程退出，之后再读取到达记录
+	connManager.DisconnectAll()
+	for _, d := range devices[:n] {
+		<-d.done
+	}
+
+	// ==================== 计算偏差与延迟（仅正常设备） ====================
+	var skews, latencies []time.Duration
+	var missing int
+	for seq := 0; seq < chunks; seq++ {
+		first, last := int64(0), int64(0)
+		for _, d := range devices[:n] {
+			t := d.arrivals[seq]
+			if t == 0 {
+				missing++
+				continue
+			}
+			latencies = append(latencies, d.latency[seq])
+			if first == 0 || t < first {
+				first = t
+			}
+			if t > last {
+				last = t
+			}
+		}
+		if first != 0 {
+			skews = append(skews, time.Duration(last-first))
+		}
+	}
+
+	var healthyDropped uint64
+	for _, d := range devices[:n] {
+		healthyDropped += stats[d.address()].FramesDropped
+	}
+	slow := devices[n]
+	slowStats := stats[slow.address()]
+	sortDurations(skews)
+	sortDurations(latencies)
+
+	fmt.Printf("streamed %d chunks in %v (real-time target %v)\n",
+		chunks, elapsed.Round(time.Millisecond), (time.Duration(chunks) * interval).Round(time.Millisecond))
+	fmt.Printf("per-chunk skew across %d devices: p50 %v  p99 %v  max %v\n",
+		n, percentile(skews, 0.50).Round(time.Microsecond), percentile(skews, 0.99).Round(time.Microsecond),
+		percentile(skews, 1).Round(time.Microsecond))
+	fmt.Printf("enqueue cost per chunk (all devices): %v\n", (enqueueTotal / time.Duration(chunks)).Round(time.Microsecond))
+	fmt.Printf("send->arrival latency: p50 %v  p99 %v  max %v\n",
+		percentile(latencies, 0.50).Round(time.Microsecond), percentile(latencies, 0.99).Round(time.Microsecond),
+		percentile(latencies, 1).Round(time.Microsecond))
+	fmt.Printf("frames queued/failed: %d/%d, missing at healthy devices: %d, dropped for healthy: %d\n",
+		queuedTotal, failedTotal, missing, healthyDropped)
+	fmt.Printf("slow device: received %d, dropped %d, queue depth at end %d\n",
+		slow.received.Load(), slowStats.FramesDropped, slowStats.QueueDepth)
+	fmt.Printf("cpu: %.2fs over %v (%.1f%% of one core, includes simulated readers)\n",
+		cpuUsed, elapsed.Round(time.Millisecond), 100*cpuUsed/elapsed.Seconds())
+	fmt.Printf("heap: before %.1f MB, peak %.1f MB, after %.1f MB, total alloc %.1f MB\n",
+		float64(memBefore.HeapAlloc)/1e6, float64(heapPeak)/1e6, float64(memAfter.HeapAlloc)/1e6,
+		float64(memAfter.TotalAlloc-memBefore.TotalAlloc)/1e6)
+	fmt.Printf("goroutines peak: %d (1 writer + 1 simulated reader per device)\n", goroutinesPeak)
+}
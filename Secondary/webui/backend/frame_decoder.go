@@ -0,0 +1,139 @@
+/***
+ * @file frame_decoder.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-16
+ * @brief ESP32响应帧解码器（带缓冲，按响应类型识别帧长度）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-16
+ * @filePath frame_decoder.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"io"
+)
+
+// ==================== ESP32响应码（与esp32_main.h一致） ====================
+const (
+	respTempNormal   = 0xD0 // 温度恢复正常     [D0][温度2字节]
+	respThreshold1   = 0xD1 // 达到阈值1        [D1][温度2字节]
+	respThreshold2   = 0xD2 // 达到阈值2        [D2][温度2字节]
+	respTempUpdate   = 0xD3 // 温度定期更新     [D3][温度2字节]
+	respStatusOK     = 0xD4 // 状态查询响应     [D4][WiFi][播放]
+	respAudioAck     = 0xD5 // 音频命令确认     [D5]
+	respDeviceInfo   = 0xD6 // 设备信息         [D6][LEN][名称]
+	respTaskStats    = 0xD7 // 任务CPU占用报告  [D7][LEN2][文本]
+	respTempHistory  = 0xD8 // 温度历史分片     [D8][LEN2][分辨率 + 记录]，LEN为1表示结束
+	respAudioCredit  = 0xD9 // 音频发送额度     [D9][剩余槽位]
+	respError        = 0xDF // 错误             [DF]
+	decoderBufSize   = 8 * 1024
+	decoderReadChunk = 1024 // 缓冲剩余空间小于此值时先整理再读取
+)
+
+// 解码出的帧；Payload指向解码器内部缓冲，仅在下一次Next之前有效
+type Frame struct {
+	Type    byte
+	Payload []byte
+}
+
+// ==================== 帧长度规则 ====================
+// 返回整帧长度和头部长度；buf不足以确定长度时返回total=0
+func frameLength(buf []byte) (total, header int) {
+	switch buf[0] {
+	case respTempNormal, respThreshold1, respThreshold2, respTempUpdate, respStatusOK:
+		return 3, 1
+	case respAudioAck, respError:
+		return 1, 1
+	case respAudioCredit:
+		return 2, 1
+	case respDeviceInfo:
+		if len(buf) < 2 {
+			return 0, 2
+		}
+		return 2 + int(buf[1]), 2
+	case respTaskStats, respTempHistory:
+		if len(buf) < 3 {
+			return 0, 3
+		}
+		return 3 + (int(buf[1])<<8 | int(buf[2])), 3
+	default:
+		// 未知字节：按单字节帧交给调用方计数，下一字节重新同步
+		return 1, 1
+	}
+}
+
+// ==================== 解码器 ====================
+// 每个连接一个解码器，缓冲在连接生命周期内复用，解码过程不分配内存
+// （只有超过当前缓冲的大帧会触发一次扩容）
+type FrameDecoder struct {
+	r          io.Reader
+	buf        []byte
+	start, end int
+	Unknown    uint64 // 无法识别的字节数
+}
+
+func NewFrameDecoder(r io.Reader) *FrameDecoder {
+	return &FrameDecoder{r: r, buf: make([]byte, decoderBufSize)}
+}
+
+// ==================== 读取下一帧 ====================
+func (d *FrameDecoder) Next() (Frame, error) {
+	for {
+		if avail := d.end - d.start; avail > 0 {
+			pending := d.buf[d.start:d.end]
+			total, header := frameLength(pending)
+			if total > 0 && total <= avail {
+				f := Frame{Type: pending[0], Payload: pending[header:total]}
+				d.start += total
+				if total == 1 && header == 1 && !isKnownSingleByte(f.Type) {
+					d.Unknown++
+				}
+				return f, nil
+			}
+			// 长度字段最大0xFFFF，超过当前缓冲的帧扩容后继续读取
+			if total > len(d.buf) {
+				d.grow(total)
+			}
+		}
+		if err := d.fill(); err != nil {
+			return Frame{}, err
+		}
+	}
+}
+
+// ==================== 从reader补充数据 ====================
+func (d *FrameDecoder) fill() error {
+	if d.start == d.end {
+		d.start, d.end = 0, 0
+	} else if len(d.buf)-d.end < decoderReadChunk || d.start > len(d.buf)/2 {
+		// 将未消费数据移到缓冲开头
+		d.end = copy(d.buf, d.buf[d.start:d.end])
+		d.start = 0
+	}
+
+	// 读到数据时忽略同时返回的错误，下一次读取会再次得到它
+	n, err := d.r.Read(d.buf[d.end:])
+	d.end += n
+	if n > 0 {
+		return nil
+	}
+	return err
+}
+
+func (d *FrameDecoder) grow(size int) {
+	buf := make([]byte, size)
+	d.end = copy(buf, d.buf[d.start:d.end])
+	d.start = 0
+	d.buf = buf
+}
+
+func isKnownSingleByte(t byte) bool {
+	return t == respAudioAck || t == respError
+}
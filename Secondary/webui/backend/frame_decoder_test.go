@@ -0,0 +1,116 @@
+/***
+ * @file frame_decoder_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief ESP32响应帧解码器测试（帧长度规则、分段到达、大帧扩容、未知字节计数）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath frame_decoder_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"errors"
+	"io"
+	"testing"
+	"testing/iotest"
+)
+
+// 读出全部帧（负载复制一份，解码器的缓冲会被下一次Next覆盖）
+func decodeAllFrames(t *testing.T, d *FrameDecoder) []Frame {
+	t.Helper()
+	var frames []Frame
+	for {
+		f, err := d.Next()
+		if errors.Is(err, io.EOF) {
+			return frames
+		}
+		if err != nil {
+			t.Fatalf("Next: %v", err)
+		}
+		frames = append(frames, Frame{Type: f.Type, Payload: append([]byte{}, f.Payload...)})
+	}
+}
+
+func TestFrameDecoder(t *testing.T) {
+	big := bytes.Repeat([]byte("x"), 20000) // 超过decoderBufSize，触发扩容
+	tests := []struct {
+		name    string
+		in      []byte
+		want    []Frame
+		unknown uint64
+	}{
+		{"fixed length", []byte{respTempUpdate, 0x01, 0x02, respStatusOK, 1, 0},
+			[]Frame{{respTempUpdate, []byte{1, 2}}, {respStatusOK, []byte{1, 0}}}, 0},
+		{"single byte", []byte{respAudioAck, respError, respAudioCredit, 7},
+			[]Frame{{respAudioAck, []byte{}}, {respError, []byte{}}, {respAudioCredit, []byte{7}}}, 0},
+		{"device info", append([]byte{respDeviceInfo, 5}, "esp32"...),
+			[]Frame{{respDeviceInfo, []byte("esp32")}}, 0},
+		{"two-byte length", append([]byte{respTaskStats, 0x00, 0x03}, "abc"...),
+			[]Frame{{respTaskStats, []byte("abc")}}, 0},
+		{"history end marker", []byte{respTempHistory, 0x00, 0x01, 0x02},
+			[]Frame{{respTempHistory, []byte{2}}}, 0},
+		{"large frame", append([]byte{respTaskStats, byte(len(big) >> 8), byte(len(big))}, big...),
+			[]Frame{{respTaskStats, big}}, 0},
+		{"unknown bytes resync", []byte{0x42, 0x43, respTempNormal, 0, 25},
+			[]Frame{{0x42, []byte{}}, {0x43, []byte{}}, {respTempNormal, []byte{0, 25}}}, 2},
+	}
+	for _, tt := range tests {
+		for _, split := range []bool{false, true} {
+			var r io.Reader = bytes.NewReader(tt.in)
+			if split {
+				r = iotest.OneByteReader(r)
+			}
+			d := NewFrameDecoder(r)
+			got := decodeAllFrames(t, d)
+			if len(got) != len(tt.want) {
+				t.Fatalf("%s (split=%v): %d frames, want %d", tt.name, split, len(got), len(tt.want))
+			}
+			for i := range got {
+				if got[i].Type != tt.want[i].Type || !bytes.Equal(got[i].Payload, tt.want[i].Payload) {
+					t.Errorf("%s (split=%v): frame %d = %#x %d bytes, want %#x %d bytes", tt.name, split, i,
+						got[i].Type, len(got[i].Payload), tt.want[i].Type, len(tt.want[i].Payload))
+				}
+			}
+			if d.Unknown != tt.unknown {
+				t.Errorf("%s (split=%v): Unknown = %d, want %d", tt.name, split, d.Unknown, tt.unknown)
+			}
+		}
+	}
+}
+
+// 帧不完整时连接断开：返回读取错误，不返回半帧
+func TestFrameDecoderTruncated(t *testing.T) {
+	for _, in := range [][]byte{
+		{respTempUpdate, 0x01},
+		{respDeviceInfo},
+		{respTaskStats, 0x00, 0x05, 'a', 'b'},
+	} {
+		d := NewFrameDecoder(bytes.NewReader(in))
+		if f, err := d.Next(); !errors.Is(err, io.EOF) {
+			t.Errorf("% x: got frame %#x err %v, want io.EOF", in, f.Type, err)
+		}
+	}
+}
+
+// 持续读取大量小帧：缓冲循环整理，不因已消费数据堆积而扩容
+func TestFrameDecoderCompacts(t *testing.T) {
+	const n = 10000
+	in := bytes.Repeat([]byte{respTempUpdate, 0x00, 0x19}, n)
+	d := NewFrameDecoder(iotest.HalfReader(bytes.NewReader(in)))
+	frames := decodeAllFrames(t, d)
+	if len(frames) != n {
+		t.Fatalf("%d frames, want %d", len(frames), n)
+	}
+	if len(d.buf) != decoderBufSize {
+		t.Errorf("buffer grew to %d bytes, want %d", len(d.buf), decoderBufSize)
+	}
+}
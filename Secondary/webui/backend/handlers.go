@@ -17,25 +17,26 @@
 package main
 
 import (
+	"context"
+	"encoding/binary"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"io"
 	"log"
-	"net"
 	"net/http"
 	"os"
 	"os/exec"
 	"path/filepath"
+	"strconv"
 	"strings"
 	"sync"
 	"time"
 )
 
 // ==================== 全局连接管理 ====================
+// 设备连接由connManager（connection_manager.go）管理
 var (
-	esp32Conn   net.Conn
-	esp32ConnMu sync.Mutex
-	
 	// 温度警告订阅者
 	temperatureSubscribers   = make(map[chan TemperatureAlert]bool)
 	temperatureSubscribersMu sync.RWMutex
@@ -52,6 +53,7 @@ type TemperatureAlert struct {
 	Temperature float64 `json:"temperature"` // 实际温度值
 	Message     string  `json:"message"`     // 警告消息
 	Timestamp   int64   `json:"timestamp"`   // 时间戳
+	Device      string  `json:"device,omitempty"` // 来源设备（ip:port）
 }
 
 // ==================== 响应结构 ====================
@@ -223,22 +225,14 @@ func handleDeviceConnect(w http.ResponseWriter, r *http.Request) {
 	
 	log.Printf("Connecting to device: %s:%d", req.IP, req.Port)
 	
-	// 关闭现有连接
-	esp32ConnMu.Lock()
-	if esp32Conn != nil {
-		esp32Conn.Close()
-		esp32Conn = nil
-	}
-	esp32ConnMu.Unlock()
-	
-	// 建立新连接
+	// 建立新连接（加入连接池，不影响其他已连接设备）
 	address := fmt.Sprintf("%s:%d", req.IP, req.Port)
 	if req.Port == 0 {
 		address = req.IP + ":8080"
 	}
 	
 	log.Printf("Attempting to connect to %s...", address)
-	conn, err := net.DialTimeout("tcp", address, 5*time.Second)
+	device, err := connManager.Connect(address)
 	if err != nil {
 		log.Printf("❌ Failed to connect to device %s: %v", address, err)
 		response := Response{
@@ -251,6 +245,18 @@ func handleDeviceConnect(w http.ResponseWriter, r *http.Request) {
 	
 	log.Printf("✓ TCP connection established to %s", address)
 	
+	// 按mDNS TXT记录中的采样率/声道设置节拍速率（未发现的设备使用默认44.1kHz立体声）
+	if ds := getDiscoveryService(); ds != nil {
+		for _, d := range ds.GetDevices() {
+			if d.IP == req.IP && d.TXT != nil {
+				rate, channels := formatFromTXT(d.TXT)
+				device.SetAudioFormat(rate, channels)
+				log.Printf("Audio format for %s: %d Hz, %d ch", address, rate, channels)
+				break
+			}
+		}
+	}
+	
 	// 暂时禁用自动设备识别（避免ESP32重启）
 	// TODO: 找到ESP32重启的根本原因后再启用
 	deviceInfo := "Connected Device"
@@ -258,15 +264,15 @@ func handleDeviceConnect(w http.ResponseWriter, r *http.Request) {
 	
 	log.Printf("Device identification temporarily disabled to prevent ESP32 restart")
 	
-	esp32ConnMu.Lock()
-	esp32Conn = conn
-	esp32ConnMu.Unlock()
-	
-	// 启动温度监控goroutine
-	go monitorESP32Temperature(conn)
+	// 同步设备时间（0xA9 + Unix秒，大端），温度历史存储依赖正确的时间戳
+	var epoch [4]byte
+	binary.BigEndian.PutUint32(epoch[:], uint32(time.Now().Unix()))
+	if res := connManager.Send([]string{device.ID}, 0xA9, epoch[:], controlEnqueueWait); res.Queued == 0 {
+		log.Printf("⚠️ Failed to sync device time")
+	}
 	
-	log.Printf("✓ Successfully connected to device at %s", address)
-	log.Printf("Local addr: %s, Remote addr: %s", conn.LocalAddr(), conn.RemoteAddr())
+	// 温度遥测由设备读取协程解码后交给handleTelemetryFrame
+	log.Printf("✓ Successfully connected to device at %s (%d connected)", address, connManager.Count())
 	log.Printf("✓ Temperature monitoring started")
 	
 	response := Response{
@@ -276,6 +282,7 @@ func handleDeviceConnect(w http.ResponseWriter, r *http.Request) {
 			"address":     address,
 			"device_info": deviceInfo,
 			"is_esp32":    isESP32,
+			"connections": connManager.Count(),
 		},
 	}
 	
@@ -291,18 +298,34 @@ func handleDeviceDisconnect(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	esp32ConnMu.Lock()
-	defer esp32ConnMu.Unlock()
+	// 请求体可选：{"ip": "..."} 断开指定设备，为空则断开全部
+	var req struct {
+		IP   string `json:"ip"`
+		Port int    `json:"port"`
+	}
+	json.NewDecoder(r.Body).Decode(&req)
 	
-	if esp32Conn != nil {
-		esp32Conn.Close()
-		esp32Conn = nil
-		log.Println("Disconnected from ESP32 device")
+	var closed int
+	if req.IP != "" {
+		target := req.IP
+		if req.Port != 0 {
+			target = fmt.Sprintf("%s:%d", req.IP, req.Port)
+		}
+		closed = connManager.Disconnect(target)
+	} else {
+		closed = connManager.DisconnectAll()
+	}
+	if closed > 0 {
+		log.Printf("Disconnected from %d ESP32 device(s)", closed)
 	}
 	
 	response := Response{
 		Success: true,
 		Message: "Disconnected from device",
+		Data: map[string]interface{}{
+			"disconnected": closed,
+			"connections":  connManager.Count(),
+		},
 	}
 	
 	json.NewEncoder(w).Encode(response)
@@ -317,11 +340,9 @@ func handleAudioStreamStart(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	esp32ConnMu.Lock()
-	conn := esp32Conn
-	esp32ConnMu.Unlock()
-	
-	if conn == nil {
+	// 目标设备：?targets=ip1,ip2（为空则发送到全部已连接设备）
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
 		response := Response{
 			Success: false,
 			Message: "Not connected to ESP32 device",
@@ -336,8 +357,9 @@ func handleAudioStreamStart(w http.ResponseWriter, r *http.Request) {
 	}
 	
 	// 发送音频流开始命令 0xA3
-	_, err := conn.Write([]byte{0xA3})
-	if err != nil {
+	res := connManager.Send(targets, 0xA3, nil, controlEnqueueWait)
+	if res.Queued == 0 {
+		err := errDeviceClosed
 		log.Printf("Failed to send stream start command: %v", err)
 		// 恢复设备扫描
 		if ds := getDiscoveryService(); ds != nil {
@@ -351,11 +373,12 @@ func handleAudioStreamStart(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	log.Println("Audio stream started")
+	log.Printf("Audio stream started on %d/%d device(s)", res.Queued, res.Targets)
 	
 	response := Response{
 		Success: true,
 		Message: "Audio stream started",
+		Data:    res,
 	}
 	
 	json.NewEncoder(w).Encode(response)
@@ -368,31 +391,24 @@ func handleAudioStreamData(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	esp32ConnMu.Lock()
-	conn := esp32Conn
-	esp32ConnMu.Unlock()
-	
-	if conn == nil {
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
 		http.Error(w, "Not connected to ESP32 device", http.StatusBadRequest)
 		return
 	}
 	
-	// 读取音频数据
-	audioData, err := io.ReadAll(r.Body)
+	// 读取音频数据，直接构建为 0xA4 + 数据 的共享帧，所有目标设备共用一份缓冲
+	frame, err := newSharedFrameFromReader(0xA4, r.Body)
 	if err != nil {
 		log.Printf("Failed to read audio data: %v", err)
 		http.Error(w, "Failed to read audio data", http.StatusBadRequest)
 		return
 	}
 	
-	// 发送音频流数据命令 0xA4 + 数据
-	packet := make([]byte, len(audioData)+1)
-	packet[0] = 0xA4
-	copy(packet[1:], audioData)
-	
-	_, err = conn.Write(packet)
-	if err != nil {
-		log.Printf("Failed to send audio data: %v", err)
+	// 音频按实时节拍发往设备，队列满时最多等待audioEnqueueWait（期间不回复，上游随之减速），超时则丢弃
+	res := connManager.SendFrame(targets, frame, audioEnqueueWait)
+	if res.Queued == 0 {
+		log.Printf("Failed to send audio data: all %d device queue(s) unavailable", res.Targets)
 		http.Error(w, "Failed to send audio data", http.StatusInternalServerError)
 		return
 	}
@@ -401,6 +417,226 @@ func handleAudioStreamData(w http.ResponseWriter, r *http.Request) {
 	w.WriteHeader(http.StatusOK)
 }
 
+// ==================== 音频流WebSocket接入 ====================
+// GET /api/audio/ws?targets=ip1,ip2
+// 建立连接即开始音频流（0xA3）；二进制消息为PCM数据块，直接读入共享帧缓冲转发（0xA4）；
+// 文本消息 "start" / "end" / "stop" 对应 0xA3 / 0xA5 / 0xA0，"end" 后回复统计；连接关闭时未结束的流自动结束
+func handleAudioStreamWS(w http.ResponseWriter, r *http.Request) {
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
+		http.Error(w, "Not connected to ESP32 device", http.StatusBadRequest)
+		return
+	}
+	
+	ws, err := wsUpgrade(w, r)
+	if err != nil {
+		log.Printf("WebSocket upgrade failed: %v", err)
+		return
+	}
+	defer ws.Close()
+	
+	startStream := func() {
+		if ds := getDiscoveryService(); ds != nil {
+			ds.Pause()
+		}
+		connManager.Send(targets, 0xA3, nil, controlEnqueueWait)
+	}
+	endStream := func(cmd byte) {
+		connManager.Send(targets, cmd, nil, controlEnqueueWait)
+		if ds := getDiscoveryService(); ds != nil {
+			ds.Resume()
+		}
+	}
+	
+	startStream()
+	streaming := true
+	var chunks, dropped int
+	log.Printf("Audio WebSocket opened from %s", r.RemoteAddr)
+	
+	for {
+		frame := sharedFramePool.Get().(*sharedFrame)
+		frame.refs.Store(1)
+		op, data, err := ws.readMessage(append(frame.data[:0], 0xA4), sharedFrameMaxPool)
+		frame.data = data
+		if err != nil {
+			frame.release()
+			if err != io.EOF {
+				log.Printf("Audio WebSocket closed: %v", err)
+			}
+			break
+		}
+		
+		switch op {
+		case wsOpBinary:
+			if len(data) <= 1 {
+				frame.release()
+				continue
+			}
+			if !streaming {
+				startStream()
+				streaming = true
+			}
+			// 队列满时最多等待audioEnqueueWait，期间不读取，经TCP窗口减慢浏览器发送（bufferedAmount）；超时则丢弃该块
+			res := connManager.SendFrame(targets, frame, audioEnqueueWait)
+			chunks++
+			dropped += res.Failed
+			
+		case wsOpText:
+			cmd := string(data[1:])
+			frame.release()
+			switch cmd {
+			case "start":
+				if !streaming {
+					startStream()
+					streaming = true
+				}
+			case "end", "stop":
+				if streaming {
+					if cmd == "end" {
+						endStream(0xA5)
+					} else {
+						endStream(0xA0)
+					}
+					streaming = false
+				}
+				ws.writeText(fmt.Sprintf(`{"type":"%s","chunks":%d,"dropped":%d}`, cmd, chunks, dropped))
+			}
+			
+		default:
+			frame.release()
+		}
+	}
+	
+	if streaming {
+		endStream(0xA5)
+	}
+	log.Printf("Audio WebSocket finished: %d chunks, %d dropped", chunks, dropped)
+}
+
+// ==================== 上传音频文件（服务端流式解码） ====================
+// POST /api/audio/upload?targets=ip1,ip2，请求体为音频文件原始字节
+// 边接收边解码、重采样为44.1kHz立体声16位并分块转发，设备队列满时暂停读取请求体，
+// 内存占用与文件长度无关，首块音频在上传完成前即可播放。非WAV格式需要ffmpeg，否则返回415
+func handleAudioUpload(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
+	
+	if r.Method != http.MethodPost {
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+	
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
+		http.Error(w, "Not connected to ESP32 device", http.StatusBadRequest)
+		return
+	}
+	
+	src, decoder, err := newPCMStream(r.Body)
+	if err != nil {
+		log.Printf("Audio upload rejected: %v", err)
+		status := http.StatusBadRequest
+		if errors.Is(err, errUnsupportedAudio) {
+			status = http.StatusUnsupportedMediaType
+		}
+		w.WriteHeader(status)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
+		return
+	}
+	defer src.Close()
+	
+	// 上传随播放进度读取，持续时间接近音频时长，取消服务器的整体读写超时
+	rc := http.NewResponseController(w)
+	rc.SetReadDeadline(time.Time{})
+	rc.SetWriteDeadline(time.Time{})
+	
+	log.Printf("Audio upload started from %s (%s)", r.RemoteAddr, decoder)
+	stats, err := relayPCM(targets, src)
+	if err != nil {
+		log.Printf("Audio upload aborted after %d chunks: %v", stats.Chunks, err)
+		w.WriteHeader(http.StatusBadRequest)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: "Audio upload aborted: " + err.Error()})
+		return
+	}
+	
+	log.Printf("Audio upload finished: %d chunks (%.1fs), %d dropped", stats.Chunks, stats.Duration(), stats.Dropped)
+	json.NewEncoder(w).Encode(Response{
+		Success: true,
+		Message: "Audio streamed",
+		Data: map[string]interface{}{
+			"decoder":  decoder,
+			"chunks":   stats.Chunks,
+			"dropped":  stats.Dropped,
+			"duration": stats.Duration(),
+		},
+	})
+}
+
+// ==================== 转发PCM流到设备 ====================
+type pcmRelayStats struct {
+	Chunks     int
+	Dropped    int
+	PCMBytes   int64
+	FirstFrame time.Time // 首帧进入设备发送队列的时间
+}
+
+func (s pcmRelayStats) Duration() float64 {
+	return float64(s.PCMBytes) / float64(defaultSampleRate*defaultChannels*defaultSampleSize)
+}
+
+// 从src读取44.1kHz立体声PCM，按0xA4帧发给设备（0xA3开始、0xA5结束）；
+// 设备队列满时阻塞，src因此按播放速率被读取。读取出错时发送0xA0丢弃已缓冲的音频
+func relayPCM(targets []string, src io.Reader) (pcmRelayStats, error) {
+	var stats pcmRelayStats
+	
+	if ds := getDiscoveryService(); ds != nil {
+		ds.Pause()
+		defer ds.Resume()
+	}
+	connManager.Send(targets, 0xA3, nil, controlEnqueueWait)
+	
+	var readErr error
+	for {
+		frame := sharedFramePool.Get().(*sharedFrame)
+		frame.refs.Store(1)
+		if cap(frame.data) < 1+pcmChunkBytes {
+			frame.data = make([]byte, 0, 1+pcmChunkBytes)
+		}
+		frame.data = append(frame.data[:0], 0xA4)[:1+pcmChunkBytes]
+		n, err := io.ReadFull(src, frame.data[1:])
+		if n == 0 {
+			frame.release()
+		} else {
+			frame.data = frame.data[:1+n]
+			res := connManager.SendFrame(targets, frame, audioEnqueueWait)
+			if stats.Chunks == 0 {
+				stats.FirstFrame = time.Now()
+			}
+			stats.Chunks++
+			stats.Dropped += res.Failed
+			stats.PCMBytes += int64(n)
+			if res.Targets == 0 {
+				readErr = errDeviceClosed
+				break
+			}
+		}
+		if err == io.EOF || err == io.ErrUnexpectedEOF {
+			break
+		}
+		if err != nil {
+			readErr = err
+			break
+		}
+	}
+	
+	// 中断时停止播放并丢弃已缓冲的音频，正常结束则播完缓冲
+	if readErr != nil {
+		connManager.Send(targets, 0xA0, nil, controlEnqueueWait)
+		return stats, readErr
+	}
+	connManager.Send(targets, 0xA5, nil, controlEnqueueWait)
+	return stats, nil
+}
+
 // ==================== 音频流结束 ====================
 func handleAudioStreamEnd(w http.ResponseWriter, r *http.Request) {
 	w.Header().Set("Content-Type", "application/json")
@@ -410,11 +646,8 @@ func handleAudioStreamEnd(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	esp32ConnMu.Lock()
-	conn := esp32Conn
-	esp32ConnMu.Unlock()
-	
-	if conn == nil {
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
 		response := Response{
 			Success: false,
 			Message: "Not connected to ESP32 device",
@@ -424,12 +657,11 @@ func handleAudioStreamEnd(w http.ResponseWriter, r *http.Request) {
 	}
 	
 	// 发送音频流结束命令 0xA5
-	_, err := conn.Write([]byte{0xA5})
-	if err != nil {
-		log.Printf("Failed to send stream end command: %v", err)
+	if res := connManager.Send(targets, 0xA5, nil, controlEnqueueWait); res.Queued == 0 {
+		log.Printf("Failed to send stream end command: %v", errDeviceClosed)
 		response := Response{
 			Success: false,
-			Message: "Failed to end audio stream: " + err.Error(),
+			Message: "Failed to end audio stream: " + errDeviceClosed.Error(),
 		}
 		json.NewEncoder(w).Encode(response)
 		return
@@ -460,11 +692,8 @@ func handleAudioStop(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 	
-	esp32ConnMu.Lock()
-	conn := esp32Conn
-	esp32ConnMu.Unlock()
-	
-	if conn == nil {
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
 		response := Response{
 			Success: false,
 			Message: "Not connected to ESP32 device",
@@ -474,11 +703,10 @@ func handleAudioStop(w http.ResponseWriter, r *http.Request) {
 	}
 	
 	// 发送停止命令
-	_, err := conn.Write([]byte{0xA0})
-	if err != nil {
+	if res := connManager.Send(targets, 0xA0, nil, controlEnqueueWait); res.Queued == 0 {
 		response := Response{
 			Success: false,
-			Message: "Failed to send stop command: " + err.Error(),
+			Message: "Failed to send stop command: " + errDeviceClosed.Error(),
 		}
 		json.NewEncoder(w).Encode(response)
 		return
@@ -503,17 +731,14 @@ func handleAudioStop(w http.ResponseWriter, r *http.Request) {
 func handleStatus(w http.ResponseWriter, r *http.Request) {
 	w.Header().Set("Content-Type", "application/json")
 	
-	esp32ConnMu.Lock()
-	conn := esp32Conn
-	esp32ConnMu.Unlock()
-	
-	connected := conn != nil
+	devices := connManager.Snapshot()
 	
 	response := Response{
 		Success: true,
 		Message: "Status retrieved",
 		Data: map[string]interface{}{
-			"connected": connected,
+			"connected": len(devices) > 0,
+			"devices":   devices,
 			"timestamp": time.Now().Unix(),
 		},
 	}
@@ -521,6 +746,131 @@ func handleStatus(w http.ResponseWriter, r *http.Request) {
 	json.NewEncoder(w).Encode(response)
 }
 
+// ==================== 指标（Prometheus文本格式） ====================
+// GET /api/metrics
+// 每设备：音频实际/目标提前量、突发（设备队列满）、欠载、发送/丢弃/清空帧数、队列深度
+func handleMetrics(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "text/plain; version=0.0.4")
+	
+	devices := connManager.Snapshot()
+	var b strings.Builder
+	metric := func(name, kind, help string, value func(d DeviceConnStats) float64) {
+		fmt.Fprintf(&b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, kind)
+		for _, d := range devices {
+			fmt.Fprintf(&b, "%s{device=%q} %g\n", name, d.ID, value(d))
+		}
+	}
+	metric("esp32_audio_send_lead_seconds", "gauge", "Audio sent ahead of the device playback clock.",
+		func(d DeviceConnStats) float64 { return d.SendLeadMs / 1000 })
+	metric("esp32_audio_target_lead_seconds", "gauge", "Current pacer target lead, adapted from device credit.",
+		func(d DeviceConnStats) float64 { return d.TargetLeadMs / 1000 })
+	metric("esp32_audio_bursts_total", "counter", "Credit reports with the device audio queue full.",
+		func(d DeviceConnStats) float64 { return float64(d.Bursts) })
+	metric("esp32_audio_stalls_total", "counter", "Times the playback clock overtook the sent audio.",
+		func(d DeviceConnStats) float64 { return float64(d.Stalls) })
+	metric("esp32_audio_byte_rate", "gauge", "Negotiated playback rate in bytes per second.",
+		func(d DeviceConnStats) float64 { return float64(d.ByteRate) })
+	metric("esp32_frames_sent_total", "counter", "Frames written to the device.",
+		func(d DeviceConnStats) float64 { return float64(d.FramesSent) })
+	metric("esp32_frames_dropped_total", "counter", "Frames dropped because the device queue was full.",
+		func(d DeviceConnStats) float64 { return float64(d.FramesDropped) })
+	metric("esp32_frames_flushed_total", "counter", "Buffered audio frames discarded by a stop command.",
+		func(d DeviceConnStats) float64 { return float64(d.FramesFlushed) })
+	metric("esp32_queue_depth", "gauge", "Frames waiting in the device send queue.",
+		func(d DeviceConnStats) float64 { return float64(d.QueueDepth) })
+	if ttsJobs != nil {
+		ttsJobs.writeMetrics(&b)
+	}
+	
+	io.WriteString(w, b.String())
+}
+
+// ==================== 查询设备（状态/任务占用/温度历史） ====================
+// GET /api/device/query?target=ip&type=status|tasks|history[&res=0&start=unix&end=unix]
+func handleDeviceQuery(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
+	
+	q := r.URL.Query()
+	device := connManager.Get(q.Get("target"))
+	if q.Get("target") == "" {
+		// 未指定时使用任一已连接设备
+		if devs := connManager.Resolve(nil); len(devs) > 0 {
+			device = devs[0]
+		}
+	}
+	if device == nil {
+		json.NewEncoder(w).Encode(Response{Success: false, Message: "Not connected to ESP32 device"})
+		return
+	}
+	
+	var data interface{}
+	var err error
+	switch q.Get("type") {
+	case "", "status":
+		var payload []byte
+		payload, err = device.Request(0xA2, nil, respStatusOK, 3*time.Second)
+		if err == nil && len(payload) >= 2 {
+			data = map[string]interface{}{
+				"wifi_connected": payload[0] == 1,
+				"audio_playing":  payload[1] == 1,
+			}
+		}
+		
+	case "tasks":
+		var payload []byte
+		payload, err = device.Request(0xA7, nil, respTaskStats, 3*time.Second)
+		if err == nil {
+			data = map[string]interface{}{"report": string(payload)}
+		}
+		
+	case "history":
+		// 请求：分辨率1字节 + 起始/结束时间各4字节（大端）；记录：时间4字节 + 最小/最大/平均各2字节
+		res, _ := strconv.Atoi(q.Get("res"))
+		start, _ := strconv.ParseUint(q.Get("start"), 10, 32)
+		end, _ := strconv.ParseUint(q.Get("end"), 10, 32)
+		if end == 0 {
+			end = uint64(time.Now().Unix())
+		}
+		req := make([]byte, 9)
+		req[0] = byte(res)
+		binary.BigEndian.PutUint32(req[1:5], uint32(start))
+		binary.BigEndian.PutUint32(req[5:9], uint32(end))
+		
+		var payload []byte
+		payload, err = device.Request(0xA8, req, respTempHistory, 10*time.Second)
+		if err == nil {
+			type record struct {
+				Timestamp uint32  `json:"ts"`
+				Min       float64 `json:"min"`
+				Max       float64 `json:"max"`
+				Avg       float64 `json:"avg"`
+			}
+			records := make([]record, 0, len(payload)/10)
+			for i := 0; i+10 <= len(payload); i += 10 {
+				records = append(records, record{
+					Timestamp: binary.BigEndian.Uint32(payload[i:]),
+					Min:       float64(int16(binary.BigEndian.Uint16(payload[i+4:]))) / 10.0,
+					Max:       float64(int16(binary.BigEndian.Uint16(payload[i+6:]))) / 10.0,
+					Avg:       float64(int16(binary.BigEndian.Uint16(payload[i+8:]))) / 10.0,
+				})
+			}
+			data = map[string]interface{}{"resolution": res, "records": records}
+		}
+		
+	default:
+		http.Error(w, "Unknown query type", http.StatusBadRequest)
+		return
+	}
+	
+	if err != nil {
+		log.Printf("Device %s query failed: %v", device.ID, err)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: "Device query failed: " + err.Error()})
+		return
+	}
+	
+	json.NewEncoder(w).Encode(Response{Success: true, Message: "Query completed", Data: data})
+}
+
 // ==================== 广播温度警告 ====================
 func broadcastTemperatureAlert(alert TemperatureAlert) {
 	temperatureSubscribersMu.RLock()
@@ -535,59 +885,45 @@ func broadcastTemperatureAlert(alert TemperatureAlert) {
 	}
 }
 
-// ==================== 监听ESP32温度数据 ====================
-func monitorESP32Temperature(conn net.Conn) {
-	log.Println("Started ESP32 temperature monitoring")
-	buffer := make([]byte, 3)  // 修改为3字节：命令 + 温度高字节 + 温度低字节
-	
-	for {
-		conn.SetReadDeadline(time.Now().Add(30 * time.Second))
-		n, err := conn.Read(buffer)
-		if err != nil {
-			log.Printf("ESP32 monitoring stopped: %v", err)
-			return
-		}
+// ==================== 处理ESP32温度遥测帧 ====================
+func handleTelemetryFrame(device *DeviceConn, f Frame) {
+	tempValue := (uint16(f.Payload[0]) << 8) | uint16(f.Payload[1]) // 组合温度值
+	temperature := float64(tempValue) / 10.0                        // 转换为实际温度（0.1°C精度）
+	
+	var alert TemperatureAlert
+	alert.Timestamp = time.Now().Unix()
+	alert.Temperature = temperature
+	alert.Device = device.ID
+	
+	switch f.Type {
+	case respThreshold1: // RESP_THRESHOLD1_REACHED
+		alert.Type = "threshold1"
+		alert.Threshold = 28
+		alert.Message = fmt.Sprintf("温度已达到 %.1f°C，已启动风扇（阈值: 28°C）", temperature)
+		log.Printf("Temperature Alert: Threshold 1 reached at %.1f°C", temperature)
 		
-		if n >= 3 {
-			cmd := buffer[0]
-			tempValue := (uint16(buffer[1]) << 8) | uint16(buffer[2])  // 组合温度值
-			temperature := float64(tempValue) / 10.0                     // 转换为实际温度（0.1°C精度）
-			
-			var alert TemperatureAlert
-			alert.Timestamp = time.Now().Unix()
-			alert.Temperature = temperature
-			
-			switch cmd {
-			case 0xD1: // RESP_THRESHOLD1_REACHED (修正：0xF1->0xD1)
-				alert.Type = "threshold1"
-				alert.Threshold = 28
-				alert.Message = fmt.Sprintf("温度已达到 %.1f°C，已启动风扇（阈值: 28°C）", temperature)
-				log.Printf("Temperature Alert: Threshold 1 reached at %.1f°C", temperature)
-				broadcastTemperatureAlert(alert)
-				
-			case 0xD2: // RESP_THRESHOLD2_REACHED (修正：0xF2->0xD2)
-				alert.Type = "threshold2"
-				alert.Threshold = 35
-				alert.Message = fmt.Sprintf("温度已达到 %.1f°C，蜂鸣器报警（阈值: 35°C）", temperature)
-				log.Printf("Temperature Alert: Threshold 2 reached at %.1f°C", temperature)
-				broadcastTemperatureAlert(alert)
-				
-			case 0xD0: // RESP_TEMP_NORMAL
-				alert.Type = "normal"
-				alert.Threshold = 0
-				alert.Message = fmt.Sprintf("温度已恢复正常（当前: %.1f°C）", temperature)
-				log.Printf("Temperature Status: Returned to normal at %.1f°C", temperature)
-				broadcastTemperatureAlert(alert)
-				
-			case 0xD3: // RESP_TEMP_UPDATE (定期温度更新)
-				alert.Type = "update"
-				alert.Threshold = 0
-				alert.Message = fmt.Sprintf("当前温度: %.1f°C", temperature)
-				log.Printf("Temperature Update: %.1f°C", temperature)
-				broadcastTemperatureAlert(alert)
-			}
-		}
+	case respThreshold2: // RESP_THRESHOLD2_REACHED
+		alert.Type = "threshold2"
+		alert.Threshold = 35
+		alert.Message = fmt.Sprintf("温度已达到 %.1f°C，蜂鸣器报警（阈值: 35°C）", temperature)
+		log.Printf("Temperature Alert: Threshold 2 reached at %.1f°C", temperature)
+		
+	case respTempNormal: // RESP_TEMP_NORMAL
+		alert.Type = "normal"
+		alert.Threshold = 0
+		alert.Message = fmt.Sprintf("温度已恢复正常（当前: %.1f°C）", temperature)
+		log.Printf("Temperature Status: Returned to normal at %.1f°C", temperature)
+		
+	case respTempUpdate: // RESP_TEMP_UPDATE (定期温度更新)
+		alert.Type = "update"
+		alert.Threshold = 0
+		alert.Message = fmt.Sprintf("当前温度: %.1f°C", temperature)
+		log.Printf("Temperature Update: %.1f°C", temperature)
+		
+	default:
+		return
 	}
+	broadcastTemperatureAlert(alert)
 }
 
 // ==================== 温度警告SSE端点 ====================
@@ -639,181 +975,220 @@ func handleTemperatureEvents(w http.ResponseWriter, r *http.Request) {
 	}
 }
 
-// ==================== TTS 合成状态 ====================
-var (
-	ttsStatus       = "idle" // idle, processing, completed, error
-	ttsStatusMu     sync.RWMutex
-	ttsResultPath   string
-	ttsErrorMessage string
-)
-
-// ==================== TTS 合成请求 ====================
-func handleTTSSynthesize(w http.ResponseWriter, r *http.Request) {
-	w.Header().Set("Content-Type", "application/json")
-	
-	if r.Method != http.MethodPost {
-		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
-		return
+// ==================== 解析合成表单 ====================
+// text、priority（alarm/routine）、profile（解码档位 quality/balanced/fast，报警默认 -tts-alarm-profile），以及 voice（已注册音色ID）或 prompt_text + prompt_audio（multipart）；
+// 参考音频保存为任务的临时文件，任务结束时删除。VoxCPM 要求参考音频与参考文本同时提供
+func parseTTSForm(r *http.Request, kind string) (TTSJobRequest, error) {
+	req := TTSJobRequest{Kind: kind}
+	if err := r.ParseMultipartForm(32 << 20); err != nil {
+		return req, fmt.Errorf("failed to parse form data: %v", err)
+	}
+	req.Text = r.FormValue("text")
+	if strings.TrimSpace(req.Text) == "" {
+		return req, errors.New("target text is required")
+	}
+	priority, err := parseTTSPriority(r.FormValue("priority"))
+	if err != nil {
+		return req, err
+	}
+	req.Priority = priority
+	if req.Profile, err = parseTTSProfile(r.FormValue("profile"), priority); err != nil {
+		return req, err
 	}
 	
-	// 检查当前状态
-	ttsStatusMu.Lock()
-	if ttsStatus == "processing" {
-		ttsStatusMu.Unlock()
-		response := Response{
-			Success: false,
-			Message: "TTS synthesis already in progress",
+	if id := r.FormValue("voice"); id != "" {
+		if ttsVoices == nil {
+			return req, errVoiceNotFound
 		}
-		json.NewEncoder(w).Encode(response)
-		return
+		voice, err := ttsVoices.Get(id)
+		if err != nil {
+			return req, fmt.Errorf("%v: %s", err, id)
+		}
+		req.Prompt.Voice = voice
+		return req, nil
 	}
-	ttsStatus = "processing"
-	ttsErrorMessage = ""
-	ttsResultPath = ""
-	ttsStatusMu.Unlock()
 	
-	// 解析multipart form
-	err := r.ParseMultipartForm(32 << 20) // 32MB max
-	if err != nil {
-		log.Printf("Failed to parse multipart form: %v", err)
-		ttsStatusMu.Lock()
-		ttsStatus = "error"
-		ttsErrorMessage = "Failed to parse form data"
-		ttsStatusMu.Unlock()
-		
-		response := Response{
-			Success: false,
-			Message: "Failed to parse form data: " + err.Error(),
-		}
-		json.NewEncoder(w).Encode(response)
-		return
+	req.Prompt.Text = r.FormValue("prompt_text")
+	file, handler, err := r.FormFile("prompt_audio")
+	if err != nil || req.Prompt.Text == "" {
+		req.Prompt.Text = ""
+		return req, nil
 	}
+	defer file.Close()
 	
-	// 获取参数
-	targetText := r.FormValue("text")
-	promptText := r.FormValue("prompt_text")
+	tmpDir := filepath.Join(os.TempDir(), "tts_temp")
+	os.MkdirAll(tmpDir, 0755)
+	promptPath := filepath.Join(tmpDir, fmt.Sprintf("prompt_%d_%s", time.Now().UnixNano(), filepath.Base(handler.Filename)))
+	dst, err := os.Create(promptPath)
+	if err == nil {
+		_, err = io.Copy(dst, file)
+		dst.Close()
+	}
+	if err != nil {
+		os.Remove(promptPath)
+		return req, fmt.Errorf("failed to save prompt audio: %v", err)
+	}
+	req.Prompt.Wav = promptPath
+	req.TempFiles = append(req.TempFiles, promptPath)
+	log.Printf("Saved prompt audio to: %s", promptPath)
+	return req, nil
+}
+
+// ==================== 已注册音色 ====================
+// GET 列出音色；POST（multipart：name、prompt_text、prompt_audio）注册并编码提示缓存；DELETE ?id= 删除。
+// 之后的合成请求以 voice=ID 引用，不再上传参考音频，合成进程也不再重复编码
+func handleTTSVoices(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
 	
-	if targetText == "" {
-		ttsStatusMu.Lock()
-		ttsStatus = "error"
-		ttsErrorMessage = "Target text is required"
-		ttsStatusMu.Unlock()
-		
-		response := Response{
-			Success: false,
-			Message: "Target text is required",
-		}
-		json.NewEncoder(w).Encode(response)
+	if ttsVoices == nil {
+		w.WriteHeader(http.StatusServiceUnavailable)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: errWorkerMissing.Error()})
 		return
 	}
 	
-	// 获取上传的音频文件
-	file, handler, err := r.FormFile("prompt_audio")
-	var promptAudioPath string
+	switch r.Method {
+	case http.MethodGet:
+		json.NewEncoder(w).Encode(Response{Success: true, Message: "Voices retrieved", Data: ttsVoices.List()})
 	
-	if err == nil && file != nil {
-		defer file.Close()
-		
-		// 创建临时目录
-		tmpDir := filepath.Join(os.TempDir(), "tts_temp")
-		os.MkdirAll(tmpDir, 0755)
-		
-		// 保存上传的文件
-		promptAudioPath = filepath.Join(tmpDir, handler.Filename)
-		dst, err := os.Create(promptAudioPath)
+	case http.MethodPost:
+		if err := r.ParseMultipartForm(32 << 20); err != nil {
+			w.WriteHeader(http.StatusBadRequest)
+			json.NewEncoder(w).Encode(Response{Success: false, Message: "failed to parse form data: " + err.Error()})
+			return
+		}
+		file, handler, err := r.FormFile("prompt_audio")
 		if err != nil {
-			log.Printf("Failed to create temp file: %v", err)
-			ttsStatusMu.Lock()
-			ttsStatus = "error"
-			ttsErrorMessage = "Failed to save prompt audio"
-			ttsStatusMu.Unlock()
-			
-			response := Response{
-				Success: false,
-				Message: "Failed to save prompt audio: " + err.Error(),
-			}
-			json.NewEncoder(w).Encode(response)
+			w.WriteHeader(http.StatusBadRequest)
+			json.NewEncoder(w).Encode(Response{Success: false, Message: "prompt_audio is required"})
 			return
 		}
-		defer dst.Close()
+		defer file.Close()
 		
-		_, err = io.Copy(dst, file)
+		voice, err := ttsVoices.Register(r.Context(), ttsJobs.Worker(), r.FormValue("name"), r.FormValue("prompt_text"), handler.Filename, file)
 		if err != nil {
-			log.Printf("Failed to save prompt audio: %v", err)
-			ttsStatusMu.Lock()
-			ttsStatus = "error"
-			ttsErrorMessage = "Failed to save prompt audio"
-			ttsStatusMu.Unlock()
-			
-			response := Response{
-				Success: false,
-				Message: "Failed to save prompt audio: " + err.Error(),
-			}
-			json.NewEncoder(w).Encode(response)
+			log.Printf("Voice registration failed: %v", err)
+			w.WriteHeader(http.StatusBadRequest)
+			json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
 			return
 		}
-		
-		log.Printf("Saved prompt audio to: %s", promptAudioPath)
-	}
+		json.NewEncoder(w).Encode(Response{Success: true, Message: "Voice registered", Data: voice})
 	
-	// 清理上一次的结果文件
-	ttsStatusMu.Lock()
-	oldResultPath := ttsResultPath
-	ttsResultPath = ""
-	ttsStatusMu.Unlock()
+	case http.MethodDelete:
+		if err := ttsVoices.Delete(r.URL.Query().Get("id")); err != nil {
+			w.WriteHeader(http.StatusNotFound)
+			json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
+			return
+		}
+		json.NewEncoder(w).Encode(Response{Success: true, Message: "Voice deleted"})
 	
-	if oldResultPath != "" {
-		os.Remove(oldResultPath)
+	default:
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
 	}
+}
+
+// ==================== TTS 合成请求 ====================
+// 提交合成任务后立即返回任务ID；状态经 /api/tts/events?job= 推送，完成后 /api/tts/download?job= 下载
+func handleTTSSynthesize(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
 	
-	// 异步调用 VoxCPM 进行合成
-	go func() {
-		err := callVoxCPMAPI(targetText, promptText, promptAudioPath)
-		
-		ttsStatusMu.Lock()
-		if err != nil {
-			ttsStatus = "error"
-			ttsErrorMessage = err.Error()
-			log.Printf("TTS synthesis failed: %v", err)
-		} else {
-			ttsStatus = "completed"
-			log.Printf("TTS synthesis completed successfully")
+	if r.Method != http.MethodPost {
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+	
+	req, err := parseTTSForm(r, "file")
+	if err == nil {
+		var job TTSJobInfo
+		if job, err = ttsJobs.Submit(req); err == nil {
+			json.NewEncoder(w).Encode(Response{
+				Success: true,
+				Message: "TTS synthesis queued",
+				Data:    job,
+			})
+			return
 		}
-		ttsStatusMu.Unlock()
-		
-		// 清理临时文件
-		if promptAudioPath != "" {
-			os.Remove(promptAudioPath)
+	}
+	
+	for _, f := range req.TempFiles {
+		os.Remove(f)
+	}
+	log.Printf("TTS synthesis rejected: %v", err)
+	w.WriteHeader(http.StatusBadRequest)
+	json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
+}
+
+// ==================== 流式合成并直接播放 ====================
+// 与 /api/tts/synthesize 相同的表单参数；作为任务排队，执行时边合成边发送到设备
+// （?targets= 指定设备，默认全部），播放完缓冲后返回。客户端断开时取消任务。需要常驻合成进程
+func handleTTSSpeak(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
+	
+	if r.Method != http.MethodPost {
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+	
+	if !ttsJobs.Streaming() {
+		w.WriteHeader(http.StatusServiceUnavailable)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: errWorkerMissing.Error()})
+		return
+	}
+	
+	targets := parseTargets(r.URL.Query().Get("targets"))
+	if len(connManager.Resolve(targets)) == 0 {
+		http.Error(w, "Not connected to ESP32 device", http.StatusBadRequest)
+		return
+	}
+	
+	req, err := parseTTSForm(r, "speak")
+	var job TTSJobInfo
+	if err == nil {
+		req.Targets = targets
+		job, err = ttsJobs.Submit(req)
+	}
+	if err != nil {
+		for _, f := range req.TempFiles {
+			os.Remove(f)
 		}
-	}()
+		w.WriteHeader(http.StatusBadRequest)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
+		return
+	}
 	
-	response := Response{
-		Success: true,
-		Message: "TTS synthesis started",
+	// 请求持续到播放完缓冲，取消服务器的整体读写超时
+	rc := http.NewResponseController(w)
+	rc.SetReadDeadline(time.Time{})
+	rc.SetWriteDeadline(time.Time{})
+	
+	job, _ = ttsJobs.Wait(r.Context(), job.ID)
+	if job.Status != "completed" {
+		w.WriteHeader(http.StatusInternalServerError)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: "TTS speak " + job.Status + ": " + job.Error, Data: job})
+		return
 	}
-	json.NewEncoder(w).Encode(response)
+	json.NewEncoder(w).Encode(Response{
+		Success: true,
+		Message: "Speech streamed",
+		Data:    job,
+	})
 }
 
-// ==================== 调用 VoxCPM 合成语音 ====================
-func callVoxCPMAPI(text, promptText, promptAudioPath string) error {
+// ==================== 每次请求启动Python进程合成（未启用常驻进程时） ====================
+// 取消时结束进程；返回结果文件路径
+func callVoxCPMProcess(ctx context.Context, text, promptText, promptAudioPath, resultPath string) (string, error) {
 	// 获取 Python 脚本路径
 	helperPath, err := filepath.Abs(filepath.Join(".", "voxcpm_tts.py"))
 	if err != nil {
-		return fmt.Errorf("failed to get helper script path: %v", err)
+		return "", fmt.Errorf("failed to get helper script path: %v", err)
 	}
 	
 	// 获取 VoxCPM 目录
 	voxcpmPath := filepath.Join("..", "..", "..", "VoxCPM")
 	absVoxcpmPath, err := filepath.Abs(voxcpmPath)
 	if err != nil {
-		return fmt.Errorf("failed to get VoxCPM path: %v", err)
+		return "", fmt.Errorf("failed to get VoxCPM path: %v", err)
 	}
 	
-	// 准备输出路径
-	tmpDir := filepath.Join(os.TempDir(), "tts_temp")
-	os.MkdirAll(tmpDir, 0755)
-	resultPath := filepath.Join(tmpDir, fmt.Sprintf("tts_result_%d.wav", time.Now().Unix()))
-	
 	// 获取参考音频的绝对路径
 	absPromptPath := ""
 	if promptAudioPath != "" {
@@ -835,11 +1210,11 @@ func callVoxCPMAPI(text, promptText, promptAudioPath string) error {
 	log.Printf("Calling VoxCPM TTS with text: %s", text[:min(50, len(text))])
 	
 	// 使用 uv run 执行 Python 脚本
-	cmd := exec.Command("uv", args...)
+	cmd := exec.CommandContext(ctx, "uv", args...)
 	
 	output, err := cmd.CombinedOutput()
 	if err != nil {
-		return fmt.Errorf("failed to execute TTS: %v, output: %s", err, string(output))
+		return "", fmt.Errorf("failed to execute TTS: %v, output: %s", err, string(output))
 	}
 	
 	// 解析 JSON 输出
@@ -855,21 +1230,16 @@ func callVoxCPMAPI(text, promptText, promptAudioPath string) error {
 	
 	err = json.Unmarshal([]byte(lastLine), &result)
 	if err != nil {
-		return fmt.Errorf("failed to parse TTS result: %v, output: %s", err, lastLine)
+		return "", fmt.Errorf("failed to parse TTS result: %v, output: %s", err, lastLine)
 	}
 	
 	if !result.Success {
-		return fmt.Errorf("TTS synthesis failed: %s", result.Error)
+		return "", fmt.Errorf("TTS synthesis failed: %s", result.Error)
 	}
 	
-	// 设置结果路径
-	ttsStatusMu.Lock()
-	ttsResultPath = result.Path
-	ttsStatusMu.Unlock()
-	
 	log.Printf("TTS result saved to: %s", result.Path)
 	
-	return nil
+	return result.Path, nil
 }
 
 // 辅助函数：返回较小的整数
@@ -881,38 +1251,129 @@ func min(a, b int) int {
 }
 
 // ==================== 获取 TTS 状态 ====================
+// ?job= 指定任务，省略时为最近提交的任务；同时返回队列统计、合成进程状态与缓存命中率
 func handleTTSStatus(w http.ResponseWriter, r *http.Request) {
 	w.Header().Set("Content-Type", "application/json")
 	
-	ttsStatusMu.RLock()
-	status := ttsStatus
-	errorMsg := ttsErrorMessage
-	hasResult := ttsResultPath != ""
-	resultPath := ttsResultPath
-	ttsStatusMu.RUnlock()
+	data := map[string]interface{}{
+		"status":  "idle",
+		"queue":   ttsJobs.Stats(),
+		"workers": ttsJobs.WorkerStats(),
+		"cache":   ttsJobs.CacheStats(),
+	}
+	if asrWorker != nil {
+		data["asr"] = asrWorker.Stats()
+	}
+	jobID := r.URL.Query().Get("job")
+	job, err := ttsJobs.Get(jobID)
+	if err == nil {
+		data["job"] = job
+		data["status"] = job.Status
+		data["error"] = job.Error
+		data["has_result"] = job.HasResult
+	} else if jobID != "" {
+		w.WriteHeader(http.StatusNotFound)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error()})
+		return
+	}
 	
 	response := Response{
 		Success: true,
 		Message: "TTS status retrieved",
+		Data:    data,
+	}
+	
+	json.NewEncoder(w).Encode(response)
+}
+
+// ==================== 取消 TTS 任务 ====================
+// POST /api/tts/cancel?job=id
+func handleTTSCancel(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
+	
+	if r.Method != http.MethodPost {
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+	
+	job, err := ttsJobs.Cancel(r.URL.Query().Get("job"))
+	if err != nil {
+		status := http.StatusConflict
+		if errors.Is(err, errJobNotFound) {
+			status = http.StatusNotFound
+		}
+		w.WriteHeader(status)
+		json.NewEncoder(w).Encode(Response{Success: false, Message: err.Error(), Data: job})
+		return
+	}
+	json.NewEncoder(w).Encode(Response{Success: true, Message: "TTS job cancelling", Data: job})
+}
+
+// ==================== TTS 任务列表 ====================
+func handleTTSJobs(w http.ResponseWriter, r *http.Request) {
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(Response{
+		Success: true,
+		Message: "TTS jobs retrieved",
 		Data: map[string]interface{}{
-			"status":      status,
-			"error":       errorMsg,
-			"has_result":  hasResult,
-			"result_path": resultPath,
+			"jobs":  ttsJobs.List(),
+			"queue": ttsJobs.Stats(),
 		},
+	})
+}
+
+// ==================== TTS 任务事件SSE端点 ====================
+// ?job= 只推送该任务，结束后关闭连接；省略时推送全部任务的状态变化
+func handleTTSEvents(w http.ResponseWriter, r *http.Request) {
+	ch, snapshot, done, err := ttsJobs.Subscribe(r.URL.Query().Get("job"))
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusNotFound)
+		return
 	}
+	defer ttsJobs.Unsubscribe(ch)
 	
-	json.NewEncoder(w).Encode(response)
+	// 设置SSE头部
+	w.Header().Set("Content-Type", "text/event-stream")
+	w.Header().Set("Cache-Control", "no-cache")
+	w.Header().Set("Connection", "keep-alive")
+	w.Header().Set("Access-Control-Allow-Origin", "*")
+	http.NewResponseController(w).SetWriteDeadline(time.Time{})
+	
+	send := func(job TTSJobInfo) {
+		data, err := json.Marshal(job)
+		if err != nil {
+			return
+		}
+		fmt.Fprintf(w, "data: %s\n\n", data)
+		if f, ok := w.(http.Flusher); ok {
+			f.Flush()
+		}
+	}
+	for _, job := range snapshot {
+		send(job)
+	}
+	
+	for {
+		select {
+		case job := <-ch:
+			send(job)
+		case <-done:
+			// 任务已结束：推送最终状态（中间事件可能因消费慢被丢弃）后关闭
+			if job, err := ttsJobs.Get(snapshot[0].ID); err == nil {
+				send(job)
+			}
+			return
+		case <-r.Context().Done():
+			return
+		}
+	}
 }
 
 // ==================== 下载 TTS 结果 ====================
+// ?job= 指定任务，省略时为最近提交的任务
 func handleTTSDownload(w http.ResponseWriter, r *http.Request) {
-	ttsStatusMu.RLock()
-	resultPath := ttsResultPath
-	status := ttsStatus
-	ttsStatusMu.RUnlock()
-	
-	if status != "completed" || resultPath == "" {
+	resultPath, err := ttsJobs.ResultPath(r.URL.Query().Get("job"))
+	if err != nil {
 		w.Header().Set("Content-Type", "application/json")
 		response := Response{
 			Success: false,
@@ -947,8 +1408,7 @@ func handleTTSDownload(w http.ResponseWriter, r *http.Request) {
 		log.Printf("Failed to send TTS result: %v", err)
 	}
 	
-	// 不再自动重置状态和删除文件，允许重复下载和发送
-	// 只有在新的合成开始时才清理旧文件
+	// 结果文件随任务保留，超出保留数量时由任务队列删除
 }
 
 // ==================== 识别参考音频文本 ====================
@@ -983,7 +1443,45 @@ func handleTTSRecognize(w http.ResponseWriter, r *http.Request) {
 	}
 	defer file.Close()
 	
-	// 保存临时文件
+	// 常驻识别进程：文件内容直接经管道送入，不写临时文件
+	if asrWorker != nil {
+		audio, err := io.ReadAll(io.LimitReader(file, asrMaxAudioBytes+1))
+		if err == nil && len(audio) > asrMaxAudioBytes {
+			err = fmt.Errorf("larger than %d MB", asrMaxAudioBytes>>20)
+		}
+		if err != nil {
+			response := Response{
+				Success: false,
+				Message: "Failed to read audio file: " + err.Error(),
+			}
+			json.NewEncoder(w).Encode(response)
+			return
+		}
+		res, err := asrWorker.Recognize(r.Context(), audio)
+		if err != nil {
+			log.Printf("Failed to recognize audio: %v", err)
+			response := Response{
+				Success: false,
+				Message: "Failed to recognize audio: " + err.Error(),
+			}
+			json.NewEncoder(w).Encode(response)
+			return
+		}
+		response := Response{
+			Success: true,
+			Message: "Audio recognized successfully",
+			Data: map[string]interface{}{
+				"text":         res.Text,
+				"audio_ms":     res.AudioMs,
+				"recognize_ms": res.RecognizeMs,
+				"batch":        res.Batch,
+			},
+		}
+		json.NewEncoder(w).Encode(response)
+		return
+	}
+	
+	// 未启用常驻识别进程：保存临时文件，每次启动voxcpm_helper.py
 	tmpDir := filepath.Join(os.TempDir(), "tts_temp")
 	os.MkdirAll(tmpDir, 0755)
 	
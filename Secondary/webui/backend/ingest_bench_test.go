@@ -0,0 +1,239 @@
+/***
+ * @file ingest_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-17
+ * @brief 音频接入基准测试（逐块HTTP POST vs WebSocket）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-17
+ * @filePath ingest_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"context"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"net/http"
+	"os"
+	"runtime"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkIngest$' -benchtime 1x
+//
+// 在回环地址上启动真实的HTTP路由和一个模拟设备，分别用两种方式以实时速率推送同样的音频块：
+//   http: 每块一个 POST /api/audio/stream/data（keep-alive，与前端原实现一致）
+//   ws:   一个 /api/audio/ws 连接，每块一条二进制消息
+// 统计每块的客户端字节数（含HTTP头/WS帧头）、发送到设备到达的延迟、CPU与每块分配次数。
+// 客户端、服务端与模拟设备在同一进程内，CPU和分配为三者之和。
+
+func BenchmarkIngest(b *testing.B) {
+	runBenchOnce(b, func() { runIngestBenchmark() })
+}
+
+const ingestBenchChunks = 600 // 约10秒音频
+
+// 统计客户端写出的字节数
+type countingConn struct {
+	net.Conn
+	written *atomic.Int64
+}
+
+func (c countingConn) Write(p []byte) (int, error) {
+	n, err := c.Conn.Write(p)
+	c.written.Add(int64(n))
+	return n, err
+}
+
+type ingestBenchResult struct {
+	requests  int
+	wireBytes int64
+	latencies []time.Duration
+	missing   int
+	cpu       float64
+	mallocs   uint64
+	elapsed   time.Duration
+}
+
+// ==================== 单次运行：send为每块的发送函数 ====================
+func runIngestPath(setup func(written *atomic.Int64) (send func([]byte) error, finish func() error, err error)) (ingestBenchResult, error) {
+	var res ingestBenchResult
+
+	device, err := newFanoutDevice(ingestBenchChunks, false)
+	if err != nil {
+		return res, err
+	}
+	defer device.listener.Close()
+	if _, err := connManager.Connect(device.address()); err != nil {
+		return res, err
+	}
+
+	var written atomic.Int64
+	send, finish, err := setup(&written)
+	if err != nil {
+		connManager.DisconnectAll()
+		return res, err
+	}
+
+	interval := time.Second * fanoutChunkBytes / fanoutByteRate
+	payload := make([]byte, fanoutChunkBytes)
+
+	runtime.GC()
+	var before, after runtime.MemStats
+	runtime.ReadMemStats(&before)
+	cpuBefore := cpuSeconds()
+	start := time.Now()
+
+	ticker := time.NewTicker(interval)
+	for seq := 0; seq < ingestBenchChunks; seq++ {
+		<-ticker.C
+		binary.BigEndian.PutUint64(payload[0:8], uint64(seq))
+		binary.BigEndian.PutUint64(payload[8:16], uint64(time.Now().UnixNano()))
+		if err := send(payload); err != nil {
+			ticker.Stop()
+			connManager.DisconnectAll()
+			return res, err
+		}
+	}
+	ticker.Stop()
+	if err := finish(); err != nil {
+		log.Printf("finish: %v", err)
+	}
+	res.elapsed = time.Since(start)
+	time.Sleep(100 * time.Millisecond)
+
+	runtime.ReadMemStats(&after)
+	res.cpu = cpuSeconds() - cpuBefore
+	res.mallocs = after.Mallocs - before.Mallocs
+	res.wireBytes = written.Load()
+
+	connManager.DisconnectAll()
+	<-device.done
+	for seq := range device.arrivals {
+		if device.arrivals[seq] == 0 {
+			res.missing++
+			continue
+		}
+		res.latencies = append(res.latencies, device.latency[seq])
+	}
+	sortDurations(res.latencies)
+	return res, nil
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runIngestBenchmark() {
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mux := http.NewServeMux()
+	mux.HandleFunc("/api/audio/stream/start", handleAudioStreamStart)
+	mux.HandleFunc("/api/audio/stream/data", handleAudioStreamData)
+	mux.HandleFunc("/api/audio/stream/end", handleAudioStreamEnd)
+	mux.HandleFunc("/api/audio/ws", handleAudioStreamWS)
+
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		fmt.Printf("Failed to listen: %v\n", err)
+		return
+	}
+	server := &http.Server{Handler: mux}
+	go server.Serve(l)
+	defer server.Close()
+	base := "http://" + l.Addr().String()
+
+	// ==================== 逐块HTTP POST ====================
+	httpPath := func(written *atomic.Int64) (func([]byte) error, func() error, error) {
+		dialer := &net.Dialer{}
+		client := &http.Client{Transport: &http.Transport{
+			DialContext: func(ctx context.Context, network, addr string) (net.Conn, error) {
+				c, err := dialer.DialContext(ctx, network, addr)
+				if err != nil {
+					return nil, err
+				}
+				return countingConn{Conn: c, written: written}, nil
+			},
+			MaxIdleConnsPerHost: 4,
+		}}
+		post := func(path string, body []byte) error {
+			resp, err := client.Post(base+path, "application/octet-stream", bytes.NewReader(body))
+			if err != nil {
+				return err
+			}
+			io.Copy(io.Discard, resp.Body)
+			resp.Body.Close()
+			return nil
+		}
+		if err := post("/api/audio/stream/start", nil); err != nil {
+			return nil, nil, err
+		}
+		send := func(p []byte) error { return post("/api/audio/stream/data", p) }
+		finish := func() error {
+			defer client.CloseIdleConnections()
+			return post("/api/audio/stream/end", nil)
+		}
+		return send, finish, nil
+	}
+
+	// ==================== WebSocket ====================
+	wsPath := func(written *atomic.Int64) (func([]byte) error, func() error, error) {
+		ws, err := wsDial(l.Addr().String(), "/api/audio/ws")
+		if err != nil {
+			return nil, nil, err
+		}
+		ws.conn = countingConn{Conn: ws.conn, written: written}
+		send := func(p []byte) error { return ws.writeFrame(wsOpBinary, p) }
+		finish := func() error {
+			defer ws.Close()
+			if err := ws.writeText("end"); err != nil {
+				return err
+			}
+			// 等待服务端确认后关闭
+			_, _, err := ws.readMessage(nil, 1024)
+			ws.writeClose(wsCloseNormal)
+			return err
+		}
+		return send, finish, nil
+	}
+
+	fmt.Println("Audio ingest benchmark (loopback, real-time pacing)")
+	fmt.Printf("%d chunks x %d bytes, one chunk every %v\n\n", ingestBenchChunks, fanoutChunkBytes,
+		(time.Second * fanoutChunkBytes / fanoutByteRate).Round(10*time.Microsecond))
+	fmt.Printf("%-5s | %-8s | %-14s | %-32s | %-8s | %-10s | %s\n",
+		"path", "requests", "wire B/chunk", "send->device p50 / p99 / max", "missing", "cpu", "allocs/chunk")
+
+	for _, p := range []struct {
+		name     string
+		requests int
+		setup    func(*atomic.Int64) (func([]byte) error, func() error, error)
+	}{
+		{"http", ingestBenchChunks + 2, httpPath},
+		{"ws", 1, wsPath},
+	} {
+		res, err := runIngestPath(p.setup)
+		if err != nil {
+			fmt.Printf("%-5s | failed: %v\n", p.name, err)
+			continue
+		}
+		fmt.Printf("%-5s | %-8d | %-14.1f | %-32s | %-8d | %-10s | %.1f\n",
+			p.name, p.requests, float64(res.wireBytes)/ingestBenchChunks,
+			fmt.Sprintf("%v / %v / %v",
+				percentile(res.latencies, 0.50).Round(time.Microsecond),
+				percentile(res.latencies, 0.99).Round(time.Microsecond),
+				percentile(res.latencies, 1).Round(time.Microsecond)),
+			res.missing, fmt.Sprintf("%.3fs", res.cpu), float64(res.mallocs)/ingestBenchChunks)
+	}
+	fmt.Println("\ncpu and allocations cover client, server and simulated device in one process.")
+}
@@ -0,0 +1,193 @@
+/***
+ * @file library_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-25
+ * @brief 预渲染播报库基准测试（离线合成吞吐、归档打开、片段查找与拼接延迟 vs 实时合成）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-25
+ * @filePath library_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"fmt"
+	"io"
+	"log"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strconv"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkTTSLibrary$' -benchtime 1x [-tts-workers N] [-tts-stub]
+//
+// 用常驻合成进程渲染示例库（病区体温告警模板与常用短语）到临时归档，记录离线合成吞吐；
+// 之后打开归档（内存映射），测量逐个片段查找与按文本拼接整条播报的延迟和分配，
+// 并与同一进程实时流式合成同样播报的首块延迟对比。
+// 占位模型（-tts-stub）按libraryBenchStubRTF模拟合成耗时（假定），输出静音，片段不做裁剪。
+
+func BenchmarkTTSLibrary(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSLibraryBenchmark(*ttsWarmup, *ttsStub, *ttsWorkers) })
+}
+
+const (
+	libraryBenchStubRTF  = 0.3
+	libraryBenchRounds   = 200  // 查找：全部片段重复的轮数
+	libraryBenchAssemble = 2000 // 拼接：随机播报条数
+	libraryBenchSynth    = 3    // 实时合成对比的播报条数
+)
+
+var libraryBenchSpec = TTSLibrarySpec{
+	Phrases: []string{"请注意", "护士请到护士站", "探视时间已结束，请家属离开病区", "请保持病区安静"},
+	Templates: []TTSLibraryTemplate{{
+		Text: "{bed}号床病人体温{temp}度，请及时处理",
+		Slots: map[string]TTSLibrarySlot{
+			"bed":  {From: 1, To: 40},
+			"temp": {From: 36, To: 41, Step: 0.1, Decimals: 1},
+		},
+	}},
+}
+
+func libraryBenchText(rng *rand.Rand) string {
+	return fmt.Sprintf("请注意，%d号床病人体温%.1f度，请及时处理", 1+rng.Intn(40), 36+float64(rng.Intn(51))/10)
+}
+
+// 返回每次调用的平均耗时与平均分配次数
+func libraryBenchMeasure(n int, fn func(i int)) (time.Duration, float64) {
+	var before, after runtime.MemStats
+	runtime.GC()
+	runtime.ReadMemStats(&before)
+	start := time.Now()
+	for i := 0; i < n; i++ {
+		fn(i)
+	}
+	elapsed := time.Since(start)
+	runtime.ReadMemStats(&after)
+	return elapsed / time.Duration(n), float64(after.Mallocs-before.Mallocs) / float64(n)
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runTTSLibraryBenchmark(warmup string, stub bool, workers int) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts library benchmark:", err)
+		return
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mode := "VoxCPM model"
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(libraryBenchStubRTF, 'f', -1, 64))
+		mode = fmt.Sprintf("stub model at RTF %.1f (assumed), silent clips", libraryBenchStubRTF)
+	}
+	clips, err := libraryBenchSpec.Clips()
+	if err != nil {
+		fmt.Println("tts library benchmark:", err)
+		return
+	}
+	tmpDir, err := os.MkdirTemp("", "tts_library_bench")
+	if err != nil {
+		fmt.Println("tts library benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(tmpDir)
+	path := filepath.Join(tmpDir, "tts_library.bin")
+
+	runners, err := startTTSWorkers(argv, dir, max(workers, 1))
+	if err != nil {
+		fmt.Println("tts library benchmark: workers failed to start:", err)
+		return
+	}
+	defer stopTTSWorkers(runners)
+	fmt.Printf("TTS library benchmark: %d clips (%d phrases, 1 template), %d worker(s), %s\n\n",
+		len(clips), len(libraryBenchSpec.Phrases), len(runners), mode)
+
+	// 离线合成
+	stats, err := buildTTSLibrary(context.Background(), runners, clips, path)
+	if err != nil {
+		fmt.Println("build failed:", err)
+		return
+	}
+	fmt.Print("build: ")
+	printTTSLibraryBuild(filepath.Base(path), stats)
+
+	// 打开与查找
+	start := time.Now()
+	lib, err := OpenTTSLibrary(path)
+	if err != nil {
+		fmt.Println("open failed:", err)
+		return
+	}
+	defer lib.Close()
+	openTime := time.Since(start)
+	keys := append([]string(nil), clips...)
+	lookup, lookupAllocs := libraryBenchMeasure(libraryBenchRounds*len(keys), func(i int) {
+		if _, ok := lib.Clip(keys[i%len(keys)]); !ok {
+			panic("clip missing: " + keys[i%len(keys)])
+		}
+	})
+
+	rng := rand.New(rand.NewSource(1))
+	texts := make([]string, libraryBenchAssemble)
+	for i := range texts {
+		texts[i] = libraryBenchText(rng)
+	}
+	lat := make([]time.Duration, len(texts))
+	var parts, audioMs float64
+	assemble, assembleAllocs := libraryBenchMeasure(len(texts), func(i int) {
+		t := time.Now()
+		clips, ok := lib.Assemble(texts[i])
+		lat[i] = time.Since(t)
+		if !ok {
+			panic("not covered: " + texts[i])
+		}
+		parts += float64(len(clips))
+		audioMs += lib.durationMs(clips)
+	})
+	sort.Slice(lat, func(i, j int) bool { return lat[i] < lat[j] })
+
+	// 实时合成同样的播报
+	var first, total time.Duration
+	for i := 0; i < libraryBenchSynth; i++ {
+		start := time.Now()
+		var firstChunk time.Duration
+		_, err := runners[0].SynthesizeStream(context.Background(), texts[i], TTSPrompt{}, "", ttsDevicePCMFormat,
+			func(pcm []byte, f ttsPCMFormat) error {
+				if firstChunk == 0 {
+					firstChunk = time.Since(start)
+				}
+				return nil
+			})
+		if err != nil {
+			fmt.Println("synthesis failed:", err)
+			return
+		}
+		first += firstChunk
+		total += time.Since(start)
+	}
+
+	fmt.Printf("open (mmap): %v, archive %.1f MB, index %d B\n\n", openTime.Round(time.Microsecond),
+		float64(lib.Size())/(1<<20), len(lib.index))
+	fmt.Printf("%-30s | %-14s | %-14s | %s\n", "operation", "mean", "p99", "allocs/op")
+	fmt.Printf("%-30s | %-14v | %-14s | %.1f\n", "clip lookup", lookup, "-", lookupAllocs)
+	fmt.Printf("%-30s | %-14v | %-14v | %.1f\n", fmt.Sprintf("assemble (%.1f clips, %.1fs)", parts/float64(len(texts)),
+		audioMs/float64(len(texts))/1000), assemble, lat[len(lat)*99/100], assembleAllocs)
+	fmt.Printf("%-30s | %-14v | %-14s | -\n", "synthesis: first chunk", (first / libraryBenchSynth).Round(time.Microsecond), "-")
+	fmt.Printf("%-30s | %-14v | %-14s | -\n", "synthesis: whole announcement", (total / libraryBenchSynth).Round(time.Microsecond), "-")
+	fmt.Println("\nassemble = greedy longest match of an alarm text (\"请注意，12号床病人体温38.5度，请及时处理\") over the index,")
+	fmt.Println("returning slices of the mapped archive (no PCM copied); page cache warm after the build.")
+}
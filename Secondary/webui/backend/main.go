@@ -32,13 +32,46 @@ import (
 
 // ==================== 配置参数 ====================
 var (
-	httpAddr = flag.String("http", ":8088", "HTTP server address")
-	debug    = flag.Bool("debug", false, "Enable debug logging")
-	voxcpmCmd *exec.Cmd
+	httpAddr       = flag.String("http", ":8088", "HTTP server address")
+	debug          = flag.Bool("debug", false, "Enable debug logging")
+	scanFallback   = flag.Bool("scan-fallback", false, "Also sweep the local /24 on port 8080 (legacy discovery)")
+	ttsWorkerOn    = flag.Bool("tts-worker", true, "Keep one VoxCPM process loaded and reuse it for every synthesis")
+	ttsWarmup      = flag.String("tts-warmup", "你好，语音合成服务已就绪。", "Text synthesized once when the TTS worker starts (empty skips warmup)")
+	ttsWorkers     = flag.Int("tts-workers", 1, "Synthesis jobs run concurrently; each worker loads its own model copy")
+	ttsBatch       = flag.Int("tts-batch", 1, "Experimental: syntheses each worker decodes together in one batch (continuous batching; 1 decodes one at a time). Keep at 1 until VoxCPM/scripts/voxcpm_batch_check.py passes on the target machine")
+	ttsSentences   = flag.Bool("tts-sentences", true, "Split long texts into sentences and synthesize them on idle workers in parallel (output stays in order)")
+	ttsCPUOptimize = flag.Bool("tts-cpu-optimize", false, "CPU-only inference: int8 dynamic quantization of the linear layers (float32 elsewhere) and compiled step functions")
+	ttsThreads     = flag.Int("tts-threads", 0, "Inference threads per TTS worker (0: PyTorch default, or the CPUs split across -tts-workers)")
+	ttsStub        = flag.Bool("tts-stub", false, "Run the TTS worker without loading a model (protocol testing)")
+	ttsAlarmDecode = flag.String("tts-alarm-profile", "quality", "Decode profile of alarm jobs that do not name one (quality, balanced, fast: fewer diffusion steps for lower latency; check intelligibility with VoxCPM/scripts/voxcpm_profile_bench.py before lowering it)")
+	asrWorkerOn    = flag.Bool("asr-worker", false, "Keep the SenseVoice ASR model loaded in one process for /api/tts/recognize (off: spawn voxcpm_helper.py per request)")
+	asrBatch       = flag.Int("asr-batch", 4, "Queued recognition requests the ASR worker transcribes together in one batch")
+	asrStub        = flag.Bool("asr-stub", false, "Run the ASR worker without loading a model (protocol testing)")
+	ttsCacheDir    = flag.String("tts-cache-dir", "tts_cache", "Directory of cached synthesized announcements (device format)")
+	ttsVoiceDir    = flag.String("tts-voice-dir", "tts_voices", "Directory of registered voices (reference audio and encoded prompt caches)")
+	ttsCacheMB     = flag.Int("tts-cache-mb", 512, "Size cap of the TTS result cache in MB (0 disables caching)")
+	ttsLibraryPath = flag.String("tts-library", "tts_library.bin", "Pre-rendered announcement archive; texts fully covered by its clips are assembled without synthesis (missing file disables)")
+	ttsLibraryJSON = flag.String("tts-library-build", "", "Render the phrases and templates of this JSON file into -tts-library with the TTS worker(s) and exit")
+	audioLead      = flag.Duration("audio-lead", audioLeadDefault, "Target audio lead ahead of device playback (0 disables pacing)")
+	voxcpmCmd      *exec.Cmd
 )
 
 func main() {
 	flag.Parse()
+	audioLeadDefault = *audioLead
+
+	if *ttsLibraryJSON != "" {
+		argv, dir, err := voxcpmWorkerCommand(*ttsWarmup, *ttsStub)
+		if err == nil {
+			argv = append(argv, voxcpmCPUArgs(*ttsCPUOptimize, *ttsThreads, max(*ttsWorkers, 1))...)
+			err = runTTSLibraryBuild(*ttsLibraryJSON, *ttsLibraryPath, argv, dir, *ttsWorkers)
+		}
+		if err != nil {
+			log.Printf("TTS library build failed: %v", err)
+			os.Exit(1)
+		}
+		return
+	}
 
 	// ==================== 初始化日志 ====================
 	if *debug {
@@ -53,18 +86,95 @@ func main() {
 		log.Println("VoxCPM service started successfully")
 	}
 
+	// ==================== 启动合成任务队列与常驻合成进程 ====================
+	if _, err := parseTTSProfile(*ttsAlarmDecode, ttsPriorityRoutine); err != nil {
+		log.Printf("Warning: -tts-alarm-profile: %v, alarms use %s", err, ttsAlarmProfile)
+	} else {
+		ttsAlarmProfile = *ttsAlarmDecode
+	}
+	// 每个常驻进程对应-tts-batch个执行协程（批量解码）；未启用常驻进程时每个任务启动一个Python进程
+	workers := make([]*TTSWorker, max(*ttsWorkers, 1))
+	runners := workers
+	if *ttsWorkerOn {
+		argv, dir, err := voxcpmWorkerCommand(*ttsWarmup, *ttsStub)
+		if err != nil {
+			log.Printf("Warning: TTS worker disabled: %v", err)
+		} else {
+			argv = append(argv, voxcpmCPUArgs(*ttsCPUOptimize, *ttsThreads, len(workers))...)
+			for i := range workers {
+				workers[i] = NewBatchedTTSWorker(argv, dir, *ttsBatch)
+				workers[i].Start()
+			}
+			runners = nil
+			for b := 0; b < max(*ttsBatch, 1); b++ {
+				runners = append(runners, workers...)
+			}
+			log.Printf("%d TTS worker(s) starting (model loads once per worker in the background, batch %d)",
+				len(workers), max(*ttsBatch, 1))
+		}
+	}
+	// 常驻识别进程：与合成进程分开加载，模型只占CPU
+	if *asrWorkerOn {
+		if argv, dir, err := voxcpmASRCommand(*asrStub); err != nil {
+			log.Printf("Warning: ASR worker disabled: %v", err)
+		} else {
+			asrWorker = NewASRWorker(argv, dir, *asrBatch)
+			asrWorker.Start()
+			log.Printf("ASR worker starting (model loads once in the background, batch %d)", max(*asrBatch, 1))
+		}
+	}
+
+	// 合成缓存需要常驻进程报告的模型版本
+	var ttsCache *TTSCache
+	if *ttsCacheMB > 0 && runners[0] != nil {
+		cache, err := NewTTSCache(*ttsCacheDir, int64(*ttsCacheMB)<<20)
+		if err != nil {
+			log.Printf("Warning: TTS cache disabled: %v", err)
+		} else {
+			ttsCache = cache
+		}
+	}
+	ttsJobs = NewTTSJobQueue(runners, ttsCache, *ttsSentences)
+	if runners[0] != nil {
+		if voices, err := NewVoiceRegistry(*ttsVoiceDir); err != nil {
+			log.Printf("Warning: TTS voices disabled: %v", err)
+		} else {
+			ttsVoices = voices
+		}
+	}
+	// 预渲染播报库：只读映射，与合成进程的模型版本不一致时不使用
+	if lib, err := OpenTTSLibrary(*ttsLibraryPath); err == nil {
+		ttsLibrary = lib
+		log.Printf("TTS library: %s, %d clips, %.1f MB (model %s)",
+			*ttsLibraryPath, lib.Len(), float64(lib.Size())/(1<<20), lib.ModelVersion())
+	} else if !os.IsNotExist(err) {
+		log.Printf("Warning: TTS library disabled: %v", err)
+	}
+
 	// ==================== 设置信号处理 ====================
 	sigChan := make(chan os.Signal, 1)
 	signal.Notify(sigChan, os.Interrupt, syscall.SIGTERM)
 	go func() {
 		<-sigChan
 		log.Println("Shutting down...")
+		ttsJobs.Close()
+		for _, w := range workers {
+			if w != nil {
+				w.Stop()
+			}
+		}
+		if asrWorker != nil {
+			asrWorker.Stop()
+		}
 		stopVoxCPM()
 		os.Exit(0)
 	}()
 
+	// ==================== 设备响应分发 ====================
+	connManager.OnTelemetry = handleTelemetryFrame
+
 	// ==================== 初始化设备发现 ====================
-	discoveryService := NewDeviceDiscovery()
+	discoveryService := NewDeviceDiscovery(*scanFallback)
 	setDiscoveryService(discoveryService)  // 设置全局引用
 	go discoveryService.Start()
 
@@ -84,14 +194,23 @@ func main() {
 	mux.HandleFunc("/api/audio/stream/start", handleAudioStreamStart)
 	mux.HandleFunc("/api/audio/stream/data", handleAudioStreamData)
 	mux.HandleFunc("/api/audio/stream/end", handleAudioStreamEnd)
+	mux.HandleFunc("/api/audio/ws", handleAudioStreamWS)
+	mux.HandleFunc("/api/audio/upload", handleAudioUpload)
 	mux.HandleFunc("/api/audio/stop", handleAudioStop)
 	mux.HandleFunc("/api/status", handleStatus)
+	mux.HandleFunc("/api/metrics", handleMetrics)
+	mux.HandleFunc("/api/device/query", handleDeviceQuery)
 	mux.HandleFunc("/api/temperature/events", handleTemperatureEvents)
 	
 	// TTS 相关路由
 	mux.HandleFunc("/api/tts/synthesize", handleTTSSynthesize)
 	mux.HandleFunc("/api/tts/status", handleTTSStatus)
 	mux.HandleFunc("/api/tts/download", handleTTSDownload)
+	mux.HandleFunc("/api/tts/speak", handleTTSSpeak)
+	mux.HandleFunc("/api/tts/cancel", handleTTSCancel)
+	mux.HandleFunc("/api/tts/jobs", handleTTSJobs)
+	mux.HandleFunc("/api/tts/events", handleTTSEvents)
+	mux.HandleFunc("/api/tts/voices", handleTTSVoices)
 	mux.HandleFunc("/api/tts/recognize", handleTTSRecognize)
 
 	// ==================== 请求日志中间件 ====================
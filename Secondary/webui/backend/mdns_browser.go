@@ -0,0 +1,609 @@
+/***
+ * @file mdns_browser.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-14
+ * @brief mDNS服务浏览（被动监听 + 主动查询 + TTL过期）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-14
+ * @filePath mdns_browser.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"encoding/binary"
+	"errors"
+	"log"
+	"net"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// ==================== mDNS常量 ====================
+const (
+	mdnsGroupAddr   = "224.0.0.251:5353"
+	mdnsServiceName = "_esp32temp._tcp.local."
+
+	dnsTypeA   uint16 = 1
+	dnsTypePTR uint16 = 12
+	dnsTypeTXT uint16 = 16
+	dnsTypeSRV uint16 = 33
+	dnsClassIN uint16 = 1
+
+	dnsClassMask     = 0x7FFF // 去掉cache-flush / unicast-response位
+	dnsFlagResponse  = 0x8400 // QR + AA
+	mdnsMaxPacket    = 9000
+	mdnsMaxQueryWait = 60 * time.Second // 主动查询最大间隔
+	mdnsRefreshRatio = 0.8              // 记录剩余20%寿命时刷新
+)
+
+// ==================== DNS报文结构 ====================
+type dnsQuestion struct {
+	Name  string
+	Type  uint16
+	Class uint16
+}
+
+type dnsRecord struct {
+	Name  string
+	Type  uint16
+	Class uint16
+	TTL   uint32
+
+	Target string            // PTR目标 / SRV主机
+	Port   uint16            // SRV端口
+	TXT    map[string]string // TXT键值
+	IP     net.IP            // A记录地址
+}
+
+type dnsMessage struct {
+	ID        uint16
+	Flags     uint16
+	Questions []dnsQuestion
+	Records   []dnsRecord // 回答、授权、附加区合并
+}
+
+// ==================== 浏览结果 ====================
+type mdnsInstance struct {
+	Name       string            // 实例全名（含服务名）
+	Host       string            // SRV目标主机
+	Port       int               // SRV端口
+	IP         string            // A记录地址
+	TXT        map[string]string // TXT键值
+	ptrExpires time.Time
+	srvExpires time.Time
+	ptrTTL     time.Duration
+	srvTTL     time.Duration
+	refreshed  bool // 本轮是否已发送刷新查询
+}
+
+type mdnsHost struct {
+	IP      string
+	Expires time.Time
+}
+
+// mDNS统计（用于基准测试与状态接口）
+type MDNSStats struct {
+	QueriesSent     uint64 `json:"queries_sent"`
+	PacketsReceived uint64 `json:"packets_received"`
+	BytesSent       uint64 `json:"bytes_sent"`
+	BytesReceived   uint64 `json:"bytes_received"`
+}
+
+// ==================== mDNS浏览器 ====================
+type MDNSBrowser struct {
+	service string
+	conn    net.PacketConn
+	dest    net.Addr
+
+	OnUpdate func(inst mdnsInstance) // 实例新增或变化（已解析到IP）
+	OnRemove func(inst mdnsInstance) // 实例过期或收到goodbye
+
+	mu        sync.Mutex
+	instances map[string]*mdnsInstance // 键为小写实例名
+	hosts     map[string]mdnsHost      // 键为小写主机名
+
+	queriesSent     atomic.Uint64
+	packetsReceived atomic.Uint64
+	bytesSent       atomic.Uint64
+	bytesReceived   atomic.Uint64
+}
+
+// ==================== 创建mDNS浏览器（加入224.0.0.251:5353组播组） ====================
+func NewMDNSBrowser(service string) (*MDNSBrowser, error) {
+	group, err := net.ResolveUDPAddr("udp4", mdnsGroupAddr)
+	if err != nil {
+		return nil, err
+	}
+	conn, err := net.ListenMulticastUDP("udp4", nil, group)
+	if err != nil {
+		return nil, err
+	}
+	conn.SetReadBuffer(1 << 20)
+	return newMDNSBrowserWithConn(service, conn, group), nil
+}
+
+// ==================== 基于指定连接创建浏览器（基准测试使用单播替身） ====================
+func newMDNSBrowserWithConn(service string, conn net.PacketConn, dest net.Addr) *MDNSBrowser {
+	return &MDNSBrowser{
+		service:   service,
+		conn:      conn,
+		dest:      dest,
+		instances: make(map[string]*mdnsInstance),
+		hosts:     make(map[string]mdnsHost),
+	}
+}
+
+// ==================== 获取统计 ====================
+func (b *MDNSBrowser) Stats() MDNSStats {
+	return MDNSStats{
+		QueriesSent:     b.queriesSent.Load(),
+		PacketsReceived: b.packetsReceived.Load(),
+		BytesSent:       b.bytesSent.Load(),
+		BytesReceived:   b.bytesReceived.Load(),
+	}
+}
+
+// ==================== 运行浏览器（阻塞直到ctx取消） ====================
+// 被动：接收组播组中的所有响应（包括设备状态变化时的TXT重新通告）
+// 主动：启动时立即查询，之后间隔1s、2s、4s…逐步退避到60s；记录到达80%寿命时单独刷新
+func (b *MDNSBrowser) Run(ctx context.Context) {
+	go func() {
+		<-ctx.Done()
+		b.conn.Close()
+	}()
+	go b.receiveLoop()
+
+	queryInterval := time.Second
+	nextQuery := time.Now()
+	ticker := time.NewTicker(250 * time.Millisecond)
+	defer ticker.Stop()
+
+	for {
+		now := time.Now()
+		if !now.Before(nextQuery) {
+			b.sendBrowseQuery()
+			nextQuery = now.Add(queryInterval)
+			if queryInterval < mdnsMaxQueryWait {
+				queryInterval *= 2
+			}
+		}
+		b.maintain(now)
+
+		select {
+		case <-ctx.Done():
+			return
+		case <-ticker.C:
+		}
+	}
+}
+
+// ==================== 接收循环 ====================
+func (b *MDNSBrowser) receiveLoop() {
+	buf := make([]byte, mdnsMaxPacket)
+	for {
+		n, _, err := b.conn.ReadFrom(buf)
+		if err != nil {
+			if errors.Is(err, net.ErrClosed) {
+				return
+			}
+			log.Printf("mDNS read error: %v", err)
+			time.Sleep(100 * time.Millisecond)
+			continue
+		}
+		b.packetsReceived.Add(1)
+		b.bytesReceived.Add(uint64(n))
+
+		msg, err := parseDNSMessage(buf[:n])
+		if err != nil || msg.Flags&0x8000 == 0 {
+			continue // 解析失败或是查询报文
+		}
+		b.handleResponse(msg, time.Now())
+	}
+}
+
+// ==================== 发送浏览查询（携带已知答案以抑制重复响应） ====================
+func (b *MDNSBrowser) sendBrowseQuery() {
+	now := time.Now()
+	var known []dnsRecord
+
+	b.mu.Lock()
+	for _, inst := range b.instances {
+		remaining := inst.ptrExpires.Sub(now)
+		// RFC 6762 7.1：仅包含剩余TTL超过一半的记录
+		if remaining > inst.ptrTTL/2 {
+			known = append(known, dnsRecord{
+				Name: b.service, Type: dnsTypePTR, Class: dnsClassIN,
+				TTL: uint32(remaining / time.Second), Target: inst.Name,
+			})
+		}
+	}
+	b.mu.Unlock()
+
+	b.send(buildDNSQuery([]dnsQuestion{{Name: b.service, Type: dnsTypePTR, Class: dnsClassIN}}, known))
+}
+
+// ==================== 发送报文 ====================
+func (b *MDNSBrowser) send(packet []byte) {
+	if _, err := b.conn.WriteTo(packet, b.dest); err != nil {
+		if !errors.Is(err, net.ErrClosed) {
+			log.Printf("mDNS send error: %v", err)
+		}
+		return
+	}
+	b.queriesSent.Add(1)
+	b.bytesSent.Add(uint64(len(packet)))
+}
+
+// ==================== 处理响应报文 ====================
+func (b *MDNSBrowser) handleResponse(msg *dnsMessage, now time.Time) {
+	var updated, removed []mdnsInstance
+	touched := make(map[string]bool)
+
+	b.mu.Lock()
+	// 先处理A记录，同一报文中的SRV可以立即解析
+	for _, rr := range msg.Records {
+		if rr.Type != dnsTypeA || rr.IP == nil {
+			continue
+		}
+		host := strings.ToLower(rr.Name)
+		if rr.TTL == 0 {
+			delete(b.hosts, host)
+			continue
+		}
+		b.hosts[host] = mdnsHost{IP: rr.IP.String(), Expires: now.Add(time.Duration(rr.TTL) * time.Second)}
+		for name, inst := range b.instances {
+			if inst.Host == host && inst.IP != rr.IP.String() {
+				touched[name] = true
+			}
+		}
+	}
+
+	for _, rr := range msg.Records {
+		ttl := time.Duration(rr.TTL) * time.Second
+		switch rr.Type {
+		case dnsTypePTR:
+			if !strings.EqualFold(rr.Name, b.service) {
+				continue
+			}
+			if rr.TTL == 0 {
+				// goodbye报文：实例下线
+				if inst, ok := b.instances[strings.ToLower(rr.Target)]; ok {
+					delete(b.instances, strings.ToLower(rr.Target))
+					removed = append(removed, *inst)
+				}
+				continue
+			}
+			inst := b.instanceLocked(rr.Target)
+			inst.ptrExpires = now.Add(ttl)
+			inst.ptrTTL = ttl
+			touched[strings.ToLower(rr.Target)] = true
+
+		case dnsTypeSRV:
+			if !strings.HasSuffix(strings.ToLower(rr.Name), strings.ToLower(b.service)) {
+				continue
+			}
+			inst := b.instanceLocked(rr.Name)
+			if rr.TTL == 0 {
+				inst.srvExpires = now
+				continue
+			}
+			inst.Host = strings.ToLower(rr.Target)
+			inst.Port = int(rr.Port)
+			inst.srvExpires = now.Add(ttl)
+			inst.srvTTL = ttl
+			inst.refreshed = false
+			touched[strings.ToLower(rr.Name)] = true
+
+		case dnsTypeTXT:
+			if !strings.HasSuffix(strings.ToLower(rr.Name), strings.ToLower(b.service)) {
+				continue
+			}
+			inst := b.instanceLocked(rr.Name)
+			inst.TXT = rr.TXT
+			touched[strings.ToLower(rr.Name)] = true
+		}
+	}
+
+	var needAddr []dnsQuestion
+	for name := range touched {
+		inst, ok := b.instances[name]
+		if !ok || inst.Host == "" {
+			continue
+		}
+		if h, ok := b.hosts[inst.Host]; ok {
+			inst.IP = h.IP
+			updated = append(updated, *inst)
+		} else {
+			needAddr = append(needAddr, dnsQuestion{Name: inst.Host, Type: dnsTypeA, Class: dnsClassIN})
+		}
+	}
+	b.mu.Unlock()
+
+	if len(needAddr) > 0 {
+		b.send(buildDNSQuery(needAddr, nil))
+	}
+	for _, inst := range removed {
+		if b.OnRemove != nil {
+			b.OnRemove(inst)
+		}
+	}
+	for _, inst := range updated {
+		if b.OnUpdate != nil {
+			b.OnUpdate(inst)
+		}
+	}
+}
+
+// ==================== 获取或创建实例（需持有锁，按小写名索引） ====================
+func (b *MDNSBrowser) instanceLocked(name string) *mdnsInstance {
+	key := strings.ToLower(name)
+	inst, ok := b.instances[key]
+	if !ok {
+		inst = &mdnsInstance{Name: name}
+		b.instances[key] = inst
+	}
+	return inst
+}
+
+// ==================== 缓存维护：过期删除 + 到期前刷新 ====================
+func (b *MDNSBrowser) maintain(now time.Time) {
+	var expired []mdnsInstance
+	var refresh []dnsQuestion
+
+	b.mu.Lock()
+	for host, h := range b.hosts {
+		if now.After(h.Expires) {
+			delete(b.hosts, host)
+		}
+	}
+	for name, inst := range b.instances {
+		// 实例在PTR或SRV任一过期时视为下线（SRV寿命短，能更快发现掉线设备）
+		if (!inst.ptrExpires.IsZero() && now.After(inst.ptrExpires)) ||
+			(!inst.srvExpires.IsZero() && now.After(inst.srvExpires)) {
+			delete(b.instances, name)
+			if inst.IP != "" {
+				expired = append(expired, *inst)
+			}
+			continue
+		}
+		if !inst.refreshed && inst.srvTTL > 0 &&
+			now.After(inst.srvExpires.Add(-time.Duration(float64(inst.srvTTL)*(1-mdnsRefreshRatio)))) {
+			inst.refreshed = true
+			refresh = append(refresh, dnsQuestion{Name: name, Type: dnsTypeSRV, Class: dnsClassIN})
+		}
+	}
+	b.mu.Unlock()
+
+	if len(refresh) > 0 {
+		b.send(buildDNSQuery(refresh, nil))
+	}
+	for _, inst := range expired {
+		if b.OnRemove != nil {
+			b.OnRemove(inst)
+		}
+	}
+}
+
+// ==================== DNS报文编码 ====================
+func appendDNSName(buf []byte, name string) []byte {
+	for _, label := range strings.Split(strings.TrimSuffix(name, "."), ".") {
+		if label == "" {
+			continue
+		}
+		buf = append(buf, byte(len(label)))
+		buf = append(buf, label...)
+	}
+	return append(buf, 0)
+}
+
+func appendDNSHeader(buf []byte, flags uint16, qd, an, ns, ar int) []byte {
+	buf = binary.BigEndian.AppendUint16(buf, 0) // mDNS报文ID为0
+	buf = binary.BigEndian.AppendUint16(buf, flags)
+	buf = binary.BigEndian.AppendUint16(buf, uint16(qd))
+	buf = binary.BigEndian.AppendUint16(buf, uint16(an))
+	buf = binary.BigEndian.AppendUint16(buf, uint16(ns))
+	return binary.BigEndian.AppendUint16(buf, uint16(ar))
+}
+
+func appendDNSRecord(buf []byte, rr dnsRecord) []byte {
+	buf = appendDNSName(buf, rr.Name)
+	buf = binary.BigEndian.AppendUint16(buf, rr.Type)
+	buf = binary.BigEndian.AppendUint16(buf, rr.Class)
+	buf = binary.BigEndian.AppendUint32(buf, rr.TTL)
+
+	lenPos := len(buf)
+	buf = append(buf, 0, 0)
+	switch rr.Type {
+	case dnsTypePTR:
+		buf = appendDNSName(buf, rr.Target)
+	case dnsTypeSRV:
+		buf = binary.BigEndian.AppendUint16(buf, 0) // priority
+		buf = binary.BigEndian.AppendUint16(buf, 0) // weight
+		buf = binary.BigEndian.AppendUint16(buf, rr.Port)
+		buf = appendDNSName(buf, rr.Target)
+	case dnsTypeTXT:
+		if len(rr.TXT) == 0 {
+			buf = append(buf, 0)
+		}
+		for k, v := range rr.TXT {
+			item := k + "=" + v
+			if len(item) > 255 {
+				item = item[:255]
+			}
+			buf = append(buf, byte(len(item)))
+			buf = append(buf, item...)
+		}
+	case dnsTypeA:
+		buf = append(buf, rr.IP.To4()...)
+	}
+	binary.BigEndian.PutUint16(buf[lenPos:], uint16(len(buf)-lenPos-2))
+	return buf
+}
+
+// 构建查询报文，known为已知答案（放在回答区）
+func buildDNSQuery(questions []dnsQuestion, known []dnsRecord) []byte {
+	buf := make([]byte, 0, 512)
+	buf = appendDNSHeader(buf, 0, len(questions), len(known), 0, 0)
+	for _, q := range questions {
+		buf = appendDNSName(buf, q.Name)
+		buf = binary.BigEndian.AppendUint16(buf, q.Type)
+		buf = binary.BigEndian.AppendUint16(buf, q.Class)
+	}
+	for _, rr := range known {
+		buf = appendDNSRecord(buf, rr)
+	}
+	return buf
+}
+
+// 构建响应报文，answers放回答区，extra放附加区
+func buildDNSResponse(answers, extra []dnsRecord) []byte {
+	buf := make([]byte, 0, 512)
+	buf = appendDNSHeader(buf, dnsFlagResponse, 0, len(answers), 0, len(extra))
+	for _, rr := range answers {
+		buf = appendDNSRecord(buf, rr)
+	}
+	for _, rr := range extra {
+		buf = appendDNSRecord(buf, rr)
+	}
+	return buf
+}
+
+// ==================== DNS报文解析 ====================
+var errDNSShort = errors.New("dns: message too short")
+
+func readDNSName(msg []byte, off int) (string, int, error) {
+	var labels []string
+	end := -1
+	for jumps := 0; ; {
+		if off >= len(msg) {
+			return "", 0, errDNSShort
+		}
+		l := int(msg[off])
+		switch {
+		case l == 0:
+			off++
+			if end < 0 {
+				end = off
+			}
+			return strings.Join(labels, ".") + ".", end, nil
+		case l&0xC0 == 0xC0:
+			// 压缩指针
+			if off+1 >= len(msg) {
+				return "", 0, errDNSShort
+			}
+			if end < 0 {
+				end = off + 2
+			}
+			off = int(binary.BigEndian.Uint16(msg[off:]) & 0x3FFF)
+			if jumps++; jumps > 16 {
+				return "", 0, errors.New("dns: compression loop")
+			}
+		default:
+			if off+1+l > len(msg) {
+				return "", 0, errDNSShort
+			}
+			labels = append(labels, string(msg[off+1:off+1+l]))
+			off += 1 + l
+		}
+	}
+}
+
+func parseDNSMessage(msg []byte) (*dnsMessage, error) {
+	if len(msg) < 12 {
+		return nil, errDNSShort
+	}
+	m := &dnsMessage{
+		ID:    binary.BigEndian.Uint16(msg[0:]),
+		Flags: binary.BigEndian.Uint16(msg[2:]),
+	}
+	qd := int(binary.BigEndian.Uint16(msg[4:]))
+	rrCount := int(binary.BigEndian.Uint16(msg[6:])) + int(binary.BigEndian.Uint16(msg[8:])) +
+		int(binary.BigEndian.Uint16(msg[10:]))
+	off := 12
+
+	for i := 0; i < qd; i++ {
+		name, next, err := readDNSName(msg, off)
+		if err != nil || next+4 > len(msg) {
+			return nil, errDNSShort
+		}
+		m.Questions = append(m.Questions, dnsQuestion{
+			Name:  name,
+			Type:  binary.BigEndian.Uint16(msg[next:]),
+			Class: binary.BigEndian.Uint16(msg[next+2:]) & dnsClassMask,
+		})
+		off = next + 4
+	}
+
+	for i := 0; i < rrCount; i++ {
+		name, next, err := readDNSName(msg, off)
+		if err != nil || next+10 > len(msg) {
+			return nil, errDNSShort
+		}
+		rr := dnsRecord{
+			Name:  name,
+			Type:  binary.BigEndian.Uint16(msg[next:]),
+			Class: binary.BigEndian.Uint16(msg[next+2:]) & dnsClassMask,
+			TTL:   binary.BigEndian.Uint32(msg[next+4:]),
+		}
+		rdLen := int(binary.BigEndian.Uint16(msg[next+8:]))
+		rdStart := next + 10
+		if rdStart+rdLen > len(msg) {
+			return nil, errDNSShort
+		}
+		rdata := msg[rdStart : rdStart+rdLen]
+
+		switch rr.Type {
+		case dnsTypePTR:
+			rr.Target, _, err = readDNSName(msg, rdStart)
+		case dnsTypeSRV:
+			if rdLen < 7 {
+				err = errDNSShort
+				break
+			}
+			rr.Port = binary.BigEndian.Uint16(rdata[4:])
+			rr.Target, _, err = readDNSName(msg, rdStart+6)
+		case dnsTypeTXT:
+			rr.TXT = parseTXT(rdata)
+		case dnsTypeA:
+			if rdLen == 4 {
+				rr.IP = net.IPv4(rdata[0], rdata[1], rdata[2], rdata[3])
+			}
+		}
+		if err != nil {
+			return nil, err
+		}
+		m.Records = append(m.Records, rr)
+		off = rdStart + rdLen
+	}
+	return m, nil
+}
+
+func parseTXT(rdata []byte) map[string]string {
+	txt := make(map[string]string)
+	for i := 0; i < len(rdata); {
+		l := int(rdata[i])
+		i++
+		if l == 0 || i+l > len(rdata) {
+			i += l
+			continue
+		}
+		item := string(rdata[i : i+l])
+		i += l
+		if k, v, ok := strings.Cut(item, "="); ok {
+			txt[strings.ToLower(k)] = v
+		} else {
+			txt[strings.ToLower(item)] = ""
+		}
+	}
+	return txt
+}
@@ -0,0 +1,142 @@
+/***
+ * @file mdns_browser_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief DNS报文编解码测试（记录往返、名称压缩、截断与压缩环、TXT解析）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath mdns_browser_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"net"
+	"reflect"
+	"testing"
+)
+
+func TestDNSMessageRoundTrip(t *testing.T) {
+	instance := "esp32-kitchen." + mdnsServiceName
+	answers := []dnsRecord{
+		{Name: mdnsServiceName, Type: dnsTypePTR, Class: dnsClassIN, TTL: 4500, Target: instance},
+	}
+	extra := []dnsRecord{
+		{Name: instance, Type: dnsTypeSRV, Class: dnsClassIN, TTL: 120, Target: "esp32-kitchen.local.", Port: 8080},
+		{Name: instance, Type: dnsTypeTXT, Class: dnsClassIN, TTL: 4500, TXT: map[string]string{"rates": "44100", "channels": "2"}},
+		{Name: "esp32-kitchen.local.", Type: dnsTypeA, Class: dnsClassIN, TTL: 120, IP: net.IPv4(192, 168, 1, 20)},
+	}
+	msg, err := parseDNSMessage(buildDNSResponse(answers, extra))
+	if err != nil {
+		t.Fatalf("parseDNSMessage: %v", err)
+	}
+	if msg.Flags != dnsFlagResponse || len(msg.Questions) != 0 {
+		t.Errorf("flags %#x, %d questions; want %#x, 0", msg.Flags, len(msg.Questions), dnsFlagResponse)
+	}
+	want := append(append([]dnsRecord{}, answers...), extra...)
+	if len(msg.Records) != len(want) {
+		t.Fatalf("%d records, want %d", len(msg.Records), len(want))
+	}
+	for i, rr := range msg.Records {
+		w := want[i]
+		if rr.Name != w.Name || rr.Type != w.Type || rr.Class != w.Class || rr.TTL != w.TTL ||
+			rr.Target != w.Target || rr.Port != w.Port || !rr.IP.Equal(w.IP) ||
+			(w.TXT != nil && !reflect.DeepEqual(rr.TXT, w.TXT)) {
+			t.Errorf("record %d = %+v, want %+v", i, rr, w)
+		}
+	}
+
+	query, err := parseDNSMessage(buildDNSQuery([]dnsQuestion{{mdnsServiceName, dnsTypePTR, dnsClassIN}}, answers))
+	if err != nil {
+		t.Fatalf("parse query: %v", err)
+	}
+	if len(query.Questions) != 1 || query.Questions[0] != (dnsQuestion{mdnsServiceName, dnsTypePTR, dnsClassIN}) ||
+		len(query.Records) != 1 || query.Records[0].Target != instance {
+		t.Errorf("query = %+v", query)
+	}
+}
+
+// 手工构造的响应：PTR目标与SRV主机使用压缩指针，类字段带cache-flush位
+func TestDNSNameCompression(t *testing.T) {
+	msg := []byte{
+		0, 0, 0x84, 0, 0, 0, 0, 2, 0, 0, 0, 0, // 头：2条回答
+		// 偏移12：_esp32temp._tcp.local. PTR
+		10, '_', 'e', 's', 'p', '3', '2', 't', 'e', 'm', 'p', 4, '_', 't', 'c', 'p', 5, 'l', 'o', 'c', 'a', 'l', 0,
+		0, 12, 0x80, 1, 0, 0, 0, 120, 0, 6,
+		// 偏移45，PTR目标：dev + 指向偏移12
+		3, 'd', 'e', 'v', 0xC0, 12,
+		// 偏移51：SRV记录名指向PTR目标（偏移45）
+		0xC0, 45, 0, 33, 0x80, 1, 0, 0, 0, 120, 0, 8,
+		0, 0, 0, 0, 0x1F, 0x90, 0xC0, 45,
+	}
+	m, err := parseDNSMessage(msg)
+	if err != nil {
+		t.Fatalf("parseDNSMessage: %v", err)
+	}
+	if len(m.Records) != 2 {
+		t.Fatalf("%d records, want 2", len(m.Records))
+	}
+	ptr, srv := m.Records[0], m.Records[1]
+	if ptr.Name != mdnsServiceName || ptr.Class != dnsClassIN || ptr.Target != "dev."+mdnsServiceName {
+		t.Errorf("PTR = %+v", ptr)
+	}
+	if srv.Name != "dev."+mdnsServiceName || srv.Type != dnsTypeSRV || srv.Port != 8080 || srv.Target != srv.Name {
+		t.Errorf("SRV = %+v", srv)
+	}
+}
+
+// 截断或恶意报文只返回错误，不越界、不死循环
+func TestDNSMalformed(t *testing.T) {
+	valid := buildDNSResponse([]dnsRecord{
+		{Name: mdnsServiceName, Type: dnsTypePTR, Class: dnsClassIN, TTL: 120, Target: "dev." + mdnsServiceName},
+	}, nil)
+	for n := 0; n < len(valid); n++ {
+		if _, err := parseDNSMessage(valid[:n]); err == nil {
+			t.Errorf("truncated to %d of %d bytes: no error", n, len(valid))
+		}
+	}
+
+	loop := []byte{0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0xC0, 12, 0, 1, 0, 1}
+	if _, err := parseDNSMessage(loop); err == nil {
+		t.Error("self-referencing compression pointer: no error")
+	}
+	shortSRV := []byte{0, 0, 0x84, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 33, 0, 1, 0, 0, 0, 120, 0, 2, 0, 0}
+	if _, err := parseDNSMessage(shortSRV); err == nil {
+		t.Error("SRV with 2-byte rdata: no error")
+	}
+}
+
+func TestParseTXT(t *testing.T) {
+	item := func(s string) []byte { return append([]byte{byte(len(s))}, s...) }
+	cat := func(items ...[]byte) []byte {
+		var b []byte
+		for _, it := range items {
+			b = append(b, it...)
+		}
+		return b
+	}
+	tests := []struct {
+		name string
+		in   []byte
+		want map[string]string
+	}{
+		{"empty", nil, map[string]string{}},
+		{"single zero byte", []byte{0}, map[string]string{}},
+		{"pairs", cat(item("rates=44100,48000"), item("Channels=2")),
+			map[string]string{"rates": "44100,48000", "channels": "2"}},
+		{"flag and empty value", cat(item("stereo"), item("name=")), map[string]string{"stereo": "", "name": ""}},
+		{"value containing =", cat(item("k=a=b")), map[string]string{"k": "a=b"}},
+		{"overlong item dropped", cat(item("a=1"), []byte{9, 'b', '=', '2'}), map[string]string{"a": "1"}},
+	}
+	for _, tt := range tests {
+		if got := parseTXT(tt.in); !reflect.DeepEqual(got, tt.want) {
+			t.Errorf("%s: parseTXT = %v, want %v", tt.name, got, tt.want)
+		}
+	}
+}
@@ -0,0 +1,35 @@
+//go:build !unix
+
+/***
+ * @file mmap_other.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-25
+ * @brief 不支持内存映射的平台：整个文件读入内存
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-25
+ * @filePath mmap_other.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"errors"
+	"os"
+)
+
+func mmapFile(path string) ([]byte, func() error, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, nil, err
+	}
+	if len(data) == 0 {
+		return nil, nil, errors.New("empty file")
+	}
+	return data, func() error { return nil }, nil
+}
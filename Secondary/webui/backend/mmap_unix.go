@@ -0,0 +1,46 @@
+//go:build unix
+
+/***
+ * @file mmap_unix.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-25
+ * @brief 只读内存映射文件（Unix）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-25
+ * @filePath mmap_unix.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"errors"
+	"os"
+	"syscall"
+)
+
+// 整个文件只读映射到内存，页面按需从页缓存载入；返回的释放函数解除映射
+func mmapFile(path string) ([]byte, func() error, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, nil, err
+	}
+	defer f.Close()
+	st, err := f.Stat()
+	if err != nil {
+		return nil, nil, err
+	}
+	if st.Size() == 0 {
+		return nil, nil, errors.New("empty file")
+	}
+	data, err := syscall.Mmap(int(f.Fd()), 0, int(st.Size()), syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, nil, err
+	}
+	return data, func() error { return syscall.Munmap(data) }, nil
+}
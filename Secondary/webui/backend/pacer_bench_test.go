@@ -0,0 +1,249 @@
+/***
+ * @file pacer_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-18
+ * @brief 音频节拍基准测试（不节拍 vs 按播放速率节拍，模拟10槽位设备队列）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-18
+ * @filePath pacer_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"os"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkPacer$' -benchtime 1x
+//
+// 模拟设备按固件行为处理音频：TCP接收缓冲较小（接近lwIP窗口），音频块进入10槽位队列，
+// 入队最多等待100ms否则丢弃；播放协程按实时速率每块取一次，取不到记一次欠载；
+// 每10个包或丢包时回报剩余槽位（0xD9）。收到停止命令（0xA0）时清空队列。
+// 上游一次性推入约5秒音频（快于实时），2秒后发送停止命令，比较：
+//   前2秒的播放块数与欠载、设备丢包、停止命令到达设备的延迟（停止后仍会播放的时长）、节拍器指标。
+
+func BenchmarkPacer(b *testing.B) {
+	runBenchOnce(b, func() { runPacerBenchmark() })
+}
+
+const (
+	pacerBenchChunks    = 300 // 约5秒音频
+	pacerBenchStopAfter = 2 * time.Second
+	pacerBenchRecvBuf   = 8 * 1024
+	pacerBenchFeedWait  = 100 * time.Millisecond
+)
+
+type pacerBenchDevice struct {
+	listener  net.Listener
+	interval  time.Duration
+	queue     chan struct{}
+	played    atomic.Int64
+	underruns atomic.Int64
+	drops     atomic.Int64
+	stoppedAt atomic.Int64 // 收到停止命令的时间（UnixNano）
+	done      chan struct{}
+}
+
+func newPacerBenchDevice() (*pacerBenchDevice, error) {
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		return nil, err
+	}
+	d := &pacerBenchDevice{
+		listener: l,
+		interval: time.Second * fanoutChunkBytes / fanoutByteRate,
+		queue:    make(chan struct{}, deviceAudioSlots),
+		done:     make(chan struct{}),
+	}
+	go d.serve()
+	return d, nil
+}
+
+// ==================== 接收协程（对应tcp_server + audio_stream_feed） ====================
+func (d *pacerBenchDevice) serve() {
+	defer close(d.done)
+	c, err := d.listener.Accept()
+	if err != nil {
+		return
+	}
+	defer c.Close()
+	c.(*net.TCPConn).SetReadBuffer(pacerBenchRecvBuf)
+
+	stop := make(chan struct{})
+	defer close(stop)
+	playing := false
+
+	buf := make([]byte, 1+fanoutChunkBytes)
+	packets := 0
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+	for {
+		if _, err := io.ReadFull(c, buf[:1]); err != nil {
+			return
+		}
+		switch buf[0] {
+		case 0xA3, 0xA5:
+			c.Write([]byte{respAudioAck})
+		case 0xA0:
+			d.stoppedAt.Store(time.Now().UnixNano())
+			for len(d.queue) > 0 {
+				<-d.queue
+			}
+			c.Write([]byte{respAudioAck})
+			return
+		case 0xA4:
+			if _, err := io.ReadFull(c, buf[1:]); err != nil {
+				return
+			}
+			if !playing {
+				playing = true
+				go d.play(stop)
+			}
+			fed := true
+			select {
+			case d.queue <- struct{}{}:
+			default:
+				timer.Reset(pacerBenchFeedWait)
+				select {
+				case d.queue <- struct{}{}:
+					timer.Stop()
+				case <-timer.C:
+					fed = false
+					d.drops.Add(1)
+				}
+			}
+			if packets++; packets >= 10 || !fed {
+				c.Write([]byte{respAudioCredit, byte(cap(d.queue) - len(d.queue))})
+				packets = 0
+			}
+		}
+	}
+}
+
+// ==================== 播放协程（对应I2S按采样率消耗） ====================
+func (d *pacerBenchDevice) play(stop chan struct{}) {
+	ticker := time.NewTicker(d.interval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-stop:
+			return
+		case <-ticker.C:
+		}
+		if d.stoppedAt.Load() != 0 {
+			return
+		}
+		select {
+		case <-d.queue:
+			d.played.Add(1)
+		default:
+			d.underruns.Add(1)
+		}
+	}
+}
+
+type pacerBenchResult struct {
+	stopLatency time.Duration
+	stats       DeviceConnStats
+	played      int64 // 发送停止命令时已播放的块数
+	underruns   int64 // 发送停止命令前的欠载次数
+	drops       int64
+}
+
+// ==================== 单次运行 ====================
+func runPacerCase(lead time.Duration) (pacerBenchResult, error) {
+	var res pacerBenchResult
+	audioLeadDefault = lead
+
+	device, err := newPacerBenchDevice()
+	if err != nil {
+		return res, err
+	}
+	defer device.listener.Close()
+	conn, err := connManager.Connect(device.listener.Addr().String())
+	if err != nil {
+		return res, err
+	}
+	connManager.Send(nil, 0xA3, nil, controlEnqueueWait)
+
+	// 快于实时：一次性推入全部音频，队列满时等待
+	go func() {
+		payload := make([]byte, fanoutChunkBytes)
+		for seq := 0; seq < pacerBenchChunks; seq++ {
+			frame := newSharedFrame(0xA4, payload)
+			if connManager.SendFrame(nil, frame, audioEnqueueWait).Queued == 0 {
+				return
+			}
+		}
+		connManager.Send(nil, 0xA5, nil, controlEnqueueWait)
+	}()
+
+	time.Sleep(pacerBenchStopAfter)
+	res.stats = conn.Stats()
+	stopSent := time.Now()
+	res.played = device.played.Load()
+	res.underruns = device.underruns.Load()
+	connManager.Send(nil, 0xA0, nil, controlEnqueueWait)
+
+	select {
+	case <-device.done:
+	case <-time.After(15 * time.Second):
+		connManager.DisconnectAll()
+		return res, fmt.Errorf("stop command not delivered")
+	}
+	if at := device.stoppedAt.Load(); at != 0 {
+		res.stopLatency = time.Unix(0, at).Sub(stopSent)
+	}
+	res.drops = device.drops.Load()
+	connManager.DisconnectAll()
+	return res, nil
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runPacerBenchmark() {
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+	defer func(lead time.Duration) { audioLeadDefault = lead }(audioLeadDefault)
+
+	fmt.Println("Audio pacing benchmark (simulated device on loopback)")
+	fmt.Printf("%d chunks x %d bytes (%v of audio) pushed at once, stop after %v; device: %d slots, %d KB receive buffer\n\n",
+		pacerBenchChunks, fanoutChunkBytes,
+		(time.Second * fanoutChunkBytes / fanoutByteRate * pacerBenchChunks).Round(time.Millisecond),
+		pacerBenchStopAfter, deviceAudioSlots, pacerBenchRecvBuf/1024)
+	fmt.Printf("%-10s | %-7s | %-9s | %-12s | %-12s | %-11s | %-6s | %s\n",
+		"lead", "played", "underruns", "device drops", "stop latency", "send lead", "bursts", "stalls")
+
+	for _, lead := range []time.Duration{0, 40 * time.Millisecond, 120 * time.Millisecond} {
+		name := lead.String()
+		if lead == 0 {
+			name = "unpaced"
+		}
+		res, err := runPacerCase(lead)
+		if err != nil {
+			fmt.Printf("%-10s | failed: %v\n", name, err)
+			continue
+		}
+		sendLead := "-"
+		if lead > 0 {
+			sendLead = fmt.Sprintf("%.1fms", res.stats.SendLeadMs)
+		}
+		fmt.Printf("%-10s | %-7d | %-9d | %-12d | %-12v | %-11s | %-6d | %d\n",
+			name, res.played, res.underruns, res.drops, res.stopLatency.Round(time.Millisecond),
+			sendLead, res.stats.Bursts, res.stats.Stalls)
+	}
+	fmt.Println("\nplayed / underruns: counted up to the stop request (first 2s).")
+	fmt.Println("stop latency: time from the stop request until the device reads it, i.e. audio that keeps playing after stop.")
+}
@@ -0,0 +1,482 @@
+/***
+ * @file speak_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-21
+ * @brief 文本到首个可听采样的延迟基准（合成完再轮询下载 vs 流式合成直接播放）；每次播报的数据搬运（WAV文件 vs 管道PCM）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-21
+ * @filePath speak_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"context"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"path/filepath"
+	"runtime"
+	"strconv"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkSpeak$' -benchtime 1x [-tts-stub]
+//
+// 两条路径都使用同一个常驻合成进程，把文本变成模拟设备收到的第一个音频帧：
+//   poll:   原流程——/api/tts/synthesize 合成完整WAV，前端每秒轮询 /api/tts/status，
+//           完成后下载、整段解码再逐块发送。这里省略HTTP往返与浏览器解码，只保留
+//           完整合成 + 轮询等待 + 整段解码，是原流程延迟的下限；
+//   stream: /api/tts/speak——合成进程每个生成步的音频块立即重采样并发给设备。
+// 计时从提交文本开始，到设备读到第一个0xA4帧为止。
+// 占位模型（-tts-stub）按 speakBenchStubRTF 模拟生成耗时，每80ms输出一块，与VoxCPM流式输出的粒度一致。
+
+func BenchmarkSpeak(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runSpeakBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const (
+	speakBenchStubRTF  = 0.17 // README中RTX 4090下的实测实时率
+	speakBenchPollTick = time.Second
+)
+
+var speakBenchTexts = []string{
+	"已为您打开客厅的灯。",
+	"请注意，三号病房的呼叫铃已响起，请值班护士尽快前往处理，谢谢配合。",
+	"各位访客请注意，探视时间将于下午五点结束。请在离开前整理好随身物品，并在护士站登记离开时间。如需延长探视，请提前与主治医生沟通。感谢您的理解与配合，祝您的家人早日康复。",
+}
+
+type speakBenchResult struct {
+	firstAudio time.Duration
+	synth      time.Duration
+	audioSec   float64
+}
+
+// 模拟设备：复用上传基准的全速接收设备，首个音频帧到达时间即首个可听采样
+func runSpeakPath(speak func(text string) (TTSResult, error), text string) (speakBenchResult, error) {
+	var res speakBenchResult
+	device, err := newUploadSinkDevice()
+	if err != nil {
+		return res, err
+	}
+	defer device.listener.Close()
+	if _, err := connManager.Connect(device.listener.Addr().String()); err != nil {
+		return res, err
+	}
+	defer connManager.DisconnectAll()
+
+	start := time.Now()
+	synth, err := speak(text)
+	if err != nil {
+		return res, err
+	}
+	deadline := time.Now().Add(2 * time.Second)
+	for device.firstData.Load() == 0 && time.Now().Before(deadline) {
+		time.Sleep(time.Millisecond)
+	}
+	if at := device.firstData.Load(); at != 0 {
+		res.firstAudio = time.Unix(0, at).Sub(start)
+	}
+	res.synth = time.Duration(synth.SynthMs * float64(time.Millisecond))
+	res.audioSec = synth.AudioMs / 1000
+	return res, nil
+}
+
+// 原流程：完整合成写WAV，下一次轮询发现完成后读入整个文件、解码，再逐块发送
+func speakByPolling(w *TTSWorker, tmpDir string) func(string) (TTSResult, error) {
+	return func(text string) (TTSResult, error) {
+		start := time.Now()
+		output := filepath.Join(tmpDir, "poll.wav")
+		defer os.Remove(output)
+		res, err := w.Synthesize(context.Background(), text, TTSPrompt{}, "", output)
+		if err != nil {
+			return res, err
+		}
+		// setInterval从提交成功后开始计时，完成状态在合成结束后的下一个整秒被看到
+		elapsed := time.Since(start)
+		time.Sleep(speakBenchPollTick*(elapsed/speakBenchPollTick+1) - elapsed)
+
+		data, err := os.ReadFile(output)
+		if err != nil {
+			return res, err
+		}
+		src, _, err := newPCMStream(bytes.NewReader(data))
+		if err != nil {
+			return res, err
+		}
+		pcm, err := io.ReadAll(src)
+		src.Close()
+		if err != nil {
+			return res, err
+		}
+		_, err = relayPCM(nil, bytes.NewReader(pcm))
+		return res, err
+	}
+}
+
+func speakByStreaming(w *TTSWorker) func(string) (TTSResult, error) {
+	return func(text string) (TTSResult, error) {
+		synth := func(ctx context.Context, format ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error) {
+			return w.SynthesizeStream(ctx, text, TTSPrompt{}, "", format, onChunk)
+		}
+		res, err := speakText(context.Background(), synth, nil, nil)
+		return res.Synth, err
+	}
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runSpeakBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("speak benchmark:", err)
+		return
+	}
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(speakBenchStubRTF, 'f', -1, 64))
+	}
+	tmpDir, err := os.MkdirTemp("", "speak_bench")
+	if err != nil {
+		fmt.Println("speak benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(tmpDir)
+
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	w := NewTTSWorker(argv, dir)
+	w.Start()
+	defer w.Stop()
+	ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+	_, err = w.current(ctx)
+	cancel()
+	if err != nil {
+		fmt.Println("speak benchmark: worker failed to start:", err)
+		return
+	}
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = fmt.Sprintf("stub model at RTF %.2f (80ms chunks)", speakBenchStubRTF)
+	}
+	fmt.Printf("Text to first audible sample: %s, warm worker, loopback device\n\n", mode)
+	fmt.Printf("%-6s | %-6s | %-8s | %-10s | %s\n", "chars", "audio", "path", "synthesis", "first audio at device")
+
+	paths := []struct {
+		name  string
+		speak func(string) (TTSResult, error)
+	}{
+		{"poll", speakByPolling(w, tmpDir)},
+		{"stream", speakByStreaming(w)},
+	}
+	for _, text := range speakBenchTexts {
+		for _, p := range paths {
+			res, err := runSpeakPath(p.speak, text)
+			if err != nil {
+				fmt.Printf("%-6d | %-6s | %-8s | failed: %v\n", len([]rune(text)), "-", p.name, err)
+				continue
+			}
+			fmt.Printf("%-6d | %-6s | %-8s | %-10s | %s\n", len([]rune(text)),
+				fmt.Sprintf("%.1fs", res.audioSec), p.name, benchMs(res.synth), benchMs(res.firstAudio))
+		}
+	}
+	fmt.Println("\npoll omits HTTP round trips and browser decode, so it is a lower bound for the old flow.")
+}
+
+// ==================== 每次播报的数据搬运 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSPCM$' -benchtime 1x [-tts-stub]
+//
+// 三条路径把同一段文本播放到模拟设备（全速接收），统计每次播报：
+//   file:   合成进程写出完整WAV（原voxcpm_tts.py与下载流程），后端从磁盘读回、解码、重采样后转发；
+//   16k:    流式合成输出模型采样率单声道，后端重采样为设备格式后转发；
+//   device: 流式合成由合成进程直接输出设备格式，后端把读入的音频块复制进设备帧。
+// 管道字节为合成进程经标准输出送来的PCM；磁盘字节为写出与读回WAV之和；
+// Go复制为音频数据在后端用户态被复制的字节数，按各路径经过的缓冲区计（见pcmBenchCopies）；
+// 后端耗时与分配为后端处理这些音频的开销：按实际收到的音频块回放协议输出（file路径重新读取WAV文件），
+// 经读取协程、管道与（需要时的）解码重采样切成设备帧，不含合成与设备网络发送，取多次平均；
+// base64为旧协议把同样的PCM编码进JSON行的字节数。
+
+func BenchmarkTTSPCM(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSPCMBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const pcmBenchReplays = 20
+
+type pcmBenchUsage struct {
+	pipeBytes int64
+	diskBytes int64
+	wavBytes  int64 // file路径的WAV数据字节
+	devBytes  int64 // 转发给设备的PCM字节
+	chunks    []int // 流式路径收到的音频块大小
+	format    ttsPCMFormat
+	wavPath   string
+}
+
+// 音频数据在后端用户态被复制的字节数（read系统调用直接写入的缓冲区不计，协议行之后已缓冲的少量字节忽略）。
+// device：复用缓冲区 -> 设备帧（io.Pipe直接从写方复制到读方）；
+// 16k：复用缓冲区 -> 解码缓冲区，重采样写出，输出 -> 设备帧；
+// file：bufio -> 解码缓冲区，重采样写出，输出 -> 设备帧
+func pcmBenchCopies(path string, u pcmBenchUsage) int64 {
+	switch path {
+	case "device":
+		return u.devBytes
+	case "16k":
+		return u.pipeBytes + 2*u.devBytes
+	default:
+		return u.wavBytes + 2*u.devBytes
+	}
+}
+
+func pcmBenchFile(w *TTSWorker, tmpDir, text string, u *pcmBenchUsage) func(string) (TTSResult, error) {
+	return func(string) (TTSResult, error) {
+		u.wavPath = filepath.Join(tmpDir, "announcement.wav")
+		res, err := w.Synthesize(context.Background(), text, TTSPrompt{}, "", u.wavPath)
+		if err != nil {
+			return res, err
+		}
+		f, err := os.Open(u.wavPath)
+		if err != nil {
+			return res, err
+		}
+		defer f.Close()
+		if st, err := f.Stat(); err == nil {
+			u.diskBytes = 2 * st.Size()
+			u.wavBytes = st.Size() - 44
+		}
+		src, _, err := newPCMStream(f)
+		if err != nil {
+			return res, err
+		}
+		defer src.Close()
+		stats, err := relayPCM(nil, src)
+		u.devBytes = stats.PCMBytes
+		return res, err
+	}
+}
+
+func pcmBenchStream(w *TTSWorker, text string, format ttsPCMFormat, u *pcmBenchUsage) func(string) (TTSResult, error) {
+	return func(string) (TTSResult, error) {
+		synth := func(ctx context.Context, _ ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error) {
+			return w.SynthesizeStream(ctx, text, TTSPrompt{}, "", format, func(pcm []byte, f ttsPCMFormat) error {
+				u.chunks = append(u.chunks, len(pcm))
+				u.format = f
+				return onChunk(pcm, f)
+			})
+		}
+		res, err := speakText(context.Background(), synth, nil, nil)
+		u.pipeBytes = res.Synth.PCMBytes
+		u.devBytes = res.Relay.PCMBytes
+		return res.Synth, err
+	}
+}
+
+// ==================== 回放：后端处理一次播报的开销 ====================
+// 协议输出：每个音频块一行长度加PCM，最后是done
+func pcmBenchProtocol(chunks []int) []byte {
+	var b bytes.Buffer
+	for _, n := range chunks {
+		fmt.Fprintf(&b, "{\"id\": 1, \"event\": \"chunk\", \"bytes\": %d}\n", n)
+		b.Write(make([]byte, n))
+	}
+	b.WriteString("{\"id\": 1, \"event\": \"done\"}\n")
+	return b.Bytes()
+}
+
+// 按设备帧大小读完src（relayPCM去掉网络发送）
+func pcmBenchFrames(src io.Reader) error {
+	frame := make([]byte, pcmChunkBytes)
+	for {
+		if _, err := io.ReadFull(src, frame); err != nil {
+			if err == io.EOF || err == io.ErrUnexpectedEOF {
+				return nil
+			}
+			return err
+		}
+	}
+}
+
+// 读取协程解析协议输出，call把音频块交给与speakText相同的管道转发
+func pcmBenchReplayStream(data []byte, format ttsPCMFormat) error {
+	stdout, feed := io.Pipe()
+	p := &workerProc{
+		stdin:   pcmBenchStdin{func() { go func() { feed.Write(data); feed.Close() }() }},
+		pending: make(map[uint64]*pendingCall),
+		ready:   make(chan ttsWorkerEvent, 1),
+		exited:  make(chan struct{}),
+	}
+	go p.readLoop(stdout)
+
+	var pw *io.PipeWriter
+	relayDone := make(chan error, 1)
+	_, err := p.call(context.Background(), ttsWorkerRequest{ID: 1, Op: "synthesize_stream"}, func(ev ttsWorkerEvent) error {
+		if pw == nil {
+			var pr *io.PipeReader
+			pr, pw = io.Pipe()
+			go func() {
+				var src io.Reader = pr
+				if format != ttsDevicePCMFormat {
+					src = newRawPCMStream(pr, format.SampleRate, format.Channels, 16)
+				}
+				relayDone <- pcmBenchFrames(src)
+			}()
+		}
+		_, err := pw.Write(ev.PCM)
+		return err
+	})
+	if pw == nil {
+		return errors.New("no audio")
+	}
+	pw.Close()
+	return errors.Join(err, <-relayDone)
+}
+
+// 请求写入标准输入时开始输出
+type pcmBenchStdin struct{ start func() }
+
+func (s pcmBenchStdin) Write(p []byte) (int, error) {
+	s.start()
+	return len(p), nil
+}
+
+func (s pcmBenchStdin) Close() error { return nil }
+
+func pcmBenchReplayFile(path string) error {
+	f, err := os.Open(path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+	src, _, err := newPCMStream(f)
+	if err != nil {
+		return err
+	}
+	defer src.Close()
+	return pcmBenchFrames(src)
+}
+
+// 平均每次的耗时与堆分配
+func pcmBenchReplay(u pcmBenchUsage) (time.Duration, uint64, error) {
+	var data []byte
+	if u.wavPath == "" {
+		data = pcmBenchProtocol(u.chunks)
+	}
+	var before, after runtime.MemStats
+	runtime.GC()
+	runtime.ReadMemStats(&before)
+	start := time.Now()
+	for i := 0; i < pcmBenchReplays; i++ {
+		var err error
+		if u.wavPath != "" {
+			err = pcmBenchReplayFile(u.wavPath)
+		} else {
+			err = pcmBenchReplayStream(data, u.format)
+		}
+		if err != nil {
+			return 0, 0, err
+		}
+	}
+	elapsed := time.Since(start)
+	runtime.ReadMemStats(&after)
+	return elapsed / pcmBenchReplays, (after.TotalAlloc - before.TotalAlloc) / pcmBenchReplays, nil
+}
+
+// 旧协议：每个生成步（模型采样率单声道1280个采样）一行JSON，PCM经base64编码
+func pcmBenchBase64Bytes(nativeBytes int64) int64 {
+	const chunk = 2560
+	const overhead = len(`{"id": 1, "event": "chunk", "pcm": ""}` + "\n")
+	chunks := (nativeBytes + chunk - 1) / chunk
+	return (nativeBytes+2)/3*4 + chunks*int64(overhead)
+}
+
+func runTTSPCMBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts pcm benchmark:", err)
+		return
+	}
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(speakBenchStubRTF, 'f', -1, 64))
+	}
+	tmpDir, err := os.MkdirTemp("", "pcm_bench")
+	if err != nil {
+		fmt.Println("tts pcm benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(tmpDir)
+
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	w := NewTTSWorker(argv, dir)
+	w.Start()
+	defer w.Stop()
+	ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+	_, err = w.current(ctx)
+	cancel()
+	if err != nil {
+		fmt.Println("tts pcm benchmark: worker failed to start:", err)
+		return
+	}
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = fmt.Sprintf("stub model at RTF %.2f", speakBenchStubRTF)
+	}
+	fmt.Printf("Data moved per announcement: %s, warm worker, loopback device\n\n", mode)
+	fmt.Printf("%-6s | %-6s | %-6s | %-9s | %-9s | %-9s | %-9s | %-12s | %-13s | %s\n",
+		"chars", "audio", "path", "pipe", "base64", "disk", "Go copies", "backend time", "backend alloc", "first audio")
+
+	kb := func(n int64) string { return fmt.Sprintf("%.0f KB", float64(n)/1024) }
+	for _, text := range speakBenchTexts {
+		var native int64
+		for _, path := range []string{"file", "16k", "device"} {
+			var u pcmBenchUsage
+			var speak func(string) (TTSResult, error)
+			switch path {
+			case "file":
+				speak = pcmBenchFile(w, tmpDir, text, &u)
+			case "16k":
+				speak = pcmBenchStream(w, text, ttsPCMFormat{}, &u)
+			default:
+				speak = pcmBenchStream(w, text, ttsDevicePCMFormat, &u)
+			}
+			res, err := runSpeakPath(speak, text)
+			var work time.Duration
+			var alloc uint64
+			if err == nil {
+				work, alloc, err = pcmBenchReplay(u)
+			}
+			if u.wavPath != "" {
+				os.Remove(u.wavPath)
+			}
+			if err != nil {
+				fmt.Printf("%-6d | %-6s | %-6s | failed: %v\n", len([]rune(text)), "-", path, err)
+				continue
+			}
+			b64 := "-"
+			if path == "16k" {
+				native = u.pipeBytes
+			}
+			if path != "file" && native > 0 {
+				b64 = kb(pcmBenchBase64Bytes(native))
+			}
+			fmt.Printf("%-6d | %-6s | %-6s | %-9s | %-9s | %-9s | %-9s | %-12s | %-13s | %s\n", len([]rune(text)),
+				fmt.Sprintf("%.1fs", res.audioSec), path, kb(u.pipeBytes), b64, kb(u.diskBytes),
+				kb(pcmBenchCopies(path, u)), benchMs(work), kb(int64(alloc)), benchMs(res.firstAudio))
+		}
+	}
+	fmt.Println("\nbase64 = bytes the previous JSON/base64 chunk protocol would send for the same audio (16k mono);")
+	fmt.Println("backend time/alloc = replayed processing of the received audio down to device frames, without synthesis or network.")
+}
@@ -0,0 +1,877 @@
+/***
+ * @file tts_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-20
+ * @brief 语音合成基准测试（每请求一个进程 vs 常驻进程；任务队列优先级与并发；结果缓存；已注册音色；分句并行；批量解码）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-20
+ * @filePath tts_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"math/rand"
+	"mime/multipart"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strconv"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkTTS$' -benchtime 1x [-tts-requests 10] [-tts-stub]
+//
+// 冷启动：每个请求启动一个新进程，等待模型加载（及预热）后合成一次再退出，与原先每请求调用voxcpm_tts.py相同；
+// 常驻：一个进程先完成加载，之后依次处理全部请求。
+// 每个请求记录端到端延迟与首字节时间（从发起请求到输出WAV可读到第一个字节）。
+// 合成结果整段写出，首字节时间与完成时间接近；两者的差值主要是进程启动与模型加载。
+
+func BenchmarkTTS(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSBenchmark(*benchTTSRequests, *ttsWarmup, *ttsStub) })
+}
+
+var ttsBenchTexts = []string{
+	"欢迎使用智能音箱。",
+	"今天天气晴，最高气温二十三度。",
+	"请注意，会议将在五分钟后开始。",
+	"已为您打开客厅的灯。",
+}
+
+type ttsBenchSample struct {
+	total time.Duration
+	ttfb  time.Duration
+}
+
+// 等待文件出现并可读到数据；请求完成（done关闭）后不再等待
+func waitFirstByte(path string, start time.Time, done <-chan struct{}) time.Duration {
+	for {
+		if st, err := os.Stat(path); err == nil && st.Size() > 0 {
+			return time.Since(start)
+		}
+		select {
+		case <-done:
+			return time.Since(start)
+		case <-time.After(time.Millisecond):
+		}
+	}
+}
+
+func ttsBenchRequest(w *TTSWorker, text, output string) (ttsBenchSample, error) {
+	start := time.Now()
+	done := make(chan struct{})
+	ttfbCh := make(chan time.Duration, 1)
+	go func() { ttfbCh <- waitFirstByte(output, start, done) }()
+
+	_, err := w.Synthesize(context.Background(), text, TTSPrompt{}, "", output)
+	total := time.Since(start)
+	close(done)
+	ttfb := <-ttfbCh
+	os.Remove(output)
+	return ttsBenchSample{total: total, ttfb: minDuration(ttfb, total)}, err
+}
+
+func summarizeTTSBench(samples []ttsBenchSample) (p50, mean, ttfbP50 time.Duration) {
+	if len(samples) == 0 {
+		return
+	}
+	totals := make([]time.Duration, len(samples))
+	ttfbs := make([]time.Duration, len(samples))
+	var sum time.Duration
+	for i, s := range samples {
+		totals[i], ttfbs[i] = s.total, s.ttfb
+		sum += s.total
+	}
+	sort.Slice(totals, func(i, j int) bool { return totals[i] < totals[j] })
+	sort.Slice(ttfbs, func(i, j int) bool { return ttfbs[i] < ttfbs[j] })
+	return totals[len(totals)/2], sum / time.Duration(len(samples)), ttfbs[len(ttfbs)/2]
+}
+
+func benchMs(d time.Duration) string {
+	return fmt.Sprintf("%.2fms", float64(d)/1e6)
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runTTSBenchmark(n int, warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts benchmark:", err)
+		return
+	}
+	tmpDir, err := os.MkdirTemp("", "tts_bench")
+	if err != nil {
+		fmt.Println("tts benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(tmpDir)
+
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = "stub model (no weights loaded: measures process + IPC overhead only)"
+	}
+	fmt.Printf("TTS worker benchmark: %d requests, %s\n", n, mode)
+	fmt.Printf("command: %v\n\n", argv)
+
+	// 冷启动：每个请求一个进程
+	var cold []ttsBenchSample
+	var coldLoad, coldWarmup float64
+	for i := 0; i < n; i++ {
+		// 请求在进程启动后立即发起，计时包含解释器启动、导入与模型加载
+		w := NewTTSWorker(argv, dir)
+		w.Start()
+		out := filepath.Join(tmpDir, fmt.Sprintf("cold_%d.wav", i))
+		s, err := ttsBenchRequest(w, ttsBenchTexts[i%len(ttsBenchTexts)], out)
+		st := w.Stats()
+		w.Stop()
+		if err != nil {
+			fmt.Printf("cold request %d failed: %v\n", i, err)
+			return
+		}
+		cold = append(cold, s)
+		coldLoad += st.LoadMs
+		coldWarmup += st.WarmupMs
+	}
+
+	// 常驻：启动一次，等待就绪后计时
+	w := NewTTSWorker(argv, dir)
+	startupBegin := time.Now()
+	w.Start()
+	defer w.Stop()
+	ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+	_, err = w.current(ctx)
+	cancel()
+	if err != nil {
+		fmt.Println("warm worker failed to start:", err)
+		return
+	}
+	startup := time.Since(startupBegin)
+	var warm []ttsBenchSample
+	for i := 0; i < n; i++ {
+		out := filepath.Join(tmpDir, fmt.Sprintf("warm_%d.wav", i))
+		s, err := ttsBenchRequest(w, ttsBenchTexts[i%len(ttsBenchTexts)], out)
+		if err != nil {
+			fmt.Printf("warm request %d failed: %v\n", i, err)
+			return
+		}
+		warm = append(warm, s)
+	}
+	st := w.Stats()
+
+	fmt.Printf("%-6s | %-12s | %-12s | %-12s | %s\n", "mode", "p50 latency", "mean latency", "p50 TTFB", "per-request model load / warmup")
+	p50, mean, ttfb := summarizeTTSBench(cold)
+	fmt.Printf("%-6s | %-12s | %-12s | %-12s | %.0fms / %.0fms\n", "cold",
+		benchMs(p50), benchMs(mean), benchMs(ttfb), coldLoad/float64(n), coldWarmup/float64(n))
+	p50, mean, ttfb = summarizeTTSBench(warm)
+	fmt.Printf("%-6s | %-12s | %-12s | %-12s | 0ms / 0ms (paid once at startup)\n", "warm",
+		benchMs(p50), benchMs(mean), benchMs(ttfb))
+	fmt.Printf("\nwarm worker startup: %v (model load %.0fms, warmup %.0fms), restarts %d, failures %d\n",
+		startup.Round(time.Millisecond), st.LoadMs, st.WarmupMs, st.Restarts, st.Failures)
+	fmt.Println("cold latency includes interpreter start, imports and model load; TTFB = request start until the output WAV has its first byte.")
+}
+
+// ==================== 任务队列基准 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSQueue$' -benchtime 1x [-tts-stub]
+//
+// 一次提交20个合成任务（每5个中有1个报警），分别在不分优先级（全部按日常排队）与分优先级、
+// 1个与2个合成进程下运行，比较报警与日常任务的排队等待以及全部完成的总耗时。
+// 占位模型按speakBenchStubRTF模拟生成耗时。
+
+func BenchmarkTTSQueue(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSQueueBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const (
+	queueBenchJobs       = 20
+	queueBenchAlarmEvery = 5
+)
+
+type queueBenchResult struct {
+	alarmWait   []time.Duration
+	routineWait []time.Duration
+	makespan    time.Duration
+	stats       TTSQueueStats
+}
+
+func runQueueCase(argv []string, dir string, workers int, priorities bool) (queueBenchResult, error) {
+	var res queueBenchResult
+	runners := make([]*TTSWorker, workers)
+	for i := range runners {
+		runners[i] = NewTTSWorker(argv, dir)
+		runners[i].Start()
+		defer runners[i].Stop()
+	}
+	for _, w := range runners {
+		ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+		_, err := w.current(ctx)
+		cancel()
+		if err != nil {
+			return res, err
+		}
+	}
+	q := NewTTSJobQueue(runners, nil, false)
+	defer q.Close()
+
+	start := time.Now()
+	ids := make([]string, queueBenchJobs)
+	alarm := make([]bool, queueBenchJobs)
+	for i := range ids {
+		req := TTSJobRequest{Kind: "file", Priority: ttsPriorityRoutine, Text: ttsBenchTexts[1]}
+		alarm[i] = i%queueBenchAlarmEvery == queueBenchAlarmEvery-1
+		if alarm[i] && priorities {
+			req.Priority = ttsPriorityAlarm
+		}
+		job, err := q.Submit(req)
+		if err != nil {
+			return res, err
+		}
+		ids[i] = job.ID
+	}
+	for i, id := range ids {
+		job, err := q.Wait(context.Background(), id)
+		if err != nil {
+			return res, err
+		}
+		if job.Status != "completed" {
+			return res, fmt.Errorf("job %s %s: %s", id, job.Status, job.Error)
+		}
+		wait := time.Duration(job.QueueWaitMs * float64(time.Millisecond))
+		if alarm[i] {
+			res.alarmWait = append(res.alarmWait, wait)
+		} else {
+			res.routineWait = append(res.routineWait, wait)
+		}
+	}
+	res.makespan = time.Since(start)
+	res.stats = q.Stats()
+	return res, nil
+}
+
+func meanMax(ds []time.Duration) (mean, max time.Duration) {
+	for _, d := range ds {
+		mean += d
+		if d > max {
+			max = d
+		}
+	}
+	if len(ds) > 0 {
+		mean /= time.Duration(len(ds))
+	}
+	return
+}
+
+func p95Bucket(s latencySummary) string {
+	if s.Count == 0 {
+		return "-"
+	}
+	return fmt.Sprintf("<=%gms", s.P95Ms)
+}
+
+func runTTSQueueBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts queue benchmark:", err)
+		return
+	}
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(speakBenchStubRTF, 'f', -1, 64))
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = fmt.Sprintf("stub model at RTF %.2f", speakBenchStubRTF)
+	}
+	fmt.Printf("TTS job queue: %d jobs submitted at once, every %dth is an alarm, %s\n\n",
+		queueBenchJobs, queueBenchAlarmEvery, mode)
+	fmt.Printf("%-7s | %-10s | %-12s | %-12s | %-14s | %-10s | %s\n",
+		"workers", "ordering", "alarm wait", "alarm max", "routine wait", "makespan", "histogram p95 (alarm/routine)")
+	for _, workers := range []int{1, 2} {
+		for _, priorities := range []bool{false, true} {
+			ordering := "fifo"
+			if priorities {
+				ordering = "priority"
+			}
+			res, err := runQueueCase(argv, dir, workers, priorities)
+			if err != nil {
+				fmt.Printf("%-7d | %-10s | failed: %v\n", workers, ordering, err)
+				continue
+			}
+			alarmMean, alarmMax := meanMax(res.alarmWait)
+			routineMean, _ := meanMax(res.routineWait)
+			// fifo下报警任务按日常优先级提交，直方图全部记在routine
+			fmt.Printf("%-7d | %-10s | %-12s | %-12s | %-14s | %-10s | %s / %s\n", workers, ordering,
+				benchMs(alarmMean), benchMs(alarmMax), benchMs(routineMean), benchMs(res.makespan),
+				p95Bucket(res.stats.Wait["alarm"]), p95Bucket(res.stats.Wait["routine"]))
+		}
+	}
+	fmt.Println("\nwait = submission until a worker starts the job; wait columns are means over the job class.")
+}
+
+// ==================== 合成缓存基准 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSCache$' -benchtime 1x [-tts-stub]
+//
+// 40个合成任务依次提交并等待，文本从8条常用广播中按Zipf分布抽取（固定种子，重复的通知占多数），
+// 分别在不缓存与缓存下运行，比较每个任务的执行耗时与总耗时；
+// 再对同一条通知各执行一次speak任务（未命中、命中），比较首帧到达模拟设备的延迟。
+
+func BenchmarkTTSCache(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSCacheBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const cacheBenchJobs = 40
+
+var cacheBenchTexts = []string{
+	"请回到病床上休息，谢谢配合。",
+	"现在是服药时间，请按医嘱服药。",
+	"探视时间已结束，请访客有序离开。",
+	"请注意，三号病房的呼叫铃已响起，请值班护士尽快前往处理。",
+	"午餐已送达，请需要协助的患者按呼叫铃。",
+	"请保持病区安静，手机调至静音。",
+	"夜间巡查开始，请关闭不必要的照明。",
+	"各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品，并在护士站登记离开时间。",
+}
+
+type cacheBenchResult struct {
+	service  []time.Duration
+	cached   int
+	makespan time.Duration
+}
+
+func runCacheCase(w *TTSWorker, cache *TTSCache, texts []string) (cacheBenchResult, error) {
+	var res cacheBenchResult
+	q := NewTTSJobQueue([]*TTSWorker{w}, cache, false)
+	defer q.Close()
+	start := time.Now()
+	for _, text := range texts {
+		job, err := q.Submit(TTSJobRequest{Kind: "file", Priority: ttsPriorityRoutine, Text: text})
+		if err != nil {
+			return res, err
+		}
+		if job, err = q.Wait(context.Background(), job.ID); err != nil {
+			return res, err
+		}
+		if job.Status != "completed" {
+			return res, fmt.Errorf("job %s %s: %s", job.ID, job.Status, job.Error)
+		}
+		res.service = append(res.service, time.Duration(job.ServiceMs*float64(time.Millisecond)))
+		if job.Cached {
+			res.cached++
+		}
+	}
+	res.makespan = time.Since(start)
+	return res, nil
+}
+
+func runTTSCacheBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts cache benchmark:", err)
+		return
+	}
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(speakBenchStubRTF, 'f', -1, 64))
+	}
+	cacheDir, err := os.MkdirTemp("", "tts_cache_bench")
+	if err != nil {
+		fmt.Println("tts cache benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(cacheDir)
+
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	w := NewTTSWorker(argv, dir)
+	w.Start()
+	defer w.Stop()
+	ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+	_, err = w.current(ctx)
+	cancel()
+	if err != nil {
+		fmt.Println("tts cache benchmark: worker failed to start:", err)
+		return
+	}
+
+	rng := rand.New(rand.NewSource(1))
+	zipf := rand.NewZipf(rng, 1.2, 1, uint64(len(cacheBenchTexts)-1))
+	texts := make([]string, cacheBenchJobs)
+	for i := range texts {
+		texts[i] = cacheBenchTexts[zipf.Uint64()]
+	}
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = fmt.Sprintf("stub model at RTF %.2f", speakBenchStubRTF)
+	}
+	fmt.Printf("TTS result cache: %d file jobs drawn from %d announcements (Zipf), %s\n\n",
+		cacheBenchJobs, len(cacheBenchTexts), mode)
+	fmt.Printf("%-8s | %-9s | %-13s | %-13s | %s\n", "cache", "hit ratio", "mean service", "p50 service", "total")
+
+	var cache *TTSCache
+	for _, enabled := range []bool{false, true} {
+		name := "off"
+		cache = nil
+		if enabled {
+			name = "on"
+			if cache, err = NewTTSCache(cacheDir, 64<<20); err != nil {
+				fmt.Println("tts cache benchmark:", err)
+				return
+			}
+		}
+		res, err := runCacheCase(w, cache, texts)
+		if err != nil {
+			fmt.Printf("%-8s | failed: %v\n", name, err)
+			continue
+		}
+		mean, _ := meanMax(res.service)
+		sort.Slice(res.service, func(i, j int) bool { return res.service[i] < res.service[j] })
+		fmt.Printf("%-8s | %-9s | %-13s | %-13s | %s\n", name,
+			fmt.Sprintf("%d/%d", res.cached, len(texts)), benchMs(mean), benchMs(res.service[len(res.service)/2]), benchMs(res.makespan))
+	}
+	if cache == nil {
+		return
+	}
+	for kind, s := range cache.Stats().Kinds {
+		fmt.Printf("\n%s jobs: hit mean %.2fms, miss mean %.2fms, estimated saved %.0fms over %d hits\n",
+			kind, s.HitMeanMs, s.MissMeanMs, s.SavedMs, s.Hits)
+	}
+
+	// speak：同一条通知先未命中再命中，首帧到达模拟设备的延迟
+	q := NewTTSJobQueue([]*TTSWorker{w}, cache, false)
+	defer q.Close()
+	speak := func(text string) (TTSResult, error) {
+		job, err := q.Submit(TTSJobRequest{Kind: "speak", Priority: ttsPriorityAlarm, Text: text})
+		if err != nil {
+			return TTSResult{}, err
+		}
+		job, err = q.Wait(context.Background(), job.ID)
+		if err == nil && job.Status != "completed" {
+			err = fmt.Errorf("job %s %s: %s", job.ID, job.Status, job.Error)
+		}
+		return TTSResult{AudioMs: job.AudioMs}, err
+	}
+	text := "请注意，二号手术室需要麻醉科医生支援。"
+	fmt.Printf("\nspeak %q (%d chars), text to first audio at device:\n", text, len([]rune(text)))
+	for _, name := range []string{"miss", "hit"} {
+		res, err := runSpeakPath(speak, text)
+		if err != nil {
+			fmt.Printf("  %-4s failed: %v\n", name, err)
+			continue
+		}
+		fmt.Printf("  %-4s %s\n", name, benchMs(res.firstAudio))
+	}
+	fmt.Println("\nservice = job start until the result WAV is ready; hits are served without entering the queue.")
+}
+
+// ==================== 已注册音色基准 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSVoice$' -benchtime 1x [-tts-stub]
+//
+// 经HTTP接口（进程内httptest）提交克隆音色的合成任务并等待完成，比较两种方式：
+//   upload: 每个请求上传10秒44.1kHz立体声参考音频（prompt_audio），合成进程每次编码；
+//   voice:  参考音频注册一次，请求只带voice=ID，提示缓存已在进程内存中。
+// 记录请求体大小、端到端延迟与合成进程报告的取得提示缓存耗时（prompt_ms）。
+// 不使用结果缓存，占位模型不模拟生成耗时（RTF 0），差值即每请求的参考音色开销。
+// 占位模型只读取参考音频，不做audio VAE编码，真实模型的prompt_ms差值会大得多。
+
+func BenchmarkTTSVoice(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSVoiceBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const (
+	voiceBenchRequests = 10
+	voiceBenchSeconds  = 10
+)
+
+func voiceBenchForm(fields map[string]string, audio io.Reader) (*bytes.Buffer, string, error) {
+	var body bytes.Buffer
+	mw := multipart.NewWriter(&body)
+	for k, v := range fields {
+		mw.WriteField(k, v)
+	}
+	if audio != nil {
+		part, err := mw.CreateFormFile("prompt_audio", "reference.wav")
+		if err != nil {
+			return nil, "", err
+		}
+		if _, err := io.Copy(part, audio); err != nil {
+			return nil, "", err
+		}
+	}
+	mw.Close()
+	return &body, mw.FormDataContentType(), nil
+}
+
+func voiceBenchPost(url string, body *bytes.Buffer, contentType string) (Response, error) {
+	var res Response
+	resp, err := http.Post(url, contentType, body)
+	if err != nil {
+		return res, err
+	}
+	defer resp.Body.Close()
+	if err := json.NewDecoder(resp.Body).Decode(&res); err != nil {
+		return res, err
+	}
+	if !res.Success {
+		return res, errors.New(res.Message)
+	}
+	return res, nil
+}
+
+func runTTSVoiceBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts voice benchmark:", err)
+		return
+	}
+	voiceDir, err := os.MkdirTemp("", "tts_voice_bench")
+	if err != nil {
+		fmt.Println("tts voice benchmark:", err)
+		return
+	}
+	defer os.RemoveAll(voiceDir)
+
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	w := NewTTSWorker(argv, dir)
+	w.Start()
+	defer w.Stop()
+	ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+	_, err = w.current(ctx)
+	cancel()
+	if err != nil {
+		fmt.Println("tts voice benchmark: worker failed to start:", err)
+		return
+	}
+	ttsJobs = NewTTSJobQueue([]*TTSWorker{w}, nil, false)
+	defer ttsJobs.Close()
+	if ttsVoices, err = NewVoiceRegistry(voiceDir); err != nil {
+		fmt.Println("tts voice benchmark:", err)
+		return
+	}
+
+	mux := http.NewServeMux()
+	mux.HandleFunc("/api/tts/synthesize", handleTTSSynthesize)
+	mux.HandleFunc("/api/tts/voices", handleTTSVoices)
+	srv := httptest.NewServer(mux)
+	defer srv.Close()
+
+	var reference bytes.Buffer
+	io.Copy(&reference, newWAVGenerator(voiceBenchSeconds, defaultSampleRate))
+	promptText := "这是一段用于音色克隆的参考录音。"
+
+	body, ct, _ := voiceBenchForm(map[string]string{"name": "bench", "prompt_text": promptText}, bytes.NewReader(reference.Bytes()))
+	regStart := time.Now()
+	res, err := voiceBenchPost(srv.URL+"/api/tts/voices", body, ct)
+	if err != nil {
+		fmt.Println("tts voice benchmark: register failed:", err)
+		return
+	}
+	registerTime := time.Since(regStart)
+	voice, _ := res.Data.(map[string]interface{})
+	voiceID, _ := voice["id"].(string)
+
+	mode := "VoxCPM model"
+	if stub {
+		mode = "stub model (reads the reference audio, no VAE encoding)"
+	}
+	fmt.Printf("Cloned-voice synthesis over HTTP: %d requests per path, %ds 44.1kHz stereo reference (%d bytes), %s\n",
+		voiceBenchRequests, voiceBenchSeconds, reference.Len(), mode)
+	fmt.Printf("voice registration (upload + encode + persist, once): %s\n\n", benchMs(registerTime))
+	fmt.Printf("%-7s | %-13s | %-13s | %-13s | %s\n", "path", "request body", "mean latency", "p50 latency", "mean prompt_ms")
+
+	paths := []struct {
+		name  string
+		build func() (*bytes.Buffer, string, error)
+	}{
+		{"upload", func() (*bytes.Buffer, string, error) {
+			return voiceBenchForm(map[string]string{"text": ttsBenchTexts[0], "prompt_text": promptText}, bytes.NewReader(reference.Bytes()))
+		}},
+		{"voice", func() (*bytes.Buffer, string, error) {
+			return voiceBenchForm(map[string]string{"text": ttsBenchTexts[0], "voice": voiceID}, nil)
+		}},
+	}
+	for _, p := range paths {
+		var latencies []time.Duration
+		var promptMs float64
+		var bodyBytes int
+		for i := 0; i < voiceBenchRequests; i++ {
+			body, ct, err := p.build()
+			if err != nil {
+				fmt.Printf("%-7s | failed: %v\n", p.name, err)
+				return
+			}
+			bodyBytes = body.Len()
+			start := time.Now()
+			res, err := voiceBenchPost(srv.URL+"/api/tts/synthesize", body, ct)
+			if err != nil {
+				fmt.Printf("%-7s | failed: %v\n", p.name, err)
+				return
+			}
+			data, _ := res.Data.(map[string]interface{})
+			id, _ := data["id"].(string)
+			job, err := ttsJobs.Wait(context.Background(), id)
+			if err == nil && job.Status != "completed" {
+				err = fmt.Errorf("job %s %s: %s", id, job.Status, job.Error)
+			}
+			if err != nil {
+				fmt.Printf("%-7s | failed: %v\n", p.name, err)
+				return
+			}
+			latencies = append(latencies, time.Since(start))
+			promptMs += job.PromptMs
+		}
+		mean, _ := meanMax(latencies)
+		sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+		fmt.Printf("%-7s | %-13s | %-13s | %-13s | %.2fms\n", p.name, fmt.Sprintf("%d B", bodyBytes),
+			benchMs(mean), benchMs(latencies[len(latencies)/2]), promptMs/voiceBenchRequests)
+	}
+	fmt.Println("\nlatency = POST /api/tts/synthesize until the job completed; prompt_ms = worker time to obtain the prompt cache.")
+}
+
+// ==================== 分句并行合成基准 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSSentences$' -benchtime 1x [-tts-stub]（真实模型只用CPU时加 CUDA_VISIBLE_DEVICES=）
+//
+// 短、中、长三段文本依次作为file任务提交，分别整段合成（1个进程）与分句合成（1、2、4个进程），
+// 记录首个音频块写入结果的延迟与实时率（执行耗时/音频时长）。
+// 占位模型按sentenceBenchStubRTF模拟CPU推理：sleep模式相当于每个进程独占一个核；
+// cpu模式（--stub-cpu）空转占用CPU，进程数超过本机核数时互相争用，反映本机的实际上限。
+
+func BenchmarkTTSSentences(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSSentenceBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const sentenceBenchStubRTF = 1.0 // 假设的CPU推理实时率
+
+var sentenceBenchTexts = []string{
+	"请注意，会议将在五分钟后开始。",
+	"各位访客请注意，探视时间将于下午五点结束。请在离开前整理好随身物品。如需延长探视，请提前与主治医生沟通。",
+	"各位旅客请注意，由本站开往上海虹桥的列车即将进站。请在黄色安全线以内排队候车，先下后上。" +
+		"携带大件行李的旅客请使用车厢两端的行李架。列车停靠时间为两分钟，请抓紧时间上车。" +
+		"车厢内禁止吸烟，如有需要请联系列车工作人员。感谢您的配合，祝您旅途愉快。",
+}
+
+type sentenceBenchRow struct {
+	firstAudio time.Duration
+	service    time.Duration
+	audioMs    float64
+	sentences  int
+}
+
+func runSentenceCase(runners []*TTSWorker, split bool, text string) (sentenceBenchRow, error) {
+	q := NewTTSJobQueue(runners, nil, split)
+	defer q.Close()
+	job, err := q.Submit(TTSJobRequest{Kind: "file", Priority: ttsPriorityRoutine, Text: text})
+	if err != nil {
+		return sentenceBenchRow{}, err
+	}
+	info, err := q.Wait(context.Background(), job.ID)
+	if err == nil && info.Status != "completed" {
+		err = fmt.Errorf("job %s %s: %s", info.ID, info.Status, info.Error)
+	}
+	if err != nil {
+		return sentenceBenchRow{}, err
+	}
+	if path, err := q.ResultPath(info.ID); err == nil {
+		os.Remove(path)
+	}
+	return sentenceBenchRow{
+		firstAudio: time.Duration(info.FirstAudioMs * float64(time.Millisecond)),
+		service:    time.Duration(info.ServiceMs * float64(time.Millisecond)),
+		audioMs:    info.AudioMs,
+		sentences:  max(info.Sentences, 1),
+	}, nil
+}
+
+func runTTSSentenceBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts sentence benchmark:", err)
+		return
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	type benchMode struct {
+		name string
+		argv []string
+	}
+	modes := []benchMode{{"VoxCPM model", argv}}
+	if stub {
+		rtf := strconv.FormatFloat(sentenceBenchStubRTF, 'f', -1, 64)
+		modes = []benchMode{
+			{fmt.Sprintf("stub model at RTF %.2f, sleep (one core per worker)", sentenceBenchStubRTF),
+				append(append([]string(nil), argv...), "--stub-rtf", rtf)},
+			{fmt.Sprintf("stub model at RTF %.2f, busy CPU (%d core(s) on this machine)", sentenceBenchStubRTF, runtime.NumCPU()),
+				append(append([]string(nil), argv...), "--stub-rtf", rtf, "--stub-cpu")},
+		}
+	}
+
+	for _, mode := range modes {
+		fmt.Printf("Whole-text vs sentence-parallel synthesis, %s\n\n", mode.name)
+		fmt.Printf("%-7s | %-9s | %-6s | %-9s | %-9s | %-11s | %-11s | %s\n",
+			"workers", "mode", "chars", "sentences", "audio", "first audio", "service", "RTF")
+		for _, workers := range []int{1, 2, 4} {
+			runners, err := startTTSWorkers(mode.argv, dir, workers)
+			if err != nil {
+				fmt.Printf("%-7d | failed to start workers: %v\n", workers, err)
+				continue
+			}
+			splits := []bool{true}
+			if workers == 1 {
+				splits = []bool{false, true}
+			}
+			for _, split := range splits {
+				name := "whole"
+				if split {
+					name = "sentences"
+				}
+				for _, text := range sentenceBenchTexts {
+					row, err := runSentenceCase(runners, split, text)
+					if err != nil {
+						fmt.Printf("%-7d | %-9s | failed: %v\n", workers, name, err)
+						continue
+					}
+					fmt.Printf("%-7d | %-9s | %-6d | %-9d | %-9s | %-11s | %-11s | %.2f\n", workers, name,
+						len([]rune(text)), row.sentences, fmt.Sprintf("%.1fs", row.audioMs/1000),
+						benchMs(row.firstAudio), benchMs(row.service), float64(row.service)/float64(time.Millisecond)/row.audioMs)
+				}
+			}
+			stopTTSWorkers(runners)
+		}
+		fmt.Println()
+	}
+	fmt.Println("first audio = job start until the first chunk is written; RTF = service time / audio duration.")
+}
+
+// ==================== 批量解码基准 ====================
+// 用法：go test -run '^$' -bench '^BenchmarkTTSBatch$' -benchtime 1x [-tts-stub]（真实模型只用CPU时加 CUDA_VISIBLE_DEVICES=）
+//
+// 同一个进程上同时发起1、4、8个流式合成，对比逐个解码（batch 1，请求排队串行）与批量解码（batch 8），
+// 记录每个请求从发起到首个音频块、到结束的延迟，以及吞吐（合成的音频秒数/墙钟秒数）。
+// 占位模型按batchBenchStubRTF模拟单个请求的生成耗时，批量时每多一个请求一步耗时增加batchBenchStubCost倍
+// （假设值：CPU上单步以读取权重与小算子的固定开销为主），只反映调度与协议开销，不代表真实模型的批量收益。
+
+func BenchmarkTTSBatch(b *testing.B) {
+	skipWithoutTTSWorker(b, *ttsStub)
+	runBenchOnce(b, func() { runTTSBatchBenchmark(*ttsWarmup, *ttsStub) })
+}
+
+const (
+	batchBenchStubRTF  = 1.0
+	batchBenchStubCost = 0.3
+	batchBenchMax      = 8
+)
+
+const batchBenchText = "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。"
+
+type batchBenchRow struct {
+	first, latency []time.Duration
+	audioMs        float64
+	wall           time.Duration
+}
+
+func runBatchCase(w *TTSWorker, concurrency int) (batchBenchRow, error) {
+	row := batchBenchRow{first: make([]time.Duration, concurrency), latency: make([]time.Duration, concurrency)}
+	audio := make([]float64, concurrency)
+	errs := make([]error, concurrency)
+	start := time.Now()
+	done := make(chan int, concurrency)
+	for i := 0; i < concurrency; i++ {
+		go func(i int) {
+			defer func() { done <- i }()
+			res, err := w.SynthesizeStream(context.Background(), batchBenchText, TTSPrompt{}, "", ttsPCMFormat{}, func(pcm []byte, format ttsPCMFormat) error {
+				if row.first[i] == 0 {
+					row.first[i] = time.Since(start)
+				}
+				return nil
+			})
+			row.latency[i], audio[i], errs[i] = time.Since(start), res.AudioMs, err
+		}(i)
+	}
+	for i := 0; i < concurrency; i++ {
+		<-done
+	}
+	row.wall = time.Since(start)
+	if err := errors.Join(errs...); err != nil {
+		return row, err
+	}
+	for _, ms := range audio {
+		row.audioMs += ms
+	}
+	return row, nil
+}
+
+func runTTSBatchBenchmark(warmup string, stub bool) {
+	argv, dir, err := voxcpmWorkerCommand(warmup, stub)
+	if err != nil {
+		fmt.Println("tts batch benchmark:", err)
+		return
+	}
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+
+	mode := "VoxCPM model"
+	if stub {
+		argv = append(argv, "--stub-rtf", strconv.FormatFloat(batchBenchStubRTF, 'f', -1, 64),
+			"--stub-batch-cost", strconv.FormatFloat(batchBenchStubCost, 'f', -1, 64))
+		mode = fmt.Sprintf("stub model at RTF %.2f, each extra row adds %.0f%% to a step (assumed)",
+			batchBenchStubRTF, batchBenchStubCost*100)
+	}
+	fmt.Printf("Sequential vs batched streaming decoding in one worker, %s\n\n", mode)
+	fmt.Printf("%-5s | %-11s | %-23s | %-23s | %s\n", "batch", "concurrency", "first chunk mean / max",
+		"latency mean / max", "throughput")
+	for _, batch := range []int{1, batchBenchMax} {
+		w := NewBatchedTTSWorker(argv, dir, batch)
+		w.Start()
+		ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+		_, err := w.current(ctx)
+		cancel()
+		if err != nil {
+			fmt.Printf("%-5d | failed to start worker: %v\n", batch, err)
+			w.Stop()
+			continue
+		}
+		for _, concurrency := range []int{1, 4, 8} {
+			row, err := runBatchCase(w, concurrency)
+			if err != nil {
+				fmt.Printf("%-5d | %-11d | failed: %v\n", batch, concurrency, err)
+				continue
+			}
+			firstMean, firstMax := meanMax(row.first)
+			latMean, latMax := meanMax(row.latency)
+			fmt.Printf("%-5d | %-11d | %-23s | %-23s | %.2f audio s/s\n", batch, concurrency,
+				benchMs(firstMean)+" / "+benchMs(firstMax), benchMs(latMean)+" / "+benchMs(latMax),
+				row.audioMs/1000/row.wall.Seconds())
+		}
+		w.Stop()
+	}
+	fmt.Println("\nfirst chunk / latency = from sending the requests together until each request's first chunk / its end;")
+	fmt.Println("throughput = audio seconds of all requests / wall seconds.")
+}
@@ -0,0 +1,428 @@
+/***
+ * @file tts_cache.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-23
+ * @brief 语音合成结果缓存（内容寻址、磁盘LRU、原子写入，存储设备播放格式）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-23
+ * @filePath tts_cache.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"container/list"
+	"context"
+	"crypto/sha256"
+	"encoding/binary"
+	"encoding/hex"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// ==================== 缓存格式 ====================
+// 每个条目是一个44.1kHz立体声16位WAV（与0xA4帧的PCM格式相同），文件名为键的十六进制。
+// 命中时speak任务跳过44字节头直接按帧转发，file任务把条目硬链接为下载结果。
+// 写入先落到同目录的临时文件，同步后rename，进程崩溃不会留下半个条目。
+// 访问时更新文件修改时间，重启后按修改时间恢复LRU顺序。
+const (
+	ttsCacheEntryExt  = ".wav"
+	ttsCacheTempExt   = ".tmp"
+	ttsCacheHeaderLen = 44
+)
+
+type ttsCacheEntry struct {
+	key  string
+	size int64
+	elem *list.Element
+}
+
+// 按任务类型统计：命中与未命中的延迟（speak为首帧进入设备队列，file为执行耗时）
+type ttsCacheKindStats struct {
+	hits, misses        uint64
+	hitTotal, missTotal time.Duration
+}
+
+type TTSCache struct {
+	dir      string
+	maxBytes int64
+
+	mu        sync.Mutex
+	entries   map[string]*ttsCacheEntry
+	lru       *list.List // 队首为最近使用
+	bytes     int64
+	stores    uint64
+	evictions uint64
+	kinds     map[string]*ttsCacheKindStats
+}
+
+// ==================== 打开缓存目录 ====================
+// 清理上次遗留的临时文件，按修改时间恢复已有条目，超出上限时淘汰最旧的
+func NewTTSCache(dir string, maxBytes int64) (*TTSCache, error) {
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		return nil, err
+	}
+	c := &TTSCache{
+		dir:      dir,
+		maxBytes: maxBytes,
+		entries:  make(map[string]*ttsCacheEntry),
+		lru:      list.New(),
+		kinds:    make(map[string]*ttsCacheKindStats),
+	}
+
+	files, err := os.ReadDir(dir)
+	if err != nil {
+		return nil, err
+	}
+	type found struct {
+		key     string
+		size    int64
+		modTime time.Time
+	}
+	var existing []found
+	for _, f := range files {
+		name := f.Name()
+		if strings.HasSuffix(name, ttsCacheTempExt) {
+			os.Remove(filepath.Join(dir, name))
+			continue
+		}
+		key, ok := strings.CutSuffix(name, ttsCacheEntryExt)
+		if !ok || f.IsDir() {
+			continue
+		}
+		info, err := f.Info()
+		if err != nil {
+			continue
+		}
+		existing = append(existing, found{key, info.Size(), info.ModTime()})
+	}
+	sort.Slice(existing, func(i, j int) bool { return existing[i].modTime.After(existing[j].modTime) })
+	for _, e := range existing {
+		entry := &ttsCacheEntry{key: e.key, size: e.size}
+		entry.elem = c.lru.PushBack(entry)
+		c.entries[e.key] = entry
+		c.bytes += e.size
+	}
+	c.evictLocked()
+	log.Printf("TTS cache: %s, %d entries, %.1f MB (limit %.0f MB)",
+		dir, len(c.entries), float64(c.bytes)/(1<<20), float64(maxBytes)/(1<<20))
+	return c, nil
+}
+
+// ==================== 缓存键 ====================
+// 模型版本、合成参数、文本、参考文本与参考音频内容（而非上传的临时文件名）的SHA-256，
+// 各字段带长度前缀，避免拼接歧义。已注册音色使用注册时计算的参考音频摘要
+func ttsCacheKey(modelVersion, text, profile string, prompt TTSPrompt) (string, error) {
+	h := sha256.New()
+	field := func(s string) {
+		var n [8]byte
+		binary.LittleEndian.PutUint64(n[:], uint64(len(s)))
+		h.Write(n[:])
+		io.WriteString(h, s)
+	}
+	field(modelVersion)
+	field(strconv.FormatFloat(ttsCfgValue, 'g', -1, 64))
+	field(strconv.Itoa(ttsInferenceTimesteps))
+	field(text)
+	switch {
+	case prompt.Voice != nil:
+		field(prompt.Voice.PromptText)
+		digest, err := hex.DecodeString(prompt.Voice.SHA256)
+		if err != nil {
+			return "", err
+		}
+		field(string(digest))
+	case prompt.Wav != "":
+		field(prompt.Text)
+		f, err := os.Open(prompt.Wav)
+		if err != nil {
+			return "", err
+		}
+		defer f.Close()
+		ph := sha256.New()
+		if _, err := io.Copy(ph, f); err != nil {
+			return "", err
+		}
+		field(string(ph.Sum(nil)))
+	default:
+		field("")
+		field("")
+	}
+	// 原有解码不加字段，已有的缓存条目仍然有效
+	if profile != "" && profile != "quality" {
+		field(profile)
+	}
+	return hex.EncodeToString(h.Sum(nil)), nil
+}
+
+func (c *TTSCache) path(key string) string {
+	return filepath.Join(c.dir, key+ttsCacheEntryExt)
+}
+
+// ==================== 查找 ====================
+// 命中时返回已打开的条目（读位置在文件头），并把条目移到LRU队首。
+// 条目之后被淘汰也不影响已打开的文件
+func (c *TTSCache) Open(key string) *os.File {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	entry := c.entries[key]
+	if entry == nil {
+		return nil
+	}
+	f, err := os.Open(c.path(key))
+	if err != nil {
+		// 文件被外部删除
+		c.removeLocked(entry)
+		return nil
+	}
+	c.lru.MoveToFront(entry.elem)
+	now := time.Now()
+	os.Chtimes(f.Name(), now, now)
+	return f
+}
+
+// ==================== 写入 ====================
+// 写入设备格式PCM，Commit时回填WAV头、同步并rename为正式条目；Abort丢弃
+type ttsCacheWriter struct {
+	c   *TTSCache
+	key string
+	wav *wavFileWriter
+}
+
+func (c *TTSCache) Create(key string) (*ttsCacheWriter, error) {
+	tmp, err := os.CreateTemp(c.dir, key+"-*"+ttsCacheTempExt)
+	if err != nil {
+		return nil, err
+	}
+	tmp.Close()
+	wav, err := createWAVFile(tmp.Name(), defaultSampleRate, defaultChannels)
+	if err != nil {
+		os.Remove(tmp.Name())
+		return nil, err
+	}
+	return &ttsCacheWriter{c: c, key: key, wav: wav}, nil
+}
+
+func (w *ttsCacheWriter) Write(p []byte) (int, error) {
+	if err := w.wav.write(p); err != nil {
+		return 0, err
+	}
+	return len(p), nil
+}
+
+func (w *ttsCacheWriter) Abort() {
+	w.wav.f.Close()
+	os.Remove(w.wav.f.Name())
+}
+
+func (w *ttsCacheWriter) Commit() error {
+	tmp := w.wav.f.Name()
+	size := ttsCacheHeaderLen + w.wav.dataBytes
+	if w.wav.dataBytes == 0 || size > w.c.maxBytes {
+		w.Abort()
+		return nil
+	}
+	// 回填头部后同步再rename，保证正式条目总是完整的
+	f := w.wav.f
+	if _, err := f.WriteAt(w.wav.header(), 0); err != nil {
+		w.Abort()
+		return err
+	}
+	if err := f.Sync(); err != nil {
+		w.Abort()
+		return err
+	}
+	if err := f.Close(); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+	if err := os.Rename(tmp, w.c.path(w.key)); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+
+	c := w.c
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	// 相同内容的任务并发合成时后写入的覆盖先写入的
+	if old := c.entries[w.key]; old != nil {
+		c.bytes -= old.size
+		c.lru.Remove(old.elem)
+	}
+	entry := &ttsCacheEntry{key: w.key, size: size}
+	entry.elem = c.lru.PushFront(entry)
+	c.entries[w.key] = entry
+	c.bytes += size
+	c.stores++
+	c.evictLocked()
+	return nil
+}
+
+// 把合成好的WAV文件转为设备格式写入缓存
+func (c *TTSCache) StoreFile(key, wavPath string) error {
+	f, err := os.Open(wavPath)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+	src, _, err := newPCMStream(f)
+	if err != nil {
+		return err
+	}
+	defer src.Close()
+	w, err := c.Create(key)
+	if err != nil {
+		return err
+	}
+	if _, err := io.Copy(w, src); err != nil {
+		w.Abort()
+		return err
+	}
+	return w.Commit()
+}
+
+// ==================== 淘汰 ====================
+func (c *TTSCache) evictLocked() {
+	for c.bytes > c.maxBytes && c.lru.Len() > 0 {
+		c.removeLocked(c.lru.Back().Value.(*ttsCacheEntry))
+		c.evictions++
+	}
+}
+
+func (c *TTSCache) removeLocked(entry *ttsCacheEntry) {
+	os.Remove(c.path(entry.key))
+	c.lru.Remove(entry.elem)
+	delete(c.entries, entry.key)
+	c.bytes -= entry.size
+}
+
+// ==================== 命中率与节省的延迟 ====================
+func (c *TTSCache) observe(kind string, hit bool, latency time.Duration) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	s := c.kinds[kind]
+	if s == nil {
+		s = &ttsCacheKindStats{}
+		c.kinds[kind] = s
+	}
+	if hit {
+		s.hits++
+		s.hitTotal += latency
+	} else {
+		s.misses++
+		s.missTotal += latency
+	}
+}
+
+type TTSCacheKindStats struct {
+	Hits      uint64  `json:"hits"`
+	Misses    uint64  `json:"misses"`
+	HitRatio  float64 `json:"hit_ratio"`
+	HitMeanMs float64 `json:"hit_mean_ms"`
+	// 未命中的平均延迟（实际合成），命中时节省的估计即两者之差
+	MissMeanMs float64 `json:"miss_mean_ms"`
+	SavedMs    float64 `json:"saved_ms"`
+}
+
+type TTSCacheStats struct {
+	Entries   int                          `json:"entries"`
+	Bytes     int64                        `json:"bytes"`
+	MaxBytes  int64                        `json:"max_bytes"`
+	Stores    uint64                       `json:"stores"`
+	Evictions uint64                       `json:"evictions"`
+	Kinds     map[string]TTSCacheKindStats `json:"kinds"` // speak：首帧延迟；file：执行耗时
+}
+
+func (s *ttsCacheKindStats) summary() TTSCacheKindStats {
+	out := TTSCacheKindStats{Hits: s.hits, Misses: s.misses}
+	if s.hits > 0 {
+		out.HitMeanMs = float64(s.hitTotal) / float64(s.hits) / 1e6
+	}
+	if s.misses > 0 {
+		out.MissMeanMs = float64(s.missTotal) / float64(s.misses) / 1e6
+	}
+	if n := s.hits + s.misses; n > 0 {
+		out.HitRatio = float64(s.hits) / float64(n)
+	}
+	if s.hits > 0 && s.misses > 0 {
+		out.SavedMs = (out.MissMeanMs - out.HitMeanMs) * float64(s.hits)
+	}
+	return out
+}
+
+func (c *TTSCache) Stats() TTSCacheStats {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	s := TTSCacheStats{
+		Entries:   len(c.entries),
+		Bytes:     c.bytes,
+		MaxBytes:  c.maxBytes,
+		Stores:    c.stores,
+		Evictions: c.evictions,
+		Kinds:     make(map[string]TTSCacheKindStats),
+	}
+	for kind, ks := range c.kinds {
+		s.Kinds[kind] = ks.summary()
+	}
+	return s
+}
+
+// Prometheus文本格式，由/api/metrics追加输出
+func (c *TTSCache) writeMetrics(b *strings.Builder) {
+	s := c.Stats()
+	kinds := make([]string, 0, len(s.Kinds))
+	for kind := range s.Kinds {
+		kinds = append(kinds, kind)
+	}
+	sort.Strings(kinds)
+	b.WriteString("# HELP tts_cache_requests_total Completed synthesis jobs by cache outcome.\n# TYPE tts_cache_requests_total counter\n")
+	for _, kind := range kinds {
+		fmt.Fprintf(b, "tts_cache_requests_total{kind=%q,result=\"hit\"} %d\n", kind, s.Kinds[kind].Hits)
+		fmt.Fprintf(b, "tts_cache_requests_total{kind=%q,result=\"miss\"} %d\n", kind, s.Kinds[kind].Misses)
+	}
+	b.WriteString("# HELP tts_cache_saved_seconds Estimated latency saved by cache hits (miss mean minus hit mean, per hit).\n# TYPE tts_cache_saved_seconds counter\n")
+	for _, kind := range kinds {
+		fmt.Fprintf(b, "tts_cache_saved_seconds{kind=%q} %g\n", kind, s.Kinds[kind].SavedMs/1000)
+	}
+	fmt.Fprintf(b, "# HELP tts_cache_bytes Size of cached audio on disk.\n# TYPE tts_cache_bytes gauge\ntts_cache_bytes %d\n", s.Bytes)
+	fmt.Fprintf(b, "# HELP tts_cache_entries Cached announcements.\n# TYPE tts_cache_entries gauge\ntts_cache_entries %d\n", s.Entries)
+	fmt.Fprintf(b, "# HELP tts_cache_evictions_total Entries evicted by the size cap.\n# TYPE tts_cache_evictions_total counter\ntts_cache_evictions_total %d\n", s.Evictions)
+}
+
+// ==================== 任务的缓存键 ====================
+// 只有常驻进程报告模型版本，每请求启动进程的回退路径不使用缓存。
+// wait为false时不等待进程就绪（提交时查找），取不到版本返回空
+func ttsJobCacheKey(ctx context.Context, w *TTSWorker, req TTSJobRequest, wait bool) string {
+	if w == nil {
+		return ""
+	}
+	var version string
+	if wait {
+		version, _ = w.ModelVersion(ctx)
+	} else {
+		version = w.Stats().ModelVersion
+	}
+	if version == "" {
+		return ""
+	}
+	key, err := ttsCacheKey(version, req.Text, req.Profile, req.Prompt)
+	if err != nil {
+		log.Printf("TTS cache: %v", err)
+		return ""
+	}
+	return key
+}
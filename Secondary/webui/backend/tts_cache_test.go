@@ -0,0 +1,196 @@
+/***
+ * @file tts_cache_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief 合成结果磁盘缓存测试（缓存键、写入与提交、LRU淘汰、重启恢复）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath tts_cache_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+func TestTTSCacheKey(t *testing.T) {
+	dir := t.TempDir()
+	writeFile := func(name, content string) string {
+		path := filepath.Join(dir, name)
+		if err := os.WriteFile(path, []byte(content), 0644); err != nil {
+			t.Fatal(err)
+		}
+		return path
+	}
+	a1 := writeFile("a1.wav", "voice-a")
+	a2 := writeFile("upload-123.wav", "voice-a")
+	b := writeFile("b.wav", "voice-b")
+
+	key := func(version, text, profile string, prompt TTSPrompt) string {
+		k, err := ttsCacheKey(version, text, profile, prompt)
+		if err != nil {
+			t.Fatalf("ttsCacheKey: %v", err)
+		}
+		if len(k) != 64 {
+			t.Fatalf("key %q is not a hex SHA-256", k)
+		}
+		return k
+	}
+	base := key("m1", "请注意", "", TTSPrompt{})
+
+	same := []struct {
+		name string
+		got  string
+	}{
+		{"repeat", key("m1", "请注意", "", TTSPrompt{})},
+		{"quality profile equals default", key("m1", "请注意", "quality", TTSPrompt{})},
+	}
+	for _, s := range same {
+		if s.got != base {
+			t.Errorf("%s: key changed", s.name)
+		}
+	}
+	if key("m1", "x", "", TTSPrompt{Text: "t", Wav: a1}) != key("m1", "x", "", TTSPrompt{Text: "t", Wav: a2}) {
+		t.Error("same prompt audio under different file names: keys differ")
+	}
+
+	different := []struct {
+		name string
+		got  string
+	}{
+		{"model version", key("m2", "请注意", "", TTSPrompt{})},
+		{"text", key("m1", "请注意。", "", TTSPrompt{})},
+		{"profile", key("m1", "请注意", "fast", TTSPrompt{})},
+		{"field boundary", key("m1请", "注意", "", TTSPrompt{})},
+		{"prompt audio", key("m1", "请注意", "", TTSPrompt{Text: "t", Wav: b})},
+		{"prompt text", key("m1", "请注意", "", TTSPrompt{Text: "u", Wav: b})},
+	}
+	seen := map[string]string{base: "base"}
+	for _, d := range different {
+		if prev, ok := seen[d.got]; ok {
+			t.Errorf("%s: same key as %s", d.name, prev)
+		}
+		seen[d.got] = d.name
+	}
+
+	if _, err := ttsCacheKey("m1", "x", "", TTSPrompt{Wav: filepath.Join(dir, "missing.wav")}); err == nil {
+		t.Error("missing prompt audio: no error")
+	}
+}
+
+// 写入一个条目，返回其PCM内容
+func storeTestEntry(t *testing.T, c *TTSCache, key string, n int) []byte {
+	t.Helper()
+	pcm := bytes.Repeat([]byte{byte(len(key)), 0x7F}, n/2)
+	w, err := c.Create(key)
+	if err != nil {
+		t.Fatalf("Create: %v", err)
+	}
+	w.Write(pcm[:n/3])
+	w.Write(pcm[n/3:])
+	if err := w.Commit(); err != nil {
+		t.Fatalf("Commit: %v", err)
+	}
+	return pcm
+}
+
+func TestTTSCacheStoreAndOpen(t *testing.T) {
+	c, err := NewTTSCache(t.TempDir(), 1<<20)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if c.Open("absent") != nil {
+		t.Fatal("Open of an absent key returned a file")
+	}
+	pcm := storeTestEntry(t, c, "k1", 3000)
+
+	f := c.Open("k1")
+	if f == nil {
+		t.Fatal("Open after Commit: miss")
+	}
+	data, _ := io.ReadAll(f)
+	f.Close()
+	if len(data) != ttsCacheHeaderLen+len(pcm) || string(data[0:4]) != "RIFF" || string(data[36:40]) != "data" ||
+		binary.LittleEndian.Uint32(data[40:44]) != uint32(len(pcm)) || !bytes.Equal(data[ttsCacheHeaderLen:], pcm) {
+		t.Errorf("entry is %d bytes, header % x; want a %d-byte WAV with the written PCM",
+			len(data), data[:min(len(data), ttsCacheHeaderLen)], ttsCacheHeaderLen+len(pcm))
+	}
+	if rate := binary.LittleEndian.Uint32(data[24:28]); rate != defaultSampleRate {
+		t.Errorf("entry sample rate %d, want %d", rate, defaultSampleRate)
+	}
+
+	// 空条目与超过上限的条目不保存；中止的写入不留下文件
+	w, _ := c.Create("empty")
+	w.Commit()
+	w, _ = c.Create("aborted")
+	w.Write([]byte{1, 2})
+	w.Abort()
+	small, _ := NewTTSCache(t.TempDir(), 100)
+	storeTestEntry(t, small, "big", 200)
+	if c.Open("empty") != nil || c.Open("aborted") != nil || small.Open("big") != nil {
+		t.Error("empty, aborted or oversized entry was stored")
+	}
+	files, _ := os.ReadDir(c.dir)
+	if len(files) != 1 {
+		t.Errorf("cache dir has %d files, want 1", len(files))
+	}
+}
+
+// 超过上限时淘汰最久未使用的条目；Open会刷新使用顺序；重启后按修改时间恢复并清理临时文件
+func TestTTSCacheEviction(t *testing.T) {
+	dir := t.TempDir()
+	entry := int64(ttsCacheHeaderLen + 1000)
+	c, err := NewTTSCache(dir, 3*entry)
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, k := range []string{"a", "b", "c"} {
+		storeTestEntry(t, c, k, 1000)
+	}
+	if f := c.Open("a"); f != nil {
+		f.Close()
+	}
+	storeTestEntry(t, c, "d", 1000)
+
+	present := func(c *TTSCache) string {
+		var keys []string
+		for _, k := range []string{"a", "b", "c", "d"} {
+			if f := c.Open(k); f != nil {
+				f.Close()
+				keys = append(keys, k)
+			}
+		}
+		return strings.Join(keys, ",")
+	}
+	if got := present(c); got != "a,c,d" {
+		t.Errorf("after eviction: %s, want a,c,d", got)
+	}
+	if st := c.Stats(); st.Entries != 3 || st.Bytes != 3*entry || st.Evictions != 1 {
+		t.Errorf("stats = %+v, want 3 entries, %d bytes, 1 eviction", st, 3*entry)
+	}
+
+	os.WriteFile(filepath.Join(dir, "x-123"+ttsCacheTempExt), []byte("partial"), 0644)
+	reopened, err := NewTTSCache(dir, 2*entry)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "x-123"+ttsCacheTempExt)); !os.IsNotExist(err) {
+		t.Error("leftover temp file was not removed")
+	}
+	if got := reopened.Stats().Entries; got != 2 {
+		t.Errorf("reopened with a smaller limit: %d entries, want 2", got)
+	}
+}
@@ -0,0 +1,976 @@
+/***
+ * @file tts_jobs.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-22
+ * @brief 语音合成任务队列（任务ID、优先级、并发执行、取消、SSE状态推送、排队/服务耗时直方图）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-22
+ * @filePath tts_jobs.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"time"
+)
+
+// ==================== 队列参数 ====================
+const (
+	ttsJobHistory          = 64                     // 保留的已结束任务数，超出时删除最早的结果文件
+	ttsJobProgressInterval = 250 * time.Millisecond // 合成进度推送的最小间隔
+	ttsJobSubscriberBuffer = 32
+)
+
+// 优先级：数值小的先执行，同级按提交顺序
+type ttsPriority int
+
+const (
+	ttsPriorityAlarm   ttsPriority = iota // 报警广播
+	ttsPriorityRoutine                    // 日常消息
+	ttsPriorityClasses
+)
+
+var ttsPriorityNames = [ttsPriorityClasses]string{"alarm", "routine"}
+
+func (p ttsPriority) String() string {
+	return ttsPriorityNames[p]
+}
+
+func parseTTSPriority(s string) (ttsPriority, error) {
+	for p, name := range ttsPriorityNames {
+		if s == name {
+			return ttsPriority(p), nil
+		}
+	}
+	if s == "" {
+		return ttsPriorityRoutine, nil
+	}
+	return 0, fmt.Errorf("unknown priority %q (alarm, routine)", s)
+}
+
+// 解码档位（voxcpm.modules.locdit.DECODE_PROFILES）：步数更少、CFG无条件分支复用、提前结束换取更低的延迟。
+// quality与原有解码相同；未指定时报警任务使用ttsAlarmProfile（-tts-alarm-profile），其余为原有解码。
+// 报警默认保持quality：降低档位前须先用VoxCPM/scripts/voxcpm_profile_bench.py对比转写错误率
+var ttsProfileNames = []string{"quality", "balanced", "fast"}
+
+var ttsAlarmProfile = "quality"
+
+func parseTTSProfile(s string, priority ttsPriority) (string, error) {
+	if s == "" {
+		if priority == ttsPriorityAlarm {
+			return ttsAlarmProfile, nil
+		}
+		return "", nil
+	}
+	for _, name := range ttsProfileNames {
+		if s == name {
+			return s, nil
+		}
+	}
+	return "", fmt.Errorf("unknown profile %q (%s)", s, strings.Join(ttsProfileNames, ", "))
+}
+
+var (
+	errJobNotFound   = errors.New("tts job not found")
+	errJobFinished   = errors.New("tts job already finished")
+	errQueueClosed   = errors.New("tts job queue closed")
+	errWorkerMissing = errors.New("TTS worker disabled (start with -tts-worker)")
+)
+
+// 全局任务队列
+var ttsJobs *TTSJobQueue
+
+// ==================== 任务 ====================
+// Kind为file时合成WAV供下载，为speak时边合成边发送到Targets（为空表示全部已连接设备）
+type TTSJobRequest struct {
+	Kind      string
+	Priority  ttsPriority
+	Profile   string // 解码档位，为空时为原有解码
+	Text      string
+	Prompt    TTSPrompt
+	Targets   []string
+	TempFiles []string // 任务结束时删除（上传的参考音频）
+}
+
+// 任务快照（/api/tts/status、/api/tts/jobs、SSE）
+type TTSJobInfo struct {
+	ID           string  `json:"id"`
+	Kind         string  `json:"kind"`
+	Priority     string  `json:"priority"`
+	Profile      string  `json:"profile,omitempty"`
+	Status       string  `json:"status"` // queued, running, completed, error, cancelled
+	Text         string  `json:"text"`
+	Error        string  `json:"error,omitempty"`
+	Ahead        int     `json:"ahead"` // 排队中：前面还有几个任务
+	AudioMs      float64 `json:"audio_ms"`
+	FirstAudioMs float64 `json:"first_audio_ms,omitempty"` // speak：从开始执行到首帧进入设备队列；file：到首个音频块写入结果
+	Sentences    int     `json:"sentences,omitempty"`      // 分句合成的句数
+	PromptMs     float64 `json:"prompt_ms,omitempty"`      // 取得参考音色提示缓存的耗时
+	Voice        string  `json:"voice,omitempty"`
+	QueueWaitMs  float64 `json:"queue_wait_ms"`
+	ServiceMs    float64 `json:"service_ms"`
+	HasResult    bool    `json:"has_result"`
+	Cached       bool    `json:"cached"`            // 结果来自合成缓存
+	Library      bool    `json:"library,omitempty"` // 由预渲染库的片段拼接
+}
+
+type ttsJob struct {
+	id  string
+	req TTSJobRequest
+
+	// 以下字段由队列锁保护
+	status       string
+	err          string
+	resultPath   string
+	audioMs      float64
+	firstAudioMs float64
+	promptMs     float64
+	sentences    int
+	created      time.Time
+	started      time.Time
+	finished     time.Time
+	lastProgress time.Time
+	cancel       context.CancelFunc
+	cancelled    bool
+	done         chan struct{}
+
+	cacheKey string   // 为空表示不使用缓存
+	cached   *os.File // 命中的缓存条目，由执行协程关闭
+	clips    [][]byte // 由预渲染库拼接时的各片段（tts_library.go）
+}
+
+// ==================== 队列 ====================
+type TTSJobQueue struct {
+	runners []*TTSWorker // 每个执行协程使用的合成进程（批量解码时多个协程共用一个）；为nil的位置每个任务启动一个Python进程
+	cache   *TTSCache    // 为nil时不缓存
+
+	splitSentences bool // 长文本分句，由空闲进程并行合成（tts_sentences.go）
+
+	mu        sync.Mutex
+	cond      *sync.Cond
+	pending   [ttsPriorityClasses][]*ttsJob
+	sentences [ttsPriorityClasses][]*ttsSentence // 执行中任务待领取的句子
+	jobs      map[string]*ttsJob
+	history   []*ttsJob // 已结束，按结束顺序
+	latest    *ttsJob   // 最近提交的任务（兼容不带job参数的旧接口）
+	nextID    uint64
+	running   int
+	closed    bool
+	subs      map[chan TTSJobInfo]string // 订阅者 -> 任务ID（空为全部任务）
+
+	wait    [ttsPriorityClasses]latencyHistogram // 提交到开始执行
+	service [ttsPriorityClasses]latencyHistogram // 开始执行到结束
+
+	wg sync.WaitGroup
+}
+
+func NewTTSJobQueue(runners []*TTSWorker, cache *TTSCache, splitSentences bool) *TTSJobQueue {
+	q := &TTSJobQueue{
+		runners:        runners,
+		cache:          cache,
+		splitSentences: splitSentences,
+		jobs:           make(map[string]*ttsJob),
+		subs:           make(map[chan TTSJobInfo]string),
+	}
+	q.cond = sync.NewCond(&q.mu)
+	for _, w := range runners {
+		q.wg.Add(1)
+		go q.runLoop(w)
+	}
+	return q
+}
+
+// 是否有常驻合成进程（speak任务需要流式合成）
+func (q *TTSJobQueue) Streaming() bool {
+	return len(q.runners) > 0 && q.runners[0] != nil
+}
+
+// 用于音色注册等单次请求的合成进程，未启用常驻进程时为nil
+func (q *TTSJobQueue) Worker() *TTSWorker {
+	if !q.Streaming() {
+		return nil
+	}
+	return q.runners[0]
+}
+
+func (q *TTSJobQueue) WorkerStats() []TTSWorkerStats {
+	var stats []TTSWorkerStats
+	seen := make(map[*TTSWorker]bool)
+	for _, w := range q.runners {
+		if w != nil && !seen[w] {
+			seen[w] = true
+			stats = append(stats, w.Stats())
+		}
+	}
+	return stats
+}
+
+// 合成缓存统计，未启用缓存时为nil
+func (q *TTSJobQueue) CacheStats() *TTSCacheStats {
+	if q.cache == nil {
+		return nil
+	}
+	s := q.cache.Stats()
+	return &s
+}
+
+// ==================== 关闭：取消排队与执行中的任务，等待执行协程退出 ====================
+func (q *TTSJobQueue) Close() {
+	q.mu.Lock()
+	q.closed = true
+	for p := range q.pending {
+		for _, job := range q.pending[p] {
+			q.finishLocked(job, "cancelled", errQueueClosed.Error())
+		}
+		q.pending[p] = nil
+	}
+	for _, job := range q.jobs {
+		if job.status == "running" {
+			job.cancelled = true
+			job.cancel()
+		}
+	}
+	q.cond.Broadcast()
+	q.mu.Unlock()
+	q.wg.Wait()
+}
+
+// ==================== 提交 ====================
+// 缓存命中或能由预渲染库拼出的任务不排队，立即在独立协程中播放或生成下载结果
+func (q *TTSJobQueue) Submit(req TTSJobRequest) (TTSJobInfo, error) {
+	var key string
+	var cached *os.File
+	if q.cache != nil && q.Streaming() {
+		// 参考音频的哈希在锁外计算
+		if key = ttsJobCacheKey(context.Background(), q.runners[0], req, false); key != "" {
+			cached = q.cache.Open(key)
+		}
+	}
+	var clips [][]byte
+	if cached == nil {
+		if clips = q.libraryClips(req); clips != nil {
+			key = ""
+		}
+	}
+
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	if q.closed {
+		if cached != nil {
+			cached.Close()
+		}
+		return TTSJobInfo{}, errQueueClosed
+	}
+	q.nextID++
+	job := &ttsJob{
+		id:       fmt.Sprintf("tts-%d", q.nextID),
+		req:      req,
+		status:   "queued",
+		created:  time.Now(),
+		done:     make(chan struct{}),
+		cacheKey: key,
+		cached:   cached,
+		clips:    clips,
+	}
+	q.jobs[job.id] = job
+	q.latest = job
+	if cached != nil || clips != nil {
+		ctx := q.startLocked(job)
+		q.wg.Add(1)
+		go func() {
+			defer q.wg.Done()
+			q.execute(ctx, job, nil)
+		}()
+		source := "cache hit"
+		if clips != nil {
+			source = fmt.Sprintf("assembled from %d library clips", len(clips))
+		}
+		log.Printf("TTS job %s %s (%s, %s): %s", job.id, source, req.Kind, req.Priority, truncateText(req.Text, 30))
+		return q.infoLocked(job), nil
+	}
+	q.pending[req.Priority] = append(q.pending[req.Priority], job)
+	q.cond.Signal()
+	q.publishLocked(job)
+	log.Printf("TTS job %s queued (%s, %s): %s", job.id, req.Kind, req.Priority, truncateText(req.Text, 30))
+	return q.infoLocked(job), nil
+}
+
+// ==================== 取消 ====================
+// 排队中的任务直接移出队列；执行中的任务在下一个生成步停止（合成进程保持加载）
+func (q *TTSJobQueue) Cancel(id string) (TTSJobInfo, error) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	job := q.jobs[id]
+	if job == nil {
+		return TTSJobInfo{}, errJobNotFound
+	}
+	switch job.status {
+	case "queued":
+		list := q.pending[job.req.Priority]
+		for i, j := range list {
+			if j == job {
+				q.pending[job.req.Priority] = append(list[:i:i], list[i+1:]...)
+				break
+			}
+		}
+		q.finishLocked(job, "cancelled", "")
+	case "running":
+		job.cancelled = true
+		job.cancel()
+	default:
+		return q.infoLocked(job), errJobFinished
+	}
+	return q.infoLocked(job), nil
+}
+
+// ==================== 等待任务结束 ====================
+// ctx结束（如HTTP客户端断开）时取消任务
+func (q *TTSJobQueue) Wait(ctx context.Context, id string) (TTSJobInfo, error) {
+	q.mu.Lock()
+	job := q.jobs[id]
+	q.mu.Unlock()
+	if job == nil {
+		return TTSJobInfo{}, errJobNotFound
+	}
+	select {
+	case <-job.done:
+	case <-ctx.Done():
+		q.Cancel(id)
+		<-job.done
+	}
+	return q.Get(id)
+}
+
+// 查询任务；id为空时返回最近提交的任务
+func (q *TTSJobQueue) Get(id string) (TTSJobInfo, error) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	job := q.jobs[id]
+	if id == "" {
+		job = q.latest
+	}
+	if job == nil {
+		return TTSJobInfo{}, errJobNotFound
+	}
+	return q.infoLocked(job), nil
+}
+
+// 已完成任务的结果文件；id为空时使用最近提交的任务
+func (q *TTSJobQueue) ResultPath(id string) (string, error) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	job := q.jobs[id]
+	if id == "" {
+		job = q.latest
+	}
+	if job == nil || job.status != "completed" || job.resultPath == "" {
+		return "", errJobNotFound
+	}
+	return job.resultPath, nil
+}
+
+// 排队中与执行中的任务在前，之后是最近结束的任务（新的在前）
+func (q *TTSJobQueue) List() []TTSJobInfo {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	var list []TTSJobInfo
+	for _, job := range q.jobs {
+		if job.status == "running" {
+			list = append(list, q.infoLocked(job))
+		}
+	}
+	for p := range q.pending {
+		for _, job := range q.pending[p] {
+			list = append(list, q.infoLocked(job))
+		}
+	}
+	for i := len(q.history) - 1; i >= 0; i-- {
+		list = append(list, q.infoLocked(q.history[i]))
+	}
+	return list
+}
+
+// ==================== 订阅任务事件（SSE） ====================
+// id为空时订阅全部任务；返回当前快照，之后的状态变化与合成进度经channel推送。
+// 消费慢时丢弃中间事件，单个任务的订阅者应同时等待done以确保拿到最终状态
+func (q *TTSJobQueue) Subscribe(id string) (ch chan TTSJobInfo, snapshot []TTSJobInfo, done <-chan struct{}, err error) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	if id != "" {
+		job := q.jobs[id]
+		if job == nil {
+			return nil, nil, nil, errJobNotFound
+		}
+		snapshot = []TTSJobInfo{q.infoLocked(job)}
+		done = job.done
+	}
+	ch = make(chan TTSJobInfo, ttsJobSubscriberBuffer)
+	q.subs[ch] = id
+	return ch, snapshot, done, nil
+}
+
+func (q *TTSJobQueue) Unsubscribe(ch chan TTSJobInfo) {
+	q.mu.Lock()
+	delete(q.subs, ch)
+	q.mu.Unlock()
+}
+
+func (q *TTSJobQueue) publishLocked(job *ttsJob) {
+	if len(q.subs) == 0 {
+		return
+	}
+	info := q.infoLocked(job)
+	for ch, id := range q.subs {
+		if id != "" && id != job.id {
+			continue
+		}
+		select {
+		case ch <- info:
+		default:
+		}
+	}
+}
+
+// ==================== 执行协程 ====================
+func (q *TTSJobQueue) runLoop(w *TTSWorker) {
+	defer q.wg.Done()
+	for {
+		job, sentence, ctx := q.next()
+		switch {
+		case sentence != nil:
+			sentence.run(w)
+		case job != nil:
+			q.execute(ctx, job, w)
+		default:
+			return
+		}
+	}
+}
+
+// 取出优先级最高的工作：同级中执行中任务的句子先于排队的任务；队列关闭时都返回nil
+func (q *TTSJobQueue) next() (*ttsJob, *ttsSentence, context.Context) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	for {
+		if q.closed {
+			return nil, nil, nil
+		}
+		for p := range q.pending {
+			if len(q.sentences[p]) > 0 {
+				s := q.sentences[p][0]
+				q.sentences[p][0] = nil
+				q.sentences[p] = q.sentences[p][1:]
+				s.taken = true
+				return nil, s, nil
+			}
+			if len(q.pending[p]) == 0 {
+				continue
+			}
+			job := q.pending[p][0]
+			q.pending[p][0] = nil
+			q.pending[p] = q.pending[p][1:]
+			return job, nil, q.startLocked(job)
+		}
+		q.cond.Wait()
+	}
+}
+
+func (q *TTSJobQueue) startLocked(job *ttsJob) context.Context {
+	ctx, cancel := context.WithCancel(context.Background())
+	job.cancel = cancel
+	job.status = "running"
+	job.started = time.Now()
+	q.running++
+	q.wait[job.req.Priority].observe(job.started.Sub(job.created))
+	q.publishLocked(job)
+	return ctx
+}
+
+func (q *TTSJobQueue) execute(ctx context.Context, job *ttsJob, w *TTSWorker) {
+	defer job.cancel()
+	log.Printf("TTS job %s started after %v in queue", job.id, job.started.Sub(job.created).Round(time.Millisecond))
+
+	progress := func(audioMs float64) {
+		q.mu.Lock()
+		job.audioMs = audioMs
+		if now := time.Now(); now.Sub(job.lastProgress) >= ttsJobProgressInterval {
+			job.lastProgress = now
+			q.publishLocked(job)
+		}
+		q.mu.Unlock()
+	}
+
+	// 排队期间可能有相同内容的任务完成并写入了缓存，执行前再查一次
+	if job.cacheKey == "" && job.cached == nil && job.clips == nil && q.cache != nil {
+		job.cacheKey = ttsJobCacheKey(ctx, w, job.req, true)
+	}
+	if job.cacheKey != "" && job.cached == nil {
+		job.cached = q.cache.Open(job.cacheKey)
+	}
+
+	var resultPath string
+	var firstAudio time.Duration
+	var promptMs float64
+	var sentences int
+	var err error
+	synth := func(ctx context.Context, format ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error) {
+		res, err := q.synthesize(ctx, w, job, format, onChunk)
+		promptMs, sentences = res.PromptMs, len(res.Sentences)
+		return res, err
+	}
+	switch {
+	case job.cached != nil:
+		resultPath, firstAudio, err = q.playCached(ctx, job, progress)
+	case job.clips != nil:
+		resultPath, firstAudio, err = q.playLibrary(ctx, job, progress)
+	case job.req.Kind == "speak":
+		if w == nil {
+			err = errWorkerMissing
+			break
+		}
+		var record *ttsCacheWriter
+		if job.cacheKey != "" {
+			if record, err = q.cache.Create(job.cacheKey); err != nil {
+				log.Printf("TTS cache: %v", err)
+				record, err = nil, nil
+			}
+		}
+		var sink io.Writer // 未缓存时保持nil接口
+		if record != nil {
+			sink = record
+		}
+		var res ttsSpeakResult
+		res, err = speakText(ctx, synth, job.req.Targets, sink)
+		firstAudio = res.FirstAudio
+		progress(res.Relay.Duration() * 1000)
+		if record != nil {
+			if err == nil && ctx.Err() == nil {
+				if cerr := record.Commit(); cerr != nil {
+					log.Printf("TTS cache: %v", cerr)
+				}
+			} else {
+				record.Abort()
+			}
+		}
+	default:
+		if w != nil {
+			resultPath, err = synthesizeJobFile(ctx, synth, job, func(audioMs float64) {
+				if firstAudio == 0 {
+					firstAudio = time.Since(job.started)
+				}
+				progress(audioMs)
+			})
+		} else {
+			resultPath, err = synthesizeJobProcess(ctx, job)
+		}
+		if err == nil && job.cacheKey != "" {
+			if cerr := q.cache.StoreFile(job.cacheKey, resultPath); cerr != nil {
+				log.Printf("TTS cache: %v", cerr)
+			}
+		}
+	}
+
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	q.running--
+	job.resultPath = resultPath
+	job.promptMs = promptMs
+	job.sentences = sentences
+	if firstAudio > 0 {
+		job.firstAudioMs = float64(firstAudio) / float64(time.Millisecond)
+	}
+	switch {
+	case job.cancelled:
+		q.finishLocked(job, "cancelled", "")
+	case err != nil:
+		q.finishLocked(job, "error", err.Error())
+	default:
+		q.finishLocked(job, "completed", "")
+	}
+	q.service[job.req.Priority].observe(job.finished.Sub(job.started))
+	if job.cacheKey != "" && job.status == "completed" {
+		latency := job.finished.Sub(job.started)
+		if job.req.Kind == "speak" {
+			latency = firstAudio
+		}
+		q.cache.observe(job.req.Kind, job.cached != nil, latency)
+	}
+	log.Printf("TTS job %s %s in %v (%.1fs audio) %s", job.id, job.status,
+		job.finished.Sub(job.started).Round(time.Millisecond), job.audioMs/1000, job.err)
+}
+
+// 结束任务并移入历史，超出保留数时删除最早任务的结果文件
+func (q *TTSJobQueue) finishLocked(job *ttsJob, status, errMsg string) {
+	job.status = status
+	job.err = errMsg
+	job.finished = time.Now()
+	for _, f := range job.req.TempFiles {
+		os.Remove(f)
+	}
+	if status != "completed" && job.resultPath != "" {
+		os.Remove(job.resultPath)
+		job.resultPath = ""
+	}
+	close(job.done)
+	q.history = append(q.history, job)
+	for len(q.history) > ttsJobHistory {
+		old := q.history[0]
+		q.history[0] = nil
+		q.history = q.history[1:]
+		if old.resultPath != "" {
+			os.Remove(old.resultPath)
+		}
+		delete(q.jobs, old.id)
+		if q.latest == old {
+			q.latest = nil
+		}
+	}
+	q.publishLocked(job)
+}
+
+func (q *TTSJobQueue) infoLocked(job *ttsJob) TTSJobInfo {
+	info := TTSJobInfo{
+		ID:           job.id,
+		Kind:         job.req.Kind,
+		Priority:     job.req.Priority.String(),
+		Profile:      job.req.Profile,
+		Status:       job.status,
+		Text:         truncateText(job.req.Text, 50),
+		Error:        job.err,
+		AudioMs:      job.audioMs,
+		FirstAudioMs: job.firstAudioMs,
+		PromptMs:     job.promptMs,
+		Sentences:    job.sentences,
+		HasResult:    job.resultPath != "",
+		Cached:       job.cached != nil,
+		Library:      job.clips != nil,
+	}
+	if job.req.Prompt.Voice != nil {
+		info.Voice = job.req.Prompt.Voice.ID
+	}
+	if job.status == "queued" {
+		for p := ttsPriority(0); p < job.req.Priority; p++ {
+			info.Ahead += len(q.pending[p])
+		}
+		for _, j := range q.pending[job.req.Priority] {
+			if j == job {
+				break
+			}
+			info.Ahead++
+		}
+		info.QueueWaitMs = msSince(job.created, time.Now())
+	} else if !job.started.IsZero() {
+		info.QueueWaitMs = msSince(job.created, job.started)
+		end := job.finished
+		if end.IsZero() {
+			end = time.Now()
+		}
+		info.ServiceMs = msSince(job.started, end)
+	}
+	return info
+}
+
+func msSince(from, to time.Time) float64 {
+	return float64(to.Sub(from)) / float64(time.Millisecond)
+}
+
+func truncateText(s string, n int) string {
+	r := []rune(s)
+	if len(r) <= n {
+		return s
+	}
+	return string(r[:n]) + "…"
+}
+
+// ==================== 从缓存播放或生成下载结果 ====================
+// 条目已是设备格式，speak任务跳过WAV头直接按帧转发；file任务硬链接（跨设备时复制）为结果文件
+func (q *TTSJobQueue) playCached(ctx context.Context, job *ttsJob, progress func(audioMs float64)) (string, time.Duration, error) {
+	f := job.cached
+	defer f.Close()
+	if job.req.Kind == "speak" {
+		if _, err := f.Seek(ttsCacheHeaderLen, io.SeekStart); err != nil {
+			return "", 0, err
+		}
+		stats, err := relayPCM(job.req.Targets, ctxReader{ctx, f})
+		progress(stats.Duration() * 1000)
+		var firstAudio time.Duration
+		if !stats.FirstFrame.IsZero() {
+			firstAudio = stats.FirstFrame.Sub(job.started)
+		}
+		return "", firstAudio, err
+	}
+
+	path := ttsJobResultPath(job.id)
+	if err := os.Link(f.Name(), path); err != nil {
+		out, err := os.Create(path)
+		if err != nil {
+			return "", 0, err
+		}
+		_, err = io.Copy(out, f)
+		if cerr := out.Close(); err == nil {
+			err = cerr
+		}
+		if err != nil {
+			os.Remove(path)
+			return "", 0, err
+		}
+	}
+	if st, err := f.Stat(); err == nil {
+		progress(float64(st.Size()-ttsCacheHeaderLen) / float64(defaultSampleRate*defaultChannels*defaultSampleSize) * 1000)
+	}
+	return path, 0, nil
+}
+
+// 读取前检查ctx，取消后relayPCM在下一帧停止
+type ctxReader struct {
+	ctx context.Context
+	r   io.Reader
+}
+
+func (r ctxReader) Read(p []byte) (int, error) {
+	if err := r.ctx.Err(); err != nil {
+		return 0, err
+	}
+	return r.r.Read(p)
+}
+
+func ttsJobResultPath(id string) string {
+	tmpDir := filepath.Join(os.TempDir(), "tts_temp")
+	os.MkdirAll(tmpDir, 0755)
+	return filepath.Join(tmpDir, fmt.Sprintf("tts_result_%s.wav", id))
+}
+
+// ==================== 合成WAV文件 ====================
+// 常驻进程流式合成并在Go端写出WAV，执行中的任务可在下一个生成步取消而不必结束进程
+func synthesizeJobFile(ctx context.Context, synth ttsSynthFunc, job *ttsJob, progress func(audioMs float64)) (string, error) {
+	path := ttsJobResultPath(job.id)
+	var out *wavFileWriter
+	_, err := synth(ctx, ttsPCMFormat{}, func(pcm []byte, format ttsPCMFormat) error {
+		if out == nil {
+			var err error
+			if out, err = createWAVFile(path, format.SampleRate, format.Channels); err != nil {
+				return err
+			}
+		}
+		if err := out.write(pcm); err != nil {
+			return err
+		}
+		progress(out.durationMs())
+		return nil
+	})
+	if out == nil {
+		if err == nil {
+			err = errors.New("TTS synthesis produced no audio")
+		}
+		return "", err
+	}
+	if cerr := out.close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		os.Remove(path)
+		return "", err
+	}
+	return path, nil
+}
+
+// 未启用常驻进程时每个任务启动一个Python进程（整段合成），取消时结束该进程
+func synthesizeJobProcess(ctx context.Context, job *ttsJob) (string, error) {
+	prompt := job.req.Prompt
+	if prompt.Voice != nil {
+		prompt.Wav = prompt.Voice.workerVoice().Wav
+		prompt.Text = prompt.Voice.PromptText
+	}
+	return callVoxCPMProcess(ctx, job.req.Text, prompt.Text, prompt.Wav, ttsJobResultPath(job.id))
+}
+
+// 16位PCM WAV，数据长度在关闭时回填
+type wavFileWriter struct {
+	f          *os.File
+	sampleRate int
+	channels   int
+	dataBytes  int64
+}
+
+func createWAVFile(path string, sampleRate, channels int) (*wavFileWriter, error) {
+	f, err := os.Create(path)
+	if err != nil {
+		return nil, err
+	}
+	w := &wavFileWriter{f: f, sampleRate: sampleRate, channels: channels}
+	if _, err := f.Write(w.header()); err != nil {
+		f.Close()
+		return nil, err
+	}
+	return w, nil
+}
+
+func (w *wavFileWriter) header() []byte {
+	h := make([]byte, 44)
+	copy(h[0:4], "RIFF")
+	binary.LittleEndian.PutUint32(h[4:8], uint32(36+w.dataBytes))
+	copy(h[8:16], "WAVEfmt ")
+	binary.LittleEndian.PutUint32(h[16:20], 16)
+	binary.LittleEndian.PutUint16(h[20:22], wavFormatPCM)
+	binary.LittleEndian.PutUint16(h[22:24], uint16(w.channels))
+	binary.LittleEndian.PutUint32(h[24:28], uint32(w.sampleRate))
+	binary.LittleEndian.PutUint32(h[28:32], uint32(w.sampleRate*w.channels*2))
+	binary.LittleEndian.PutUint16(h[32:34], uint16(w.channels*2))
+	binary.LittleEndian.PutUint16(h[34:36], 16)
+	copy(h[36:40], "data")
+	binary.LittleEndian.PutUint32(h[40:44], uint32(w.dataBytes))
+	return h
+}
+
+func (w *wavFileWriter) write(pcm []byte) error {
+	n, err := w.f.Write(pcm)
+	w.dataBytes += int64(n)
+	return err
+}
+
+func (w *wavFileWriter) durationMs() float64 {
+	return float64(w.dataBytes) / float64(2*w.channels) / float64(w.sampleRate) * 1000
+}
+
+func (w *wavFileWriter) close() error {
+	if _, err := w.f.WriteAt(w.header(), 0); err != nil {
+		w.f.Close()
+		return err
+	}
+	return w.f.Close()
+}
+
+// ==================== 排队/服务耗时直方图 ====================
+// 固定桶（秒），由队列锁保护
+var ttsLatencyBuckets = [...]float64{0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300}
+
+type latencyHistogram struct {
+	counts [len(ttsLatencyBuckets) + 1]uint64 // 最后一个为+Inf
+	sum    float64
+	n      uint64
+}
+
+func (h *latencyHistogram) observe(d time.Duration) {
+	v := d.Seconds()
+	i := 0
+	for i < len(ttsLatencyBuckets) && v > ttsLatencyBuckets[i] {
+		i++
+	}
+	h.counts[i]++
+	h.sum += v
+	h.n++
+}
+
+// 分位数估计：返回所在桶的上界（秒），落在+Inf桶时返回最大桶上界
+func (h *latencyHistogram) quantile(q float64) float64 {
+	if h.n == 0 {
+		return 0
+	}
+	rank := uint64(q*float64(h.n) + 0.5)
+	if rank < 1 {
+		rank = 1
+	}
+	var cum uint64
+	for i, c := range h.counts {
+		cum += c
+		if cum >= rank && i < len(ttsLatencyBuckets) {
+			return ttsLatencyBuckets[i]
+		}
+	}
+	return ttsLatencyBuckets[len(ttsLatencyBuckets)-1]
+}
+
+func (h *latencyHistogram) writeProm(b *strings.Builder, name, labels string) {
+	var cum uint64
+	for i, le := range ttsLatencyBuckets {
+		cum += h.counts[i]
+		fmt.Fprintf(b, "%s_bucket{%s,le=\"%g\"} %d\n", name, labels, le, cum)
+	}
+	cum += h.counts[len(ttsLatencyBuckets)]
+	fmt.Fprintf(b, "%s_bucket{%s,le=\"+Inf\"} %d\n", name, labels, cum)
+	fmt.Fprintf(b, "%s_sum{%s} %g\n%s_count{%s} %d\n", name, labels, h.sum, name, labels, h.n)
+}
+
+// 直方图摘要（/api/tts/jobs）
+type latencySummary struct {
+	Count  uint64  `json:"count"`
+	MeanMs float64 `json:"mean_ms"`
+	P50Ms  float64 `json:"p50_le_ms"` // 所在桶的上界
+	P95Ms  float64 `json:"p95_le_ms"`
+}
+
+func (h *latencyHistogram) summary() latencySummary {
+	s := latencySummary{Count: h.n, P50Ms: h.quantile(0.5) * 1000, P95Ms: h.quantile(0.95) * 1000}
+	if h.n > 0 {
+		s.MeanMs = h.sum / float64(h.n) * 1000
+	}
+	return s
+}
+
+// ==================== 队列统计 ====================
+type TTSQueueStats struct {
+	Runners int                       `json:"runners"`
+	Running int                       `json:"running"`
+	Queued  map[string]int            `json:"queued"`
+	Split   map[string]int            `json:"sentences_queued"` // 执行中任务尚未领取的句子
+	Wait    map[string]latencySummary `json:"queue_wait"`
+	Service map[string]latencySummary `json:"service_time"`
+}
+
+func (q *TTSJobQueue) Stats() TTSQueueStats {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	s := TTSQueueStats{
+		Runners: len(q.runners),
+		Running: q.running,
+		Queued:  make(map[string]int),
+		Split:   make(map[string]int),
+		Wait:    make(map[string]latencySummary),
+		Service: make(map[string]latencySummary),
+	}
+	for p := ttsPriority(0); p < ttsPriorityClasses; p++ {
+		s.Queued[p.String()] = len(q.pending[p])
+		s.Split[p.String()] = len(q.sentences[p])
+		s.Wait[p.String()] = q.wait[p].summary()
+		s.Service[p.String()] = q.service[p].summary()
+	}
+	return s
+}
+
+// Prometheus文本格式，由/api/metrics追加输出
+func (q *TTSJobQueue) writeMetrics(b *strings.Builder) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	b.WriteString("# HELP tts_jobs_queued Synthesis jobs waiting for a worker.\n# TYPE tts_jobs_queued gauge\n")
+	for p := ttsPriority(0); p < ttsPriorityClasses; p++ {
+		fmt.Fprintf(b, "tts_jobs_queued{priority=%q} %d\n", p.String(), len(q.pending[p]))
+	}
+	fmt.Fprintf(b, "# HELP tts_jobs_running Synthesis jobs being executed.\n# TYPE tts_jobs_running gauge\ntts_jobs_running %d\n", q.running)
+	b.WriteString("# HELP tts_job_queue_wait_seconds Time from submission until a worker picks the job up.\n# TYPE tts_job_queue_wait_seconds histogram\n")
+	for p := ttsPriority(0); p < ttsPriorityClasses; p++ {
+		q.wait[p].writeProm(b, "tts_job_queue_wait_seconds", fmt.Sprintf("priority=%q", p.String()))
+	}
+	b.WriteString("# HELP tts_job_service_seconds Time from start until the job finished (speak jobs include playback).\n# TYPE tts_job_service_seconds histogram\n")
+	for p := ttsPriority(0); p < ttsPriorityClasses; p++ {
+		q.service[p].writeProm(b, "tts_job_service_seconds", fmt.Sprintf("priority=%q", p.String()))
+	}
+	if q.cache != nil {
+		q.cache.writeMetrics(b)
+	}
+}
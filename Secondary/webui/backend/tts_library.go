@@ -0,0 +1,588 @@
+/***
+ * @file tts_library.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-25
+ * @brief 预渲染播报库（短语与模板离线批量合成，设备格式打包为带索引的归档，内存映射查找并拼接播报）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-25
+ * @filePath tts_library.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"context"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+	"unicode"
+	"unicode/utf8"
+)
+
+// 全局预渲染库（-tts-library），为nil时不使用
+var ttsLibrary *TTSLibrary
+
+// ==================== 库定义 ====================
+// JSON：短语原样合成；模板中的{槽位}拆开，固定部分与各槽位取值分别合成为片段，播报时按文本拼接。
+//
+//	{"phrases": ["请注意", "护士请到护士站"],
+//	 "templates": [{"text": "{bed}号床病人体温{temp}度，请及时处理",
+//	                "slots": {"bed": {"from": 1, "to": 60},
+//	                          "temp": {"from": 35, "to": 42, "step": 0.1, "decimals": 1}}}]}
+type TTSLibrarySpec struct {
+	Phrases   []string             `json:"phrases"`
+	Templates []TTSLibraryTemplate `json:"templates"`
+}
+
+type TTSLibraryTemplate struct {
+	Text  string                    `json:"text"`
+	Slots map[string]TTSLibrarySlot `json:"slots"`
+}
+
+// 槽位取值：Values逐个列出，或From到To按Step（默认1）取值并保留Decimals位小数
+type TTSLibrarySlot struct {
+	Values   []string `json:"values,omitempty"`
+	From     float64  `json:"from"`
+	To       float64  `json:"to"`
+	Step     float64  `json:"step,omitempty"`
+	Decimals int      `json:"decimals,omitempty"`
+}
+
+func LoadTTSLibrarySpec(path string) (TTSLibrarySpec, error) {
+	var spec TTSLibrarySpec
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return spec, err
+	}
+	err = json.Unmarshal(data, &spec)
+	return spec, err
+}
+
+func (s TTSLibrarySlot) values() []string {
+	if len(s.Values) > 0 {
+		return s.Values
+	}
+	step := s.Step
+	if step <= 0 {
+		step = 1
+	}
+	n := int(math.Round((s.To - s.From) / step))
+	out := make([]string, 0, n+1)
+	for i := 0; i <= n; i++ {
+		out = append(out, strconv.FormatFloat(s.From+float64(i)*step, 'f', s.Decimals, 64))
+	}
+	return out
+}
+
+// 需要合成的片段文本（去重，保持定义顺序）
+func (s TTSLibrarySpec) Clips() ([]string, error) {
+	seen := make(map[string]bool)
+	var clips []string
+	add := func(text string) {
+		if text = strings.TrimSpace(text); text != "" && !seen[text] {
+			seen[text] = true
+			clips = append(clips, text)
+		}
+	}
+	for _, p := range s.Phrases {
+		add(p)
+	}
+	for _, t := range s.Templates {
+		rest := t.Text
+		for {
+			open := strings.IndexByte(rest, '{')
+			if open < 0 {
+				add(rest)
+				break
+			}
+			end := strings.IndexByte(rest[open:], '}')
+			if end < 0 {
+				return nil, fmt.Errorf("template %q: unclosed slot", t.Text)
+			}
+			add(rest[:open])
+			name := rest[open+1 : open+end]
+			slot, ok := t.Slots[name]
+			if !ok {
+				return nil, fmt.Errorf("template %q: slot %q has no values", t.Text, name)
+			}
+			for _, v := range slot.values() {
+				add(v)
+			}
+			rest = rest[open+end+1:]
+		}
+	}
+	return clips, nil
+}
+
+// ==================== 归档格式 ====================
+// 小端定长结构，便于后端内存映射直接查找，也可整体写入ESP32的flash分区按同样方式读取：
+//
+//	文件头 128字节：magic "VXTTSLIB" | 采样率 u32 | 声道数 u16 | 位深 u16 | 片段数 u32 | 最长键字符数 u32 |
+//	               键区偏移 u64 | 数据区偏移 u64 | 模型版本（64字节，不足补0） | 保留
+//	索引 片段数 x 32字节，按哈希升序：键哈希 u64 | 数据偏移 u64 | 数据长度 u32 | 键偏移 u32 | 键长度 u32 | 保留 u32
+//	键区 各片段文本（UTF-8）依次存放
+//	数据区 从4096字节边界开始，各片段为设备格式PCM（16位小端），不带WAV头
+//
+// 键哈希为64位FNV-1a；哈希相同时比较键文本。写入先落到同目录的临时文件，同步后rename。
+const (
+	ttsLibraryMagic      = "VXTTSLIB"
+	ttsLibraryHeaderLen  = 128
+	ttsLibraryEntryLen   = 32
+	ttsLibraryVersionLen = 64
+	ttsLibraryDataAlign  = 4096
+
+	ttsLibraryTrimLevel = 300                    // 片段首尾低于该幅度的样本视为静音（约-40dBFS）
+	ttsLibraryTrimPad   = 30 * time.Millisecond  // 裁剪后首尾保留的静音
+	ttsLibraryPause     = 200 * time.Millisecond // 拼接时库中没有的标点与空白处的停顿
+)
+
+func ttsLibraryHash(s string) uint64 {
+	h := uint64(14695981039346656037)
+	for i := 0; i < len(s); i++ {
+		h ^= uint64(s[i])
+		h *= 1099511628211
+	}
+	return h
+}
+
+// 写出归档：clips为片段文本 -> 设备格式PCM
+func writeTTSLibrary(path string, format ttsPCMFormat, modelVersion string, clips map[string][]byte) error {
+	type entry struct {
+		key  string
+		hash uint64
+	}
+	entries := make([]entry, 0, len(clips))
+	maxRunes := 0
+	for key := range clips {
+		entries = append(entries, entry{key, ttsLibraryHash(key)})
+		maxRunes = max(maxRunes, utf8.RuneCountInString(key))
+	}
+	sort.Slice(entries, func(i, j int) bool {
+		if entries[i].hash != entries[j].hash {
+			return entries[i].hash < entries[j].hash
+		}
+		return entries[i].key < entries[j].key
+	})
+
+	keysOffset := ttsLibraryHeaderLen + ttsLibraryEntryLen*len(entries)
+	var keys bytes.Buffer
+	index := make([]byte, ttsLibraryEntryLen*len(entries))
+	var dataLen uint64
+	for i, e := range entries {
+		b := index[i*ttsLibraryEntryLen:]
+		binary.LittleEndian.PutUint64(b[0:], e.hash)
+		binary.LittleEndian.PutUint64(b[8:], dataLen)
+		binary.LittleEndian.PutUint32(b[16:], uint32(len(clips[e.key])))
+		binary.LittleEndian.PutUint32(b[20:], uint32(keys.Len()))
+		binary.LittleEndian.PutUint32(b[24:], uint32(len(e.key)))
+		keys.WriteString(e.key)
+		dataLen += uint64(len(clips[e.key]))
+	}
+	dataOffset := (keysOffset + keys.Len() + ttsLibraryDataAlign - 1) / ttsLibraryDataAlign * ttsLibraryDataAlign
+
+	header := make([]byte, ttsLibraryHeaderLen)
+	copy(header, ttsLibraryMagic)
+	binary.LittleEndian.PutUint32(header[8:], uint32(format.SampleRate))
+	binary.LittleEndian.PutUint16(header[12:], uint16(format.Channels))
+	binary.LittleEndian.PutUint16(header[14:], 16)
+	binary.LittleEndian.PutUint32(header[16:], uint32(len(entries)))
+	binary.LittleEndian.PutUint32(header[20:], uint32(maxRunes))
+	binary.LittleEndian.PutUint64(header[24:], uint64(keysOffset))
+	binary.LittleEndian.PutUint64(header[32:], uint64(dataOffset))
+	if len(modelVersion) > ttsLibraryVersionLen {
+		return fmt.Errorf("model version %q too long", modelVersion)
+	}
+	copy(header[40:40+ttsLibraryVersionLen], modelVersion)
+
+	tmp, err := os.CreateTemp(filepath.Dir(path), filepath.Base(path)+".*.tmp")
+	if err != nil {
+		return err
+	}
+	defer os.Remove(tmp.Name())
+	_, err = tmp.Write(header)
+	if err == nil {
+		_, err = tmp.Write(index)
+	}
+	if err == nil {
+		_, err = tmp.Write(keys.Bytes())
+	}
+	if err == nil {
+		_, err = tmp.Write(make([]byte, dataOffset-keysOffset-keys.Len()))
+	}
+	for _, e := range entries {
+		if err != nil {
+			break
+		}
+		_, err = tmp.Write(clips[e.key])
+	}
+	if err == nil {
+		err = tmp.Sync()
+	}
+	if cerr := tmp.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		return err
+	}
+	return os.Rename(tmp.Name(), path)
+}
+
+// ==================== 打开与查找 ====================
+type TTSLibrary struct {
+	path    string
+	data    []byte // 整个归档（内存映射）
+	release func() error
+
+	format       ttsPCMFormat
+	modelVersion string
+	count        int
+	maxRunes     int
+	index        []byte
+	keys         []byte
+	clipData     []byte
+	pause        []byte // 停顿的静音
+}
+
+func OpenTTSLibrary(path string) (*TTSLibrary, error) {
+	data, release, err := mmapFile(path)
+	if err != nil {
+		return nil, err
+	}
+	l, err := parseTTSLibrary(data)
+	if err != nil {
+		release()
+		return nil, fmt.Errorf("%s: %v", path, err)
+	}
+	l.path, l.release = path, release
+	return l, nil
+}
+
+func parseTTSLibrary(data []byte) (*TTSLibrary, error) {
+	if len(data) < ttsLibraryHeaderLen || string(data[:8]) != ttsLibraryMagic {
+		return nil, errors.New("not a TTS library archive")
+	}
+	if bits := binary.LittleEndian.Uint16(data[14:]); bits != 16 {
+		return nil, fmt.Errorf("unsupported sample size %d", bits)
+	}
+	l := &TTSLibrary{
+		data: data,
+		format: ttsPCMFormat{
+			SampleRate: int(binary.LittleEndian.Uint32(data[8:])),
+			Channels:   int(binary.LittleEndian.Uint16(data[12:])),
+		},
+		count:        int(binary.LittleEndian.Uint32(data[16:])),
+		maxRunes:     int(binary.LittleEndian.Uint32(data[20:])),
+		modelVersion: string(bytes.TrimRight(data[40:40+ttsLibraryVersionLen], "\x00")),
+	}
+	// 片段按原样转发给设备，只接受设备格式（也保证按格式计算的时长与停顿有效）
+	if l.format != ttsDevicePCMFormat {
+		return nil, fmt.Errorf("audio format %d Hz x %d channels, devices need %d Hz x %d channels",
+			l.format.SampleRate, l.format.Channels, ttsDevicePCMFormat.SampleRate, ttsDevicePCMFormat.Channels)
+	}
+	keysOffset := binary.LittleEndian.Uint64(data[24:])
+	dataOffset := binary.LittleEndian.Uint64(data[32:])
+	indexEnd := uint64(ttsLibraryHeaderLen + ttsLibraryEntryLen*l.count)
+	if keysOffset != indexEnd || dataOffset < keysOffset || dataOffset > uint64(len(data)) {
+		return nil, errors.New("corrupt archive header")
+	}
+	l.index = data[ttsLibraryHeaderLen:indexEnd]
+	l.keys = data[keysOffset:dataOffset]
+	l.clipData = data[dataOffset:]
+	for i := 0; i < l.count; i++ {
+		off, n, koff, klen := l.entry(i)
+		if off+uint64(n) > uint64(len(l.clipData)) || uint64(koff)+uint64(klen) > uint64(len(l.keys)) {
+			return nil, fmt.Errorf("corrupt index entry %d", i)
+		}
+	}
+	l.pause = make([]byte, int(ttsLibraryPause.Seconds()*float64(l.format.SampleRate))*l.format.Channels*2)
+	return l, nil
+}
+
+func (l *TTSLibrary) entry(i int) (dataOff uint64, dataLen, keyOff, keyLen uint32) {
+	b := l.index[i*ttsLibraryEntryLen:]
+	return binary.LittleEndian.Uint64(b[8:]), binary.LittleEndian.Uint32(b[16:]),
+		binary.LittleEndian.Uint32(b[20:]), binary.LittleEndian.Uint32(b[24:])
+}
+
+func (l *TTSLibrary) hashAt(i int) uint64 {
+	return binary.LittleEndian.Uint64(l.index[i*ttsLibraryEntryLen:])
+}
+
+// 按文本查找片段，返回的PCM直接引用映射的文件内容（只读，归档关闭前有效）
+func (l *TTSLibrary) Clip(key string) ([]byte, bool) {
+	h := ttsLibraryHash(key)
+	i := sort.Search(l.count, func(i int) bool { return l.hashAt(i) >= h })
+	for ; i < l.count && l.hashAt(i) == h; i++ {
+		off, n, koff, klen := l.entry(i)
+		if string(l.keys[koff:koff+klen]) == key {
+			return l.clipData[off : off+uint64(n)], true
+		}
+	}
+	return nil, false
+}
+
+// 把文本从左到右按最长匹配切分为库中的片段；库中没有的标点与空白处插入停顿，
+// 其余任何字符不在库中时返回false（需要合成）
+func (l *TTSLibrary) Assemble(text string) ([][]byte, bool) {
+	var parts [][]byte
+	ends := make([]int, 0, l.maxRunes)
+	for text != "" {
+		// 候选长度从最长键的字符数开始递减
+		ends = ends[:0]
+		for i := range text {
+			if i > 0 {
+				ends = append(ends, i)
+			}
+			if len(ends) == l.maxRunes {
+				break
+			}
+		}
+		if len(ends) < l.maxRunes {
+			ends = append(ends, len(text))
+		}
+		matched := false
+		for k := len(ends) - 1; k >= 0; k-- {
+			if pcm, ok := l.Clip(text[:ends[k]]); ok {
+				parts = append(parts, pcm)
+				text = text[ends[k]:]
+				matched = true
+				break
+			}
+		}
+		if matched {
+			continue
+		}
+		r, size := utf8.DecodeRuneInString(text)
+		if !unicode.IsPunct(r) && !unicode.IsSpace(r) {
+			return nil, false
+		}
+		if len(parts) > 0 && !unicode.IsSpace(r) {
+			parts = append(parts, l.pause)
+		}
+		text = text[size:]
+	}
+	return parts, len(parts) > 0
+}
+
+func (l *TTSLibrary) Len() int             { return l.count }
+func (l *TTSLibrary) Format() ttsPCMFormat { return l.format }
+func (l *TTSLibrary) ModelVersion() string { return l.modelVersion }
+func (l *TTSLibrary) Size() int            { return len(l.data) }
+
+func (l *TTSLibrary) Close() error {
+	if l.release == nil {
+		return nil
+	}
+	return l.release()
+}
+
+// 拼接结果的时长（毫秒）
+func (l *TTSLibrary) durationMs(parts [][]byte) float64 {
+	n := 0
+	for _, p := range parts {
+		n += len(p)
+	}
+	return float64(n) / float64(l.format.SampleRate*l.format.Channels*2) * 1000
+}
+
+// ==================== 离线合成 ====================
+type ttsLibraryBuildStats struct {
+	Clips   int
+	AudioMs float64
+	Bytes   int64
+	Wall    time.Duration
+}
+
+// 裁去片段首尾的静音（保留ttsLibraryTrimPad）；整段静音时原样返回
+func trimPCMSilence(pcm []byte, format ttsPCMFormat) []byte {
+	frame := format.Channels * 2
+	frames := len(pcm) / frame
+	loud := func(i int) bool {
+		for c := 0; c < format.Channels; c++ {
+			v := int16(binary.LittleEndian.Uint16(pcm[i*frame+c*2:]))
+			if v > ttsLibraryTrimLevel || v < -ttsLibraryTrimLevel {
+				return true
+			}
+		}
+		return false
+	}
+	first, last := 0, frames-1
+	for first < frames && !loud(first) {
+		first++
+	}
+	if first == frames {
+		return pcm
+	}
+	for last > first && !loud(last) {
+		last--
+	}
+	pad := int(ttsLibraryTrimPad.Seconds() * float64(format.SampleRate))
+	first = max(first-pad, 0)
+	last = min(last+pad, frames-1)
+	return pcm[first*frame : (last+1)*frame]
+}
+
+// 各合成进程并行领取片段，以设备格式流式合成并裁去首尾静音后写入归档
+func buildTTSLibrary(ctx context.Context, runners []*TTSWorker, clips []string, path string) (ttsLibraryBuildStats, error) {
+	start := time.Now()
+	version, err := runners[0].ModelVersion(ctx)
+	if err != nil {
+		return ttsLibraryBuildStats{}, err
+	}
+	format := ttsDevicePCMFormat
+
+	next := make(chan string)
+	var mu sync.Mutex
+	rendered := make(map[string][]byte, len(clips))
+	var firstErr error
+	var wg sync.WaitGroup
+	for _, w := range runners {
+		wg.Add(1)
+		go func(w *TTSWorker) {
+			defer wg.Done()
+			for text := range next {
+				var pcm []byte
+				_, err := w.SynthesizeStream(ctx, text, TTSPrompt{}, "", format, func(chunk []byte, f ttsPCMFormat) error {
+					pcm = append(pcm, chunk...)
+					return nil
+				})
+				mu.Lock()
+				if err != nil && firstErr == nil {
+					firstErr = fmt.Errorf("%q: %v", text, err)
+				}
+				rendered[text] = trimPCMSilence(pcm, format)
+				mu.Unlock()
+			}
+		}(w)
+	}
+	for _, text := range clips {
+		mu.Lock()
+		failed := firstErr != nil
+		mu.Unlock()
+		if failed {
+			break
+		}
+		next <- text
+	}
+	close(next)
+	wg.Wait()
+	if firstErr != nil {
+		return ttsLibraryBuildStats{}, firstErr
+	}
+	if err := writeTTSLibrary(path, format, version, rendered); err != nil {
+		return ttsLibraryBuildStats{}, err
+	}
+
+	stats := ttsLibraryBuildStats{Clips: len(rendered), Wall: time.Since(start)}
+	for _, pcm := range rendered {
+		stats.AudioMs += float64(len(pcm)) / float64(format.SampleRate*format.Channels*2) * 1000
+	}
+	if st, err := os.Stat(path); err == nil {
+		stats.Bytes = st.Size()
+	}
+	return stats, nil
+}
+
+// -tts-library-build：用常驻合成进程渲染库定义中的全部片段，写入归档后退出
+func runTTSLibraryBuild(specPath, outPath string, argv []string, dir string, workers int) error {
+	spec, err := LoadTTSLibrarySpec(specPath)
+	if err != nil {
+		return err
+	}
+	clips, err := spec.Clips()
+	if err != nil {
+		return err
+	}
+	runners, err := startTTSWorkers(argv, dir, max(workers, 1))
+	if err != nil {
+		return err
+	}
+	defer stopTTSWorkers(runners)
+	fmt.Printf("rendering %d clips from %s with %d worker(s)\n", len(clips), specPath, len(runners))
+	stats, err := buildTTSLibrary(context.Background(), runners, clips, outPath)
+	if err != nil {
+		return err
+	}
+	printTTSLibraryBuild(outPath, stats)
+	return nil
+}
+
+func printTTSLibraryBuild(path string, stats ttsLibraryBuildStats) {
+	fmt.Printf("%s: %d clips, %.1fs audio, %.1f MB in %v (%.1f clips/s, %.1fx realtime)\n",
+		path, stats.Clips, stats.AudioMs/1000, float64(stats.Bytes)/(1<<20), stats.Wall.Round(time.Millisecond),
+		float64(stats.Clips)/stats.Wall.Seconds(), stats.AudioMs/1000/stats.Wall.Seconds())
+}
+
+// ==================== 任务使用 ====================
+// 没有参考音色、且库与合成进程的模型版本一致时，能完全由库中片段拼出的文本不经合成。
+// 每次查找都核对版本；版本未知（未启用常驻进程，或进程尚未报告版本）时不使用库
+func (q *TTSJobQueue) libraryClips(req TTSJobRequest) [][]byte {
+	lib := ttsLibrary
+	if lib == nil || req.Prompt.Voice != nil || req.Prompt.Wav != "" || !q.Streaming() {
+		return nil
+	}
+	if version := q.runners[0].Stats().ModelVersion; version == "" || version != lib.ModelVersion() {
+		return nil
+	}
+	parts, ok := lib.Assemble(strings.TrimSpace(req.Text))
+	if !ok {
+		return nil
+	}
+	return parts
+}
+
+// speak任务把片段依次按帧转发；file任务写成WAV
+func (q *TTSJobQueue) playLibrary(ctx context.Context, job *ttsJob, progress func(audioMs float64)) (string, time.Duration, error) {
+	lib := ttsLibrary
+	if job.req.Kind == "speak" {
+		readers := make([]io.Reader, len(job.clips))
+		for i, pcm := range job.clips {
+			readers[i] = bytes.NewReader(pcm)
+		}
+		stats, err := relayPCM(job.req.Targets, ctxReader{ctx, io.MultiReader(readers...)})
+		progress(stats.Duration() * 1000)
+		var firstAudio time.Duration
+		if !stats.FirstFrame.IsZero() {
+			firstAudio = stats.FirstFrame.Sub(job.started)
+		}
+		return "", firstAudio, err
+	}
+
+	path := ttsJobResultPath(job.id)
+	format := lib.Format()
+	out, err := createWAVFile(path, format.SampleRate, format.Channels)
+	if err != nil {
+		return "", 0, err
+	}
+	for _, pcm := range job.clips {
+		if err = out.write(pcm); err != nil {
+			break
+		}
+	}
+	if cerr := out.close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		os.Remove(path)
+		return "", 0, err
+	}
+	progress(lib.durationMs(job.clips))
+	return path, 0, nil
+}
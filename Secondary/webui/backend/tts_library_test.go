@@ -0,0 +1,244 @@
+/***
+ * @file tts_library_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief 预渲染播报库测试（片段展开、归档写入与解析、最长匹配拼接、模型版本与格式校验）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath tts_library_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"encoding/binary"
+	"os"
+	"path/filepath"
+	"slices"
+	"strings"
+	"testing"
+	"time"
+)
+
+// 用libraryBenchSpec写出归档并打开；每个片段的PCM为一个立体声帧，内容为片段序号，便于从拼接结果反查文本
+func writeTestLibrary(t *testing.T, version string) (*TTSLibrary, []string, string) {
+	t.Helper()
+	keys, err := libraryBenchSpec.Clips()
+	if err != nil {
+		t.Fatalf("Clips: %v", err)
+	}
+	clips := make(map[string][]byte, len(keys))
+	for i, k := range keys {
+		clips[k] = binary.LittleEndian.AppendUint32(nil, uint32(i+1))
+	}
+	path := filepath.Join(t.TempDir(), "tts_library.bin")
+	if err := writeTTSLibrary(path, ttsDevicePCMFormat, version, clips); err != nil {
+		t.Fatalf("writeTTSLibrary: %v", err)
+	}
+	lib, err := OpenTTSLibrary(path)
+	if err != nil {
+		t.Fatalf("OpenTTSLibrary: %v", err)
+	}
+	t.Cleanup(func() { lib.Close() })
+	return lib, keys, path
+}
+
+// 拼接结果转为片段文本，停顿记为"|"
+func assembledKeys(lib *TTSLibrary, keys []string, parts [][]byte) []string {
+	var out []string
+	for _, p := range parts {
+		if len(p) == 4 {
+			out = append(out, keys[binary.LittleEndian.Uint32(p)-1])
+		} else if len(p) == len(lib.pause) {
+			out = append(out, "|")
+		} else {
+			out = append(out, "?")
+		}
+	}
+	return out
+}
+
+func TestTTSLibraryClips(t *testing.T) {
+	keys, err := libraryBenchSpec.Clips()
+	if err != nil {
+		t.Fatal(err)
+	}
+	// 4条短语 + 40个床号 + 51个体温 + 模板的2个固定部分（模板开头的空串不计）
+	if len(keys) != 4+40+51+2 {
+		t.Fatalf("%d clips, want %d", len(keys), 4+40+51+2)
+	}
+	if keys[4] != "1" || keys[43] != "40" || keys[44] != "号床病人体温" || keys[45] != "36.0" ||
+		keys[95] != "41.0" || keys[96] != "度，请及时处理" {
+		t.Errorf("clips out of definition order: %q", keys[4:])
+	}
+
+	tests := []struct {
+		name string
+		spec TTSLibrarySpec
+		want []string
+		err  bool
+	}{
+		{"duplicates and blanks", TTSLibrarySpec{Phrases: []string{" 请注意 ", "请注意", "", "好"},
+			Templates: []TTSLibraryTemplate{{Text: "好{n}", Slots: map[string]TTSLibrarySlot{"n": {Values: []string{"请注意", "x"}}}}}},
+			[]string{"请注意", "好", "x"}, false},
+		{"step and decimals", TTSLibrarySpec{Templates: []TTSLibraryTemplate{{Text: "{v}",
+			Slots: map[string]TTSLibrarySlot{"v": {From: 0.5, To: 1.5, Step: 0.5, Decimals: 2}}}}},
+			[]string{"0.50", "1.00", "1.50"}, false},
+		{"unclosed slot", TTSLibrarySpec{Templates: []TTSLibraryTemplate{{Text: "a{b"}}}, nil, true},
+		{"slot without values", TTSLibrarySpec{Templates: []TTSLibraryTemplate{{Text: "a{b}c"}}}, nil, true},
+	}
+	for _, tt := range tests {
+		got, err := tt.spec.Clips()
+		if (err != nil) != tt.err || !slices.Equal(got, tt.want) {
+			t.Errorf("%s: Clips = %q, %v; want %q (error %v)", tt.name, got, err, tt.want, tt.err)
+		}
+	}
+}
+
+// 写出后重新解析：头部字段、数据区对齐、每个片段的查找
+func TestTTSLibraryArchive(t *testing.T) {
+	lib, keys, path := writeTestLibrary(t, "m1")
+	if lib.Len() != len(keys) || lib.ModelVersion() != "m1" || lib.Format() != ttsDevicePCMFormat {
+		t.Errorf("opened %d clips, version %q, format %+v; want %d, \"m1\", %+v",
+			lib.Len(), lib.ModelVersion(), lib.Format(), len(keys), ttsDevicePCMFormat)
+	}
+	if off := binary.LittleEndian.Uint64(lib.data[32:]); off%ttsLibraryDataAlign != 0 {
+		t.Errorf("data offset %d not aligned to %d", off, ttsLibraryDataAlign)
+	}
+	for i, k := range keys {
+		pcm, ok := lib.Clip(k)
+		if !ok || len(pcm) != 4 || binary.LittleEndian.Uint32(pcm) != uint32(i+1) {
+			t.Errorf("Clip(%q) = % x, %v; want clip %d", k, pcm, ok, i+1)
+		}
+	}
+	for _, k := range []string{"", "请", "41", "38.50", "请注意 "} {
+		if _, ok := lib.Clip(k); ok {
+			t.Errorf("Clip(%q) found a clip", k)
+		}
+	}
+	if pause := time.Duration(lib.durationMs([][]byte{lib.pause}) * float64(time.Millisecond)); pause != ttsLibraryPause {
+		t.Errorf("pause lasts %v, want %v", pause, ttsLibraryPause)
+	}
+	if entries, _ := os.ReadDir(filepath.Dir(path)); len(entries) != 1 {
+		t.Errorf("archive dir has %d files, want 1 (temp file left behind)", len(entries))
+	}
+}
+
+// 从左到右最长匹配：38.5优先于床号38，"度，请及时处理"整段匹配不插停顿；
+// 库中没有的标点插入停顿，空白不插，开头的标点不插；其他字符不在库中时不可拼接
+func TestTTSLibraryAssemble(t *testing.T) {
+	lib, keys, _ := writeTestLibrary(t, "m1")
+	tests := []struct {
+		text string
+		want []string // nil表示不可拼接
+	}{
+		{"请注意，38号床病人体温38.5度，请及时处理",
+			[]string{"请注意", "|", "38", "号床病人体温", "38.5", "度，请及时处理"}},
+		{"40号床病人体温41.0度，请及时处理", []string{"40", "号床病人体温", "41.0", "度，请及时处理"}},
+		{"请注意 请保持病区安静", []string{"请注意", "请保持病区安静"}},
+		{"，护士请到护士站。", []string{"护士请到护士站", "|"}},
+		{"探视时间已结束，请家属离开病区", []string{"探视时间已结束，请家属离开病区"}},
+		{"请注意，护士请到三号病房", nil},
+		{"12号床病人血压偏高", nil},
+		{"，。", nil},
+		{"", nil},
+	}
+	for _, tt := range tests {
+		parts, ok := lib.Assemble(tt.text)
+		if got := assembledKeys(lib, keys, parts); ok != (tt.want != nil) || !slices.Equal(got, tt.want) {
+			t.Errorf("Assemble(%q) = %q, %v; want %q", tt.text, got, ok, tt.want)
+		}
+	}
+}
+
+// 库与合成进程的模型版本不一致（或版本未知）时不使用库；带参考音色时也不使用
+func TestTTSLibraryModelVersion(t *testing.T) {
+	lib, _, _ := writeTestLibrary(t, "m1")
+	saved := ttsLibrary
+	ttsLibrary = lib
+	defer func() { ttsLibrary = saved }()
+
+	worker := func(version string) *TTSWorker {
+		return &TTSWorker{proc: &workerProc{started: time.Now()}, info: ttsWorkerEvent{ModelVersion: version}}
+	}
+	text := "请注意，12号床病人体温38.5度，请及时处理"
+	tests := []struct {
+		name   string
+		worker *TTSWorker
+		prompt TTSPrompt
+		use    bool
+	}{
+		{"same version", worker("m1"), TTSPrompt{}, true},
+		{"other version", worker("m2"), TTSPrompt{}, false},
+		{"version not reported", worker(""), TTSPrompt{}, false},
+		{"no resident worker", nil, TTSPrompt{}, false},
+		{"reference audio", worker("m1"), TTSPrompt{Text: "t", Wav: "ref.wav"}, false},
+	}
+	for _, tt := range tests {
+		q := &TTSJobQueue{runners: []*TTSWorker{tt.worker}}
+		if got := q.libraryClips(TTSJobRequest{Kind: "speak", Text: " " + text + "\n", Prompt: tt.prompt}); (got != nil) != tt.use {
+			t.Errorf("%s: library used = %v, want %v", tt.name, got != nil, tt.use)
+		}
+	}
+}
+
+// 损坏或格式不符的归档在打开时拒绝，不会在查找时越界
+func TestTTSLibraryBadArchive(t *testing.T) {
+	_, _, path := writeTestLibrary(t, "m1")
+	good, err := os.ReadFile(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	modify := func(fn func(b []byte) []byte) []byte {
+		return fn(append([]byte(nil), good...))
+	}
+	tests := []struct {
+		name string
+		data []byte
+		err  string
+	}{
+		{"empty", nil, "not a TTS library"},
+		{"wrong magic", modify(func(b []byte) []byte { b[0] = 'W'; return b }), "not a TTS library"},
+		{"truncated header", good[:ttsLibraryHeaderLen-1], "not a TTS library"},
+		{"8-bit samples", modify(func(b []byte) []byte { b[14] = 8; return b }), "sample size"},
+		{"16kHz", modify(func(b []byte) []byte { binary.LittleEndian.PutUint32(b[8:], 16000); return b }), "devices need"},
+		{"mono", modify(func(b []byte) []byte { binary.LittleEndian.PutUint16(b[12:], 1); return b }), "devices need"},
+		{"count past keys", modify(func(b []byte) []byte {
+			binary.LittleEndian.PutUint32(b[16:], binary.LittleEndian.Uint32(b[16:])+1)
+			return b
+		}), "corrupt archive header"},
+		{"data offset past end", modify(func(b []byte) []byte {
+			binary.LittleEndian.PutUint64(b[32:], uint64(len(b)+1))
+			return b
+		}), "corrupt archive header"},
+		{"clip past end", modify(func(b []byte) []byte {
+			binary.LittleEndian.PutUint32(b[ttsLibraryHeaderLen+16:], 1<<20)
+			return b
+		}), "corrupt index entry 0"},
+		{"truncated data", good[:len(good)-1], "corrupt index entry"},
+	}
+	for _, tt := range tests {
+		if _, err := parseTTSLibrary(tt.data); err == nil || !strings.Contains(err.Error(), tt.err) {
+			t.Errorf("%s: err %v, want %q", tt.name, err, tt.err)
+		}
+	}
+
+	bad := filepath.Join(t.TempDir(), "bad.bin")
+	os.WriteFile(bad, good[:64], 0644)
+	if _, err := OpenTTSLibrary(bad); err == nil || !strings.HasPrefix(err.Error(), bad) {
+		t.Errorf("OpenTTSLibrary(truncated): err %v, want it prefixed with the path", err)
+	}
+	long := filepath.Join(t.TempDir(), "long.bin")
+	if err := writeTTSLibrary(long, ttsDevicePCMFormat, strings.Repeat("v", ttsLibraryVersionLen+1), nil); err == nil {
+		t.Error("writeTTSLibrary with an over-long model version: no error")
+	}
+	if _, err := os.Stat(long); !os.IsNotExist(err) {
+		t.Error("over-long model version: archive was written")
+	}
+}
@@ -0,0 +1,190 @@
+/***
+ * @file tts_sentences.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-25
+ * @brief 分句并行合成（长文本按句拆分给空闲的合成进程，按原顺序输出音频）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-25
+ * @filePath tts_sentences.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"sync"
+	"time"
+)
+
+// ==================== 调度方式 ====================
+// 执行任务的合成进程（所有者）先让进程分句，把第2句起放入同优先级的句子队列，然后按顺序处理每一句：
+//   - 该句仍在队列中：所有者自己合成，音频块直接交给onChunk（与整段合成相同的流式路径与反压）
+//   - 该句已被空闲进程领取：所有者按顺序转发其已缓冲的音频块，等待后续块或该句结束
+// 空闲进程在同一优先级中先领取执行中任务的句子，再领取排队的任务，因此单个长文本可用满所有进程，
+// 而报警任务仍先于日常任务的句子。只有一个进程时各句依次合成，每句的生成长度与上下文较短。
+// 只有一句或分句失败时按整段合成。
+// 按句合成会失去跨句的韵律衔接，由 -tts-sentences=false 关闭。
+
+// 合成函数：按format（零值为模型采样率单声道）把音频块按顺序交给onChunk
+type ttsSynthFunc func(ctx context.Context, format ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error)
+
+type ttsSentence struct {
+	job    *ttsJob
+	ctx    context.Context // 任务的ctx，任务结束时取消
+	index  int
+	text   string
+	format ttsPCMFormat // 请求的输出格式
+	taken  bool         // 已被所有者或空闲进程领取，由队列锁保护
+
+	mu       sync.Mutex
+	chunks   [][]byte // 尚未转发的音频块
+	chunkFmt ttsPCMFormat
+	done     bool
+	res      TTSResult
+	err      error
+	notify   chan struct{} // 有新音频块或已结束，容量1
+}
+
+// 音频块的缓冲区在回调返回后复用，缓冲时复制
+func (s *ttsSentence) push(pcm []byte, format ttsPCMFormat) error {
+	s.mu.Lock()
+	s.chunks = append(s.chunks, append([]byte(nil), pcm...))
+	s.chunkFmt = format
+	s.mu.Unlock()
+	s.wake()
+	return nil
+}
+
+func (s *ttsSentence) finish(res TTSResult, err error) {
+	s.mu.Lock()
+	s.done = true
+	s.res, s.err = res, err
+	s.mu.Unlock()
+	s.wake()
+}
+
+func (s *ttsSentence) wake() {
+	select {
+	case s.notify <- struct{}{}:
+	default:
+	}
+}
+
+// 空闲进程合成该句并缓冲全部音频块
+func (s *ttsSentence) run(w *TTSWorker) {
+	res, err := w.SynthesizeStream(s.ctx, s.text, s.job.req.Prompt, s.job.req.Profile, s.format, s.push)
+	s.finish(res, err)
+}
+
+// 按顺序转发已缓冲与后续的音频块，直到该句结束
+func (s *ttsSentence) drain(ctx context.Context, onChunk TTSChunkFunc) (TTSResult, error) {
+	for {
+		s.mu.Lock()
+		chunks, format, done := s.chunks, s.chunkFmt, s.done
+		s.chunks = nil
+		s.mu.Unlock()
+		for _, pcm := range chunks {
+			if err := onChunk(pcm, format); err != nil {
+				return TTSResult{}, err
+			}
+		}
+		if done {
+			// 结束前的音频块已在上面取出
+			return s.res, s.err
+		}
+		select {
+		case <-s.notify:
+		case <-ctx.Done():
+			return TTSResult{}, ctx.Err()
+		}
+	}
+}
+
+// ==================== 所有者：分句并按顺序输出 ====================
+func (q *TTSJobQueue) synthesize(ctx context.Context, w *TTSWorker, job *ttsJob, format ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error) {
+	whole := func() (TTSResult, error) {
+		return w.SynthesizeStream(ctx, job.req.Text, job.req.Prompt, job.req.Profile, format, onChunk)
+	}
+	if !q.splitSentences {
+		return whole()
+	}
+	start := time.Now()
+	texts, err := w.SplitSentences(ctx, job.req.Text)
+	if err != nil || len(texts) < 2 {
+		return whole()
+	}
+
+	items := make([]*ttsSentence, len(texts))
+	for i, text := range texts {
+		items[i] = &ttsSentence{job: job, ctx: ctx, index: i, text: text, format: format, notify: make(chan struct{}, 1)}
+	}
+	p := job.req.Priority
+	q.mu.Lock()
+	items[0].taken = true
+	q.sentences[p] = append(q.sentences[p], items[1:]...)
+	q.cond.Broadcast()
+	q.mu.Unlock()
+	defer q.dropSentences(job)
+
+	var total TTSResult
+	for _, s := range items {
+		var res TTSResult
+		if s.index == 0 || q.claimSentence(s) {
+			res, err = w.SynthesizeStream(ctx, s.text, job.req.Prompt, job.req.Profile, format, onChunk)
+		} else {
+			res, err = s.drain(ctx, onChunk)
+		}
+		if err != nil {
+			return total, err
+		}
+		if s.index == 0 {
+			total.FirstChunkMs = res.FirstChunkMs
+			total.PromptMs = res.PromptMs
+		}
+		total.AudioMs += res.AudioMs
+		total.SynthMs += res.SynthMs
+		total.PCMBytes += res.PCMBytes
+	}
+	total.Sentences = texts
+	total.Elapsed = time.Since(start)
+	return total, nil
+}
+
+// 该句尚未被领取时由调用方领取并移出句子队列
+func (q *TTSJobQueue) claimSentence(s *ttsSentence) bool {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	if s.taken {
+		return false
+	}
+	s.taken = true
+	list := q.sentences[s.job.req.Priority]
+	for i, item := range list {
+		if item == s {
+			q.sentences[s.job.req.Priority] = append(list[:i:i], list[i+1:]...)
+			break
+		}
+	}
+	return true
+}
+
+// 任务结束（完成、出错或取消）时移除尚未领取的句子；已领取的随任务ctx取消
+func (q *TTSJobQueue) dropSentences(job *ttsJob) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	p := job.req.Priority
+	kept := q.sentences[p][:0]
+	for _, s := range q.sentences[p] {
+		if s.job != job {
+			kept = append(kept, s)
+		}
+	}
+	clear(q.sentences[p][len(kept):])
+	q.sentences[p] = kept
+}
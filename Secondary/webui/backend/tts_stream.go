@@ -0,0 +1,90 @@
+/***
+ * @file tts_stream.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-21
+ * @brief 流式语音合成直接播放（合成进程输出设备格式的音频块 -> 节拍转发到设备）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-21
+ * @filePath tts_stream.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"io"
+	"time"
+)
+
+// 合成并播放的结果
+type ttsSpeakResult struct {
+	Synth      TTSResult
+	Relay      pcmRelayStats
+	FirstAudio time.Duration // 从请求开始到首个音频帧进入设备发送队列
+}
+
+// ==================== 合成并直接播放 ====================
+// 合成进程每产生一个音频块（约80ms，已是44.1kHz立体声的设备格式），经管道交给转发协程，
+// 按3000字节一帧发给设备，设备发送队列由节拍器按播放速率放行。音频块从读取缓冲区直接复制进设备帧，
+// 只有合成函数给出其他格式的音频块时才在转发协程中解码并重采样。
+// 管道无缓冲，转发阻塞时回调阻塞，进而反压合成进程；首个音频块到达时才向设备发送0xA3。
+// ctx取消（如HTTP客户端断开）或设备全部断开时合成在下一个生成步停止，设备丢弃已缓冲的音频。
+// record不为nil时同时写入转发给设备的PCM（合成缓存），是否保留由调用方根据返回的错误决定。
+func speakText(ctx context.Context, synth ttsSynthFunc, targets []string, record io.Writer) (ttsSpeakResult, error) {
+	var res ttsSpeakResult
+	start := time.Now()
+
+	type relayOutcome struct {
+		stats pcmRelayStats
+		err   error
+	}
+	var pw *io.PipeWriter
+	relayDone := make(chan relayOutcome, 1)
+
+	onChunk := func(pcm []byte, format ttsPCMFormat) error {
+		if pw == nil {
+			var pr *io.PipeReader
+			pr, pw = io.Pipe()
+			go func() {
+				var src io.Reader = pr
+				if format != ttsDevicePCMFormat {
+					src = newRawPCMStream(pr, format.SampleRate, format.Channels, 16)
+				}
+				if record != nil {
+					src = io.TeeReader(src, record)
+				}
+				stats, err := relayPCM(targets, src)
+				pr.CloseWithError(err) // 转发提前结束时后续写入失败（err为nil时返回io.ErrClosedPipe）
+				relayDone <- relayOutcome{stats, err}
+			}()
+		}
+		_, err := pw.Write(pcm)
+		return err
+	}
+
+	synthRes, err := synth(ctx, ttsDevicePCMFormat, onChunk)
+	res.Synth = synthRes
+	if pw == nil {
+		return res, err
+	}
+	if err != nil {
+		pw.CloseWithError(err)
+	} else {
+		pw.Close()
+	}
+	outcome := <-relayDone
+	res.Relay = outcome.stats
+	if !outcome.stats.FirstFrame.IsZero() {
+		res.FirstAudio = outcome.stats.FirstFrame.Sub(start)
+	}
+	if err == nil {
+		err = outcome.err
+	}
+	return res, err
+}
@@ -0,0 +1,221 @@
+/***
+ * @file tts_voices.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-24
+ * @brief 已注册音色（参考音频上传一次，提示缓存预先编码并持久化，合成请求按音色ID引用）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-24
+ * @filePath tts_voices.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"context"
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+)
+
+// ==================== 存储格式 ====================
+// 每个音色在目录下有三个文件：
+//   <id>.json    元数据（名称、参考文本、参考音频摘要）
+//   <id><扩展名> 上传的参考音频，模型版本变化时由合成进程据此重新编码
+//   <id>.prompt  合成进程编码的提示缓存（文本token与audio VAE特征，带模型版本）
+// 元数据最后写入且经临时文件rename，启动时只加载元数据完整的音色。
+
+var errVoiceNotFound = errors.New("voice not found")
+
+// 全局音色表
+var ttsVoices *VoiceRegistry
+
+type TTSVoice struct {
+	ID         string    `json:"id"`
+	Name       string    `json:"name"`
+	PromptText string    `json:"prompt_text"`
+	AudioFile  string    `json:"audio_file"`
+	AudioBytes int64     `json:"audio_bytes"`
+	SHA256     string    `json:"sha256"` // 参考音频内容，参与合成缓存的键
+	EncodeMs   float64   `json:"encode_ms"`
+	Created    time.Time `json:"created"`
+
+	dir string
+}
+
+func (v *TTSVoice) workerVoice() *ttsWorkerVoice {
+	return &ttsWorkerVoice{
+		ID:         v.ID,
+		Wav:        filepath.Join(v.dir, v.AudioFile),
+		PromptText: v.PromptText,
+		Cache:      filepath.Join(v.dir, v.ID+".prompt"),
+	}
+}
+
+type VoiceRegistry struct {
+	dir    string
+	mu     sync.Mutex
+	voices map[string]*TTSVoice
+}
+
+// ==================== 加载音色目录 ====================
+func NewVoiceRegistry(dir string) (*VoiceRegistry, error) {
+	abs, err := filepath.Abs(dir)
+	if err != nil {
+		return nil, err
+	}
+	if err := os.MkdirAll(abs, 0755); err != nil {
+		return nil, err
+	}
+	r := &VoiceRegistry{dir: abs, voices: make(map[string]*TTSVoice)}
+	files, err := filepath.Glob(filepath.Join(abs, "*.json"))
+	if err != nil {
+		return nil, err
+	}
+	for _, path := range files {
+		data, err := os.ReadFile(path)
+		if err != nil {
+			continue
+		}
+		v := &TTSVoice{}
+		if err := json.Unmarshal(data, v); err != nil || v.ID == "" {
+			log.Printf("TTS voices: skipping %s: invalid metadata", filepath.Base(path))
+			continue
+		}
+		v.dir = abs
+		r.voices[v.ID] = v
+	}
+	log.Printf("TTS voices: %s, %d registered", abs, len(r.voices))
+	return r, nil
+}
+
+// ==================== 注册 ====================
+// 保存参考音频并计算摘要，由合成进程编码提示缓存后写入元数据；任一步失败时删除已写入的文件
+func (r *VoiceRegistry) Register(ctx context.Context, w *TTSWorker, name, promptText, filename string, audio io.Reader) (TTSVoice, error) {
+	if strings.TrimSpace(promptText) == "" {
+		return TTSVoice{}, errors.New("prompt_text is required")
+	}
+	if w == nil {
+		return TTSVoice{}, errWorkerMissing
+	}
+	id := fmt.Sprintf("voice-%x", time.Now().UnixNano())
+	if name == "" {
+		name = id
+	}
+	v := &TTSVoice{
+		ID:         id,
+		Name:       name,
+		PromptText: promptText,
+		AudioFile:  id + strings.ToLower(filepath.Ext(filepath.Base(filename))),
+		Created:    time.Now(),
+		dir:        r.dir,
+	}
+	if v.AudioFile == id {
+		v.AudioFile = id + ".wav"
+	}
+	wv := v.workerVoice()
+	cleanup := func() {
+		os.Remove(wv.Wav)
+		os.Remove(wv.Cache)
+	}
+
+	f, err := os.Create(wv.Wav)
+	if err != nil {
+		return TTSVoice{}, err
+	}
+	h := sha256.New()
+	v.AudioBytes, err = io.Copy(io.MultiWriter(f, h), audio)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		cleanup()
+		return TTSVoice{}, fmt.Errorf("failed to save prompt audio: %v", err)
+	}
+	v.SHA256 = hex.EncodeToString(h.Sum(nil))
+
+	if v.EncodeMs, err = w.RegisterVoice(ctx, v); err != nil {
+		cleanup()
+		return TTSVoice{}, err
+	}
+	if err := r.writeMeta(v); err != nil {
+		cleanup()
+		return TTSVoice{}, err
+	}
+
+	r.mu.Lock()
+	r.voices[id] = v
+	r.mu.Unlock()
+	log.Printf("TTS voices: registered %s (%q, %d bytes, prompt encoded in %.0fms)", id, name, v.AudioBytes, v.EncodeMs)
+	return *v, nil
+}
+
+func (r *VoiceRegistry) writeMeta(v *TTSVoice) error {
+	data, err := json.MarshalIndent(v, "", "  ")
+	if err != nil {
+		return err
+	}
+	path := filepath.Join(r.dir, v.ID+".json")
+	tmp := path + ".partial"
+	if err := os.WriteFile(tmp, data, 0644); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+	return os.Rename(tmp, path)
+}
+
+// ==================== 查询与删除 ====================
+func (r *VoiceRegistry) Get(id string) (*TTSVoice, error) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	v := r.voices[id]
+	if v == nil {
+		return nil, errVoiceNotFound
+	}
+	return v, nil
+}
+
+// 按注册时间排列
+func (r *VoiceRegistry) List() []TTSVoice {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	list := make([]TTSVoice, 0, len(r.voices))
+	for _, v := range r.voices {
+		list = append(list, *v)
+	}
+	sort.Slice(list, func(i, j int) bool { return list[i].Created.Before(list[j].Created) })
+	return list
+}
+
+// 先删除元数据，其他文件删除失败时不会再被加载；合成进程内存中的提示缓存随LRU淘汰
+func (r *VoiceRegistry) Delete(id string) error {
+	r.mu.Lock()
+	v := r.voices[id]
+	delete(r.voices, id)
+	r.mu.Unlock()
+	if v == nil {
+		return errVoiceNotFound
+	}
+	if err := os.Remove(filepath.Join(r.dir, id+".json")); err != nil {
+		return err
+	}
+	wv := v.workerVoice()
+	os.Remove(wv.Wav)
+	os.Remove(wv.Cache)
+	return nil
+}
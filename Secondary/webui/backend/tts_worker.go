@@ -0,0 +1,886 @@
+/***
+ * @file tts_worker.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-20
+ * @brief VoxCPM常驻合成进程监管（启动就绪、健康检查、超时重启、JSON行协议、流式合成）；识别进程复用同一监管，见asr_worker.go
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-20
+ * @filePath tts_worker.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bufio"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// ==================== 监管参数 ====================
+const (
+	ttsWorkerReadyTimeout = 10 * time.Minute // 模型加载 + 预热的最长时间
+	ttsWorkerPingInterval = 15 * time.Second // 空闲时健康检查间隔
+	ttsWorkerPingTimeout  = 5 * time.Second
+	ttsRequestTimeout     = 5 * time.Minute  // 单次合成最长时间，超时视为进程卡死并重启
+	ttsCancelGrace        = 30 * time.Second // 批量解码时超时或取消后等待进程确认取消的时间，过后才结束进程
+	ttsRestartBackoffMin  = 1 * time.Second
+	ttsRestartBackoffMax  = 30 * time.Second
+	ttsWorkerLineMax      = 1 << 20
+	ttsWorkerChunkMax     = 16 << 20 // 单个音频块的最大字节数
+
+	// 合成参数，与原voxcpm_tts.py一致；同时参与合成缓存的键
+	ttsCfgValue           = 2.0
+	ttsInferenceTimesteps = 10
+)
+
+var (
+	errWorkerExited   = errors.New("tts worker exited")
+	errWorkerStopped  = errors.New("tts worker stopped")
+	errWorkerNotReady = errors.New("tts worker not ready")
+	errCallCancelled  = errors.New("tts request cancelled")
+)
+
+// ==================== 协议消息 ====================
+type ttsWorkerRequest struct {
+	ID         uint64 `json:"id"`
+	Op         string `json:"op"`
+	Text       string `json:"text,omitempty"`
+	PromptWav  string `json:"prompt_wav,omitempty"`
+	PromptText string `json:"prompt_text,omitempty"`
+	Output     string `json:"output,omitempty"`
+
+	CfgValue           float64 `json:"cfg_value,omitempty"`
+	InferenceTimesteps int     `json:"inference_timesteps,omitempty"`
+	Profile            string  `json:"profile,omitempty"` // 解码档位，为空时按InferenceTimesteps原样解码
+
+	// 流式合成的输出格式，为0时为模型采样率单声道
+	SampleRate int `json:"sample_rate,omitempty"`
+	Channels   int `json:"channels,omitempty"`
+
+	Voice *ttsWorkerVoice `json:"voice,omitempty"`
+
+	// 识别：请求行之后紧跟的音频文件内容
+	Bytes int    `json:"bytes,omitempty"`
+	Audio []byte `json:"-"`
+}
+
+// 批量解码时进程可单独取消的请求（在批量中逐步生成）；其余请求在两步之间一次完成
+func (r ttsWorkerRequest) cancellable() bool {
+	return r.Op == "synthesize" || r.Op == "synthesize_stream"
+}
+
+// 已注册音色：进程按ID在内存中查找提示缓存，没有时从Cache加载，缓存缺失或模型版本不符时由Wav重新编码
+type ttsWorkerVoice struct {
+	ID         string `json:"id"`
+	Wav        string `json:"wav"`
+	PromptText string `json:"prompt_text"`
+	Cache      string `json:"cache"`
+}
+
+type ttsWorkerEvent struct {
+	ID           uint64   `json:"id"`
+	Event        string   `json:"event"`
+	Path         string   `json:"path"`
+	Bytes        int      `json:"bytes"` // chunk事件：协议行之后紧跟的PCM字节数
+	PCM          []byte   `json:"-"`     // chunk事件：16位小端PCM，来自ttsPCMPool
+	AudioMs      float64  `json:"audio_ms"`
+	SynthMs      float64  `json:"synth_ms"`
+	FirstChunkMs float64  `json:"first_chunk_ms"`
+	PromptMs     float64  `json:"prompt_ms"`
+	Cancelled    bool     `json:"cancelled"`
+	Error        string   `json:"error"`
+	PID          int      `json:"pid"`
+	LoadMs       float64  `json:"load_ms"`
+	WarmupMs     float64  `json:"warmup_ms"`
+	SampleRate   int      `json:"sample_rate"`
+	ModelVersion string   `json:"model_version"`
+	Sentences    []string `json:"sentences"`
+	Text         string   `json:"text"`         // 识别结果
+	RecognizeMs  float64  `json:"recognize_ms"` // 识别：所在批次的识别耗时
+	Batch        int      `json:"batch"`        // 识别：所在批次的请求数
+	RSSMB        float64  `json:"rss_mb"`       // 就绪时进程的常驻内存
+}
+
+// 合成结果
+type TTSResult struct {
+	Path         string
+	AudioMs      float64
+	SynthMs      float64 // 进程内合成耗时
+	FirstChunkMs float64 // 流式合成：进程内首个音频块耗时
+	PromptMs     float64 // 取得参考音色提示缓存的耗时（上传的参考音频为编码耗时）
+	PCMBytes     int64   // 流式合成：经管道收到的PCM字节数
+	Sentences    []string
+	Elapsed      time.Duration
+}
+
+// 参考音色：Voice为已注册音色，否则Wav与Text为本次上传的参考音频与参考文本；都为空时不克隆音色
+type TTSPrompt struct {
+	Text  string
+	Wav   string
+	Voice *TTSVoice
+}
+
+func (p TTSPrompt) apply(req *ttsWorkerRequest) {
+	if p.Voice != nil {
+		req.Voice = p.Voice.workerVoice()
+		return
+	}
+	req.PromptWav = p.Wav
+	req.PromptText = p.Text
+}
+
+// 流式合成的音频块格式（16位小端PCM）；请求时为零值表示模型的采样率、单声道
+type ttsPCMFormat struct {
+	SampleRate int
+	Channels   int
+}
+
+// 设备格式：直接播放的请求由合成进程输出该格式，转发时不再解码与重采样
+var ttsDevicePCMFormat = ttsPCMFormat{SampleRate: defaultSampleRate, Channels: defaultChannels}
+
+// 流式合成的音频块回调：pcm为16位小端PCM，只在回调期间有效（缓冲区随后复用），需要保留时复制；
+// 返回错误时取消合成
+type TTSChunkFunc func(pcm []byte, format ttsPCMFormat) error
+
+// ==================== 音频块缓冲区 ====================
+// 读取协程按协议行给出的长度取出缓冲区并读入PCM，调用方的onChunk返回后放回
+var ttsPCMPool sync.Pool
+
+func getPCMBuffer(n int) []byte {
+	if b, ok := ttsPCMPool.Get().(*[]byte); ok && cap(*b) >= n {
+		return (*b)[:n]
+	}
+	return make([]byte, n)
+}
+
+func putPCMBuffer(b []byte) {
+	if cap(b) > 0 {
+		ttsPCMPool.Put(&b)
+	}
+}
+
+// ==================== 单个进程实例 ====================
+type workerProc struct {
+	cmd        *exec.Cmd
+	stdin      io.WriteCloser
+	wmu        sync.Mutex
+	mu         sync.Mutex
+	pending    map[uint64]*pendingCall
+	ready      chan ttsWorkerEvent
+	exited     chan struct{}
+	started    time.Time
+	sampleRate int
+	name       string // 日志前缀
+
+	cancelGrace time.Duration // 为0时超时或取消直接返回；否则先通知进程取消，等待其确认
+}
+
+// 等待响应的请求；流式合成会收到多个chunk事件，消费慢时阻塞读取协程，从而反压到Python端
+type pendingCall struct {
+	events chan ttsWorkerEvent
+	gone   chan struct{} // 调用方已返回，读取协程不再投递
+}
+
+func (p *workerProc) send(req ttsWorkerRequest) error {
+	line, err := json.Marshal(req)
+	if err != nil {
+		return err
+	}
+	p.wmu.Lock()
+	defer p.wmu.Unlock()
+	_, err = p.stdin.Write(append(append(line, '\n'), req.Audio...))
+	return err
+}
+
+// 发送请求并等待对应id的最终响应；chunk事件交给onChunk，
+// onChunk出错时通知进程取消并继续读完剩余事件，进程保持可用；
+// ctx结束时若cancelGrace>0且请求可取消，同样通知取消，进程在期限内回复则返回errCallCancelled，否则返回ctx的错误
+func (p *workerProc) call(ctx context.Context, req ttsWorkerRequest, onChunk func(ttsWorkerEvent) error) (ttsWorkerEvent, error) {
+	pc := &pendingCall{events: make(chan ttsWorkerEvent, 16), gone: make(chan struct{})}
+	p.mu.Lock()
+	p.pending[req.ID] = pc
+	p.mu.Unlock()
+	defer func() {
+		p.mu.Lock()
+		delete(p.pending, req.ID)
+		p.mu.Unlock()
+		close(pc.gone)
+	}()
+
+	if err := p.send(req); err != nil {
+		return ttsWorkerEvent{}, err
+	}
+	var chunkErr error
+	done := ctx.Done()
+	var expired <-chan time.Time
+	for {
+		select {
+		case ev := <-pc.events:
+			if ev.Event != "chunk" {
+				if expired != nil {
+					return ev, fmt.Errorf("%w: %w", errCallCancelled, ctx.Err())
+				}
+				return ev, chunkErr
+			}
+			if chunkErr == nil && onChunk != nil {
+				if chunkErr = onChunk(ev); chunkErr != nil {
+					p.send(ttsWorkerRequest{ID: req.ID, Op: "cancel"})
+				}
+			}
+			putPCMBuffer(ev.PCM)
+		case <-p.exited:
+			return ttsWorkerEvent{}, errWorkerExited
+		case <-done:
+			if p.cancelGrace == 0 || !req.cancellable() {
+				return ttsWorkerEvent{}, ctx.Err()
+			}
+			p.send(ttsWorkerRequest{ID: req.ID, Op: "cancel"})
+			done, expired = nil, time.After(p.cancelGrace)
+		case <-expired:
+			return ttsWorkerEvent{}, ctx.Err()
+		}
+	}
+}
+
+// 读取协议输出：就绪事件交给监管协程，其余按id投递；
+// chunk事件的PCM紧跟在协议行之后，读入复用的缓冲区，不经base64与JSON解码
+func (p *workerProc) readLoop(r io.Reader) {
+	br := bufio.NewReaderSize(r, 64*1024)
+	for {
+		line, err := readWorkerLine(br)
+		if err != nil {
+			if err != io.EOF {
+				log.Printf("%s: %v", p.name, err)
+			}
+			return
+		}
+		var ev ttsWorkerEvent
+		if err := json.Unmarshal(line, &ev); err != nil {
+			log.Printf("%s: invalid output line: %s", p.name, line)
+			continue
+		}
+		if ev.Bytes > 0 {
+			if ev.Bytes > ttsWorkerChunkMax {
+				log.Printf("%s: %d byte audio chunk exceeds %d", p.name, ev.Bytes, ttsWorkerChunkMax)
+				return
+			}
+			ev.PCM = getPCMBuffer(ev.Bytes)
+			if err := readWorkerPayload(br, r, ev.PCM); err != nil {
+				return
+			}
+		}
+		if ev.Event == "ready" {
+			select {
+			case p.ready <- ev:
+			default:
+			}
+			continue
+		}
+		p.mu.Lock()
+		pc := p.pending[ev.ID]
+		p.mu.Unlock()
+		if pc == nil {
+			log.Printf("%s: unsolicited %s event (id %d): %s", p.name, ev.Event, ev.ID, ev.Error)
+			putPCMBuffer(ev.PCM)
+			continue
+		}
+		select {
+		case pc.events <- ev:
+		case <-pc.gone:
+			putPCMBuffer(ev.PCM)
+		}
+	}
+}
+
+// 读入紧跟协议行的PCM：已缓冲的部分从bufio复制，其余由read直接写入buf，不再经过bufio
+func readWorkerPayload(br *bufio.Reader, r io.Reader, buf []byte) error {
+	buffered, _ := br.Peek(min(br.Buffered(), len(buf)))
+	n := copy(buf, buffered)
+	br.Discard(n)
+	_, err := io.ReadFull(r, buf[n:])
+	return err
+}
+
+// 读取一行协议输出（不含换行符）；返回的切片在下一次读取前有效
+func readWorkerLine(br *bufio.Reader) ([]byte, error) {
+	line, err := br.ReadSlice('\n')
+	if err == bufio.ErrBufferFull {
+		long := append([]byte(nil), line...)
+		for err == bufio.ErrBufferFull && len(long) <= ttsWorkerLineMax {
+			line, err = br.ReadSlice('\n')
+			long = append(long, line...)
+		}
+		if err == bufio.ErrBufferFull {
+			return nil, fmt.Errorf("output line exceeds %d bytes", ttsWorkerLineMax)
+		}
+		line = long
+	}
+	if err != nil {
+		return nil, err
+	}
+	return line[:len(line)-1], nil
+}
+
+func (p *workerProc) kill() {
+	p.cmd.Process.Kill()
+}
+
+// ==================== 监管器 ====================
+type TTSWorker struct {
+	argv    []string
+	dir     string
+	name    string // 日志前缀
+	failure string // 进程返回error事件时的错误前缀
+
+	cancelGrace  time.Duration // 见workerProc.cancelGrace；批量解码时请求可单独取消
+	readyTimeout time.Duration // 启动到就绪的最长时间，超过则结束进程并重启
+
+	busy   chan struct{} // 容量batch：进程逐个处理请求时为1（串行），批量解码时最多batch个流式合成同时进行
+	batch  int
+	nextID atomic.Uint64
+
+	mu      sync.Mutex
+	proc    *workerProc
+	state   string        // starting, ready, restarting, stopped
+	readyCh chan struct{} // 进入ready时关闭，离开ready时换新
+	info    ttsWorkerEvent
+
+	stop chan struct{}
+	done chan struct{}
+
+	restarts  atomic.Uint64
+	requests  atomic.Uint64
+	failures  atomic.Uint64
+	pcmBytes  atomic.Uint64
+	lastReqNs atomic.Int64
+}
+
+// 快照（/api/tts/status）
+type TTSWorkerStats struct {
+	State         string  `json:"state"`
+	PID           int     `json:"pid"`
+	LoadMs        float64 `json:"load_ms"`
+	WarmupMs      float64 `json:"warmup_ms"`
+	UptimeSec     float64 `json:"uptime_sec"`
+	Restarts      uint64  `json:"restarts"`
+	Requests      uint64  `json:"requests"`
+	Failures      uint64  `json:"failures"`
+	LastRequestMs float64 `json:"last_request_ms"`
+	ModelVersion  string  `json:"model_version"`
+	Batch         int     `json:"batch"`     // 同时进行的流式合成上限
+	PCMBytes      uint64  `json:"pcm_bytes"` // 经管道收到的流式合成PCM字节数
+}
+
+// argv为完整命令行（argv[0]为可执行文件），dir为工作目录
+func NewTTSWorker(argv []string, dir string) *TTSWorker {
+	return NewBatchedTTSWorker(argv, dir, 1)
+}
+
+// batch>1时进程以--max-batch批量解码（实验性）：最多batch个合成请求共用每个生成步，
+// 由batch个执行协程共用该进程；其余请求在两步之间执行。批量中的请求超时或取消时只取消该请求，不结束进程
+func NewBatchedTTSWorker(argv []string, dir string, batch int) *TTSWorker {
+	batch = max(batch, 1)
+	var grace time.Duration
+	if batch > 1 {
+		argv = append(argv[:len(argv):len(argv)], "--max-batch", strconv.Itoa(batch))
+		grace = ttsCancelGrace
+	}
+	return &TTSWorker{
+		argv:    argv,
+		dir:     dir,
+		name:    "TTS worker",
+		failure: "TTS synthesis failed",
+		busy:    make(chan struct{}, batch),
+		batch:   batch,
+		state:   "starting",
+		readyCh: make(chan struct{}),
+		stop:    make(chan struct{}),
+		done:    make(chan struct{}),
+
+		cancelGrace:  grace,
+		readyTimeout: ttsWorkerReadyTimeout,
+	}
+}
+
+// ==================== 默认命令行 ====================
+// 与原voxcpm_tts.py相同，经uv在VoxCPM目录的环境中运行；stub模式直接用系统python3且不加载模型
+func voxcpmWorkerCommand(warmup string, stub bool) ([]string, string, error) {
+	script, err := filepath.Abs(filepath.Join(".", "voxcpm_worker.py"))
+	if err != nil {
+		return nil, "", err
+	}
+	var argv []string
+	dir := ""
+	if stub {
+		argv = []string{"python3", script, "--stub"}
+	} else {
+		dir, err = filepath.Abs(filepath.Join("..", "..", "..", "VoxCPM"))
+		if err != nil {
+			return nil, "", err
+		}
+		argv = []string{"uv", "run", "--directory", dir, "python", script}
+	}
+	if warmup != "" {
+		argv = append(argv, "--warmup", warmup)
+	}
+	return argv, dir, nil
+}
+
+// 只用CPU推理时的进程参数：多个进程共享一台机器时各自只用分到的核，避免线程超额订阅；
+// optimize时启用VoxCPMModel.optimize_cpu（int8动态量化、inductor编译）；量化时其余部分固定为float32，不使用bf16
+func voxcpmCPUArgs(optimize bool, threads, workers int) []string {
+	if threads <= 0 && workers > 1 {
+		threads = max(1, runtime.NumCPU()/workers)
+	}
+	var args []string
+	if threads > 0 {
+		args = append(args, "--threads", strconv.Itoa(threads))
+	}
+	if optimize {
+		args = append(args, "--cpu-int8", "--cpu-compile", "--cpu-dtype", "float32")
+	}
+	return args
+}
+
+func (w *TTSWorker) Start() {
+	go w.supervise()
+}
+
+// ==================== 停止（发送shutdown，超时则强制结束） ====================
+func (w *TTSWorker) Stop() {
+	select {
+	case <-w.stop:
+	default:
+		close(w.stop)
+	}
+	<-w.done
+}
+
+// ==================== 监管循环 ====================
+func (w *TTSWorker) supervise() {
+	defer close(w.done)
+	backoff := ttsRestartBackoffMin
+	for {
+		p, err := w.spawn()
+		if err == nil {
+			err = w.waitReady(p)
+		}
+		if err == nil {
+			backoff = ttsRestartBackoffMin
+			err = w.monitor(p)
+		}
+		if p != nil {
+			p.kill()
+			<-p.exited
+		}
+		if errors.Is(err, errWorkerStopped) {
+			w.setState(nil, "stopped")
+			return
+		}
+
+		w.restarts.Add(1)
+		w.setState(nil, "restarting")
+		log.Printf("%s: %v, restarting in %v", w.name, err, backoff)
+		select {
+		case <-time.After(backoff):
+		case <-w.stop:
+			w.setState(nil, "stopped")
+			return
+		}
+		backoff = minDuration(backoff*2, ttsRestartBackoffMax)
+	}
+}
+
+func minDuration(a, b time.Duration) time.Duration {
+	if a < b {
+		return a
+	}
+	return b
+}
+
+func (w *TTSWorker) spawn() (*workerProc, error) {
+	cmd := exec.Command(w.argv[0], w.argv[1:]...)
+	cmd.Dir = w.dir
+	cmd.Stderr = os.Stderr
+	stdin, err := cmd.StdinPipe()
+	if err != nil {
+		return nil, err
+	}
+	stdout, err := cmd.StdoutPipe()
+	if err != nil {
+		return nil, err
+	}
+	if err := cmd.Start(); err != nil {
+		return nil, fmt.Errorf("start failed: %w", err)
+	}
+
+	p := &workerProc{
+		cmd:     cmd,
+		stdin:   stdin,
+		pending: make(map[uint64]*pendingCall),
+		ready:   make(chan ttsWorkerEvent, 1),
+		exited:  make(chan struct{}),
+		started: time.Now(),
+		name:    w.name,
+
+		cancelGrace: w.cancelGrace,
+	}
+	readDone := make(chan struct{})
+	go func() {
+		p.readLoop(stdout)
+		close(readDone)
+	}()
+	go func() {
+		// 先读完输出再Wait，Wait会关闭管道
+		<-readDone
+		cmd.Wait()
+		close(p.exited)
+	}()
+	log.Printf("%s: started pid %d", w.name, cmd.Process.Pid)
+	return p, nil
+}
+
+func (w *TTSWorker) waitReady(p *workerProc) error {
+	timer := time.NewTimer(w.readyTimeout)
+	defer timer.Stop()
+	select {
+	case ev := <-p.ready:
+		p.sampleRate = ev.SampleRate
+		if p.sampleRate <= 0 {
+			p.sampleRate = 16000
+		}
+		w.mu.Lock()
+		w.info = ev // 先于ready状态更新，就绪后读到的都是新进程的信息
+		w.mu.Unlock()
+		w.setState(p, "ready")
+		log.Printf("%s: ready (pid %d, model load %.0fms, warmup %.0fms, startup %v)", w.name,
+			ev.PID, ev.LoadMs, ev.WarmupMs, time.Since(p.started).Round(time.Millisecond))
+		return nil
+	case <-p.exited:
+		return fmt.Errorf("exited during startup: %w", errWorkerExited)
+	case <-timer.C:
+		return fmt.Errorf("not ready after %v", w.readyTimeout)
+	case <-w.stop:
+		return errWorkerStopped
+	}
+}
+
+// 进程运行期间：空闲时定期ping，失败则重启
+func (w *TTSWorker) monitor(p *workerProc) error {
+	ticker := time.NewTicker(ttsWorkerPingInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-p.exited:
+			return errWorkerExited
+		case <-w.stop:
+			// 正在合成时进程要等推理结束才会读到shutdown，宽限期后由supervise强制结束
+			p.send(ttsWorkerRequest{Op: "shutdown"})
+			select {
+			case <-p.exited:
+			case <-time.After(ttsWorkerPingTimeout):
+			}
+			return errWorkerStopped
+		case <-ticker.C:
+			if !w.acquireIdle() {
+				continue // 正在合成，由请求超时负责检测卡死
+			}
+			ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerPingTimeout)
+			ev, err := p.call(ctx, ttsWorkerRequest{ID: w.nextID.Add(1), Op: "ping"}, nil)
+			cancel()
+			w.releaseIdle()
+			if err == nil && ev.Event != "pong" {
+				err = fmt.Errorf("unexpected ping reply %q", ev.Event)
+			}
+			if err != nil {
+				return fmt.Errorf("health check failed: %w", err)
+			}
+		}
+	}
+}
+
+// 没有请求在进行时占用全部名额（健康检查期间不接受请求）；有请求时不占用并返回false
+func (w *TTSWorker) acquireIdle() bool {
+	for i := 0; i < w.batch; i++ {
+		select {
+		case w.busy <- struct{}{}:
+		default:
+			for ; i > 0; i-- {
+				<-w.busy
+			}
+			return false
+		}
+	}
+	return true
+}
+
+func (w *TTSWorker) releaseIdle() {
+	for i := 0; i < w.batch; i++ {
+		<-w.busy
+	}
+}
+
+func (w *TTSWorker) setState(p *workerProc, state string) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if state == "ready" {
+		w.proc = p
+		close(w.readyCh)
+	} else if w.state == "ready" {
+		w.proc = nil
+		w.readyCh = make(chan struct{})
+	}
+	w.state = state
+}
+
+// ==================== 等待进程就绪 ====================
+func (w *TTSWorker) current(ctx context.Context) (*workerProc, error) {
+	for {
+		w.mu.Lock()
+		p, ready := w.proc, w.readyCh
+		w.mu.Unlock()
+		if p != nil {
+			return p, nil
+		}
+		select {
+		case <-ready:
+		case <-w.done:
+			return nil, errWorkerStopped
+		case <-ctx.Done():
+			return nil, fmt.Errorf("%w: %v", errWorkerNotReady, ctx.Err())
+		}
+	}
+}
+
+// 等待监管协程处理旧进程退出（离开ready状态），避免重试时再次拿到同一进程
+func (w *TTSWorker) waitReplaced(p *workerProc, ctx context.Context) {
+	for {
+		w.mu.Lock()
+		cur := w.proc
+		w.mu.Unlock()
+		if cur != p {
+			return
+		}
+		select {
+		case <-ctx.Done():
+			return
+		case <-w.done:
+			return
+		case <-time.After(10 * time.Millisecond):
+		}
+	}
+}
+
+// 当前进程加载的模型版本（等待进程就绪），用于合成缓存的键
+func (w *TTSWorker) ModelVersion(ctx context.Context) (string, error) {
+	if _, err := w.current(ctx); err != nil {
+		return "", err
+	}
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	return w.info.ModelVersion, nil
+}
+
+// ==================== 启动一组进程并等待全部就绪（离线渲染与基准） ====================
+func startTTSWorkers(argv []string, dir string, n int) ([]*TTSWorker, error) {
+	runners := make([]*TTSWorker, n)
+	for i := range runners {
+		runners[i] = NewTTSWorker(argv, dir)
+		runners[i].Start()
+	}
+	for _, w := range runners {
+		ctx, cancel := context.WithTimeout(context.Background(), ttsWorkerReadyTimeout)
+		_, err := w.current(ctx)
+		cancel()
+		if err != nil {
+			stopTTSWorkers(runners)
+			return nil, err
+		}
+	}
+	return runners, nil
+}
+
+func stopTTSWorkers(runners []*TTSWorker) {
+	for _, w := range runners {
+		w.Stop()
+	}
+}
+
+// ==================== 合成 ====================
+// 合成完整音频并写入output（WAV）
+func (w *TTSWorker) Synthesize(ctx context.Context, text string, prompt TTSPrompt, profile string, output string) (TTSResult, error) {
+	req := ttsWorkerRequest{
+		Op:     "synthesize",
+		Text:   text,
+		Output: output,
+
+		CfgValue:           ttsCfgValue,
+		InferenceTimesteps: ttsInferenceTimesteps,
+		Profile:            profile,
+	}
+	prompt.apply(&req)
+	return w.run(ctx, req, nil)
+}
+
+// 流式合成：每个生成步的音频块产生后立即交给onChunk（在调用协程中执行，阻塞时反压生成）；
+// format为零值时音频块为模型采样率单声道，否则由合成进程转换为该格式。
+// onChunk返回错误或ctx结束时合成在下一步停止并返回该错误，进程保持可用。
+// profile为解码档位（见ttsProfileNames），为空时为原有解码
+func (w *TTSWorker) SynthesizeStream(ctx context.Context, text string, prompt TTSPrompt, profile string, format ttsPCMFormat, onChunk TTSChunkFunc) (TTSResult, error) {
+	req := ttsWorkerRequest{
+		Op:   "synthesize_stream",
+		Text: text,
+
+		CfgValue:           ttsCfgValue,
+		InferenceTimesteps: ttsInferenceTimesteps,
+		Profile:            profile,
+
+		SampleRate: format.SampleRate,
+		Channels:   format.Channels,
+	}
+	prompt.apply(&req)
+	return w.run(ctx, req, onChunk)
+}
+
+// 编码已注册音色的参考音频并保存提示缓存，返回编码耗时（毫秒）
+func (w *TTSWorker) RegisterVoice(ctx context.Context, v *TTSVoice) (float64, error) {
+	res, err := w.run(ctx, ttsWorkerRequest{Op: "register_voice", Voice: v.workerVoice()}, nil)
+	return res.PromptMs, err
+}
+
+// 按标点把文本切分为句子（过短的并入相邻句），用于分句并行合成
+func (w *TTSWorker) SplitSentences(ctx context.Context, text string) ([]string, error) {
+	res, err := w.run(ctx, ttsWorkerRequest{Op: "split", Text: text}, nil)
+	return res.Sentences, err
+}
+
+func (w *TTSWorker) run(ctx context.Context, req ttsWorkerRequest, onChunk TTSChunkFunc) (TTSResult, error) {
+	ev, pcmBytes, elapsed, err := w.exchange(ctx, req, onChunk)
+	if err != nil {
+		return TTSResult{}, err
+	}
+	return TTSResult{Path: ev.Path, AudioMs: ev.AudioMs, SynthMs: ev.SynthMs, FirstChunkMs: ev.FirstChunkMs,
+		PromptMs: ev.PromptMs, PCMBytes: pcmBytes, Sentences: ev.Sentences, Elapsed: elapsed}, nil
+}
+
+// 串行执行（批量解码时最多batch个同时进行），返回完成事件、收到的PCM字节数与总耗时；
+// 完整合成超时或调用方取消时结束进程（Python端无法中断正在进行的推理），由监管协程重启；
+// 批量解码时先通知进程取消该请求，只在进程未及时确认时才结束进程
+func (w *TTSWorker) exchange(ctx context.Context, req ttsWorkerRequest, onChunk TTSChunkFunc) (ttsWorkerEvent, int64, time.Duration, error) {
+	start := time.Now()
+	select {
+	case w.busy <- struct{}{}:
+	case <-ctx.Done():
+		return ttsWorkerEvent{}, 0, 0, ctx.Err()
+	}
+	defer func() { <-w.busy }()
+
+	w.requests.Add(1)
+	reqCtx, cancel := context.WithTimeout(ctx, ttsRequestTimeout)
+	defer cancel()
+	// 流式合成的取消在收到下一个音频块时传达给进程，等待响应期间只受超时限制；
+	// 识别耗时短，调用方取消时仍等待结果，不结束进程（重新加载模型，批次中的其他请求一并失败）
+	callCtx := reqCtx
+	if onChunk != nil || req.Op == "recognize" {
+		var cancelCall context.CancelFunc
+		callCtx, cancelCall = context.WithTimeout(context.WithoutCancel(ctx), ttsRequestTimeout)
+		defer cancelCall()
+	}
+
+	// 进程在请求期间退出时（崩溃或监管协程尚未察觉的旧进程），等待重启后重试一次；
+	// 合成请求可安全重放，流式合成已输出音频块后则不再重试，避免重复播放
+	var p *workerProc
+	var ev ttsWorkerEvent
+	var err error
+	var pcmBytes int64
+	delivered := false
+	for attempt := 0; attempt < 2; attempt++ {
+		if p, err = w.current(reqCtx); err != nil {
+			w.failures.Add(1)
+			return ttsWorkerEvent{}, 0, 0, err
+		}
+		req.ID = w.nextID.Add(1)
+		var deliver func(ttsWorkerEvent) error
+		if onChunk != nil {
+			format := ttsPCMFormat{SampleRate: req.SampleRate, Channels: req.Channels}
+			if format.SampleRate == 0 {
+				format.SampleRate = p.sampleRate
+			}
+			if format.Channels == 0 {
+				format.Channels = 1
+			}
+			deliver = func(ev ttsWorkerEvent) error {
+				delivered = true
+				pcmBytes += int64(len(ev.PCM))
+				if err := ctx.Err(); err != nil {
+					return err
+				}
+				return onChunk(ev.PCM, format)
+			}
+		}
+		ev, err = p.call(callCtx, req, deliver)
+		if !errors.Is(err, errWorkerExited) || delivered {
+			break
+		}
+		w.waitReplaced(p, reqCtx)
+	}
+	w.pcmBytes.Add(uint64(pcmBytes))
+	if err != nil {
+		w.failures.Add(1)
+		// onChunk返回的错误已在进程内取消，进程仍可用；只有等待响应超时或被取消、且进程未确认取消时才结束进程
+		if callCtx.Err() != nil && !errors.Is(err, errCallCancelled) {
+			log.Printf("%s: request abandoned (%v), killing pid %d", w.name, err, p.cmd.Process.Pid)
+			p.kill()
+		}
+		return ttsWorkerEvent{}, 0, 0, err
+	}
+	if ev.Event != "done" {
+		w.failures.Add(1)
+		return ttsWorkerEvent{}, 0, 0, fmt.Errorf("%s: %s", w.failure, ev.Error)
+	}
+
+	elapsed := time.Since(start)
+	w.lastReqNs.Store(int64(elapsed))
+	return ev, pcmBytes, elapsed, nil
+}
+
+// ==================== 状态快照 ====================
+func (w *TTSWorker) Stats() TTSWorkerStats {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	s := TTSWorkerStats{
+		State:         w.state,
+		Restarts:      w.restarts.Load(),
+		Requests:      w.requests.Load(),
+		Failures:      w.failures.Load(),
+		LastRequestMs: float64(w.lastReqNs.Load()) / 1e6,
+		Batch:         w.batch,
+		PCMBytes:      w.pcmBytes.Load(),
+	}
+	if w.proc != nil {
+		s.PID = w.info.PID
+		s.LoadMs = w.info.LoadMs
+		s.WarmupMs = w.info.WarmupMs
+		s.UptimeSec = time.Since(w.proc.started).Seconds()
+		s.ModelVersion = w.info.ModelVersion
+	}
+	return s
+}
@@ -0,0 +1,357 @@
+/***
+ * @file upload_bench_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-19
+ * @brief 音频文件处理基准测试（服务端流式解码 vs 浏览器整文件解码流程）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-19
+ * @filePath upload_bench_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"log"
+	"math"
+	"net"
+	"net/http"
+	"os"
+	"runtime"
+	"runtime/metrics"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// 用法：go test -run '^$' -bench '^BenchmarkUpload$' -benchtime 1x
+//
+// 生成10分钟48kHz立体声16位WAV（约110MB，按需生成不占内存），对比两条路径到模拟设备：
+//   server:  POST /api/audio/upload，请求体边上传边解码、重采样、分块转发；
+//   browser: 按前端processAudioFile的步骤在Go中复现内存形态——整文件读入(arrayBuffer)、
+//            解码为44.1kHz平面float32(decodeAudioData)、转Int16交错(audioBufferToPCM)、
+//            逐块slice复制(chunkPCMData)，再经WebSocket发送。
+// 统计首块音频到达设备的时间（time to first sound）、总耗时、堆峰值与累计分配。
+// 基准中关闭实时节拍，设备全速接收，以测出完整文件的处理速度；首块时间与节拍无关。
+// 浏览器路径为算法形态的复现，实际浏览器的解码速度与内存开销会有差异。
+
+func BenchmarkUpload(b *testing.B) {
+	runBenchOnce(b, func() { runUploadBenchmark() })
+}
+
+const (
+	uploadBenchSeconds = 600
+	uploadBenchRate    = 48000
+)
+
+// ==================== 按需生成的WAV文件 ====================
+type wavGenerator struct {
+	header [44]byte
+	size   int64
+	pos    int64
+}
+
+func newWAVGenerator(seconds, rate int) *wavGenerator {
+	dataBytes := int64(seconds) * int64(rate) * 4
+	g := &wavGenerator{size: 44 + dataBytes}
+	h := g.header[:]
+	copy(h[0:4], "RIFF")
+	binary.LittleEndian.PutUint32(h[4:8], uint32(36+dataBytes))
+	copy(h[8:16], "WAVEfmt ")
+	binary.LittleEndian.PutUint32(h[16:20], 16)
+	binary.LittleEndian.PutUint16(h[20:22], wavFormatPCM)
+	binary.LittleEndian.PutUint16(h[22:24], 2)
+	binary.LittleEndian.PutUint32(h[24:28], uint32(rate))
+	binary.LittleEndian.PutUint32(h[28:32], uint32(rate*4))
+	binary.LittleEndian.PutUint16(h[32:34], 4)
+	binary.LittleEndian.PutUint16(h[34:36], 16)
+	copy(h[36:40], "data")
+	binary.LittleEndian.PutUint32(h[40:44], uint32(dataBytes))
+	return g
+}
+
+func (g *wavGenerator) Read(p []byte) (int, error) {
+	if g.pos >= g.size {
+		return 0, io.EOF
+	}
+	n := 0
+	for n < len(p) && g.pos < g.size {
+		if g.pos < 44 {
+			c := copy(p[n:], g.header[g.pos:])
+			n += c
+			g.pos += int64(c)
+			continue
+		}
+		// 440Hz正弦，左右声道相同
+		off := g.pos - 44
+		frame := off / 4
+		v := int16(8000 * math.Sin(2*math.Pi*440*float64(frame)/uploadBenchRate))
+		b := [4]byte{byte(v), byte(uint16(v) >> 8), byte(v), byte(uint16(v) >> 8)}
+		c := copy(p[n:], b[off%4:])
+		n += c
+		g.pos += int64(c)
+	}
+	return n, nil
+}
+
+// ==================== 模拟设备：全速接收，记录首块音频到达时间 ====================
+type uploadSinkDevice struct {
+	listener  net.Listener
+	firstData atomic.Int64 // 首个0xA4帧到达时间（UnixNano）
+	received  atomic.Int64
+}
+
+func newUploadSinkDevice() (*uploadSinkDevice, error) {
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		return nil, err
+	}
+	d := &uploadSinkDevice{listener: l}
+	go func() {
+		c, err := l.Accept()
+		if err != nil {
+			return
+		}
+		defer c.Close()
+		buf := make([]byte, 64*1024)
+		for {
+			n, err := c.Read(buf)
+			if n > 0 {
+				// 第一个字节是开始命令0xA3，其后的数据属于音频帧
+				if d.received.Add(int64(n)) > 1 && d.firstData.Load() == 0 {
+					d.firstData.Store(time.Now().UnixNano())
+				}
+			}
+			if err != nil {
+				return
+			}
+		}
+	}()
+	return d, nil
+}
+
+// ==================== 堆峰值采样 ====================
+type heapPeakSampler struct {
+	peak atomic.Uint64
+	stop chan struct{}
+	done chan struct{}
+}
+
+func startHeapPeakSampler() *heapPeakSampler {
+	s := &heapPeakSampler{stop: make(chan struct{}), done: make(chan struct{})}
+	go func() {
+		defer close(s.done)
+		sample := []metrics.Sample{{Name: "/memory/classes/heap/objects:bytes"}}
+		ticker := time.NewTicker(time.Millisecond)
+		defer ticker.Stop()
+		for {
+			metrics.Read(sample)
+			if v := sample[0].Value.Uint64(); v > s.peak.Load() {
+				s.peak.Store(v)
+			}
+			select {
+			case <-s.stop:
+				return
+			case <-ticker.C:
+			}
+		}
+	}()
+	return s
+}
+
+func (s *heapPeakSampler) finish() uint64 {
+	close(s.stop)
+	<-s.done
+	return s.peak.Load()
+}
+
+type uploadBenchResult struct {
+	firstSound time.Duration
+	total      time.Duration
+	peakHeap   uint64
+	allocated  uint64
+	pcmBytes   int64
+}
+
+// ==================== 单次运行：send负责把文件送到设备 ====================
+func runUploadPath(send func(file io.Reader, addr string) error, addr string) (uploadBenchResult, error) {
+	var res uploadBenchResult
+	device, err := newUploadSinkDevice()
+	if err != nil {
+		return res, err
+	}
+	defer device.listener.Close()
+	conn, err := connManager.Connect(device.listener.Addr().String())
+	if err != nil {
+		return res, err
+	}
+	defer connManager.DisconnectAll()
+
+	runtime.GC()
+	var before, after runtime.MemStats
+	runtime.ReadMemStats(&before)
+	sampler := startHeapPeakSampler()
+	start := time.Now()
+
+	if err := send(newWAVGenerator(uploadBenchSeconds, uploadBenchRate), addr); err != nil {
+		sampler.finish()
+		return res, err
+	}
+	// 等待设备队列发完
+	for conn.Stats().QueueDepth > 0 {
+		time.Sleep(time.Millisecond)
+	}
+	res.total = time.Since(start)
+	res.peakHeap = sampler.finish()
+	runtime.ReadMemStats(&after)
+	res.allocated = after.TotalAlloc - before.TotalAlloc
+	if at := device.firstData.Load(); at != 0 {
+		res.firstSound = time.Unix(0, at).Sub(start)
+	}
+	res.pcmBytes = int64(conn.Stats().BytesSent)
+	return res, nil
+}
+
+// ==================== 浏览器流程复现 ====================
+func browserPathEmulation(file io.Reader, addr string) error {
+	g := file.(*wavGenerator)
+
+	// 1. file.arrayBuffer()：整文件读入
+	data := make([]byte, g.size)
+	if _, err := io.ReadFull(file, data); err != nil {
+		return err
+	}
+
+	// 2. decodeAudioData：解码并重采样到AudioContext采样率，结果为平面float32
+	s, err := newWAVStream(bytes.NewReader(data), bytes.NewReader(data[44:]))
+	if err != nil {
+		return err
+	}
+	frames := int(int64(uploadBenchSeconds) * defaultSampleRate)
+	planar := [2][]float32{make([]float32, 0, frames), make([]float32, 0, frames)}
+	block := make([]byte, 64*1024)
+	for {
+		n, err := s.Read(block)
+		for i := 0; i+3 < n; i += 4 {
+			planar[0] = append(planar[0], float32(int16(binary.LittleEndian.Uint16(block[i:])))/32768)
+			planar[1] = append(planar[1], float32(int16(binary.LittleEndian.Uint16(block[i+2:])))/32768)
+		}
+		if err != nil {
+			break
+		}
+	}
+
+	// 3. audioBufferToPCM：交错Int16
+	pcm := make([]int16, len(planar[0])*2)
+	for i := range planar[0] {
+		for c := 0; c < 2; c++ {
+			v := planar[c][i]
+			if v < 0 {
+				pcm[i*2+c] = int16(v * 0x8000)
+			} else {
+				pcm[i*2+c] = int16(v * 0x7FFF)
+			}
+		}
+	}
+
+	// 4. chunkPCMData：每块slice复制一份
+	var chunks [][]byte
+	for i := 0; i < len(pcm); i += pcmChunkBytes / 2 {
+		end := min(i+pcmChunkBytes/2, len(pcm))
+		chunk := make([]byte, (end-i)*2)
+		for j, v := range pcm[i:end] {
+			binary.LittleEndian.PutUint16(chunk[j*2:], uint16(v))
+		}
+		chunks = append(chunks, chunk)
+	}
+
+	// 5. sendAudioStream：WebSocket逐块发送
+	ws, err := wsDial(addr, "/api/audio/ws")
+	if err != nil {
+		return err
+	}
+	defer ws.Close()
+	for _, c := range chunks {
+		if err := ws.writeFrame(wsOpBinary, c); err != nil {
+			return err
+		}
+	}
+	ws.writeText("end")
+	_, _, err = ws.readMessage(nil, 1024)
+	ws.writeClose(wsCloseNormal)
+	runtime.KeepAlive(data)
+	runtime.KeepAlive(planar)
+	return err
+}
+
+// ==================== 服务端流式上传 ====================
+func serverUploadPath(file io.Reader, addr string) error {
+	// 包一层隐藏具体类型，请求按chunked编码流式发送
+	body := struct{ io.Reader }{file}
+	resp, err := http.Post("http://"+addr+"/api/audio/upload", "audio/wav", body)
+	if err != nil {
+		return err
+	}
+	defer resp.Body.Close()
+	io.Copy(io.Discard, resp.Body)
+	if resp.StatusCode != http.StatusOK {
+		return fmt.Errorf("upload failed: %s", resp.Status)
+	}
+	return nil
+}
+
+// ==================== 运行基准并打印结果 ====================
+func runUploadBenchmark() {
+	log.SetOutput(io.Discard)
+	defer log.SetOutput(os.Stderr)
+	defer func(lead time.Duration) { audioLeadDefault = lead }(audioLeadDefault)
+	audioLeadDefault = 0
+
+	mux := http.NewServeMux()
+	mux.HandleFunc("/api/audio/upload", handleAudioUpload)
+	mux.HandleFunc("/api/audio/ws", handleAudioStreamWS)
+	l, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		fmt.Printf("Failed to listen: %v\n", err)
+		return
+	}
+	server := &http.Server{Handler: mux}
+	go server.Serve(l)
+	defer server.Close()
+
+	g := newWAVGenerator(uploadBenchSeconds, uploadBenchRate)
+	fmt.Println("Audio file benchmark (simulated device on loopback, pacing disabled)")
+	fmt.Printf("input: %d s WAV, %d Hz stereo 16-bit, %.1f MB -> 44.1 kHz stereo 16-bit\n\n",
+		uploadBenchSeconds, uploadBenchRate, float64(g.size)/1e6)
+	fmt.Printf("%-8s | %-19s | %-10s | %-10s | %-13s | %s\n",
+		"path", "time to first sound", "total", "peak heap", "total alloc", "sent to device")
+
+	for _, p := range []struct {
+		name string
+		send func(io.Reader, string) error
+	}{
+		{"browser", browserPathEmulation},
+		{"server", serverUploadPath},
+	} {
+		res, err := runUploadPath(p.send, l.Addr().String())
+		if err != nil {
+			fmt.Printf("%-8s | failed: %v\n", p.name, err)
+			continue
+		}
+		fmt.Printf("%-8s | %-19v | %-10v | %-10s | %-13s | %.1f MB\n",
+			p.name, res.firstSound.Round(100*time.Microsecond), res.total.Round(time.Millisecond),
+			fmt.Sprintf("%.1f MB", float64(res.peakHeap)/1e6), fmt.Sprintf("%.1f MB", float64(res.allocated)/1e6),
+			float64(res.pcmBytes)/1e6)
+	}
+	fmt.Println("\nbrowser: Go reproduction of processAudioFile's buffers; the real browser adds its own decoder overhead.")
+	fmt.Printf("client, server and device share %d CPU(s); scheduling delays are included in time to first sound.\n", runtime.NumCPU())
+}
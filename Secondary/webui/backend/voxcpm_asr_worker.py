@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+"""
+VoxCPM ASR Worker
+常驻识别进程：启动时加载一次 SenseVoiceSmall（funasr.AutoModel），之后通过标准输入/输出处理识别请求，
+由 Go 后端以与合成进程相同的方式启动并监管（tts_worker.go：等待就绪、空闲时健康检查、超时或退出后重启）。
+取代每次识别都启动 voxcpm_helper.py 并重新加载模型的做法。
+
+协议（每行一个 JSON 对象）：
+  就绪     -> {"event": "ready", "pid": 123, "load_ms": 4123.4, "warmup_ms": 210.2, "rss_mb": 1180.5,
+               "model_version": "SenseVoiceSmall"}
+  识别     <- {"id": 1, "op": "recognize", "bytes": 96044} 后紧跟 96044 字节音频文件内容（WAV/MP3/FLAC/WebM 等）
+  完成     -> {"id": 1, "event": "done", "text": "...", "audio_ms": 3000.0, "recognize_ms": 85.2, "batch": 2}
+               （recognize_ms 为所在批次的识别耗时，batch 为批次中的请求数）
+  失败     -> {"id": 1, "event": "error", "error": "..."}
+  健康检查 <- {"id": 2, "op": "ping"}  -> {"id": 2, "event": "pong"}
+  退出     <- {"op": "shutdown"}
+
+音频不经临时文件：请求行之后原样跟随上传的文件内容，在内存中解码（torchaudio，不支持的格式经 ffmpeg 管道），
+转为 16kHz 单声道后交给模型。
+
+标准输入由独立线程读取；--max-batch N（N>1）时，识别开始前已到达的识别请求（最多 N 个）合为一批，
+一次调用 AutoModel.generate 识别。
+
+模型库的 print 输出会被重定向到 stderr，标准输出只承载协议。
+--stub 不加载模型，按音频时长返回占位文本，仅用于测试协议与进程开销；
+--stub-load 为占位模型的模拟加载耗时（秒），--stub-rtf 为模拟实时率，
+--stub-batch-cost 为批次中每多一个请求、耗时增加单个请求的比例。
+"""
+
+import argparse
+import io
+import json
+import os
+import queue
+import subprocess
+import sys
+import threading
+import time
+import warnings
+import wave
+
+# 禁用警告
+warnings.filterwarnings('ignore')
+os.environ['PYTHONWARNINGS'] = 'ignore'
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+SAMPLE_RATE = 16000  # SenseVoice 输入采样率
+
+
+# ==================== 协议输出 ====================
+# 保留原始 stdout 作为协议通道，之后 fd 1 指向 stderr；读取线程也会输出，每条消息一次写入
+_proto = os.fdopen(os.dup(1), "wb")
+_proto_lock = threading.Lock()
+os.dup2(2, 1)
+sys.stdout = sys.stderr
+
+
+def emit(obj):
+    data = (json.dumps(obj, ensure_ascii=False) + "\n").encode("utf-8")
+    with _proto_lock:
+        _proto.write(data)
+        _proto.flush()
+
+
+def elapsed_ms(start):
+    return round((time.perf_counter() - start) * 1000, 1)
+
+
+def rss_mb():
+    """本进程常驻内存（MB）"""
+    try:
+        with open("/proc/self/status") as f:
+            for line in f:
+                if line.startswith("VmRSS:"):
+                    return round(int(line.split()[1]) / 1024, 1)
+    except OSError:
+        pass
+    import resource
+    return round(resource.getrusage(resource.RUSAGE_SELF).ru_maxrss / 1024, 1)
+
+
+# ==================== 音频解码 ====================
+def decode_audio(data):
+    """上传的文件内容 -> 16kHz 单声道 float32（numpy）"""
+    import torch
+    import torchaudio
+
+    try:
+        audio, sr = torchaudio.load(io.BytesIO(data))
+    except Exception:
+        return decode_ffmpeg(data)
+    audio = audio.mean(dim=0)
+    if sr != SAMPLE_RATE:
+        audio = torchaudio.functional.resample(audio, sr, SAMPLE_RATE)
+    return audio.to(torch.float32).numpy()
+
+
+def decode_ffmpeg(data):
+    """torchaudio 不支持的格式（如浏览器录音的 WebM）经 ffmpeg 标准输入/输出解码，不写文件"""
+    import numpy as np
+
+    proc = subprocess.run(
+        ["ffmpeg", "-nostdin", "-loglevel", "error", "-i", "pipe:0",
+         "-f", "f32le", "-ac", "1", "-ar", str(SAMPLE_RATE), "pipe:1"],
+        input=data, capture_output=True)
+    if proc.returncode != 0:
+        raise ValueError(f"unsupported audio: {proc.stderr.decode('utf-8', 'replace').strip()[-200:]}")
+    return np.frombuffer(proc.stdout, dtype=np.float32)
+
+
+def wav_seconds(data):
+    """占位模型：只解析 WAV 头得到时长，不依赖 torch"""
+    try:
+        with wave.open(io.BytesIO(data)) as w:
+            return w.getnframes() / w.getframerate()
+    except (wave.Error, EOFError, ZeroDivisionError):
+        return len(data) / (SAMPLE_RATE * 2)
+
+
+# ==================== 模型 ====================
+class StubModel:
+    """占位模型：按音频时长 x 实时率耗时，返回带时长的占位文本"""
+
+    def __init__(self, rtf=0.0, batch_cost=0.0):
+        self.rtf = rtf
+        self.batch_cost = batch_cost
+
+    def decode(self, data):
+        return wav_seconds(data)
+
+    def recognize(self, audios):
+        longest = max(audios, default=0.0)
+        time.sleep(longest * self.rtf * (1 + self.batch_cost * (len(audios) - 1)))
+        return [f"占位识别结果 {seconds:.1f} 秒" for seconds in audios]
+
+    @staticmethod
+    def seconds(audio):
+        return audio
+
+
+class SenseVoice:
+    def __init__(self, path, device):
+        from funasr import AutoModel
+
+        self.model = AutoModel(
+            model=path,
+            disable_update=True,
+            log_level='ERROR',
+            device=device,
+        )
+
+    def decode(self, data):
+        return decode_audio(data)
+
+    def recognize(self, audios):
+        result = self.model.generate(input=list(audios), batch_size=len(audios), language="auto", use_itn=True)
+        return [clean_text(r.get("text", "")) for r in result]
+
+    @staticmethod
+    def seconds(audio):
+        return len(audio) / SAMPLE_RATE
+
+
+def clean_text(text):
+    """去除语言、情感等标记（<|zh|><|NEUTRAL|>...），与原 voxcpm_helper.py 一致"""
+    if '|>' in text:
+        text = text.split('|>')[-1]
+    return text.strip()
+
+
+def load_model(args):
+    if args.stub:
+        time.sleep(args.stub_load)
+        return StubModel(args.stub_rtf, args.stub_batch_cost)
+    return SenseVoice(args.model, args.device)
+
+
+def warmup(model, args):
+    """用一秒静音识别一次，首次推理的初始化不计入第一个请求"""
+    if args.stub:
+        return
+    import numpy as np
+    model.recognize([np.zeros(SAMPLE_RATE, dtype=np.float32)])
+
+
+# ==================== 识别 ====================
+# 各请求分别解码，解码失败的单独回复错误；其余一次识别
+def recognize_batch(model, reqs):
+    audios, ok = [], []
+    for req in reqs:
+        try:
+            audios.append(model.decode(req["audio"]))
+            ok.append(req)
+        except Exception as e:
+            emit({"id": req.get("id"), "event": "error", "error": f"decode failed: {e}"})
+    if not ok:
+        return
+    start = time.perf_counter()
+    try:
+        texts = model.recognize(audios)
+    except Exception as e:
+        import traceback
+        traceback.print_exc()
+        for req in ok:
+            emit({"id": req.get("id"), "event": "error", "error": str(e)})
+        return
+    ms = elapsed_ms(start)
+    for req, audio, text in zip(ok, audios, texts):
+        emit({"id": req.get("id"), "event": "done", "text": text,
+              "audio_ms": round(model.seconds(audio) * 1000, 1), "recognize_ms": ms, "batch": len(ok)})
+
+
+# ==================== 标准输入读取线程 ====================
+# 请求行带 bytes 时紧跟音频内容，按长度读出后随请求入队
+def read_requests(requests):
+    stdin = sys.stdin.buffer
+    while True:
+        line = stdin.readline()
+        if not line:
+            break
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            req = json.loads(line)
+        except json.JSONDecodeError as e:
+            emit({"event": "error", "error": f"invalid request: {e}"})
+            continue
+        n = int(req.get("bytes") or 0)
+        if n > 0:
+            req["audio"] = stdin.read(n)
+            if len(req["audio"]) < n:
+                break
+        requests.put(req)
+    requests.put({"op": "shutdown"})
+
+
+def serve(model, max_batch=1):
+    requests = queue.Queue()
+    threading.Thread(target=read_requests, args=(requests,), daemon=True).start()
+
+    pending = None
+    while True:
+        req = pending or requests.get()
+        pending = None
+        op = req.get("op")
+        rid = req.get("id")
+        if op == "shutdown":
+            return
+        if op == "ping":
+            emit({"id": rid, "event": "pong"})
+            continue
+        if op != "recognize":
+            emit({"id": rid, "event": "error", "error": f"unknown op: {op}"})
+            continue
+
+        # 合并已到达的识别请求；遇到其他请求时留到本批之后处理
+        batch = [req]
+        while len(batch) < max_batch:
+            try:
+                nxt = requests.get_nowait()
+            except queue.Empty:
+                break
+            if nxt.get("op") != "recognize":
+                pending = nxt
+                break
+            batch.append(nxt)
+        recognize_batch(model, batch)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM ASR worker")
+    parser.add_argument("--model", default="./model/SenseVoiceSmall")
+    parser.add_argument("--device", default="cpu", help="推理设备，默认 CPU 以避免与合成争用 GPU")
+    parser.add_argument("--max-batch", type=int, default=1, help="一次识别的最大请求数，1 为逐个识别")
+    parser.add_argument("--threads", type=int, default=0, help="CPU 推理线程数，0 为 PyTorch 默认")
+    parser.add_argument("--stub", action="store_true", help="不加载模型，仅测试协议")
+    parser.add_argument("--stub-load", type=float, default=0.0, help="占位模型的模拟加载耗时（秒）")
+    parser.add_argument("--stub-rtf", type=float, default=0.0, help="占位模型的模拟实时率")
+    parser.add_argument("--stub-batch-cost", type=float, default=0.0,
+                        help="占位模型批次中每多一个请求，耗时增加单个请求的该比例")
+    args = parser.parse_args()
+
+    if args.threads > 0 and not args.stub:
+        import torch
+        torch.set_num_threads(args.threads)
+
+    start = time.perf_counter()
+    model = load_model(args)
+    load_ms = elapsed_ms(start)
+
+    start = time.perf_counter()
+    try:
+        warmup(model, args)
+    except Exception as e:
+        print(f"Warmup failed: {e}", file=sys.stderr)
+    warmup_ms = elapsed_ms(start)
+
+    emit({"event": "ready", "pid": os.getpid(), "load_ms": load_ms, "warmup_ms": warmup_ms, "rss_mb": rss_mb(),
+          "sample_rate": SAMPLE_RATE,
+          "model_version": "stub" if args.stub else os.path.basename(os.path.normpath(args.model))})
+    serve(model, max(args.max_batch, 1))
+    # 读取线程可能正阻塞在标准输入上（持有其缓冲区锁），解释器正常退出时会因此中止，直接结束进程
+    _proto.flush()
+    os._exit(0)
+
+
+if __name__ == "__main__":
+    main()
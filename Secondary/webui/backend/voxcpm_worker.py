@@ -0,0 +1,853 @@
+#!/usr/bin/env python3
+"""
+VoxCPM TTS Worker
+常驻合成进程：启动时加载一次模型（可选预热），之后通过标准输入/输出的 JSON 行协议处理请求，
+由 Go 后端（tts_worker.go）启动并监管：等待就绪、空闲时健康检查、超时或退出后重启。
+
+协议（每行一个 JSON 对象）：
+  就绪     -> {"event": "ready", "pid": 123, "load_ms": 8123.4, "warmup_ms": 950.2, "sample_rate": 16000,
+               "model_version": "VoxCPM-0.5B-3f2a9c1d0b7e"}
+  合成     <- {"id": 1, "op": "synthesize", "text": "...", "prompt_wav": "", "prompt_text": "", "output": "/tmp/x.wav",
+               "cfg_value": 2.0, "inference_timesteps": 10, "profile": "fast"}
+               （profile 为解码档位 quality / balanced / fast，见 voxcpm.modules.locdit.DECODE_PROFILES；
+               省略时按 inference_timesteps 原样解码）
+  完成     -> {"id": 1, "event": "done", "path": "/tmp/x.wav", "audio_ms": 2300.0, "synth_ms": 1800.5}
+  流式合成 <- {"id": 3, "op": "synthesize_stream", "text": "...", "prompt_wav": "", "prompt_text": "",
+               "sample_rate": 44100, "channels": 2}（输出格式，省略时为模型采样率单声道）
+  音频块   -> {"id": 3, "event": "chunk", "bytes": 14112} 后紧跟 14112 字节 16 位小端 PCM（每个生成步一块，约80ms）
+  完成     -> {"id": 3, "event": "done", "audio_ms": 2300.0, "synth_ms": 1800.5, "first_chunk_ms": 160.2}
+  取消     <- {"id": 3, "op": "cancel"}（在下一个生成步停止，仍以done结束，"cancelled": true）
+  注册音色 <- {"id": 4, "op": "register_voice", "voice": {"id": "v1", "wav": "/voices/v1.wav", "prompt_text": "...",
+                                                         "cache": "/voices/v1.prompt"}}
+           -> {"id": 4, "event": "done", "prompt_ms": 310.5}（编码参考音频并保存提示缓存的耗时）
+  使用音色：合成请求带 "voice"（同上）代替 prompt_wav/prompt_text；done 事件的 prompt_ms 为取得提示缓存的耗时
+  分句     <- {"id": 5, "op": "split", "text": "..."} -> {"id": 5, "event": "done", "sentences": ["...", "..."]}
+  失败     -> {"id": 1, "event": "error", "error": "..."}
+  健康检查 <- {"id": 2, "op": "ping"}  -> {"id": 2, "event": "pong"}
+  退出     <- {"op": "shutdown"}
+
+标准输入由独立线程读取，合成进行中也能收到取消请求。
+
+音频块不经 base64 与 JSON：协议行只带长度，PCM 原样跟在其后，后端读入复用的缓冲区后直接转发。
+请求带 sample_rate / channels 时在本进程内按块转换（线性插值重采样，与后端 linearResampler 的算法和量化一致，
+跨块保留状态），直接播放到设备的请求取得的即是设备格式，后端不再解码与重采样。
+
+参考音频每次都要经 audio VAE 编码为提示缓存；注册音色只编码一次，提示缓存连同模型版本保存到磁盘（原子替换），
+最近使用的若干个常驻内存。模型版本变化或缓存文件丢失时从保存的参考音频重新编码。
+上传参考音频的请求带 "denoise": true 时先经 ZipEnhancer 在内存中分窗降噪（不写临时文件），降噪结果按音频内容哈希缓存，重复的参考音频不再降噪。
+
+model_version 由模型目录内各文件的文件名与内容（流式 SHA-256，启动时计算一次）得出，更换或重新导出模型后后端的合成缓存自然失效。
+
+模型库的 print 输出会被重定向到 stderr，标准输出只承载协议。
+--stub 不加载模型，输出与文本长度成比例的静音，仅用于测试协议与进程开销；
+--stub-rtf 让占位模型按给定实时率耗时（如 0.3 表示生成 1 秒音频耗时 0.3 秒）；
+--stub-cpu 以空转占用 CPU 代替 sleep，多个进程在同一 CPU 上会互相争用，与 CPU 推理一致。
+
+只用 CPU 时 --cpu-int8 / --cpu-compile / --cpu-dtype 启用 VoxCPMModel.optimize_cpu（int8 动态量化、inductor 编译、
+未量化时按 CPU 能力选择 bf16；--cpu-int8 时其余部分固定为 float32，--cpu-dtype 不生效），
+--threads 为本进程的推理线程数（多个进程时平分核数）。int8 改变输出，模型版本带上该标记。
+
+--max-batch N（N>1，实验性）时合成请求批量解码（VoxCPMModel.batched_generator）：最多 N 个请求共用每个生成步，
+新请求在两步之间加入，结束或取消的请求在两步之间离开，各请求的音频块仍按自己的 id 输出。
+完整合成与带文本规范化的请求同样进入批量（完整合成在结束时一次解码整段音频，与单个请求一样重试异常长度），
+不会让其他流暂停；注册音色与分句耗时短，在两步之间执行；健康检查在下一步前回复。
+批量中的请求可单独取消（后端在超时时发送 cancel），不必结束进程。
+与逐个合成的一致性用 VoxCPM/scripts/voxcpm_batch_check.py 检查，通过前保持 --max-batch 1。
+
+预填充复用（--prefix-cache，VoxCPMModel.enable_prefix_cache）：同一音色的请求共享参考文本，播报常有相同的开头，
+这些文本位置的 KV 取自最近的请求，不再经两个语言模型计算；参考音频位于目标文本之后，不能复用。
+
+分句使用 voxcpm.utils.text_normalize.split_paragraph（按标点切分，过短的合并），
+后端据此把长文本拆成句子分给多个合成进程并按顺序输出。
+"""
+
+import argparse
+import array
+import collections
+import json
+import os
+import pickle
+import queue
+import re
+import sys
+import threading
+import time
+import warnings
+
+# 禁用警告
+warnings.filterwarnings('ignore')
+os.environ['PYTHONWARNINGS'] = 'ignore'
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+SAMPLE_RATE = 16000  # 占位模型的输出采样率（真实模型以 tts_model.sample_rate 为准）
+STUB_CHUNK = 1280    # 与 VoxCPM 每个生成步的输出长度一致（patch_size 2 x 640）
+VOICE_MEMORY = 16    # 常驻内存的已注册音色数
+
+# 分句长度（中文按字数，其他语言按 token 数）：超过 SENTENCE_MAX 且已有 SENTENCE_MIN 时断开，末句短于 SENTENCE_MERGE 时并入前句
+SENTENCE_MAX = 50
+SENTENCE_MIN = 25
+SENTENCE_MERGE = 10
+
+
+# ==================== 协议输出 ====================
+# 保留原始 stdout 作为协议通道，之后 fd 1 指向 stderr；读取线程也会输出，每条消息一次写入
+_proto = os.fdopen(os.dup(1), "wb")
+_proto_lock = threading.Lock()
+os.dup2(2, 1)
+sys.stdout = sys.stderr
+
+
+def emit(obj, payload=b""):
+    data = (json.dumps(obj, ensure_ascii=False) + "\n").encode("utf-8") + payload
+    with _proto_lock:
+        _proto.write(data)
+        _proto.flush()
+
+
+def emit_chunk(rid, pcm):
+    emit({"id": rid, "event": "chunk", "bytes": len(pcm)}, pcm)
+
+
+def elapsed_ms(start):
+    return round((time.perf_counter() - start) * 1000, 1)
+
+
+# ==================== 模型 ====================
+class StubModel:
+    """不加载模型的占位实现：每个字符输出 50ms 静音，按 rtf 模拟生成耗时"""
+
+    def __init__(self, rtf=0.0, cpu=False, batch_cost=0.0):
+        self.rtf = rtf
+        self.cpu = cpu
+        self.batch_cost = batch_cost
+
+    def generate_streaming(self, text, **kwargs):
+        remaining = int(SAMPLE_RATE * 0.05) * len(text)
+        while remaining > 0:
+            n = min(STUB_CHUNK, remaining)
+            remaining -= n
+            if self.rtf > 0:
+                self.spend(n / SAMPLE_RATE * self.rtf)
+            yield bytes(n * 2)
+
+    def spend(self, seconds):
+        if not self.cpu:
+            time.sleep(seconds)
+            return
+        # 按进程 CPU 时间计，同一 CPU 上的多个进程各自只得到一部分
+        end = time.process_time() + seconds
+        while time.process_time() < end:
+            pass
+
+    def generate(self, text, **kwargs):
+        return b"".join(self.generate_streaming(text, **kwargs))
+
+    # 与 VoxCPMModel 的提示缓存接口一致；只读取参考音频，不做编码
+    def build_prompt_cache(self, prompt_text, prompt_wav_path):
+        import wave
+        try:
+            with wave.open(prompt_wav_path, "rb") as w:
+                frames = len(w.readframes(w.getnframes()))
+        except wave.Error:
+            with open(prompt_wav_path, "rb") as f:
+                frames = len(f.read())
+        return {"text_token": prompt_text, "audio_bytes": frames}
+
+    def generate_with_prompt_cache_streaming(self, target_text, prompt_cache, **kwargs):
+        for pcm in self.generate_streaming(target_text):
+            yield pcm, None, None
+
+    def generate_with_prompt_cache(self, target_text, prompt_cache, **kwargs):
+        return self.generate(target_text), None, None
+
+    def batched_generator(self, max_batch):
+        return StubBatchedGenerator(self, max_batch)
+
+
+class StubBatchedGenerator:
+    """与 voxcpm.model.batching.BatchedGenerator 接口一致的占位实现：
+    每步为每个请求输出一块静音，一步的耗时为单个请求一步的 (1 + batch_cost × (请求数 - 1)) 倍"""
+
+    def __init__(self, model, max_batch):
+        self.model = model
+        self.max_batch = max_batch
+        self.rows = collections.OrderedDict()  # handle -> 剩余样本数
+        self.next_handle = 0
+
+    def __len__(self):
+        return len(self.rows)
+
+    def add(self, target_text, prompt_cache=None, streaming=True, **kwargs):
+        if len(self.rows) >= self.max_batch:
+            raise ValueError(f"batch is full ({self.max_batch} requests)")
+        handle = self.next_handle
+        self.next_handle += 1
+        total = int(SAMPLE_RATE * 0.05) * len(target_text)
+        self.rows[handle] = (total, total, streaming)
+        return handle
+
+    def cancel(self, handle):
+        self.rows.pop(handle, None)
+
+    def step(self):
+        if not self.rows:
+            return []
+        if self.model.rtf > 0:
+            cost = 1 + self.model.batch_cost * (len(self.rows) - 1)
+            self.model.spend(STUB_CHUNK / SAMPLE_RATE * self.model.rtf * cost)
+        results = []
+        for handle, (remaining, total, streaming) in list(self.rows.items()):
+            n = min(STUB_CHUNK, remaining)
+            remaining -= n
+            if remaining > 0:
+                self.rows[handle] = (remaining, total, streaming)
+            else:
+                del self.rows[handle]
+            if streaming:
+                results.append((handle, bytes(n * 2), remaining <= 0))
+            else:
+                results.append((handle, bytes(total * 2) if remaining <= 0 else None, remaining <= 0))
+        return results
+
+
+def load_model(args):
+    if args.stub:
+        return StubModel(args.stub_rtf, args.stub_cpu, args.stub_batch_cost)
+
+    import voxcpm
+
+    enable_denoiser = not args.no_denoiser
+    model = voxcpm.VoxCPM(
+        voxcpm_model_path=args.model,
+        zipenhancer_model_path=args.zipenhancer if enable_denoiser else None,
+        enable_denoiser=enable_denoiser,
+    )
+    model.tts_model.enable_prefix_cache(args.prefix_cache)
+    if model.tts_model.device == "cpu":
+        if cpu_optimized(args):
+            dtype = model.tts_model.config.dtype if args.cpu_dtype == "config" else args.cpu_dtype
+            model.tts_model.optimize_cpu(quantize=args.cpu_int8, compile=args.cpu_compile,
+                                         dtype=dtype, num_threads=args.threads)
+        elif args.threads > 0:
+            import torch
+            torch.set_num_threads(args.threads)
+    return model
+
+
+def cpu_optimized(args):
+    return args.cpu_int8 or args.cpu_compile or args.cpu_dtype != "config"
+
+
+def model_version(args, model):
+    """模型目录名 + 目录内全部文件（配置、分词器、权重）的文件名与内容摘要；CPU 优化改变推理精度时附加精度标记
+
+    权重按块流式读入计算 SHA-256，启动时计算一次：微调或重新导出后大小不变的权重也会得到新版本，
+    合成缓存、音色提示缓存与预渲染模型库随之失效。"""
+    if args.stub:
+        return "stub"
+
+    import hashlib
+
+    h = hashlib.sha256()
+    start = time.perf_counter()
+    for root, dirs, files in os.walk(args.model):
+        dirs[:] = sorted(d for d in dirs if not d.startswith("."))  # 跳过 .git、下载缓存等
+        for name in sorted(f for f in files if not f.startswith(".")):
+            path = os.path.join(root, name)
+            h.update(os.path.relpath(path, args.model).encode("utf-8") + b"\0")
+            with open(path, "rb") as f:
+                for block in iter(lambda: f.read(1 << 20), b""):
+                    h.update(block)
+    print(f"Model hash: {elapsed_ms(start):.0f}ms", file=sys.stderr)
+    version = f"{os.path.basename(os.path.normpath(args.model))}-{h.hexdigest()[:12]}"
+    # 不同精度生成的音频不同，合成缓存与音色提示缓存不能混用
+    if cpu_optimized(args) and model.tts_model.device == "cpu":
+        version += f"+cpu-{model.tts_model.config.dtype}" + ("-int8" if args.cpu_int8 else "")
+    return version
+
+
+def tts_model(model):
+    """提示缓存接口所在的对象（VoxCPM 包装内的 VoxCPMModel；占位模型为自身）"""
+    return getattr(model, "tts_model", model)
+
+
+def model_sample_rate(model):
+    """模型输出采样率：就绪事件、WAV 文件与音频块转换都以此为准（占位模型为 SAMPLE_RATE）"""
+    return getattr(tts_model(model), "sample_rate", SAMPLE_RATE)
+
+
+# ==================== 已注册音色 ====================
+class VoiceStore:
+    """已注册音色的提示缓存：内存中保留最近使用的 VOICE_MEMORY 个，其余按需从磁盘加载"""
+
+    def __init__(self, model, version):
+        self.model = model
+        self.version = version
+        self.loaded = collections.OrderedDict()
+
+    def get(self, voice):
+        vid = voice["id"]
+        if vid in self.loaded:
+            self.loaded.move_to_end(vid)
+            return self.loaded[vid]
+        cache = self.load(voice.get("cache"))
+        if cache is None:
+            cache, _ = self.build(voice)
+        else:
+            self.remember(vid, cache)
+        return cache
+
+    def build(self, voice):
+        """编码参考音频并保存提示缓存，返回 (缓存, 编码耗时ms)"""
+        if not voice.get("wav") or not voice.get("prompt_text"):
+            raise ValueError("voice requires wav and prompt_text")
+        start = time.perf_counter()
+        cache = tts_model(self.model).build_prompt_cache(
+            prompt_text=voice["prompt_text"], prompt_wav_path=voice["wav"])
+        encode_ms = elapsed_ms(start)
+        if voice.get("cache"):
+            self.save(cache, voice["cache"])
+        self.remember(voice["id"], cache)
+        return cache, encode_ms
+
+    def remember(self, vid, cache):
+        self.loaded[vid] = cache
+        self.loaded.move_to_end(vid)
+        while len(self.loaded) > VOICE_MEMORY:
+            self.loaded.popitem(last=False)
+
+    def save(self, cache, path):
+        data = {"model_version": self.version, "cache": cache}
+        tmp = path + ".partial"
+        if isinstance(self.model, StubModel):
+            with open(tmp, "wb") as f:
+                pickle.dump(data, f)
+        else:
+            import torch
+            torch.save(data, tmp)
+        os.replace(tmp, path)
+
+    def load(self, path):
+        if not path or not os.path.exists(path):
+            return None
+        try:
+            if isinstance(self.model, StubModel):
+                with open(path, "rb") as f:
+                    data = pickle.load(f)
+            else:
+                import torch
+                data = torch.load(path, map_location="cpu")
+        except Exception as e:
+            print(f"Failed to load prompt cache {path}: {e}", file=sys.stderr)
+            return None
+        if data.get("model_version") != self.version:
+            return None
+        return data["cache"]
+
+
+def write_wav(path, audio, sample_rate):
+    """写出模型采样率的单声道 WAV，返回音频时长（毫秒）"""
+    if isinstance(audio, (bytes, bytearray)):
+        import wave
+        with wave.open(path, "wb") as w:
+            w.setnchannels(1)
+            w.setsampwidth(2)
+            w.setframerate(sample_rate)
+            w.writeframes(audio)
+        return round(len(audio) / 2 / sample_rate * 1000, 1)
+
+    import numpy as np
+    import soundfile as sf
+
+    if not isinstance(audio, np.ndarray):
+        raise ValueError(f"Unexpected audio data type: {type(audio)}")
+    sf.write(path, audio, sample_rate)
+    return round(len(audio) / sample_rate * 1000, 1)
+
+
+def to_pcm16(audio):
+    """float32 波形（或占位模型的 bytes）转为 16 位小端 PCM"""
+    if isinstance(audio, (bytes, bytearray)):
+        return bytes(audio)
+
+    import numpy as np
+    return (np.clip(audio, -1.0, 1.0) * 32767).astype("<i2").tobytes()
+
+
+class PCMConverter:
+    """把模型输出的音频块转换为请求的采样率与声道数（16 位小端 PCM）。
+
+    线性插值重采样：第 k 个输出帧位于源采样 k * src / dst 处，用整数记录位置，逐块转换与整段转换结果相同；
+    与后端 linearResampler 一样第一个源采样之后才开始输出，不输出最后一个源采样之后的部分。
+    量化与后端 appendPCM16 一致（负值乘 32768，正值乘 32767，向零取整）。输出格式与模型相同时原样输出。
+    """
+
+    def __init__(self, src_rate, dst_rate=0, channels=0):
+        self.src = src_rate
+        self.dst = dst_rate or src_rate
+        self.channels = channels or 1
+        self.passthrough = self.dst == self.src and self.channels == 1
+        self.samples = 0   # 已收到的源采样数
+        self.produced = 0  # 已输出的帧数
+        self.prev = 0.0    # 上一块的最后一个源采样
+
+    @classmethod
+    def for_request(cls, req, src_rate):
+        return cls(src_rate, int(req.get("sample_rate") or 0), int(req.get("channels") or 0))
+
+    def audio_ms(self):
+        return round(self.samples / self.src * 1000, 1)
+
+    def convert(self, audio):
+        """audio 为 float32 波形或占位模型的 16 位 PCM bytes"""
+        if self.passthrough:
+            pcm = to_pcm16(audio)
+            self.samples += len(pcm) // 2
+            return pcm
+        try:
+            import numpy as np
+        except ImportError:
+            return self._convert_list(audio)
+
+        if isinstance(audio, (bytes, bytearray)):
+            x = np.frombuffer(audio, dtype="<i2").astype(np.float32) / 32768
+        else:
+            x = np.asarray(audio, dtype=np.float32).reshape(-1)
+        if x.size == 0:
+            return b""
+        # 本块之前的最后一个采样位于 base，与本块拼接后按全局位置插值
+        base = self.samples - 1 if self.samples else 0
+        s = np.concatenate([[self.prev], x]) if self.samples else x
+        self.samples += x.size
+        self.prev = float(x[-1])
+        end = ((self.samples - 1) * self.dst + self.src - 1) // self.src  # 位置 < 最新采样的帧
+        if end <= self.produced:
+            return b""
+        pos = np.arange(self.produced, end, dtype=np.int64) * self.src
+        self.produced = end
+        i = pos // self.dst - base
+        f = ((pos % self.dst) / self.dst).astype(np.float32)
+        v = s[i] + (s[i + 1] - s[i]) * f
+        v = np.where(v < 0, v * 32768, v * 32767).clip(-32768, 32767).astype("<i2")
+        return np.repeat(v, self.channels).tobytes()
+
+    def _convert_list(self, audio):
+        """没有 numpy 时（--stub 用系统 python3）逐采样转换，算法同上"""
+        if not isinstance(audio, (bytes, bytearray)):
+            raise ValueError(f"Unexpected audio data type: {type(audio)}")
+        pcm = array.array("h", bytes(audio))
+        if sys.byteorder == "big":
+            pcm.byteswap()
+        x = [v / 32768 for v in pcm]
+        if not x:
+            return b""
+        base = self.samples - 1 if self.samples else 0
+        s = [self.prev] + x if self.samples else x
+        self.samples += len(x)
+        self.prev = x[-1]
+        end = ((self.samples - 1) * self.dst + self.src - 1) // self.src
+        out = array.array("h")
+        for k in range(self.produced, end):
+            pos = k * self.src
+            i = pos // self.dst - base
+            v = s[i] + (s[i + 1] - s[i]) * (pos % self.dst) / self.dst
+            v = max(-32768, min(32767, int(v * 32768 if v < 0 else v * 32767)))
+            out.extend([v] * self.channels)
+        self.produced = max(self.produced, end)
+        if sys.byteorder == "big":
+            out.byteswap()
+        return out.tobytes()
+
+
+# ==================== 请求处理 ====================
+def generate_args(req):
+    text = req.get("text", "")
+    if not text.strip():
+        raise ValueError("target text must be a non-empty string")
+    return dict(
+        text=text,
+        prompt_text=req.get("prompt_text") or None,
+        prompt_wav_path=req.get("prompt_wav") or None,
+        cfg_value=float(req.get("cfg_value", 2.0)),
+        inference_timesteps=int(req.get("inference_timesteps", 10)),
+        decode_profile=req.get("profile") or None,
+        normalize=bool(req.get("normalize", False)),
+        denoise=bool(req.get("denoise", False)),
+    )
+
+
+def prompt_cache(model, voices, req):
+    """返回 (提示缓存或 None, 耗时ms)：已注册音色从内存或磁盘取得，上传的参考音频每次编码"""
+    voice = req.get("voice")
+    prompt_wav = req.get("prompt_wav")
+    if not voice and not prompt_wav:
+        return None, 0.0
+    start = time.perf_counter()
+    if voice:
+        cache = voices.get(voice)
+    else:
+        if not req.get("prompt_text"):
+            raise ValueError("prompt_wav and prompt_text must both be provided")
+        if not os.path.exists(prompt_wav):
+            raise FileNotFoundError(f"prompt_wav_path does not exist: {prompt_wav}")
+        if req.get("denoise") and getattr(model, "denoiser", None) is not None:
+            # 在内存中分窗降噪，按参考音频内容缓存降噪结果
+            cache = model.build_prompt_cache(prompt_text=req["prompt_text"], prompt_wav_path=prompt_wav, denoise=True)
+        else:
+            cache = tts_model(model).build_prompt_cache(
+                prompt_text=req["prompt_text"], prompt_wav_path=prompt_wav)
+    return cache, elapsed_ms(start)
+
+
+def squeeze(wav):
+    return wav if isinstance(wav, (bytes, bytearray)) else wav.squeeze(0).cpu().numpy()
+
+
+def generate(model, voices, req, streaming):
+    """有参考音色时取得提示缓存后直接调用 VoxCPMModel（与 VoxCPM.generate 的处理一致，不做文本规范化与降噪），
+    返回 (音频或音频块生成器, 提示耗时ms)"""
+    kwargs = generate_args(req)
+    cache, prompt_ms = prompt_cache(model, voices, req)
+    if cache is None:
+        if streaming:
+            return model.generate_streaming(**kwargs), prompt_ms
+        return model.generate(**kwargs), prompt_ms
+
+    common = dict(
+        target_text=re.sub(r"\s+", " ", kwargs["text"].replace("\n", " ")),
+        prompt_cache=cache,
+        min_len=2,
+        max_len=4096,
+        inference_timesteps=kwargs["inference_timesteps"],
+        cfg_value=kwargs["cfg_value"],
+        decode_profile=kwargs["decode_profile"],
+    )
+    if streaming:
+        chunks = tts_model(model).generate_with_prompt_cache_streaming(**common)
+        return (squeeze(wav) for wav, _, _ in chunks), prompt_ms
+    wav, _, _ = tts_model(model).generate_with_prompt_cache(retry_badcase=True, **common)
+    return squeeze(wav), prompt_ms
+
+
+def synthesize(model, voices, req):
+    output = req.get("output") or f"/tmp/tts_result_{int(time.time() * 1000)}.wav"
+
+    start = time.perf_counter()
+    audio, prompt_ms = generate(model, voices, req, streaming=False)
+    synth_ms = elapsed_ms(start)
+    audio_ms = write_wav(output, audio, model_sample_rate(model))
+    return {"path": output, "audio_ms": audio_ms, "synth_ms": synth_ms, "prompt_ms": prompt_ms}
+
+
+def synthesize_stream(model, voices, req, cancelled):
+    """逐个生成步输出音频块，收到取消后在下一步停止"""
+    rid = req.get("id")
+
+    start = time.perf_counter()
+    conv = PCMConverter.for_request(req, model_sample_rate(model))
+    chunks, prompt_ms = generate(model, voices, req, streaming=True)
+    first_chunk_ms = None
+    stopped = False
+    for chunk in chunks:
+        if rid in cancelled:
+            stopped = True
+            break
+        pcm = conv.convert(chunk)
+        if not pcm:
+            continue
+        if first_chunk_ms is None:
+            first_chunk_ms = elapsed_ms(start)
+        emit_chunk(rid, pcm)
+    cancelled.discard(rid)
+    return {
+        "audio_ms": conv.audio_ms(),
+        "synth_ms": elapsed_ms(start),
+        "first_chunk_ms": first_chunk_ms or 0.0,
+        "prompt_ms": prompt_ms,
+        "cancelled": stopped,
+    }
+
+
+# ==================== 批量合成 ====================
+def batch_text(model, req, kwargs, cache):
+    """与 generate 的单个请求路径相同的文本：合并空白；没有参考音色时按请求做文本规范化（同 VoxCPM.generate）"""
+    text = re.sub(r"\s+", " ", kwargs["text"].replace("\n", " "))
+    if kwargs["normalize"] and cache is None and hasattr(model, "text_normalizer"):
+        if model.text_normalizer is None:
+            from voxcpm.utils.text_normalize import TextNormalizer
+            model.text_normalizer = TextNormalizer()
+        text = model.text_normalizer.normalize(text)
+    return text
+
+
+class SynthBatch:
+    """--max-batch 时的合成：流式与完整合成请求都进入批量解码器，每调用一次 step 全部请求前进一个生成步"""
+
+    def __init__(self, model, voices, max_batch, cancelled):
+        self.model = model
+        self.voices = voices
+        self.cancelled = cancelled
+        self.engine = tts_model(model).batched_generator(max_batch)
+        self.max_batch = max_batch
+        self.rows = {}  # handle -> 请求状态
+        self.waiting = collections.deque()  # 批量已满时到达的请求
+
+    @staticmethod
+    def accepts(req):
+        return req.get("op") in ("synthesize", "synthesize_stream")
+
+    def active(self):
+        return bool(self.rows or self.waiting)
+
+    def admit(self, req):
+        self.waiting.append(req)
+        self.fill()
+
+    def fill(self):
+        while self.waiting and len(self.engine) < self.max_batch:
+            req = self.waiting.popleft()
+            rid = req.get("id")
+            streaming = req.get("op") == "synthesize_stream"
+            start = time.perf_counter()
+            if rid in self.cancelled:
+                self.cancelled.discard(rid)
+                emit({"id": rid, "event": "done", "audio_ms": 0.0, "synth_ms": 0.0, "first_chunk_ms": 0.0,
+                      "prompt_ms": 0.0, "cancelled": True})
+                continue
+            try:
+                kwargs = generate_args(req)
+                cache, prompt_ms = prompt_cache(self.model, self.voices, req)
+                handle = self.engine.add(
+                    target_text=batch_text(self.model, req, kwargs, cache),
+                    prompt_cache=cache,
+                    min_len=2,
+                    max_len=4096,
+                    inference_timesteps=kwargs["inference_timesteps"],
+                    cfg_value=kwargs["cfg_value"],
+                    decode_profile=kwargs["decode_profile"],
+                    streaming=streaming,
+                    retry_badcase=not streaming,
+                )
+            except Exception as e:
+                import traceback
+                traceback.print_exc()
+                emit({"id": rid, "event": "error", "error": str(e)})
+                continue
+            st = {"id": rid, "start": start, "prompt_ms": prompt_ms, "streaming": streaming}
+            if streaming:
+                st.update(first_chunk_ms=None, conv=PCMConverter.for_request(req, model_sample_rate(self.model)))
+            else:
+                st["output"] = req.get("output") or f"/tmp/tts_result_{int(time.time() * 1000)}.wav"
+            self.rows[handle] = st
+
+    def step(self):
+        """取消的请求先离开，其余前进一步：流式请求输出音频块，结束的请求回复 done，空出的位置由等待的请求补上"""
+        for handle, st in list(self.rows.items()):
+            if st["id"] in self.cancelled:
+                self.engine.cancel(handle)
+                self.finish(handle, cancelled=True)
+        if self.rows:
+            try:
+                results = self.engine.step()
+            except Exception as e:
+                import traceback
+                traceback.print_exc()
+                for handle, st in list(self.rows.items()):
+                    self.engine.cancel(handle)
+                    del self.rows[handle]
+                    emit({"id": st["id"], "event": "error", "error": str(e)})
+                results = []
+            for handle, audio, finished in results:
+                st = self.rows[handle]
+                if st["streaming"]:
+                    pcm = st["conv"].convert(squeeze(audio))
+                    if pcm:
+                        if st["first_chunk_ms"] is None:
+                            st["first_chunk_ms"] = elapsed_ms(st["start"])
+                        emit_chunk(st["id"], pcm)
+                if finished:
+                    self.finish(handle, audio=audio)
+        self.fill()
+
+    def finish(self, handle, cancelled=False, audio=None):
+        st = self.rows.pop(handle)
+        self.cancelled.discard(st["id"])
+        if st["streaming"]:
+            emit({
+                "id": st["id"],
+                "event": "done",
+                "audio_ms": st["conv"].audio_ms(),
+                "synth_ms": elapsed_ms(st["start"]),
+                "first_chunk_ms": st["first_chunk_ms"] or 0.0,
+                "prompt_ms": st["prompt_ms"],
+                "cancelled": cancelled,
+            })
+            return
+        result = {"id": st["id"], "event": "done", "synth_ms": elapsed_ms(st["start"]),
+                  "prompt_ms": st["prompt_ms"], "cancelled": cancelled}
+        if not cancelled:
+            try:
+                result.update(path=st["output"],
+                              audio_ms=write_wav(st["output"], squeeze(audio), model_sample_rate(self.model)))
+            except Exception as e:
+                emit({"id": st["id"], "event": "error", "error": str(e)})
+                return
+        emit(result)
+
+
+# ==================== 分句 ====================
+def split_sentences(model, text):
+    text = re.sub(r"\s+", " ", text.replace("\n", " ")).strip()
+    if not text:
+        raise ValueError("target text must be a non-empty string")
+    tokenizer = getattr(tts_model(model), "text_tokenizer", None) or str.split
+    try:
+        from voxcpm.utils.text_normalize import contains_chinese, split_paragraph
+    except ImportError:
+        # 占位模型运行在没有 VoxCPM 依赖的环境中
+        contains_chinese, split_paragraph = _contains_chinese, _split_paragraph
+    lang = "zh" if contains_chinese(text) else "en"
+    return split_paragraph(text, tokenizer, lang=lang, token_max_n=SENTENCE_MAX,
+                           token_min_n=SENTENCE_MIN, merge_len=SENTENCE_MERGE)
+
+
+def _contains_chinese(text):
+    return re.search(r"[\u4e00-\u9fff]", text) is not None
+
+
+def _split_paragraph(text, tokenize, lang="zh", token_max_n=80, token_min_n=60, merge_len=20):
+    """text_normalize.split_paragraph 的精简版：规则相同，不处理引号"""
+    length = len if lang == "zh" else (lambda t: len(tokenize(t)))
+    punct = "。？！；：、.?!;" if lang == "zh" else ".?!;:"
+    utts = [u for u in re.findall(f"[^{re.escape(punct)}]*[{re.escape(punct)}]|[^{re.escape(punct)}]+$", text) if u.strip()]
+    final, cur = [], ""
+    for utt in utts:
+        if length(cur + utt) > token_max_n and length(cur) > token_min_n:
+            final.append(cur)
+            cur = ""
+        cur += utt
+    if cur:
+        if length(cur) < merge_len and final:
+            final[-1] += cur
+        else:
+            final.append(cur)
+    return final
+
+
+def register_voice(voices, req):
+    _, encode_ms = voices.build(req.get("voice") or {})
+    return {"prompt_ms": encode_ms}
+
+
+# ==================== 标准输入读取线程 ====================
+# 取消与健康检查不必等待当前合成结束；其余请求按顺序进入队列
+def read_requests(requests, cancelled):
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            req = json.loads(line)
+        except json.JSONDecodeError as e:
+            emit({"event": "error", "error": f"invalid request: {e}"})
+            continue
+        if req.get("op") == "cancel":
+            cancelled.add(req.get("id"))
+            continue
+        requests.put(req)
+    requests.put({"op": "shutdown"})
+
+
+def serve(model, voices, max_batch=1):
+    requests = queue.Queue()
+    cancelled = set()
+    threading.Thread(target=read_requests, args=(requests, cancelled), daemon=True).start()
+    batch = SynthBatch(model, voices, max_batch, cancelled) if max_batch > 1 else None
+
+    while True:
+        # 批量解码进行中只取已到达的请求，没有时前进一步
+        if batch is not None and batch.active():
+            try:
+                req = requests.get_nowait()
+            except queue.Empty:
+                batch.step()
+                continue
+        else:
+            req = requests.get()
+        op = req.get("op")
+        rid = req.get("id")
+        if op == "shutdown":
+            return
+        if op == "ping":
+            emit({"id": rid, "event": "pong"})
+            continue
+        if op not in ("synthesize", "synthesize_stream", "register_voice", "split"):
+            emit({"id": rid, "event": "error", "error": f"unknown op: {op}"})
+            continue
+        if batch is not None and SynthBatch.accepts(req):
+            batch.admit(req)
+            continue
+
+        try:
+            if op == "synthesize_stream":
+                result = synthesize_stream(model, voices, req, cancelled)
+            elif op == "register_voice":
+                result = register_voice(voices, req)
+            elif op == "split":
+                result = {"sentences": split_sentences(model, req.get("text", ""))}
+            else:
+                result = synthesize(model, voices, req)
+            result.update({"id": rid, "event": "done"})
+            emit(result)
+        except Exception as e:
+            import traceback
+            traceback.print_exc()
+            emit({"id": rid, "event": "error", "error": str(e)})
+
+
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM TTS worker")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--zipenhancer", default="./model/speech_zipenhancer_ans_multiloss_16k_base")
+    parser.add_argument("--no-denoiser", action="store_true", help="不加载 ZipEnhancer")
+    parser.add_argument("--warmup", default="", help="就绪前合成一次的预热文本，空则跳过")
+    parser.add_argument("--stub", action="store_true", help="不加载模型，仅测试协议")
+    parser.add_argument("--stub-rtf", type=float, default=0.0, help="占位模型的模拟实时率")
+    parser.add_argument("--stub-cpu", action="store_true", help="占位模型空转占用 CPU 而不是 sleep")
+    parser.add_argument("--stub-batch-cost", type=float, default=0.0,
+                        help="占位模型批量解码时每多一个请求，一步耗时增加单个请求一步的该比例")
+    parser.add_argument("--max-batch", type=int, default=1, help="实验性：批量解码的最大请求数，1 为逐个合成")
+    parser.add_argument("--cpu-int8", action="store_true", help="CPU：线性层 int8 动态量化")
+    parser.add_argument("--cpu-compile", action="store_true", help="CPU：用 inductor 编译各生成步函数")
+    parser.add_argument("--cpu-dtype", default="config", choices=["config", "auto", "float32", "bfloat16"],
+                        help="CPU：推理精度，auto 仅在 CPU 原生支持 bf16 时使用 bf16，config 保持模型配置；--cpu-int8 时固定为 float32")
+    parser.add_argument("--threads", type=int, default=0, help="CPU 推理线程数，0 为 PyTorch 默认")
+    parser.add_argument("--prefix-cache", type=int, default=16,
+                        help="保留最近若干个请求文本前缀的 KV，相同参考文本或开头的请求跳过这部分预填充，0 为关闭")
+    args = parser.parse_args()
+    if args.cpu_int8 and args.cpu_dtype not in ("config", "float32"):
+        parser.error("--cpu-int8 时未量化的部分固定为 float32，--cpu-dtype 只能为 config 或 float32")
+
+    start = time.perf_counter()
+    model = load_model(args)
+    load_ms = elapsed_ms(start)
+
+    warmup_ms = 0.0
+    if args.warmup:
+        start = time.perf_counter()
+        try:
+            model.generate(text=args.warmup, cfg_value=2.0, inference_timesteps=10,
+                           normalize=False, denoise=False)
+        except Exception as e:
+            print(f"Warmup failed: {e}", file=sys.stderr)
+        warmup_ms = elapsed_ms(start)
+
+    version = model_version(args, model)
+    emit({"event": "ready", "pid": os.getpid(), "load_ms": load_ms, "warmup_ms": warmup_ms,
+          "sample_rate": model_sample_rate(model),
+          "model_version": version})
+    serve(model, VoiceStore(model, version), args.max_batch)
+
+
+if __name__ == "__main__":
+    main()
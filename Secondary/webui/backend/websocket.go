@@ -0,0 +1,336 @@
+/***
+ * @file websocket.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-17
+ * @brief 最小WebSocket实现（RFC 6455，仅标准库；服务端升级 + 基准测试用客户端）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-17
+ * @filePath websocket.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bufio"
+	"crypto/rand"
+	"crypto/sha1"
+	"encoding/base64"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"strings"
+	"sync"
+	"time"
+)
+
+// ==================== 协议常量 ====================
+const (
+	wsOpContinuation = 0x0
+	wsOpText         = 0x1
+	wsOpBinary       = 0x2
+	wsOpClose        = 0x8
+	wsOpPing         = 0x9
+	wsOpPong         = 0xA
+
+	wsCloseNormal   = 1000
+	wsCloseProtocol = 1002
+	wsCloseTooBig   = 1009
+
+	wsAcceptGUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+)
+
+var (
+	errWSProtocol = errors.New("websocket protocol error")
+	errWSTooLarge = errors.New("websocket message too large")
+)
+
+// ==================== 连接 ====================
+type wsConn struct {
+	conn   net.Conn
+	br     *bufio.Reader
+	client bool // 客户端发送的帧需要掩码
+
+	wmu  sync.Mutex
+	wbuf []byte    // 写帧缓冲（帧头 + 负载），复用避免每帧分配
+	ctrl [125]byte // 控制帧负载缓冲
+	hdr  [14]byte
+}
+
+type wsFrameHeader struct {
+	fin    bool
+	op     byte
+	length int
+	masked bool
+	mask   [4]byte
+}
+
+// ==================== 服务端升级 ====================
+// 校验握手头并接管连接；失败时已向客户端写出HTTP错误
+func wsUpgrade(w http.ResponseWriter, r *http.Request) (*wsConn, error) {
+	if r.Method != http.MethodGet ||
+		!strings.EqualFold(r.Header.Get("Upgrade"), "websocket") ||
+		!strings.Contains(strings.ToLower(r.Header.Get("Connection")), "upgrade") {
+		http.Error(w, "WebSocket upgrade required", http.StatusBadRequest)
+		return nil, errWSProtocol
+	}
+	if r.Header.Get("Sec-WebSocket-Version") != "13" {
+		w.Header().Set("Sec-WebSocket-Version", "13")
+		http.Error(w, "Unsupported WebSocket version", http.StatusUpgradeRequired)
+		return nil, errWSProtocol
+	}
+	key := r.Header.Get("Sec-WebSocket-Key")
+	if key == "" {
+		http.Error(w, "Missing Sec-WebSocket-Key", http.StatusBadRequest)
+		return nil, errWSProtocol
+	}
+
+	hj, ok := w.(http.Hijacker)
+	if !ok {
+		http.Error(w, "Connection cannot be upgraded", http.StatusInternalServerError)
+		return nil, errors.New("response writer does not support hijacking")
+	}
+	conn, rw, err := hj.Hijack()
+	if err != nil {
+		return nil, err
+	}
+
+	rw.WriteString("HTTP/1.1 101 Switching Protocols\r\n" +
+		"Upgrade: websocket\r\n" +
+		"Connection: Upgrade\r\n" +
+		"Sec-WebSocket-Accept: " + wsAcceptKey(key) + "\r\n\r\n")
+	if err := rw.Flush(); err != nil {
+		conn.Close()
+		return nil, err
+	}
+	conn.SetDeadline(time.Time{})
+	return &wsConn{conn: conn, br: rw.Reader}, nil
+}
+
+func wsAcceptKey(key string) string {
+	h := sha1.Sum([]byte(key + wsAcceptGUID))
+	return base64.StdEncoding.EncodeToString(h[:])
+}
+
+// ==================== 客户端连接（基准测试用） ====================
+func wsDial(address, path string) (*wsConn, error) {
+	conn, err := net.DialTimeout("tcp", address, 5*time.Second)
+	if err != nil {
+		return nil, err
+	}
+	var nonce [16]byte
+	rand.Read(nonce[:])
+	key := base64.StdEncoding.EncodeToString(nonce[:])
+
+	req := fmt.Sprintf("GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"+
+		"Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n", path, address, key)
+	if _, err := io.WriteString(conn, req); err != nil {
+		conn.Close()
+		return nil, err
+	}
+
+	br := bufio.NewReader(conn)
+	resp, err := http.ReadResponse(br, nil)
+	if err != nil {
+		conn.Close()
+		return nil, err
+	}
+	resp.Body.Close()
+	if resp.StatusCode != http.StatusSwitchingProtocols || resp.Header.Get("Sec-WebSocket-Accept") != wsAcceptKey(key) {
+		conn.Close()
+		return nil, fmt.Errorf("websocket handshake failed: %s", resp.Status)
+	}
+	return &wsConn{conn: conn, br: br, client: true}, nil
+}
+
+// ==================== 读取帧头 ====================
+func (c *wsConn) readHeader() (wsFrameHeader, error) {
+	var h wsFrameHeader
+	b := c.hdr[:2]
+	if _, err := io.ReadFull(c.br, b); err != nil {
+		return h, err
+	}
+	h.fin = b[0]&0x80 != 0
+	h.op = b[0] & 0x0F
+	h.masked = b[1]&0x80 != 0
+	if b[0]&0x70 != 0 {
+		return h, errWSProtocol // 未协商扩展，RSV位必须为0
+	}
+
+	switch n := b[1] & 0x7F; n {
+	case 126:
+		if _, err := io.ReadFull(c.br, c.hdr[:2]); err != nil {
+			return h, err
+		}
+		h.length = int(binary.BigEndian.Uint16(c.hdr[:2]))
+	case 127:
+		if _, err := io.ReadFull(c.br, c.hdr[:8]); err != nil {
+			return h, err
+		}
+		l := binary.BigEndian.Uint64(c.hdr[:8])
+		if l > 1<<31 {
+			return h, errWSTooLarge
+		}
+		h.length = int(l)
+	default:
+		h.length = int(n)
+	}
+
+	if h.masked {
+		// 读入连接自带的缓冲再拷贝，避免帧头逃逸到堆上
+		if _, err := io.ReadFull(c.br, c.hdr[:4]); err != nil {
+			return h, err
+		}
+		copy(h.mask[:], c.hdr[:4])
+	}
+	// 客户端发往服务端的帧必须掩码
+	if !c.client && !h.masked {
+		return h, errWSProtocol
+	}
+	return h, nil
+}
+
+func (c *wsConn) readPayload(h wsFrameHeader, dst []byte) error {
+	if _, err := io.ReadFull(c.br, dst); err != nil {
+		return err
+	}
+	if h.masked {
+		wsMask(dst, h.mask)
+	}
+	return nil
+}
+
+func wsMask(b []byte, key [4]byte) {
+	// 按8字节批量异或，剩余部分逐字节处理
+	k := uint64(binary.LittleEndian.Uint32(key[:]))
+	k |= k << 32
+	i := 0
+	for ; i+8 <= len(b); i += 8 {
+		binary.LittleEndian.PutUint64(b[i:], binary.LittleEndian.Uint64(b[i:])^k)
+	}
+	for ; i < len(b); i++ {
+		b[i] ^= key[i&3]
+	}
+}
+
+// ==================== 读取完整消息 ====================
+// 负载追加到buf之后（容量足够时不分配）；控制帧在此处理，收到关闭帧时回应并返回io.EOF
+func (c *wsConn) readMessage(buf []byte, limit int) (byte, []byte, error) {
+	var op byte
+	for {
+		h, err := c.readHeader()
+		if err != nil {
+			return 0, buf, err
+		}
+
+		if h.op >= wsOpClose {
+			if h.length > len(c.ctrl) || !h.fin {
+				c.writeClose(wsCloseProtocol)
+				return 0, buf, errWSProtocol
+			}
+			p := c.ctrl[:h.length]
+			if err := c.readPayload(h, p); err != nil {
+				return 0, buf, err
+			}
+			switch h.op {
+			case wsOpClose:
+				c.writeClose(wsCloseNormal)
+				return 0, buf, io.EOF
+			case wsOpPing:
+				c.writeFrame(wsOpPong, p)
+			}
+			continue
+		}
+
+		if h.op == wsOpContinuation {
+			if op == 0 {
+				c.writeClose(wsCloseProtocol)
+				return 0, buf, errWSProtocol
+			}
+		} else {
+			if op != 0 {
+				c.writeClose(wsCloseProtocol)
+				return 0, buf, errWSProtocol
+			}
+			op = h.op
+		}
+
+		n := len(buf)
+		if n+h.length > limit {
+			c.writeClose(wsCloseTooBig)
+			return 0, buf, errWSTooLarge
+		}
+		if cap(buf) < n+h.length {
+			grown := make([]byte, n, n+h.length)
+			copy(grown, buf)
+			buf = grown
+		}
+		buf = buf[:n+h.length]
+		if err := c.readPayload(h, buf[n:]); err != nil {
+			return 0, buf, err
+		}
+		if h.fin {
+			return op, buf, nil
+		}
+	}
+}
+
+// ==================== 写帧 ====================
+func (c *wsConn) writeFrame(op byte, payload []byte) error {
+	c.wmu.Lock()
+	defer c.wmu.Unlock()
+
+	b := append(c.wbuf[:0], 0x80|op)
+	maskBit := byte(0)
+	if c.client {
+		maskBit = 0x80
+	}
+	switch l := len(payload); {
+	case l < 126:
+		b = append(b, maskBit|byte(l))
+	case l <= 0xFFFF:
+		b = append(b, maskBit|126, byte(l>>8), byte(l))
+	default:
+		b = append(b, maskBit|127)
+		b = binary.BigEndian.AppendUint64(b, uint64(l))
+	}
+
+	start := len(b)
+	if c.client {
+		var key [4]byte
+		rand.Read(key[:])
+		b = append(b, key[:]...)
+		start = len(b)
+		b = append(b, payload...)
+		wsMask(b[start:], key)
+	} else {
+		b = append(b, payload...)
+	}
+	c.wbuf = b
+
+	c.conn.SetWriteDeadline(time.Now().Add(deviceWriteTimeout))
+	_, err := c.conn.Write(b)
+	return err
+}
+
+func (c *wsConn) writeText(s string) error {
+	return c.writeFrame(wsOpText, []byte(s))
+}
+
+func (c *wsConn) writeClose(code uint16) error {
+	var p [2]byte
+	binary.BigEndian.PutUint16(p[:], code)
+	return c.writeFrame(wsOpClose, p[:])
+}
+
+func (c *wsConn) Close() error {
+	return c.conn.Close()
+}
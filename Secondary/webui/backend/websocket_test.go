@@ -0,0 +1,211 @@
+/***
+ * @file websocket_test.go
+ * @author bearbox <apuirbox@gmail.com>
+ * @date 2025-11-26
+ * @brief WebSocket帧编解码测试（握手摘要、掩码、长度编码、分片与控制帧、协议错误）
+ *
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
+ *
+ * @lastEditors bearbox <apuirbox@gmail.com>
+ * @lastEditTime 2025-11-26
+ * @filePath websocket_test.go
+ * @projectType Backend
+ */
+
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"io"
+	"net"
+	"testing"
+	"time"
+)
+
+// 写入记录到缓冲的连接替身，读取端由wsConn.br提供
+type wsTestConn struct {
+	net.Conn
+	out bytes.Buffer
+}
+
+func (c *wsTestConn) Write(p []byte) (int, error)      { return c.out.Write(p) }
+func (c *wsTestConn) SetWriteDeadline(time.Time) error { return nil }
+func (c *wsTestConn) Close() error                     { return nil }
+
+// 以in为输入的连接；client为true时发送掩码帧、接受未掩码帧
+func newTestWSConn(in []byte, client bool) (*wsConn, *wsTestConn) {
+	tc := &wsTestConn{}
+	return &wsConn{conn: tc, br: bufio.NewReader(bytes.NewReader(in)), client: client}, tc
+}
+
+// 构造一个原始帧（客户端帧带固定掩码）
+func wsRawFrame(fin bool, op byte, payload []byte, masked bool) []byte {
+	b0 := op
+	if fin {
+		b0 |= 0x80
+	}
+	b := []byte{b0}
+	maskBit := byte(0)
+	if masked {
+		maskBit = 0x80
+	}
+	switch l := len(payload); {
+	case l < 126:
+		b = append(b, maskBit|byte(l))
+	case l <= 0xFFFF:
+		b = append(b, maskBit|126, byte(l>>8), byte(l))
+	default:
+		b = append(b, maskBit|127)
+		b = binary.BigEndian.AppendUint64(b, uint64(l))
+	}
+	p := append([]byte{}, payload...)
+	if masked {
+		key := [4]byte{0x37, 0xFA, 0x21, 0x3D}
+		b = append(b, key[:]...)
+		wsMask(p, key)
+	}
+	return append(b, p...)
+}
+
+// 解析连接替身写出的帧（服务端写出的帧不带掩码）
+func readWrittenFrames(t *testing.T, out []byte) [][2][]byte {
+	t.Helper()
+	c, _ := newTestWSConn(out, true)
+	var frames [][2][]byte
+	for {
+		h, err := c.readHeader()
+		if err == io.EOF {
+			return frames
+		}
+		if err != nil {
+			t.Fatalf("written frame header: %v", err)
+		}
+		p := make([]byte, h.length)
+		if err := c.readPayload(h, p); err != nil {
+			t.Fatalf("written frame payload: %v", err)
+		}
+		frames = append(frames, [2][]byte{{h.op}, p})
+	}
+}
+
+// RFC 6455 第1.3节的示例
+func TestWSAcceptKey(t *testing.T) {
+	if got := wsAcceptKey("dGhlIHNhbXBsZSBub25jZQ=="); got != "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=" {
+		t.Errorf("wsAcceptKey = %q", got)
+	}
+}
+
+// 批量异或与逐字节异或结果一致
+func TestWSMask(t *testing.T) {
+	key := [4]byte{1, 2, 3, 4}
+	for n := 0; n <= 40; n++ {
+		b := make([]byte, n)
+		want := make([]byte, n)
+		for i := range b {
+			b[i] = byte(i * 7)
+			want[i] = b[i] ^ key[i%4]
+		}
+		wsMask(b, key)
+		if !bytes.Equal(b, want) {
+			t.Fatalf("len %d: wsMask = % x, want % x", n, b, want)
+		}
+	}
+}
+
+// 各长度编码边界：客户端写出、服务端读回，以及反方向
+func TestWSRoundTrip(t *testing.T) {
+	for _, n := range []int{0, 1, 125, 126, 127, 0xFFFF, 0x10000, 100000} {
+		payload := make([]byte, n)
+		for i := range payload {
+			payload[i] = byte(i*31 + 5)
+		}
+
+		client, cout := newTestWSConn(nil, true)
+		if err := client.writeFrame(wsOpBinary, payload); err != nil {
+			t.Fatalf("client write %d: %v", n, err)
+		}
+		server, _ := newTestWSConn(cout.out.Bytes(), false)
+		op, got, err := server.readMessage(nil, 1<<20)
+		if err != nil || op != wsOpBinary || !bytes.Equal(got, payload) {
+			t.Fatalf("server read %d bytes: op %d, %d bytes, err %v", n, op, len(got), err)
+		}
+
+		server, sout := newTestWSConn(nil, false)
+		server.writeFrame(wsOpBinary, payload)
+		client, _ = newTestWSConn(sout.out.Bytes(), true)
+		op, got, err = client.readMessage(nil, 1<<20)
+		if err != nil || op != wsOpBinary || !bytes.Equal(got, payload) {
+			t.Fatalf("client read %d bytes: op %d, %d bytes, err %v", n, op, len(got), err)
+		}
+	}
+}
+
+// 分片消息中间插入ping：拼出完整消息并回复pong；随后的关闭帧得到关闭回应与io.EOF
+func TestWSFragmentsAndControl(t *testing.T) {
+	var in []byte
+	in = append(in, wsRawFrame(false, wsOpText, []byte("hel"), true)...)
+	in = append(in, wsRawFrame(true, wsOpPing, []byte("p1"), true)...)
+	in = append(in, wsRawFrame(false, wsOpContinuation, []byte("lo "), true)...)
+	in = append(in, wsRawFrame(true, wsOpContinuation, []byte("world"), true)...)
+	in = append(in, wsRawFrame(true, wsOpClose, []byte{0x03, 0xE8}, true)...)
+
+	c, out := newTestWSConn(in, false)
+	buf := make([]byte, 0, 64)
+	op, msg, err := c.readMessage(buf[:0], 1024)
+	if err != nil || op != wsOpText || string(msg) != "hello world" {
+		t.Fatalf("readMessage = %d %q %v, want text \"hello world\"", op, msg, err)
+	}
+	if &msg[0] != &buf[:1][0] {
+		t.Error("message did not reuse the caller's buffer")
+	}
+	if _, _, err := c.readMessage(buf[:0], 1024); err != io.EOF {
+		t.Fatalf("after close frame: err %v, want io.EOF", err)
+	}
+
+	frames := readWrittenFrames(t, out.out.Bytes())
+	if len(frames) != 2 || frames[0][0][0] != wsOpPong || string(frames[0][1]) != "p1" ||
+		frames[1][0][0] != wsOpClose || binary.BigEndian.Uint16(frames[1][1]) != wsCloseNormal {
+		t.Errorf("written frames = %v, want pong \"p1\" then close 1000", frames)
+	}
+}
+
+func TestWSProtocolErrors(t *testing.T) {
+	tests := []struct {
+		name  string
+		in    []byte
+		err   error
+		close uint16 // 期望回应的关闭码，0表示不回应
+	}{
+		{"unmasked client frame", wsRawFrame(true, wsOpBinary, []byte("x"), false), errWSProtocol, 0},
+		{"reserved bits", append([]byte{0xC2}, wsRawFrame(true, wsOpBinary, []byte("x"), true)[1:]...), errWSProtocol, 0},
+		{"continuation without start", wsRawFrame(true, wsOpContinuation, []byte("x"), true), errWSProtocol, wsCloseProtocol},
+		{"new message inside fragments", append(wsRawFrame(false, wsOpText, []byte("a"), true),
+			wsRawFrame(true, wsOpBinary, []byte("b"), true)...), errWSProtocol, wsCloseProtocol},
+		{"fragmented control frame", wsRawFrame(false, wsOpPing, nil, true), errWSProtocol, wsCloseProtocol},
+		{"oversized control frame", wsRawFrame(true, wsOpPing, make([]byte, 126), true), errWSProtocol, wsCloseProtocol},
+		{"message over limit", wsRawFrame(true, wsOpBinary, make([]byte, 65), true), errWSTooLarge, wsCloseTooBig},
+		{"fragments over limit", append(wsRawFrame(false, wsOpBinary, make([]byte, 40), true),
+			wsRawFrame(true, wsOpContinuation, make([]byte, 40), true)...), errWSTooLarge, wsCloseTooBig},
+		{"truncated payload", wsRawFrame(true, wsOpBinary, []byte("hello"), true)[:8], io.ErrUnexpectedEOF, 0},
+	}
+	for _, tt := range tests {
+		c, out := newTestWSConn(tt.in, false)
+		if _, _, err := c.readMessage(nil, 64); !errors.Is(err, tt.err) {
+			t.Errorf("%s: err %v, want %v", tt.name, err, tt.err)
+			continue
+		}
+		frames := readWrittenFrames(t, out.out.Bytes())
+		switch {
+		case tt.close == 0 && len(frames) != 0:
+			t.Errorf("%s: wrote %d frames, want none", tt.name, len(frames))
+		case tt.close != 0 && (len(frames) != 1 || frames[0][0][0] != wsOpClose ||
+			binary.BigEndian.Uint16(frames[0][1]) != tt.close):
+			t.Errorf("%s: wrote %v, want close %d", tt.name, frames, tt.close)
+		}
+	}
+}
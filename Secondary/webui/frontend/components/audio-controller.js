@@ -4,18 +4,26 @@
  * @date 2025-11-05
  * @brief 音频控制Web Component
  * 
- * @version 0.2
+ * @version 0.5
  * 
  * @copyright Copyright (c) 2025 by AmBearBox, All Rights Reserved.
  * 
  * @lastEditors bearbox <apuirbox@gmail.com>
- * @lastEditTime 2025-11-05
+ * @lastEditTime 2025-11-19
  * @filePath audio-controller.js
  * @projectType Frontend
  */
 
 import { AudioProcessor, MicrophoneProcessor, AUDIO_CONFIG } from '../utils/audio-processor.js';
 
+const API_BASE = 'http://localhost:8088';
+const WS_URL = 'ws://localhost:8088/api/audio/ws';
+
+// 实时节拍由后端按设备采样率完成，前端尽快上传，只在浏览器发送缓冲过大时等待；
+// 设备队列满时后端每块最多等待1秒（audioEnqueueWait）后丢弃，丢弃数在"end"的回复中返回
+const WS_MAX_BUFFERED = 256 * 1024;  // 浏览器发送缓冲超过此值时等待
+const WS_BUFFER_POLL_MS = 20;
+
 class AudioController extends HTMLElement {
     constructor() {
         super();
@@ -28,6 +36,7 @@ class AudioController extends HTMLElement {
         this._micProcessor = null;
         this._currentFile = null;
         this._uploadProgress = 0;
+        this._micSocket = null;
     }
 
     connectedCallback() {
@@ -100,15 +109,19 @@ class AudioController extends HTMLElement {
         this.render();
 
         try {
-            // 处理音频文件（解码、重采样、转PCM）
-            this.addLog('info', `正在处理音频文件: ${file.name}`);
-            const audioData = await this._audioProcessor.processAudioFile(file);
-            
-            this.addLog('success', `音频处理完成: ${audioData.chunks.length} 个数据包, 总大小 ${(audioData.totalSize / 1024).toFixed(2)} KB`);
-            this.addLog('info', `音频参数: ${audioData.sampleRate}Hz, ${audioData.channels}通道, 时长 ${audioData.duration.toFixed(2)}秒`);
-
-            // 发送音频流
-            await this.sendAudioStream(audioData.chunks);
+            // 优先由后端边上传边解码；后端不支持该格式时在浏览器中解码
+            this.addLog('info', `正在上传音频文件: ${file.name}`);
+            const handled = await this.uploadToServer(file);
+            if (!handled) {
+                this.addLog('info', `后端无法解码该格式，在浏览器中处理: ${file.name}`);
+                const audioData = await this._audioProcessor.processAudioFile(file);
+
+                this.addLog('success', `音频处理完成: ${audioData.chunks.length} 个数据包, 总大小 ${(audioData.totalSize / 1024).toFixed(2)} KB`);
+                this.addLog('info', `音频参数: ${audioData.sampleRate}Hz, ${audioData.channels}通道, 时长 ${audioData.duration.toFixed(2)}秒`);
+
+                // 发送音频流
+                await this.sendAudioStream(audioData.chunks);
+            }
 
             this.addLog('success', '音频文件播放完成');
             this._isPlaying = false;
@@ -125,38 +138,130 @@ class AudioController extends HTMLElement {
         }
     }
 
+    // ==================== 上传文件由后端流式解码播放 ====================
+    // 文件直接作为请求体上传，请求在播放完缓冲前不会结束；返回false表示需要浏览器解码
+    async uploadToServer(file) {
+        const response = await fetch(`${API_BASE}/api/audio/upload`, {
+            method: 'POST',
+            headers: { 'Content-Type': file.type || 'application/octet-stream' },
+            body: file
+        });
+        if (response.status === 415) {
+            return false;
+        }
+
+        const result = await response.json();
+        if (!result.success) {
+            throw new Error(result.message);
+        }
+        const { decoder, chunks, dropped, duration } = result.data;
+        this.addLog('success', `音频已传输: ${chunks} 个数据包, 时长 ${duration.toFixed(2)}秒 (${decoder})`);
+        if (dropped > 0) {
+            this.addLog('warning', `设备队列丢弃 ${dropped} 个数据包`);
+        }
+        this._uploadProgress = 100;
+        this.render();
+        return true;
+    }
+
+    // ==================== 打开音频WebSocket ====================
+    openAudioSocket() {
+        return new Promise((resolve, reject) => {
+            const ws = new WebSocket(WS_URL);
+            ws.binaryType = 'arraybuffer';
+            ws.onopen = () => resolve(ws);
+            ws.onerror = () => reject(new Error('WebSocket连接失败'));
+        });
+    }
+
+    // ==================== 更新传输进度 ====================
+    updateProgress(sent, totalChunks) {
+        this._uploadProgress = Math.round((sent / totalChunks) * 100);
+        if (sent % 10 === 0) {
+            this.addLog('info', `传输进度: ${this._uploadProgress}% (${sent}/${totalChunks})`);
+        }
+        this.render();
+    }
+
     // ==================== 发送音频流 ====================
+    // 优先使用WebSocket（一个连接传输全部数据块），失败时回退到逐块HTTP POST
     async sendAudioStream(chunks) {
+        let ws;
+        try {
+            ws = await this.openAudioSocket();
+        } catch (error) {
+            console.warn('Audio WebSocket unavailable, falling back to HTTP:', error);
+            this.addLog('warning', 'WebSocket不可用，使用HTTP逐块传输');
+            await this.sendAudioStreamHTTP(chunks);
+            return;
+        }
+
+        const totalChunks = chunks.length;
+        this.addLog('info', '开始传输音频数据 (WebSocket)...');
+
+        // 连接建立即开始音频流，服务端在收到"end"后回复统计
+        const finished = new Promise((resolve, reject) => {
+            ws.onmessage = (event) => {
+                if (typeof event.data === 'string') {
+                    resolve(JSON.parse(event.data));
+                }
+            };
+            ws.onclose = () => reject(new Error('WebSocket连接已关闭'));
+        });
+        finished.catch(() => {});   // 发送过程中断开时由发送循环报错
+
+        try {
+            for (let i = 0; i < totalChunks; i++) {
+                // 后端等待设备队列期间不读取，bufferedAmount随之增长；等待超时的块由后端丢弃而非继续阻塞
+                while (ws.bufferedAmount > WS_MAX_BUFFERED) {
+                    await new Promise(resolve => setTimeout(resolve, WS_BUFFER_POLL_MS));
+                }
+                if (ws.readyState !== WebSocket.OPEN) {
+                    throw new Error('WebSocket连接已关闭');
+                }
+                ws.send(chunks[i]);
+
+                if ((i + 1) % 10 === 0 || i + 1 === totalChunks) {
+                    this.updateProgress(i + 1, totalChunks);
+                }
+            }
+
+            ws.send('end');
+            const result = await finished;
+            if (result.dropped > 0) {
+                this.addLog('warning', `设备队列丢弃 ${result.dropped} 个数据包`);
+            }
+        } finally {
+            ws.onclose = null;
+            ws.close();
+        }
+
+        this._uploadProgress = 100;
+        this.render();
+    }
+
+    // ==================== 发送音频流（HTTP逐块，兼容回退） ====================
+    async sendAudioStreamHTTP(chunks) {
         const totalChunks = chunks.length;
         
         // 发送开始命令
-        await fetch('http://localhost:8088/api/audio/stream/start', {
+        await fetch(`${API_BASE}/api/audio/stream/start`, {
             method: 'POST'
         });
 
         this.addLog('info', '开始传输音频数据...');
 
-        // 逐块发送音频数据
+        // 逐块发送音频数据（后端按播放速率放行，队列满时请求会等待）
         for (let i = 0; i < totalChunks; i++) {
-            const chunk = chunks[i];
-            
             try {
-                await fetch('http://localhost:8088/api/audio/stream/data', {
+                await fetch(`${API_BASE}/api/audio/stream/data`, {
                     method: 'POST',
-                    body: chunk
+                    body: chunks[i]
                 });
 
-                // 更新进度
-                this._uploadProgress = Math.round(((i + 1) / totalChunks) * 100);
-                
-                if ((i + 1) % 10 === 0) {
-                    this.addLog('info', `传输进度: ${this._uploadProgress}% (${i + 1}/${totalChunks})`);
+                if ((i + 1) % 10 === 0 || i + 1 === totalChunks) {
+                    this.updateProgress(i + 1, totalChunks);
                 }
-                
-                this.render();
-
-                // 控制发送速率，避免网络拥塞
-                await new Promise(resolve => setTimeout(resolve, 10));
 
             } catch (error) {
                 console.error('Failed to send chunk', i, error);
@@ -165,7 +270,7 @@ class AudioController extends HTMLElement {
         }
 
         // 发送结束命令
-        await fetch('http://localhost:8088/api/audio/stream/end', {
+        await fetch(`${API_BASE}/api/audio/stream/end`, {
             method: 'POST'
         });
 
@@ -183,23 +288,16 @@ class AudioController extends HTMLElement {
         try {
             this.addLog('info', '启动麦克风...');
             
-            // 发送音频流开始命令
-            await fetch('http://localhost:8088/api/audio/stream/start', {
-                method: 'POST'
-            });
+            // 打开音频WebSocket（连接建立即开始音频流）
+            this._micSocket = await this.openAudioSocket();
 
             // 创建麦克风处理器
             this._micProcessor = new MicrophoneProcessor();
             
-            await this._micProcessor.start(async (pcmData) => {
+            await this._micProcessor.start((pcmData) => {
                 // 实时发送PCM数据
-                try {
-                    await fetch('http://localhost:8088/api/audio/stream/data', {
-                        method: 'POST',
-                        body: pcmData
-                    });
-                } catch (error) {
-                    console.error('Failed to send microphone data:', error);
+                if (this._micSocket && this._micSocket.readyState === WebSocket.OPEN) {
+                    this._micSocket.send(pcmData);
                 }
             });
 
@@ -221,13 +319,13 @@ class AudioController extends HTMLElement {
             this._micProcessor = null;
         }
 
-        // 发送音频流结束命令
-        try {
-            await fetch('http://localhost:8088/api/audio/stream/end', {
-                method: 'POST'
-            });
-        } catch (error) {
-            console.error('Failed to send stream end command:', error);
+        // 结束音频流并关闭WebSocket（服务端在连接关闭时也会结束未结束的流）
+        if (this._micSocket) {
+            if (this._micSocket.readyState === WebSocket.OPEN) {
+                this._micSocket.send('end');
+            }
+            this._micSocket.close();
+            this._micSocket = null;
         }
 
         this._isRecording = false;
@@ -242,7 +340,7 @@ class AudioController extends HTMLElement {
         }
 
         try {
-            const response = await fetch('http://localhost:8088/api/audio/stop', {
+            const response = await fetch(`${API_BASE}/api/audio/stop`, {
                 method: 'POST'
             });
 
@@ -25,11 +25,16 @@ class TTSSynthesizer extends HTMLElement {
         this._isRecognizing = false;
         this._promptAudioFile = null;
         this._promptText = '';
+        this._voices = [];
+        this._voiceId = '';
         this._targetText = '';
         this._synthesisStatus = 'idle';
         this._errorMessage = '';
         this._audioProcessor = new AudioProcessor();
-        this._statusCheckInterval = null;
+        this._priority = 'routine';
+        this._jobId = null;
+        this._jobInfo = null;
+        this._eventSource = null;
     }
 
     connectedCallback() {
@@ -40,13 +45,11 @@ class TTSSynthesizer extends HTMLElement {
         this.render();
         // 初始化按钮状态
         this.updateButtonStates();
+        this.loadVoices();
     }
 
     disconnectedCallback() {
-        if (this._statusCheckInterval) {
-            clearInterval(this._statusCheckInterval);
-            this._statusCheckInterval = null;
-        }
+        this.closeJobEvents();
     }
 
     // ==================== 设置事件监听 ====================
@@ -75,6 +78,18 @@ class TTSSynthesizer extends HTMLElement {
             if (target.classList.contains('btn-send-to-esp32')) {
                 this.sendToESP32();
             }
+            
+            if (target.classList.contains('btn-speak')) {
+                this.speakOnESP32();
+            }
+            
+            if (target.classList.contains('btn-cancel-synthesis')) {
+                this.cancelSynthesis();
+            }
+            
+            if (target.classList.contains('btn-save-voice')) {
+                this.registerVoice();
+            }
         });
         
         // 处理文件选择
@@ -82,12 +97,22 @@ class TTSSynthesizer extends HTMLElement {
             if (e.target.classList.contains('prompt-audio-input')) {
                 this.handlePromptAudioSelect(e);
             }
+            
+            if (e.target.classList.contains('priority-select')) {
+                this._priority = e.target.value;
+            }
+            
+            if (e.target.classList.contains('voice-select')) {
+                this._voiceId = e.target.value;
+                this.render();
+            }
         });
         
         // 处理文本输入
         this.addEventListener('input', (e) => {
             if (e.target.classList.contains('prompt-text-input')) {
                 this._promptText = e.target.value;
+                this.updateButtonStates();
             }
             
             if (e.target.classList.contains('target-text-input')) {
@@ -152,6 +177,67 @@ class TTSSynthesizer extends HTMLElement {
         }
     }
 
+    // ==================== 已保存音色 ====================
+    // 参考音频注册一次后，合成请求只带音色ID，不再上传音频，后端也不再重复编码
+    async loadVoices() {
+        try {
+            const response = await fetch('http://localhost:8088/api/tts/voices');
+            const result = await response.json();
+            if (result.success) {
+                this._voices = result.data || [];
+                this.render();
+                this.updateButtonStates();
+            }
+        } catch (error) {
+            console.error('Failed to load voices:', error);
+        }
+    }
+
+    async registerVoice() {
+        if (!this._promptAudioFile || !this._promptText) {
+            alert('请先选择参考音频并确认参考文本');
+            return;
+        }
+        const name = prompt('音色名称', this._promptAudioFile.name.replace(/\.[^.]+$/, ''));
+        if (name === null) {
+            return;
+        }
+
+        try {
+            const formData = new FormData();
+            formData.append('name', name);
+            formData.append('prompt_text', this._promptText);
+            formData.append('prompt_audio', this._promptAudioFile);
+
+            this.addLog('info', '正在保存音色...');
+            const response = await fetch('http://localhost:8088/api/tts/voices', {
+                method: 'POST',
+                body: formData
+            });
+            const result = await response.json();
+            if (!result.success) {
+                throw new Error(result.message);
+            }
+
+            this._voiceId = result.data.id;
+            this.addLog('success', `音色已保存: ${result.data.name}（编码 ${Math.round(result.data.encode_ms)}ms）`);
+            await this.loadVoices();
+        } catch (error) {
+            console.error('Failed to register voice:', error);
+            this.addLog('error', '保存音色失败: ' + error.message);
+        }
+    }
+
+    // 选择了已保存音色时只发送音色ID，否则发送参考音频与参考文本
+    appendPrompt(formData) {
+        if (this._voiceId) {
+            formData.append('voice', this._voiceId);
+        } else if (this._promptText && this._promptAudioFile) {
+            formData.append('prompt_text', this._promptText);
+            formData.append('prompt_audio', this._promptAudioFile);
+        }
+    }
+
     // ==================== 开始合成 ====================
     async startSynthesis() {
         if (!this._targetText.trim()) {
@@ -167,14 +253,8 @@ class TTSSynthesizer extends HTMLElement {
         try {
             const formData = new FormData();
             formData.append('text', this._targetText);
-            
-            if (this._promptText) {
-                formData.append('prompt_text', this._promptText);
-            }
-            
-            if (this._promptAudioFile) {
-                formData.append('prompt_audio', this._promptAudioFile);
-            }
+            formData.append('priority', this._priority);
+            this.appendPrompt(formData);
 
             this.addLog('info', '正在请求 TTS 合成...');
 
@@ -189,10 +269,12 @@ class TTSSynthesizer extends HTMLElement {
                 throw new Error(result.message);
             }
 
-            this.addLog('success', 'TTS 合成已启动，请等待...');
+            this._jobId = result.data.id;
+            this._jobInfo = result.data;
+            this.addLog('success', `TTS 合成任务已提交 (${this._jobId})，请等待...`);
 
-            // 开始轮询状态
-            this.startStatusPolling();
+            // 订阅任务状态
+            this.watchJob(this._jobId);
 
         } catch (error) {
             console.error('Failed to start synthesis:', error);
@@ -204,49 +286,122 @@ class TTSSynthesizer extends HTMLElement {
         }
     }
 
-    // ==================== 轮询合成状态 ====================
-    startStatusPolling() {
-        if (this._statusCheckInterval) {
-            clearInterval(this._statusCheckInterval);
-        }
+    // ==================== 订阅任务状态（SSE） ====================
+    // 后端在排队、开始、合成进度与结束时推送任务快照，任务结束后关闭连接
+    watchJob(jobId) {
+        this.closeJobEvents();
+        this._eventSource = new EventSource(`http://localhost:8088/api/tts/events?job=${encodeURIComponent(jobId)}`);
 
-        this._statusCheckInterval = setInterval(async () => {
+        this._eventSource.onmessage = (event) => {
+            let job;
             try {
-                const response = await fetch('http://localhost:8088/api/tts/status');
-                const result = await response.json();
-
-                if (result.success) {
-                    const { status, error, has_result } = result.data;
-                    
-                    this._synthesisStatus = status;
-                    this._errorMessage = error || '';
-
-                    if (status === 'completed') {
-                        this.addLog('success', 'TTS 合成完成！');
-                        this._isSynthesizing = false;
-                        clearInterval(this._statusCheckInterval);
-                        this._statusCheckInterval = null;
-                        this.render();
-                        this.updateButtonStates();
-                    } else if (status === 'error') {
-                        this.addLog('error', '合成失败: ' + error);
-                        this._isSynthesizing = false;
-                        clearInterval(this._statusCheckInterval);
-                        this._statusCheckInterval = null;
-                        this.render();
-                        this.updateButtonStates();
-                    } else if (status === 'processing') {
-                        // 继续轮询，只更新状态显示不重新渲染整个组件
-                        const prevStatus = this._synthesisStatus;
-                        if (prevStatus !== status) {
-                            this.render();
-                        }
-                    }
-                }
+                job = JSON.parse(event.data);
             } catch (error) {
-                console.error('Failed to check status:', error);
+                return;
             }
-        }, 1000);
+            this._jobInfo = job;
+
+            if (job.status === 'completed') {
+                this.addLog('success', `TTS 合成完成${job.cached ? '（缓存）' : ''}！(${(job.audio_ms / 1000).toFixed(1)}秒音频${job.sentences ? `, 分${job.sentences}句` : ''}, 排队 ${Math.round(job.queue_wait_ms)}ms, 合成 ${Math.round(job.service_ms)}ms)`);
+                this.finishJob('completed', '');
+            } else if (job.status === 'error' || job.status === 'cancelled') {
+                const message = job.status === 'cancelled' ? '已取消' : job.error;
+                this.addLog(job.status === 'cancelled' ? 'warning' : 'error', '合成失败: ' + message);
+                this.finishJob('error', message);
+            } else {
+                // 排队/合成中只更新状态文字，不重新渲染整个组件
+                const statusText = this.querySelector('.tts-job-status');
+                if (statusText) {
+                    statusText.textContent = this.jobStatusText();
+                }
+            }
+        };
+
+        this._eventSource.onerror = () => {
+            // 任务结束后服务端关闭连接，此时不再重连
+            if (!this._isSynthesizing) {
+                this.closeJobEvents();
+            }
+        };
+    }
+
+    finishJob(status, errorMessage) {
+        this.closeJobEvents();
+        this._isSynthesizing = false;
+        this._synthesisStatus = status;
+        this._errorMessage = errorMessage;
+        this.render();
+        this.updateButtonStates();
+    }
+
+    closeJobEvents() {
+        if (this._eventSource) {
+            this._eventSource.close();
+            this._eventSource = null;
+        }
+    }
+
+    jobStatusText() {
+        const job = this._jobInfo;
+        if (!job || job.status === 'queued') {
+            return job && job.ahead > 0 ? `排队中，前面还有 ${job.ahead} 个任务...` : '排队中...';
+        }
+        return `正在合成中，已生成 ${(job.audio_ms / 1000).toFixed(1)} 秒音频...`;
+    }
+
+    // ==================== 取消合成 ====================
+    async cancelSynthesis() {
+        if (!this._jobId) {
+            return;
+        }
+        try {
+            await fetch(`http://localhost:8088/api/tts/cancel?job=${encodeURIComponent(this._jobId)}`, {
+                method: 'POST'
+            });
+        } catch (error) {
+            console.error('Failed to cancel synthesis:', error);
+        }
+    }
+
+    // ==================== 边合成边播放 ====================
+    // 后端逐块合成并直接发送到设备，无需等待完整合成、轮询和下载；请求在播放完缓冲后返回
+    async speakOnESP32() {
+        if (!this._isConnected) {
+            alert('请先连接 ESP32 设备');
+            return;
+        }
+
+        this._isSending = true;
+        this.render();
+        this.updateButtonStates();
+
+        try {
+            const formData = new FormData();
+            formData.append('text', this._targetText);
+            formData.append('priority', this._priority);
+            this.appendPrompt(formData);
+
+            this.addLog('info', '正在边合成边播放...');
+
+            const response = await fetch('http://localhost:8088/api/tts/speak', {
+                method: 'POST',
+                body: formData
+            });
+            const result = await response.json();
+            if (!result.success) {
+                throw new Error(result.message);
+            }
+
+            const { first_audio_ms, audio_ms, cached } = result.data;
+            this.addLog('success', `播放完成${cached ? '（缓存）' : ''}: 首个音频 ${Math.round(first_audio_ms)}ms, 时长 ${(audio_ms / 1000).toFixed(2)}秒`);
+        } catch (error) {
+            console.error('Failed to speak on ESP32:', error);
+            this.addLog('error', '合成播放失败: ' + error.message);
+        } finally {
+            this._isSending = false;
+            this.render();
+            this.updateButtonStates();
+        }
     }
 
     // ==================== 发送到 ESP32 ====================
@@ -263,7 +418,7 @@ class TTSSynthesizer extends HTMLElement {
             this.addLog('info', '正在下载合成音频...');
 
             // 下载生成的音频文件
-            const audioResponse = await fetch('http://localhost:8088/api/tts/download');
+            const audioResponse = await fetch(`http://localhost:8088/api/tts/download?job=${encodeURIComponent(this._jobId)}`);
             
             if (!audioResponse.ok) {
                 throw new Error('下载音频失败');
@@ -356,6 +511,8 @@ class TTSSynthesizer extends HTMLElement {
         setTimeout(() => {
             const synthesizeBtn = this.querySelector('.btn-synthesize');
             const sendBtn = this.querySelector('.btn-send-to-esp32');
+            const speakBtn = this.querySelector('.btn-speak');
+            const saveVoiceBtn = this.querySelector('.btn-save-voice');
             
             if (synthesizeBtn) {
                 const canSynthesize = !this._isSynthesizing && this._targetText.trim() !== '';
@@ -366,6 +523,15 @@ class TTSSynthesizer extends HTMLElement {
                 const canSend = this._isConnected && !this._isSending && this._synthesisStatus === 'completed';
                 sendBtn.disabled = !canSend;
             }
+            
+            if (speakBtn) {
+                const canSpeak = this._isConnected && !this._isSending && !this._isSynthesizing && this._targetText.trim() !== '';
+                speakBtn.disabled = !canSpeak;
+            }
+            
+            if (saveVoiceBtn) {
+                saveVoiceBtn.disabled = !(this._promptAudioFile && this._promptText && !this._isRecognizing);
+            }
         }, 0);
     }
 
@@ -373,6 +539,7 @@ class TTSSynthesizer extends HTMLElement {
     render() {
         const canSynthesize = !this._isSynthesizing && this._targetText.trim() !== '';
         const canSend = this._isConnected && !this._isSending && this._synthesisStatus === 'completed';
+        const canSpeak = this._isConnected && !this._isSending && !this._isSynthesizing && this._targetText.trim() !== '';
 
         this.innerHTML = `
             <div class="card tts-card">
@@ -382,6 +549,18 @@ class TTSSynthesizer extends HTMLElement {
                 </p>
                 
                 <div style="display: flex; flex-direction: column; gap: 20px;">
+                    <!-- 已保存音色 -->
+                    <div>
+                        <h3 style="font-size: 14px; margin-bottom: 8px; font-weight: 500;">音色</h3>
+                        <select class="voice-select" ${this._isSynthesizing ? 'disabled' : ''} style="width: 100%; padding: 8px; border: 1px solid var(--border-color); font-size: 14px; font-family: inherit;">
+                            <option value="">使用下方的参考音频</option>
+                            ${this._voices.map(v => `
+                                <option value="${v.id}" ${this._voiceId === v.id ? 'selected' : ''}>${v.name}</option>
+                            `).join('')}
+                        </select>
+                    </div>
+
+                    ${this._voiceId ? '' : `
                     <!-- 参考音频 -->
                     <div>
                         <h3 style="font-size: 14px; margin-bottom: 8px; font-weight: 500;">参考音频（可选）</h3>
@@ -408,7 +587,11 @@ class TTSSynthesizer extends HTMLElement {
                         <p style="font-size: 12px; color: var(--text-secondary); margin-top: 4px;">
                             ${this._isRecognizing ? '正在识别音频文本...' : '识别结果可以手动修改'}
                         </p>
+                        <button class="btn-save-voice" ${this._promptAudioFile && this._promptText && !this._isRecognizing ? '' : 'disabled'} style="margin-top: 8px;">
+                            保存为音色
+                        </button>
                     </div>
+                    `}
 
                     <!-- 目标文本 -->
                     <div>
@@ -421,10 +604,19 @@ class TTSSynthesizer extends HTMLElement {
                         >${this._targetText}</textarea>
                     </div>
 
+                    <!-- 优先级 -->
+                    <div>
+                        <h3 style="font-size: 14px; margin-bottom: 8px; font-weight: 500;">优先级</h3>
+                        <select class="priority-select" ${this._isSynthesizing ? 'disabled' : ''} style="padding: 8px; border: 1px solid var(--border-color); font-size: 14px; font-family: inherit;">
+                            <option value="routine" ${this._priority === 'routine' ? 'selected' : ''}>日常消息</option>
+                            <option value="alarm" ${this._priority === 'alarm' ? 'selected' : ''}>报警广播（优先合成）</option>
+                        </select>
+                    </div>
+
                     <!-- 状态显示 -->
                     ${this._synthesisStatus === 'processing' ? `
                         <div style="padding: 12px; background-color: #dbeafe; border-left: 3px solid #2563eb;">
-                            <p style="color: #1e40af; font-size: 14px; font-weight: 500;">正在合成中，请稍候...</p>
+                            <p class="tts-job-status" style="color: #1e40af; font-size: 14px; font-weight: 500;">${this.jobStatusText()}</p>
                         </div>
                     ` : ''}
 
@@ -432,7 +624,7 @@ class TTSSynthesizer extends HTMLElement {
                         <div style="padding: 12px; background-color: #d1fae5; border-left: 3px solid var(--success-color);">
                             <p style="color: #065f46; font-size: 14px; font-weight: 500; margin-bottom: 8px;">合成完成！可以试听或发送到 ESP32</p>
                             <audio controls style="width: 100%; max-width: 400px;">
-                                <source src="http://localhost:8088/api/tts/download?t=${Date.now()}" type="audio/wav">
+                                <source src="http://localhost:8088/api/tts/download?job=${encodeURIComponent(this._jobId)}" type="audio/wav">
                                 您的浏览器不支持音频播放
                             </audio>
                         </div>
@@ -454,6 +646,10 @@ class TTSSynthesizer extends HTMLElement {
                             ${this._isSynthesizing ? '合成中...' : '开始合成'}
                         </button>
                         
+                        ${this._isSynthesizing ? `
+                            <button class="btn-cancel-synthesis" style="flex: 1;">取消合成</button>
+                        ` : ''}
+                        
                         <button 
                             class="success btn-send-to-esp32" 
                             ${!canSend ? 'disabled' : ''}
@@ -461,6 +657,14 @@ class TTSSynthesizer extends HTMLElement {
                         >
                             ${this._isSending ? '发送中...' : '发送到 ESP32'}
                         </button>
+                        
+                        <button 
+                            class="btn-speak" 
+                            ${!canSpeak ? 'disabled' : ''}
+                            style="flex: 1;"
+                        >
+                            合成并播放
+                        </button>
                     </div>
 
                     ${!this._isConnected ? `
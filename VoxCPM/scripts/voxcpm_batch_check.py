@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+VoxCPM 批量解码一致性检查
+对比 BatchedGenerator（后端 -tts-batch / 合成进程 --max-batch 使用的批量解码）与逐个合成的输出：
+流式请求对比 generate_with_prompt_cache_streaming 拼接后的音频，完整合成对比 generate_with_prompt_cache（含异常长度重试）。
+
+用法（在 VoxCPM 目录）：
+  uv run python scripts/voxcpm_batch_check.py [--model ./model/VoxCPM-0.5B] \\
+      [--prompt-wav voice.wav --prompt-text "参考文本"] [--batch 4] [--profile fast] [--threads N] [--atol 1e-3]
+
+扩散采样与音频解码器的随机噪声在检查期间固定为 0，两条路径都是确定的，差异只来自批量计算的舍入。
+批量大小 1：每个请求单独进入批量；批量大小 N：N 个请求每步加入一个（已有请求进行中时加入），其中一个为完整合成。
+每个请求要求样本数相同且最大绝对误差不超过 --atol；全部通过时退出码为 0，否则为 1。
+通过之前 -tts-batch 保持默认的 1。
+"""
+
+import argparse
+import contextlib
+import os
+import sys
+import warnings
+
+warnings.filterwarnings("ignore")
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+TEXTS = [
+    "各位旅客请注意，由本站开往上海虹桥的列车即将进站，请在黄色安全线以内排队候车。",
+    "住院部三楼正在进行消毒，请暂时使用东侧电梯。",
+    "Attention please, the meeting will start in five minutes.",
+    "今天最高气温三十二摄氏度，请注意防暑降温。",
+    "请勿在走廊奔跑。",
+    "The north entrance is closed for maintenance until Friday.",
+    "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。",
+    "列车即将到站，请提前做好下车准备。",
+]
+
+
+@contextlib.contextmanager
+def zero_noise(torch):
+    """把 torch.randn 换成全零：局部扩散的初始噪声与音频解码器的噪声都不再随机"""
+    randn = torch.randn
+    torch.randn = lambda *args, **kwargs: torch.zeros(*args, **kwargs)
+    try:
+        yield
+    finally:
+        torch.randn = randn
+
+
+def reference(model, job, prompt_cache, profile):
+    """逐个合成的输出，Tensor(samples)"""
+    import torch
+
+    common = dict(target_text=job["text"], prompt_cache=prompt_cache, min_len=2, max_len=4096,
+                  inference_timesteps=10, cfg_value=2.0, decode_profile=profile)
+    if job["streaming"]:
+        chunks = [wav for wav, _, _ in model.generate_with_prompt_cache_streaming(**common)]
+        return torch.cat(chunks, dim=-1).squeeze(0)
+    wav, _, _ = model.generate_with_prompt_cache(retry_badcase=True, **common)
+    return wav.squeeze(0)
+
+
+def batched(model, jobs, prompt_cache, profile, max_batch, stagger):
+    """批量解码的输出，按 jobs 顺序；stagger 时每步加入一个请求，否则在第一步前全部加入"""
+    import torch
+
+    gen = model.batched_generator(max_batch)
+    names, chunks = {}, [[] for _ in jobs]
+    pending = list(range(len(jobs)))
+    while pending or len(gen):
+        while pending and len(gen) < max_batch:
+            i = pending.pop(0)
+            handle = gen.add(jobs[i]["text"], prompt_cache=prompt_cache, min_len=2, max_len=4096,
+                             inference_timesteps=10, cfg_value=2.0, decode_profile=profile,
+                             streaming=jobs[i]["streaming"], retry_badcase=not jobs[i]["streaming"])
+            names[handle] = i
+            if stagger:
+                break
+        for handle, audio, _ in gen.step():
+            if audio is not None:
+                chunks[names[handle]].append(audio)
+    return [torch.cat(c, dim=-1).squeeze(0) for c in chunks]
+
+
+def compare(label, jobs, refs, outs, atol):
+    ok = True
+    for job, ref, out in zip(jobs, refs, outs):
+        kind = "stream" if job["streaming"] else "full"
+        if ref.numel() != out.numel():
+            print(f"{label:<8} | {kind:<6} | FAIL | {out.numel()} samples, expected {ref.numel()} | {job['text'][:24]}")
+            ok = False
+            continue
+        diff = (ref - out).abs().max().item() if ref.numel() else 0.0
+        passed = diff <= atol
+        ok = ok and passed
+        print(f"{label:<8} | {kind:<6} | {'ok' if passed else 'FAIL':<4} | max abs diff {diff:.2e} over {ref.numel()} samples"
+              f" | {job['text'][:24]}")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM batched decoding equivalence check")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--prompt-wav", default="")
+    parser.add_argument("--prompt-text", default="")
+    parser.add_argument("--batch", type=int, default=4, help="批量大小 N（另检查批量大小 1）")
+    parser.add_argument("--profile", default=None, help="解码档位（quality / balanced / fast），默认原始解码")
+    parser.add_argument("--threads", type=int, default=0, help="推理线程数，0 为 PyTorch 默认")
+    parser.add_argument("--atol", type=float, default=1e-3, help="允许的最大绝对误差")
+    args = parser.parse_args()
+    if args.batch < 2 or args.batch > len(TEXTS):
+        parser.error(f"--batch 需在 2 到 {len(TEXTS)} 之间")
+
+    import torch
+    from voxcpm.model import VoxCPMModel
+
+    if args.threads > 0:
+        torch.set_num_threads(args.threads)
+    model = VoxCPMModel.from_local(args.model, optimize=False)
+    prompt_cache = None
+    if args.prompt_wav:
+        if not args.prompt_text:
+            parser.error("--prompt-wav requires --prompt-text")
+        prompt_cache = model.build_prompt_cache(prompt_text=args.prompt_text, prompt_wav_path=args.prompt_wav)
+
+    jobs = [{"text": text, "streaming": i != 1} for i, text in enumerate(TEXTS[:args.batch])]
+    print(f"{'batch':<8} | {'mode':<6} | {'':<4} | detail")
+    ok = True
+    with zero_noise(torch), torch.inference_mode():
+        refs = [reference(model, job, prompt_cache, args.profile) for job in jobs]
+        for i, job in enumerate(jobs[:2]):
+            out = batched(model, [job], prompt_cache, args.profile, 1, stagger=False)
+            ok = compare("1", [job], refs[i:i + 1], out, args.atol) and ok
+        out = batched(model, jobs, prompt_cache, args.profile, args.batch, stagger=True)
+        ok = compare(str(args.batch), jobs, refs, out, args.atol) and ok
+    print("\nPASS" if ok else "\nFAIL: keep -tts-batch at 1")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
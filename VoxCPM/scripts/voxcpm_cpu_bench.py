@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""
+VoxCPM CPU 推理模式基准
+对比 VoxCPMModel.optimize_cpu 的各模式（精度、int8 动态量化、inductor 编译）的实时率与首块延迟，
+并以 fp32 模式为参照检查准确度：波形（时长比、log-mel 平均差）与 ASR 转写的字错误率。
+
+用法（在 VoxCPM 目录，只用 CPU）：
+  CUDA_VISIBLE_DEVICES= uv run python scripts/voxcpm_cpu_bench.py \\
+      [--model ./model/VoxCPM-0.5B] [--asr ./model/SenseVoiceSmall] [--threads N] [--modes off,fp32,int8]
+
+每个模式重新加载模型；同一文本在各模式下使用相同随机种子，扩散采样的初始噪声一致。
+首次调用包含编译耗时，计入 warmup 而不计入实时率。生成的 WAV 保存在 --out 目录。
+"""
+
+import argparse
+import gc
+import json
+import os
+import re
+import sys
+import time
+import warnings
+
+warnings.filterwarnings("ignore")
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+# 模式 -> optimize_cpu 参数；off 为未优化（模型配置精度，eager）
+MODES = {
+    "off": None,
+    "fp32": dict(quantize=False, compile=False, dtype="float32"),
+    "auto": dict(quantize=False, compile=False, dtype="auto"),
+    "compile": dict(quantize=False, compile=True, dtype="auto"),
+    "int8": dict(quantize=True, compile=False),
+    "int8-compile": dict(quantize=True, compile=True),
+}
+REFERENCE = "fp32"
+
+TEXTS = [
+    "请注意，会议将在五分钟后开始。",
+    "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。",
+    "各位旅客请注意，由本站开往上海虹桥的列车即将进站，请在黄色安全线以内排队候车，先下后上，携带大件行李的旅客请使用车厢两端的行李架。",
+]
+WARMUP_TEXT = "你好，语音合成服务已就绪。"
+SEED = 1234
+
+
+def elapsed_ms(start):
+    return (time.perf_counter() - start) * 1000
+
+
+# ==================== 合成 ====================
+def load(model_path, mode, threads):
+    from voxcpm.model import VoxCPMModel
+
+    model = VoxCPMModel.from_local(model_path, optimize=False)
+    if MODES[mode] is not None:
+        model.optimize_cpu(num_threads=threads, **MODES[mode])
+    elif threads > 0:
+        import torch
+        torch.set_num_threads(threads)
+    return model
+
+
+def synthesize(model, text):
+    """流式合成，返回 (波形, 首块耗时ms, 总耗时ms)"""
+    import torch
+
+    torch.manual_seed(SEED)
+    chunks = []
+    first_ms = 0.0
+    start = time.perf_counter()
+    for chunk in model.generate_streaming(target_text=text, inference_timesteps=10, cfg_value=2.0):
+        if not chunks:
+            first_ms = elapsed_ms(start)
+        chunks.append(chunk.reshape(-1))
+    return torch.cat(chunks), first_ms, elapsed_ms(start)
+
+
+# ==================== 准确度 ====================
+def mel_db(wav, sample_rate):
+    import torch
+    import torchaudio
+
+    mel = torchaudio.transforms.MelSpectrogram(sample_rate=sample_rate, n_fft=1024, hop_length=256, n_mels=80)(wav)
+    return 10 * torch.log10(mel.clamp(min=1e-10))
+
+
+def mel_distance(wav, ref, sample_rate):
+    """log-mel 逐帧平均绝对差（dB），按较短者对齐"""
+    a, b = mel_db(wav, sample_rate), mel_db(ref, sample_rate)
+    n = min(a.shape[-1], b.shape[-1])
+    return (a[..., :n] - b[..., :n]).abs().mean().item()
+
+
+def normalize_text(text):
+    return re.sub(r"[\s\W_]+", "", text).lower()
+
+
+def cer(hyp, ref):
+    hyp, ref = normalize_text(hyp), normalize_text(ref)
+    if not ref:
+        return 0.0
+    prev = list(range(len(hyp) + 1))
+    for i, r in enumerate(ref, 1):
+        cur = [i] + [0] * len(hyp)
+        for j, h in enumerate(hyp, 1):
+            cur[j] = min(prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + (r != h))
+        prev = cur
+    return prev[-1] / len(ref)
+
+
+class ASR:
+    def __init__(self, path):
+        from funasr import AutoModel
+        from funasr.utils.postprocess_utils import rich_transcription_postprocess
+
+        self.model = AutoModel(model=path, disable_update=True, log_level="ERROR", device="cpu")
+        self.post = rich_transcription_postprocess
+
+    def transcribe(self, path):
+        res = self.model.generate(input=path, language="auto", use_itn=True)
+        return self.post(res[0]["text"]) if res else ""
+
+
+# ==================== 运行 ====================
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM CPU inference modes benchmark")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--asr", default="./model/SenseVoiceSmall", help="SenseVoice 模型目录，不存在时跳过转写")
+    parser.add_argument("--threads", type=int, default=0, help="推理线程数，0 为全部可用 CPU")
+    parser.add_argument("--modes", default=",".join(MODES), help="逗号分隔，可选 " + ",".join(MODES))
+    parser.add_argument("--out", default="cpu_bench_out", help="生成的 WAV 与结果 JSON 的目录")
+    args = parser.parse_args()
+
+    import torch
+    import torch._dynamo
+    import torchaudio
+
+    if torch.cuda.is_available():
+        print("CUDA is visible; run with CUDA_VISIBLE_DEVICES= to benchmark the CPU path", file=sys.stderr)
+        sys.exit(1)
+    modes = [m for m in args.modes.split(",") if m]
+    for m in modes:
+        if m not in MODES:
+            parser.error(f"unknown mode {m}")
+    if REFERENCE not in modes:
+        modes.insert(0, REFERENCE)
+    os.makedirs(args.out, exist_ok=True)
+
+    results = {}
+    for mode in modes:
+        start = time.perf_counter()
+        model = load(args.model, mode, args.threads)
+        load_ms = elapsed_ms(start)
+        start = time.perf_counter()
+        synthesize(model, WARMUP_TEXT)
+        warmup_ms = elapsed_ms(start)
+
+        rows = []
+        for i, text in enumerate(TEXTS):
+            wav, first_ms, total_ms = synthesize(model, text)
+            path = os.path.join(args.out, f"{mode}_{i}.wav")
+            torchaudio.save(path, wav.unsqueeze(0).float(), model.sample_rate)
+            audio_ms = wav.numel() / model.sample_rate * 1000
+            rows.append({"text": i, "path": path, "audio_ms": audio_ms, "first_chunk_ms": first_ms,
+                         "synth_ms": total_ms, "rtf": total_ms / audio_ms})
+        results[mode] = {"load_ms": load_ms, "warmup_ms": warmup_ms, "threads": torch.get_num_threads(),
+                         "dtype": model.config.dtype, "rows": rows}
+        print(f"{mode}: loaded in {load_ms:.0f}ms, warmup {warmup_ms:.0f}ms", file=sys.stderr)
+        del model
+        gc.collect()
+        torch._dynamo.reset()  # 编译缓存随模型释放
+
+    asr = ASR(args.asr) if os.path.isdir(args.asr) else None
+    for mode, res in results.items():
+        for row, ref in zip(res["rows"], results[REFERENCE]["rows"]):
+            wav, sr = torchaudio.load(row["path"])
+            ref_wav, _ = torchaudio.load(ref["path"])
+            row["duration_ratio"] = row["audio_ms"] / ref["audio_ms"]
+            row["mel_db"] = mel_distance(wav, ref_wav, sr)
+            if asr is not None:
+                row["transcript"] = asr.transcribe(row["path"])
+                row["cer"] = cer(row["transcript"], TEXTS[row["text"]])
+
+    print(f"VoxCPM CPU modes, {results[REFERENCE]['threads']} thread(s), reference = {REFERENCE}\n")
+    print(f"{'mode':<13} | {'dtype':<8} | {'text':<4} | {'audio':<7} | {'first chunk':<11} | {'RTF':<5} | "
+          f"{'dur ratio':<9} | {'mel dB':<6} | CER")
+    for mode, res in results.items():
+        for row in res["rows"]:
+            cer_col = f"{row['cer']:.3f}" if "cer" in row else "-"
+            print(f"{mode:<13} | {res['dtype']:<8} | {row['text']:<4} | {row['audio_ms'] / 1000:<6.1f}s | "
+                  f"{row['first_chunk_ms']:<9.0f}ms | {row['rtf']:<5.2f} | {row['duration_ratio']:<9.2f} | "
+                  f"{row['mel_db']:<6.2f} | {cer_col}")
+    print("\nRTF = synthesis time / audio duration; mel dB = mean |log-mel difference| against the reference "
+          "(aligned to the shorter clip); CER against the input text (SenseVoice transcript).")
+    with open(os.path.join(args.out, "results.json"), "w", encoding="utf-8") as f:
+        json.dump(results, f, ensure_ascii=False, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+ZipEnhancer 参考音频降噪基准
+对比三种取得降噪后参考音频的方式在 5 s、30 s、120 s 参考音频上的耗时与峰值内存：
+  file    原路径：ZipEnhancer.enhance 处理整个文件，写出临时 WAV，再次读入做响度归一化，最后加载
+  memory  内存分窗路径：读入字节后 ZipEnhancer.enhance_audio 按 6 s 窗口、0.5 s 交叠降噪，不写文件
+  cached  VoxCPM.build_prompt_cache 的降噪缓存命中：只读文件并计算内容哈希
+并给出 memory 与 file 输出的相对差异（||a-b|| / ||b||）。
+
+用法（在 VoxCPM 目录）：
+  uv run python scripts/voxcpm_denoise_bench.py [--zipenhancer ./model/speech_zipenhancer_ans_multiloss_16k_base] \\
+      [--wav 语音.wav]
+
+参考音频由 --wav 循环拼接到目标时长并叠加 10 dB 信噪比的白噪声（未给出时用合成的谐波音）。
+每个 (方式, 时长) 在单独的子进程中运行，峰值内存为该次处理期间常驻内存（VmHWM）相对处理前的增量。
+"""
+
+import argparse
+import hashlib
+import io
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+import warnings
+
+warnings.filterwarnings("ignore")
+
+DURATIONS = [5, 30, 120]
+MODES = ["file", "memory", "cached"]
+SAMPLE_RATE = 16000
+SNR_DB = 10
+
+
+def elapsed_ms(start):
+    return (time.perf_counter() - start) * 1000
+
+
+def proc_status_kb(field):
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith(field + ":"):
+                return int(line.split()[1])
+    return 0
+
+
+def reset_peak_rss():
+    try:
+        with open("/proc/self/clear_refs", "w") as f:
+            f.write("5")
+    except OSError:
+        pass
+
+
+def make_prompt(path, seconds, source):
+    import torch
+    import torchaudio
+
+    n = seconds * SAMPLE_RATE
+    if source:
+        speech, sr = torchaudio.load(source)
+        speech = torchaudio.functional.resample(speech.mean(dim=0), sr, SAMPLE_RATE)
+        speech = speech.repeat(n // speech.numel() + 1)[:n]
+    else:
+        t = torch.arange(n) / SAMPLE_RATE
+        f0 = 140 + 30 * torch.sin(2 * torch.pi * 0.7 * t)
+        phase = 2 * torch.pi * torch.cumsum(f0, 0) / SAMPLE_RATE
+        speech = sum(torch.sin(k * phase) / k for k in range(1, 8)) * (0.5 + 0.5 * torch.sin(2 * torch.pi * 3 * t)).clamp(min=0)
+    speech = speech / speech.abs().max() * 0.5
+    noise = torch.randn(n, generator=torch.Generator().manual_seed(0))
+    noise = noise * speech.pow(2).mean().sqrt() / noise.pow(2).mean().sqrt() / 10 ** (SNR_DB / 20)
+    torchaudio.save(path, (speech + noise).unsqueeze(0), SAMPLE_RATE)
+
+
+# ==================== 子进程：单次测量 ====================
+def run_one(args):
+    import torch
+    import torchaudio
+    from voxcpm.zipenhancer import ZipEnhancer
+
+    enhancer = ZipEnhancer(args.zipenhancer)
+    with open(args.input, "rb") as f:
+        data = f.read()
+    # 预热（模型首次推理的初始化不计入）
+    enhancer.enhance_audio(torch.zeros(1, SAMPLE_RATE), SAMPLE_RATE, normalize_loudness=False)
+
+    reset_peak_rss()
+    base_kb = proc_status_kb("VmRSS")
+    start = time.perf_counter()
+    if args.mode == "file":
+        out_path = args.output
+        enhancer.enhance(args.input, output_path=out_path)
+        wav, _ = torchaudio.load(out_path)
+    elif args.mode == "memory":
+        with open(args.input, "rb") as f:
+            audio, sr = torchaudio.load(io.BytesIO(f.read()))
+        wav = enhancer.enhance_audio(audio, sr)
+        torchaudio.save(args.output, wav, SAMPLE_RATE)
+    else:
+        cache = {hashlib.sha256(data).hexdigest(): torch.zeros(1)}
+        start = time.perf_counter()
+        with open(args.input, "rb") as f:
+            wav = cache[hashlib.sha256(f.read()).hexdigest()]
+    ms = elapsed_ms(start)
+    peak_kb = proc_status_kb("VmHWM")
+    print(json.dumps({"ms": ms, "peak_mb": max(0, peak_kb - base_kb) / 1024}))
+
+
+# ==================== 父进程 ====================
+def rel_diff(a_path, b_path):
+    import torchaudio
+
+    a, _ = torchaudio.load(a_path)
+    b, _ = torchaudio.load(b_path)
+    n = min(a.shape[-1], b.shape[-1])
+    a, b = a[..., :n], b[..., :n]
+    return ((a - b).norm() / b.norm().clamp(min=1e-9)).item()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ZipEnhancer file vs in-memory denoise benchmark")
+    parser.add_argument("--zipenhancer", default="./model/speech_zipenhancer_ans_multiloss_16k_base")
+    parser.add_argument("--wav", default="", help="用于拼接参考音频的语音文件，空则用合成音")
+    parser.add_argument("--one", default="", help=argparse.SUPPRESS)
+    parser.add_argument("--input", default="", help=argparse.SUPPRESS)
+    parser.add_argument("--output", default="", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+    if args.one:
+        args.mode = args.one
+        return run_one(args)
+
+    tmp = tempfile.mkdtemp(prefix="denoise_bench_")
+    rows = []
+    for seconds in DURATIONS:
+        prompt = os.path.join(tmp, f"prompt_{seconds}s.wav")
+        make_prompt(prompt, seconds, args.wav)
+        outputs = {}
+        for mode in MODES:
+            outputs[mode] = os.path.join(tmp, f"{mode}_{seconds}s.wav")
+            res = subprocess.run(
+                [sys.executable, __file__, "--one", mode, "--zipenhancer", args.zipenhancer,
+                 "--input", prompt, "--output", outputs[mode]],
+                capture_output=True, text=True)
+            lines = [l for l in res.stdout.splitlines() if l.startswith("{")]
+            if res.returncode != 0 or not lines:
+                print(f"{mode} {seconds}s failed:\n{res.stderr[-2000:]}", file=sys.stderr)
+                continue
+            rows.append({"seconds": seconds, "mode": mode, **json.loads(lines[-1])})
+        memory = [r for r in rows if r["seconds"] == seconds and r["mode"] == "memory"]
+        if memory and os.path.exists(outputs["file"]):
+            memory[0]["diff"] = rel_diff(outputs["memory"], outputs["file"])
+
+    print(f"ZipEnhancer prompt denoising, {SNR_DB} dB SNR prompts ({'speech: ' + args.wav if args.wav else 'synthetic'})\n")
+    print(f"{'prompt':<6} | {'mode':<6} | {'latency':<11} | {'peak RSS +':<10} | rel. diff to file")
+    for r in rows:
+        diff = f"{r['diff']:.3f}" if "diff" in r else "-"
+        print(f"{r['seconds']:<5}s | {r['mode']:<6} | {r['ms']:<9.1f}ms | {r['peak_mb']:<7.1f} MB | {diff}")
+    print("\nfile = enhance() to a temp WAV + reload; memory = enhance_audio() on the decoded bytes, no files;")
+    print("cached = repeated prompt: read + sha256 only (VoxCPM.build_prompt_cache keeps denoised prompts by content hash).")
+
+
+if __name__ == "__main__":
+    sys.exit(main())
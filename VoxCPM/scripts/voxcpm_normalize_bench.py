@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+VoxCPM 文本规范化基准
+按病区播报的典型负载（体温告警、床号呼叫等模板反复出现，夹杂少量一次性文本与英文）调用 TextNormalizer.normalize，
+对比关闭结果缓存（cache_size=0，每次都经规则与 WeText FST）与开启缓存时的吞吐与单条延迟；
+另给出未命中时各阶段（clean_text、体温/床号数字读法、WeText、空白与符号处理、inflect 数字读法）的耗时，
+以及 split_paragraph 重复切分同样文本的吞吐。
+
+用法（在 VoxCPM 目录）：
+  uv run python scripts/voxcpm_normalize_bench.py [--requests 5000] [--unique 0.1] [--cache-size 1024]
+
+--unique 为一次性文本（每条不同的床号与体温组合之外再带序号，不会命中缓存）占请求的比例。
+"""
+
+import argparse
+import inspect
+import random
+import statistics
+import time
+
+from voxcpm.utils import text_normalize as tn
+
+TEMPLATES_ZH = [
+    "请注意，{bed}号床病人体温{temp}度，请及时处理。",
+    "{bed}号床呼叫，请护士前往处理。",
+    "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。",
+    "请{bed}号床家属到护士站办理手续。",
+]
+TEMPLATES_EN = [
+    "Attention please, the patient in bed {bed} has a temperature of {temp}°C.",
+    "Bed {bed} is calling, a nurse is needed.",
+]
+BEDS = range(1, 41)
+TEMPS = ["37.5", "38.0", "38.5", "39.0", "39.2"]
+
+
+def workload(n, unique, seed=1):
+    """n 条请求；模板与槽位取自上面的小集合，unique 比例的请求附带序号使文本各不相同"""
+    rng = random.Random(seed)
+    texts = []
+    for i in range(n):
+        templates = TEMPLATES_EN if rng.random() < 0.2 else TEMPLATES_ZH
+        text = rng.choice(templates).format(bed=rng.choice(BEDS[:8]), temp=rng.choice(TEMPS))
+        if rng.random() < unique:
+            text += f" #{i}" if templates is TEMPLATES_EN else f"（第{i}次）"
+        texts.append(text)
+    return texts
+
+
+def elapsed_ms(start):
+    return (time.perf_counter() - start) * 1000
+
+
+def make_normalizer(cache_size):
+    if "cache_size" in inspect.signature(tn.TextNormalizer.__init__).parameters:
+        return tn.TextNormalizer(cache_size=cache_size)
+    if cache_size:
+        return None
+    return tn.TextNormalizer()
+
+
+def run(normalizer, texts):
+    """返回 (总耗时ms, 每条延迟µs 列表)"""
+    lat = []
+    start = time.perf_counter()
+    for text in texts:
+        t = time.perf_counter()
+        normalizer.normalize(text)
+        lat.append((time.perf_counter() - t) * 1e6)
+    return elapsed_ms(start), lat
+
+
+# ==================== 分阶段耗时 ====================
+def stages(normalizer, texts, rounds=3):
+    """未命中路径各阶段的累计耗时（ms），按 TextNormalizer 内部的顺序逐步调用"""
+    ward = getattr(tn, "spell_out_ward_numbers", None)
+    number_to_words = getattr(normalizer, "number_to_words", normalizer.inflect_parser.number_to_words)
+    cost = {}
+
+    def timed(name, fn, *args):
+        t = time.perf_counter()
+        out = fn(*args)
+        cost[name] = cost.get(name, 0.0) + elapsed_ms(t)
+        return out
+
+    for _ in range(rounds):
+        for text in texts:
+            lang = "zh" if tn.contains_chinese(text) else "en"
+            text = timed("clean_text", tn.clean_text, text)
+            if ward is not None:
+                text = timed("ward numbers", ward, text, lang, number_to_words)
+            if lang == "zh":
+                text = timed("wetext zh", normalizer.zh_tn_model.normalize, text.replace("=", "等于"))
+                text = timed("blank/symbols", lambda s: tn.remove_bracket(tn.replace_corner_mark(tn.replace_blank(s))), text)
+            else:
+                text = timed("wetext en", normalizer.en_tn_model.normalize, text)
+                text = timed("inflect numbers", tn.spell_out_number, text, normalizer.inflect_parser)
+    return {k: v / rounds for k, v in cost.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--requests", type=int, default=5000)
+    parser.add_argument("--unique", type=float, default=0.1)
+    parser.add_argument("--cache-size", type=int, default=1024)
+    args = parser.parse_args()
+
+    texts = workload(args.requests, args.unique)
+    distinct = len(set(texts))
+    print(f"文本规范化基准：{len(texts)} 条请求，{distinct} 条不同文本，一次性文本比例 {args.unique:.0%}\n")
+
+    t = time.perf_counter()
+    base = make_normalizer(0)
+    print(f"加载 WeText/inflect: {elapsed_ms(t):.0f} ms")
+    base.normalize(texts[0])  # 首次调用载入 FST
+
+    rows = [("cache off", base)]
+    cached = make_normalizer(args.cache_size)
+    if cached is None:
+        print("当前 TextNormalizer 不支持 cache_size，只测无缓存路径")
+    else:
+        cached.normalize(texts[0])
+        rows.append((f"cache {args.cache_size}", cached))
+
+    print(f"\n{'mode':<12} | {'texts/s':>9} | {'mean µs':>9} | {'p50 µs':>9} | {'p99 µs':>9} | hit rate")
+    for name, normalizer in rows:
+        total, lat = run(normalizer, texts)
+        lat.sort()
+        cache = getattr(normalizer, "cache", None)
+        hit = "-"
+        if cache is not None and cache.maxsize > 0:
+            hit = f"{cache.hits / max(cache.hits + cache.misses, 1):.1%}"
+        print(f"{name:<12} | {len(texts) / total * 1000:>9.0f} | {statistics.mean(lat):>9.1f} | "
+              f"{lat[len(lat) // 2]:>9.1f} | {lat[len(lat) * 99 // 100]:>9.1f} | {hit}")
+
+    sample = sorted(set(texts))[:200]
+    cost = stages(base, sample)
+    total = sum(cost.values()) or 1.0
+    print(f"\n未命中路径各阶段（{len(sample)} 条不同文本）：")
+    for name, ms in sorted(cost.items(), key=lambda kv: -kv[1]):
+        print(f"  {name:<16} {ms / len(sample) * 1000:>8.1f} µs/条  {ms / total:>6.1%}")
+
+    zh = [s for s in texts if tn.contains_chinese(s)]
+    start = time.perf_counter()
+    for text in zh:
+        tn.split_paragraph(text, None, "zh", comma_split=True)
+    total = elapsed_ms(start)
+    print(f"\nsplit_paragraph（中文，逗号切分）：{len(zh) / total * 1000:.0f} 条/s，{total / len(zh) * 1000:.1f} µs/条")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""
+VoxCPM 合成性能基准（回归跟踪）
+用固定语料（中英文各短、中、长一条播报）分别经 generate 与 generate_streaming 合成，
+按 推理模式 x 线程数 x inference_timesteps x cfg_value 扫描，记录每次合成的：
+  实时率（合成耗时 / 音频时长）、首块延迟（流式；整段合成为完成时间）、峰值常驻内存（VmHWM），
+  以及各模块耗时：prefill（两个语言模型与局部编码器处理整段输入）、base LM 与 residual LM 的逐步推理、
+  局部 DiT（扩散采样）、局部编码器逐步编码、audio VAE 解码，其余计入 other。
+结果写入 JSON；给出 --baseline 时与之前的结果逐项对比，实时率变差超过 --tolerance 的项列出并以返回码 1 退出。
+
+用法（在 VoxCPM 目录，只测 CPU 时加 CUDA_VISIBLE_DEVICES=）：
+  CUDA_VISIBLE_DEVICES= uv run python scripts/voxcpm_perf_bench.py \\
+      [--model ./model/VoxCPM-0.5B] [--modes off,auto,int8] [--threads 1,4,0] [--timesteps 5,10] [--cfg 1.5,2.0] \\
+      [--out perf_bench.json] [--baseline 上次的.json]
+
+推理模式与 voxcpm_cpu_bench.py 相同（VoxCPMModel.optimize_cpu 的参数），每个模式加载一次模型，线程数在运行中切换；
+每个（模式, 线程数）先合成一次预热文本（编译耗时不计入）。同一配置下各文本使用相同随机种子。
+模块耗时由包装各模块的调用得到，嵌套调用只计入最外层；CUDA 上每段计时前后同步，实时率随之略偏高。
+"""
+
+import argparse
+import gc
+import itertools
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+import warnings
+
+warnings.filterwarnings("ignore")
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+from voxcpm_cpu_bench import MODES, WARMUP_TEXT, SEED, elapsed_ms, load
+
+CORPUS = [
+    ("zh-short", "zh", "请注意，会议将在五分钟后开始。"),
+    ("zh-medium", "zh", "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。"),
+    ("zh-long", "zh", "各位旅客请注意，由本站开往上海虹桥的列车即将进站，请在黄色安全线以内排队候车，"
+                      "先下后上，携带大件行李的旅客请使用车厢两端的行李架。"),
+    ("en-short", "en", "Attention please, the meeting starts in five minutes."),
+    ("en-medium", "en", "Dear visitors, visiting hours end at five p.m. Please collect your belongings before you leave."),
+    ("en-long", "en", "Attention all passengers, the train to Shanghai Hongqiao is now arriving. Please wait behind "
+                      "the yellow line, let passengers off first, and use the luggage racks at both ends of the car."),
+]
+APIS = ["generate", "generate_streaming"]
+MODULES = ["prefill", "base_lm", "residual_lm", "local_dit", "local_enc", "vae_decode"]
+
+
+def int_list(s):
+    return [int(x) for x in s.split(",") if x != ""]
+
+
+def float_list(s):
+    return [float(x) for x in s.split(",") if x != ""]
+
+
+# ==================== 内存 ====================
+def proc_status_kb(field):
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith(field + ":"):
+                return int(line.split()[1])
+    return 0
+
+
+def reset_peak_rss():
+    try:
+        with open("/proc/self/clear_refs", "w") as f:
+            f.write("5")
+    except OSError:
+        pass
+
+
+# ==================== 模块计时 ====================
+class ModuleTimer:
+    """包装模型各模块的调用入口并累计耗时；计时区间嵌套时只计最外层，各模块耗时互不重叠"""
+
+    def __init__(self, model):
+        import torch
+
+        self.times = dict.fromkeys(MODULES, 0.0)
+        self.depth = 0
+        self.start = 0.0
+        self.sync = torch.cuda.synchronize if model.device == "cuda" else (lambda: None)
+        self.wrap(model, "_prefill", "prefill")
+        self.wrap(model.base_lm, "forward_step", "base_lm")
+        self.wrap(model.residual_lm, "forward_step", "residual_lm")
+        self.wrap(model.feat_decoder, "forward", "local_dit")
+        self.wrap(model.audio_vae, "decode", "vae_decode")
+        # 局部编码器逐步编码经 feat_encoder_step（模块或编译后的模块）调用，用前后钩子计时
+        enc = model.feat_encoder_step
+        enc.register_forward_pre_hook(lambda *_: self.enter())
+        enc.register_forward_hook(lambda *_: self.leave("local_enc"))
+
+    def wrap(self, obj, attr, name):
+        fn = getattr(obj, attr)
+
+        def timed(*args, **kwargs):
+            self.enter()
+            try:
+                return fn(*args, **kwargs)
+            finally:
+                self.leave(name)
+
+        object.__setattr__(obj, attr, timed)
+
+    def enter(self):
+        self.depth += 1
+        if self.depth == 1:
+            self.sync()
+            self.start = time.perf_counter()
+
+    def leave(self, name):
+        if self.depth == 1:
+            self.sync()
+            self.times[name] += elapsed_ms(self.start)
+        self.depth = max(self.depth - 1, 0)
+
+    def take(self):
+        times, self.times = self.times, dict.fromkeys(MODULES, 0.0)
+        return times
+
+
+# ==================== 合成 ====================
+def run_once(model, timer, api, text, timesteps, cfg):
+    """合成一次，返回 (音频时长ms, 合成耗时ms, 首块耗时ms, 模块耗时)"""
+    import torch
+
+    torch.manual_seed(SEED)
+    timer.take()
+    samples = 0
+    first_ms = None
+    start = time.perf_counter()
+    if api == "generate_streaming":
+        for chunk in model.generate_streaming(target_text=text, inference_timesteps=timesteps, cfg_value=cfg):
+            if first_ms is None:
+                first_ms = elapsed_ms(start)
+            samples += chunk.numel()
+    else:
+        samples = model.generate(target_text=text, inference_timesteps=timesteps, cfg_value=cfg).numel()
+    synth_ms = elapsed_ms(start)
+    modules = timer.take()
+    modules["other"] = max(synth_ms - sum(modules.values()), 0.0)
+    return samples / model.sample_rate * 1000, synth_ms, first_ms if first_ms is not None else synth_ms, modules
+
+
+def environment():
+    import torch
+
+    cpu = platform.processor()
+    try:
+        with open("/proc/cpuinfo") as f:
+            cpu = next((l.split(":", 1)[1].strip() for l in f if l.startswith("model name")), cpu)
+    except OSError:
+        pass
+    try:
+        commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True, text=True,
+                                cwd=os.path.dirname(os.path.abspath(__file__))).stdout.strip()
+    except OSError:
+        commit = ""
+    return {"time": time.strftime("%Y-%m-%dT%H:%M:%S%z"), "host": platform.node(), "cpu": cpu,
+            "cpus": len(os.sched_getaffinity(0)) if hasattr(os, "sched_getaffinity") else os.cpu_count(),
+            "torch": torch.__version__, "python": platform.python_version(), "commit": commit,
+            "cuda": torch.cuda.is_available()}
+
+
+def run_key(r):
+    return (r["mode"], r["threads"], r["timesteps"], r["cfg"], r["api"], r["text"])
+
+
+# ==================== 对比 ====================
+def compare(runs, baseline_path, tolerance):
+    """与之前的结果逐项对比实时率与首块延迟，返回变差超过 tolerance 的项数"""
+    with open(baseline_path, encoding="utf-8") as f:
+        base = {run_key(r): r for r in json.load(f)["runs"]}
+    regressions = 0
+    matched = 0
+    print(f"\nagainst {baseline_path} (tolerance {tolerance:.0%}):")
+    for r in runs:
+        b = base.get(run_key(r))
+        if b is None:
+            continue
+        matched += 1
+        rtf_ratio = r["rtf"] / b["rtf"] if b["rtf"] else 1.0
+        first_ratio = r["first_chunk_ms"] / b["first_chunk_ms"] if b["first_chunk_ms"] else 1.0
+        if rtf_ratio > 1 + tolerance or first_ratio > 1 + tolerance:
+            regressions += 1
+            print(f"  REGRESSION {'/'.join(map(str, run_key(r)))}: RTF {b['rtf']:.3f} -> {r['rtf']:.3f} "
+                  f"({rtf_ratio - 1:+.0%}), first chunk {b['first_chunk_ms']:.0f} -> {r['first_chunk_ms']:.0f}ms "
+                  f"({first_ratio - 1:+.0%})")
+    print(f"  {matched} runs matched, {regressions} regressed")
+    return regressions
+
+
+# ==================== 运行 ====================
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM synthesis performance sweep")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--modes", default="off,auto,int8", help="逗号分隔，可选 " + ",".join(MODES))
+    parser.add_argument("--threads", default="0", help="逗号分隔的线程数，0 为全部可用 CPU")
+    parser.add_argument("--timesteps", default="5,10", help="逗号分隔的 inference_timesteps")
+    parser.add_argument("--cfg", default="1.5,2.0", help="逗号分隔的 cfg_value")
+    parser.add_argument("--texts", default=",".join(t[0] for t in CORPUS), help="逗号分隔的语料条目")
+    parser.add_argument("--apis", default=",".join(APIS), help="逗号分隔，可选 " + ",".join(APIS))
+    parser.add_argument("--out", default="perf_bench.json", help="结果 JSON")
+    parser.add_argument("--baseline", default="", help="之前的结果 JSON，逐项对比")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="实时率或首块延迟变差超过该比例视为回归")
+    args = parser.parse_args()
+
+    import torch
+    import torch._dynamo
+
+    modes = [m for m in args.modes.split(",") if m]
+    apis = [a for a in args.apis.split(",") if a]
+    texts = [t for t in CORPUS if t[0] in args.texts.split(",")]
+    for m in modes:
+        if m not in MODES:
+            parser.error(f"unknown mode {m}")
+    for a in apis:
+        if a not in APIS:
+            parser.error(f"unknown api {a}")
+    if torch.cuda.is_available() and any(MODES[m] is not None for m in modes):
+        parser.error("CPU modes need the CPU device; run with CUDA_VISIBLE_DEVICES= or --modes off")
+    all_cpus = len(os.sched_getaffinity(0)) if hasattr(os, "sched_getaffinity") else os.cpu_count()
+    thread_counts = [t if t > 0 else all_cpus for t in int_list(args.threads)]
+
+    runs = []
+    for mode in modes:
+        start = time.perf_counter()
+        model = load(args.model, mode, thread_counts[0])
+        load_ms = elapsed_ms(start)
+        timer = ModuleTimer(model)
+        for threads in thread_counts:
+            torch.set_num_threads(threads)
+            start = time.perf_counter()
+            model.generate(target_text=WARMUP_TEXT, inference_timesteps=10, cfg_value=2.0)
+            warmup_ms = elapsed_ms(start)
+            print(f"{mode}, {threads} thread(s): load {load_ms:.0f}ms, warmup {warmup_ms:.0f}ms", file=sys.stderr)
+            for timesteps, cfg, api, (name, lang, text) in itertools.product(
+                    int_list(args.timesteps), float_list(args.cfg), apis, texts):
+                reset_peak_rss()
+                audio_ms, synth_ms, first_ms, modules = run_once(model, timer, api, text, timesteps, cfg)
+                runs.append({"mode": mode, "dtype": model.config.dtype, "threads": threads, "timesteps": timesteps,
+                             "cfg": cfg, "api": api, "text": name, "lang": lang, "chars": len(text),
+                             "audio_ms": audio_ms, "synth_ms": synth_ms, "rtf": synth_ms / max(audio_ms, 1e-9),
+                             "first_chunk_ms": first_ms, "peak_rss_mb": proc_status_kb("VmHWM") / 1024,
+                             "modules_ms": modules, "load_ms": load_ms, "warmup_ms": warmup_ms})
+        del model, timer
+        gc.collect()
+        torch._dynamo.reset()  # 编译缓存随模型释放
+
+    print(f"{'mode':<12} | {'thr':<3} | {'steps':<5} | {'cfg':<4} | {'api':<9} | {'text':<9} | {'audio':<6} | "
+          f"{'RTF':<5} | {'first':<8} | {'peak RSS':<8} | " + " | ".join(f"{m:<11}" for m in MODULES + ["other"]))
+    for r in runs:
+        share = " | ".join(f"{r['modules_ms'][m] / r['synth_ms']:<11.1%}" for m in MODULES + ["other"])
+        print(f"{r['mode']:<12} | {r['threads']:<3} | {r['timesteps']:<5} | {r['cfg']:<4.1f} | "
+              f"{'stream' if r['api'] == 'generate_streaming' else 'whole':<9} | {r['text']:<9} | "
+              f"{r['audio_ms'] / 1000:<5.1f}s | {r['rtf']:<5.2f} | {r['first_chunk_ms']:<6.0f}ms | "
+              f"{r['peak_rss_mb']:<5.0f} MB | {share}")
+    print("\nRTF = synthesis time / audio duration; first = first streamed chunk (whole: until the waveform is returned);")
+    print("module columns = share of synthesis time; prefill covers both LMs and the local encoder over the whole input.")
+
+    with open(args.out, "w", encoding="utf-8") as f:
+        json.dump({"env": environment(), "args": vars(args), "runs": runs}, f, ensure_ascii=False, indent=2)
+    print(f"results written to {args.out}")
+    if args.baseline and compare(runs, args.baseline, args.tolerance):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
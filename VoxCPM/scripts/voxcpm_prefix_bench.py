@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+VoxCPM 预填充复用基准
+一组开头相同的播报依次合成，对比每个请求的预填充（两个语言模型处理输入 + 写入 KV 缓存）耗时：
+不复用，与复用之前请求共享的文本前缀 KV（VoxCPMModel.enable_prefix_cache）。
+同时给出旧 fill_caches 每次把整个 KV 缓存清零的耗时（现已去掉），以及复用前后最后隐状态的最大差异。
+
+用法（在 VoxCPM 目录）：
+  uv run python scripts/voxcpm_prefix_bench.py [--model ./model/VoxCPM-0.5B] \\
+      [--prompt-wav voice.wav --prompt-text "参考文本"] [--threads N] [--repeat 5]
+
+有参考音色时每个请求都以相同的参考文本开头（参考音频位于目标文本之后，不能复用）。
+复用模式下第 i 条播报只能用到前 i-1 条留下的前缀，与服务中依次到达的请求一致。
+"""
+
+import argparse
+import os
+import statistics
+import sys
+import time
+import warnings
+
+warnings.filterwarnings("ignore")
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+TEXTS = [
+    "各位旅客请注意，由本站开往上海虹桥的列车即将进站，请在黄色安全线以内排队候车。",
+    "各位旅客请注意，由本站开往北京南的列车晚点约二十分钟，请耐心等候。",
+    "各位旅客请注意，由本站开往杭州东的列车开始检票，请到三号检票口检票进站。",
+    "各位访客请注意，探视时间将于下午五点结束，请在离开前整理好随身物品。",
+    "各位访客请注意，住院部三楼正在进行消毒，请暂时使用东侧电梯。",
+]
+
+
+def elapsed_ms(start):
+    return (time.perf_counter() - start) * 1000
+
+
+def prefill(model, inputs):
+    """一次预填充，返回 (耗时ms, 最后的 LM 隐状态)"""
+    text, text_mask, feat, feat_mask, _ = inputs
+    start = time.perf_counter()
+    lm_hidden, _, _, kv, residual_kv = model._prefill(text, text_mask, feat, feat_mask)
+    model.base_lm.kv_cache.fill_caches(kv)
+    model.residual_lm.kv_cache.fill_caches(residual_kv)
+    return elapsed_ms(start), lm_hidden
+
+
+def main():
+    parser = argparse.ArgumentParser(description="VoxCPM prefill prefix reuse benchmark")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--prompt-wav", default="")
+    parser.add_argument("--prompt-text", default="")
+    parser.add_argument("--threads", type=int, default=0, help="推理线程数，0 为 PyTorch 默认")
+    parser.add_argument("--repeat", type=int, default=5, help="每个请求重复次数，取中位数")
+    args = parser.parse_args()
+
+    import torch
+    from voxcpm.model import VoxCPMModel
+    from voxcpm.model.prefix_cache import PrefixKVCache
+
+    if args.threads > 0:
+        torch.set_num_threads(args.threads)
+    model = VoxCPMModel.from_local(args.model, optimize=False)
+    prompt_cache = None
+    if args.prompt_wav:
+        if not args.prompt_text:
+            parser.error("--prompt-wav requires --prompt-text")
+        prompt_cache = model.build_prompt_cache(prompt_text=args.prompt_text, prompt_wav_path=args.prompt_wav)
+    inputs = [model._prepare_inputs(text, prompt_cache) for text in TEXTS]
+
+    with torch.inference_mode():
+        model.prefix_cache = None
+        prefill(model, inputs[0])  # 预热
+
+        rows = []
+        for i, inp in enumerate(inputs):
+            model.prefix_cache = None
+            off = [prefill(model, inp) for _ in range(args.repeat)]
+            on = []
+            for _ in range(args.repeat):
+                model.prefix_cache = PrefixKVCache()
+                for prev in inputs[:i]:
+                    prefill(model, prev)
+                before = model.prefix_cache.reused_tokens
+                on.append(prefill(model, inp))
+                reused = model.prefix_cache.reused_tokens - before
+            diff = (off[0][1].float() - on[0][1].float()).abs().max().item()
+            rows.append({"positions": inp[0].size(1), "reused": reused, "diff": diff,
+                         "off": statistics.median(t for t, _ in off), "on": statistics.median(t for t, _ in on)})
+
+        zero = []
+        for _ in range(args.repeat):
+            start = time.perf_counter()
+            model.base_lm.kv_cache.kv_cache.zero_()
+            model.residual_lm.kv_cache.kv_cache.zero_()
+            zero.append(elapsed_ms(start))
+        model.prefix_cache = None
+
+    voice = "with a voice prompt" if prompt_cache is not None else "without a voice prompt"
+    print(f"VoxCPM prefill, {voice}, {torch.get_num_threads()} thread(s), median of {args.repeat}\n")
+    print(f"{'request':<7} | {'positions':<9} | {'reused':<6} | {'no reuse':<9} | {'reuse':<9} | {'saved':<9} | max |dh|")
+    for i, r in enumerate(rows):
+        print(f"{i:<7} | {r['positions']:<9} | {r['reused']:<6} | {r['off']:<7.1f}ms | {r['on']:<7.1f}ms | "
+              f"{r['off'] - r['on']:<7.1f}ms | {r['diff']:.2e}")
+    print(f"\nfull KV cache zero_() removed from fill_caches: {statistics.median(zero):.1f}ms per request "
+          f"(max_length {model.config.max_length})")
+    print("positions = prefill length; reused = text positions taken from earlier requests; "
+          "max |dh| = last hidden state difference against no reuse.")
+
+
+if __name__ == "__main__":
+    sys.exit(main())
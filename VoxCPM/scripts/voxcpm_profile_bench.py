@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""
+VoxCPM 解码档位基准（延迟 vs 质量）
+用 voxcpm_perf_bench.py 的固定语料（中英文各短、中、长一条播报）按各解码档位流式合成（DECODE_PROFILES：
+quality 为原有的 10 步 Euler 且每步都算 CFG 无条件分支；balanced、fast 步数更少、复用无条件分支、收敛后提前结束），
+另可加 cfg_value=1（不做 CFG，每步只算条件分支），记录：
+  实时率、首块延迟、局部 DiT 每个生成步的耗时与估计器调用次数，
+  以及 SenseVoice 转写的错误率（中文按字 CER，英文按词 WER），相对 quality 的加速比与错误率变化。
+WAV 与结果 JSON 写入 --out；报警播报默认使用的档位（后端 -tts-alarm-profile）应在此对比中确认可懂度。
+
+用法（在 VoxCPM 目录，只测 CPU 时加 CUDA_VISIBLE_DEVICES=）：
+  CUDA_VISIBLE_DEVICES= uv run python scripts/voxcpm_profile_bench.py \\
+      [--model ./model/VoxCPM-0.5B] [--asr ./model/SenseVoiceSmall] [--profiles quality,balanced,fast] \\
+      [--cfg 2.0,1.0] [--mode off] [--threads 0] [--out profile_bench_out]
+
+同一文本在各档位使用相同随机种子；首个配置之前合成一次预热文本。
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+import time
+import warnings
+
+warnings.filterwarnings("ignore")
+os.environ["TOKENIZERS_PARALLELISM"] = "false"
+
+from voxcpm_cpu_bench import ASR, MODES, SEED, WARMUP_TEXT, cer, elapsed_ms, load
+from voxcpm_perf_bench import CORPUS, ModuleTimer, float_list
+
+REFERENCE = "quality"
+
+
+# ==================== 准确度 ====================
+def wer(hyp, ref):
+    hyp = re.sub(r"[^\w\s]", " ", hyp).lower().split()
+    ref = re.sub(r"[^\w\s]", " ", ref).lower().split()
+    if not ref:
+        return 0.0
+    prev = list(range(len(hyp) + 1))
+    for i, r in enumerate(ref, 1):
+        cur = [i] + [0] * len(hyp)
+        for j, h in enumerate(hyp, 1):
+            cur[j] = min(prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + (r != h))
+        prev = cur
+    return prev[-1] / len(ref)
+
+
+def error_rate(hyp, ref, lang):
+    return cer(hyp, ref) if lang == "zh" else wer(hyp, ref)
+
+
+# ==================== 合成 ====================
+class EstimatorCounter:
+    """局部 DiT 估计器的调用次数与输入行数（CFG 无条件分支使行数加倍）"""
+
+    def __init__(self, model):
+        self.calls = 0
+        self.rows = 0
+        model.feat_decoder.estimator.register_forward_pre_hook(self.hook)
+
+    def hook(self, module, args):
+        self.calls += 1
+        self.rows += args[0].shape[0]
+
+    def take(self):
+        calls, rows = self.calls, self.rows
+        self.calls = self.rows = 0
+        return calls, rows
+
+
+def run_once(model, timer, counter, text, profile, cfg):
+    """流式合成一次，返回 (波形, 结果行)"""
+    import torch
+
+    torch.manual_seed(SEED)
+    timer.take()
+    counter.take()
+    chunks = []
+    first_ms = None
+    start = time.perf_counter()
+    for chunk in model.generate_streaming(target_text=text, cfg_value=cfg, decode_profile=profile):
+        if first_ms is None:
+            first_ms = elapsed_ms(start)
+        chunks.append(chunk.reshape(-1))
+    synth_ms = elapsed_ms(start)
+    wav = torch.cat(chunks)
+    steps = len(chunks)
+    calls, rows = counter.take()
+    dit_ms = timer.take()["local_dit"]
+    audio_ms = wav.numel() / model.sample_rate * 1000
+    return wav, {"audio_ms": audio_ms, "synth_ms": synth_ms, "first_chunk_ms": first_ms, "rtf": synth_ms / audio_ms,
+                 "steps": steps, "dit_ms_per_step": dit_ms / steps, "estimator_calls_per_step": calls / steps,
+                 "estimator_rows_per_step": rows / steps}
+
+
+# ==================== 运行 ====================
+def main():
+    from voxcpm.modules.locdit import DECODE_PROFILES
+
+    parser = argparse.ArgumentParser(description="VoxCPM decode profile latency / quality benchmark")
+    parser.add_argument("--model", default="./model/VoxCPM-0.5B")
+    parser.add_argument("--asr", default="./model/SenseVoiceSmall", help="SenseVoice 模型目录，不存在时跳过转写")
+    parser.add_argument("--profiles", default=",".join(DECODE_PROFILES), help="逗号分隔，可选 " + ",".join(DECODE_PROFILES))
+    parser.add_argument("--cfg", default="2.0,1.0", help="逗号分隔的 cfg_value；1.0 为不做 CFG")
+    parser.add_argument("--mode", default="off", help="推理模式，可选 " + ",".join(MODES))
+    parser.add_argument("--threads", type=int, default=0, help="推理线程数，0 为 PyTorch 默认")
+    parser.add_argument("--out", default="profile_bench_out", help="生成的 WAV 与结果 JSON 的目录")
+    args = parser.parse_args()
+
+    import torchaudio
+
+    profiles = [p for p in args.profiles.split(",") if p]
+    for p in profiles:
+        if p not in DECODE_PROFILES:
+            parser.error(f"unknown profile {p}")
+    if REFERENCE not in profiles:
+        profiles.insert(0, REFERENCE)
+    cfgs = float_list(args.cfg)
+    if args.mode not in MODES:
+        parser.error(f"unknown mode {args.mode}")
+    os.makedirs(args.out, exist_ok=True)
+
+    model = load(args.model, args.mode, args.threads)
+    timer = ModuleTimer(model)
+    counter = EstimatorCounter(model)
+    model.generate(target_text=WARMUP_TEXT, inference_timesteps=10, cfg_value=2.0)
+
+    runs = []
+    for cfg in cfgs:
+        for profile in profiles:
+            for name, lang, text in CORPUS:
+                wav, row = run_once(model, timer, counter, text, profile, cfg)
+                path = os.path.join(args.out, f"{profile}_cfg{cfg:g}_{name}.wav")
+                torchaudio.save(path, wav.unsqueeze(0).float(), model.sample_rate)
+                row.update({"profile": profile, "cfg": cfg, "text": name, "lang": lang, "path": path})
+                runs.append(row)
+                print(f"{profile} cfg {cfg:g} {name}: RTF {row['rtf']:.3f}", file=sys.stderr)
+
+    asr = ASR(args.asr) if os.path.isdir(args.asr) else None
+    texts = {name: (lang, text) for name, lang, text in CORPUS}
+    if asr is not None:
+        for row in runs:
+            lang, text = texts[row["text"]]
+            row["transcript"] = asr.transcribe(row["path"])
+            row["error_rate"] = error_rate(row["transcript"], text, lang)
+
+    # 每个（档位, cfg）汇总全部文本；加速比与错误率变化相对 quality、cfg 为首个给定值
+    def summary(profile, cfg):
+        rows = [r for r in runs if r["profile"] == profile and r["cfg"] == cfg]
+        n = len(rows)
+        s = {"profile": profile, "cfg": cfg,
+             "rtf": sum(r["synth_ms"] for r in rows) / sum(r["audio_ms"] for r in rows),
+             "first_chunk_ms": sum(r["first_chunk_ms"] for r in rows) / n,
+             "dit_ms_per_step": sum(r["dit_ms_per_step"] for r in rows) / n,
+             "estimator_calls_per_step": sum(r["estimator_calls_per_step"] for r in rows) / n,
+             "estimator_rows_per_step": sum(r["estimator_rows_per_step"] for r in rows) / n}
+        if asr is not None:
+            s["error_rate"] = sum(r["error_rate"] for r in rows) / n
+        return s
+
+    summaries = [summary(p, c) for c in cfgs for p in profiles]
+    ref = summaries[0]
+    print(f"\nVoxCPM decode profiles, mode {args.mode}, reference = {REFERENCE} at cfg {cfgs[0]:g}\n")
+    print(f"{'profile':<9} | {'cfg':<4} | {'RTF':<6} | {'speedup':<7} | {'first chunk':<11} | "
+          f"{'DiT/step':<9} | {'est calls':<9} | {'est rows':<8} | error rate")
+    for s in summaries:
+        s["speedup"] = ref["rtf"] / s["rtf"]
+        err = "-"
+        if "error_rate" in s:
+            s["error_rate_delta"] = s["error_rate"] - ref["error_rate"]
+            err = f"{s['error_rate']:.3f} ({s['error_rate_delta']:+.3f})"
+        print(f"{s['profile']:<9} | {s['cfg']:<4g} | {s['rtf']:<6.3f} | {s['speedup']:<6.2f}x | "
+              f"{s['first_chunk_ms']:<9.0f}ms | {s['dit_ms_per_step']:<7.1f}ms | "
+              f"{s['estimator_calls_per_step']:<9.1f} | {s['estimator_rows_per_step']:<8.1f} | {err}")
+    print("\nRTF = synthesis time / audio duration over the whole corpus; est calls / rows = local DiT estimator "
+          "calls and input rows per generation step (CFG doubles the rows); error rate = CER (zh) / WER (en) "
+          "of the SenseVoice transcript against the input text, change against the reference in parentheses.")
+    with open(os.path.join(args.out, "results.json"), "w", encoding="utf-8") as f:
+        json.dump({"profiles": {name: DECODE_PROFILES[name].model_dump() for name in profiles},
+                   "summary": summaries, "runs": runs}, f, ensure_ascii=False, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,8 @@
+import hashlib
+import io
 import os
 import re
-import tempfile
+from collections import OrderedDict
 import numpy as np
 from typing import Generator
 from huggingface_hub import snapshot_download
@@ -27,6 +29,8 @@ class VoxCPM:
         print(f"voxcpm_model_path: {voxcpm_model_path}, zipenhancer_model_path: {zipenhancer_model_path}, enable_denoiser: {enable_denoiser}")
         self.tts_model = VoxCPMModel.from_local(voxcpm_model_path, optimize=optimize)
         self.text_normalizer = None
+        self.denoised_prompts = OrderedDict()  # prompt audio hash -> denoised 16 kHz waveform
+        self.denoised_prompts_max = 8
         if enable_denoiser and zipenhancer_model_path is not None:
             from .zipenhancer import ZipEnhancer
             self.denoiser = ZipEnhancer(zipenhancer_model_path)
@@ -102,6 +106,7 @@ class VoxCPM:
             prompt_text : str = None,
             cfg_value : float = 2.0,    
             inference_timesteps : int = 10,
+            decode_profile : str = None,
             max_length : int = 4096,
             normalize : bool = True,
             denoise : bool = True,
@@ -124,6 +129,9 @@ class VoxCPM:
             prompt_text: Text content corresponding to the prompt audio.
             cfg_value: Guidance scale for the generation model.
             inference_timesteps: Number of inference steps.
+            decode_profile: Name of a ``DECODE_PROFILES`` entry ("quality", "balanced",
+                "fast") trading quality for local DiT latency; overrides
+                ``inference_timesteps``. ``None`` keeps the original decoding.
             max_length: Maximum token length during generation.
             normalize: Whether to run text normalization before generation.
             denoise: Whether to denoise the prompt audio if a denoiser is
@@ -149,47 +157,57 @@ class VoxCPM:
         
         text = text.replace("\n", " ")
         text = re.sub(r'\s+', ' ', text)
-        temp_prompt_wav_path = None
         
-        try:
-            if prompt_wav_path is not None and prompt_text is not None:
-                if denoise and self.denoiser is not None:
-                    with tempfile.NamedTemporaryFile(delete=False, suffix='.wav') as tmp_file:
-                        temp_prompt_wav_path = tmp_file.name
-                    self.denoiser.enhance(prompt_wav_path, output_path=temp_prompt_wav_path)
-                    prompt_wav_path = temp_prompt_wav_path
-                fixed_prompt_cache = self.tts_model.build_prompt_cache(
-                    prompt_wav_path=prompt_wav_path,
-                    prompt_text=prompt_text
-                )
-            else:
-                fixed_prompt_cache = None  # will be built from the first inference
-            
-            if normalize:
-                if self.text_normalizer is None:
-                    from .utils.text_normalize import TextNormalizer
-                    self.text_normalizer = TextNormalizer()
-                text = self.text_normalizer.normalize(text)
-            
-            generate_result = self.tts_model._generate_with_prompt_cache(
-                            target_text=text,
-                            prompt_cache=fixed_prompt_cache,
-                            min_len=2,
-                            max_len=max_length,
-                            inference_timesteps=inference_timesteps,
-                            cfg_value=cfg_value,
-                            retry_badcase=retry_badcase,
-                            retry_badcase_max_times=retry_badcase_max_times,
-                            retry_badcase_ratio_threshold=retry_badcase_ratio_threshold,
-                            streaming=streaming,
-                        )
+        if prompt_wav_path is not None and prompt_text is not None:
+            fixed_prompt_cache = self.build_prompt_cache(prompt_text, prompt_wav_path, denoise=denoise)
+        else:
+            fixed_prompt_cache = None  # will be built from the first inference
         
-            for wav, _, _ in generate_result:
-                yield wav.squeeze(0).cpu().numpy()
+        if normalize:
+            if self.text_normalizer is None:
+                from .utils.text_normalize import TextNormalizer
+                self.text_normalizer = TextNormalizer()
+            text = self.text_normalizer.normalize(text)
         
-        finally:
-            if temp_prompt_wav_path and os.path.exists(temp_prompt_wav_path):
-                try:
-                    os.unlink(temp_prompt_wav_path)
-                except OSError:
-                    pass  
\ No newline at end of file
+        generate_result = self.tts_model._generate_with_prompt_cache(
+                        target_text=text,
+                        prompt_cache=fixed_prompt_cache,
+                        min_len=2,
+                        max_len=max_length,
+                        inference_timesteps=inference_timesteps,
+                        cfg_value=cfg_value,
+                        decode_profile=decode_profile,
+                        retry_badcase=retry_badcase,
+                        retry_badcase_max_times=retry_badcase_max_times,
+                        retry_badcase_ratio_threshold=retry_badcase_ratio_threshold,
+                        streaming=streaming,
+                    )
+    
+        for wav, _, _ in generate_result:
+            yield wav.squeeze(0).cpu().numpy()
+
+    def build_prompt_cache(self, prompt_text: str, prompt_wav_path: str, denoise: bool = True) -> dict:
+        """Build the prompt cache of a reference recording, denoising it first if requested.
+
+        Denoising runs in memory (``ZipEnhancer.enhance_audio``, windowed, no temp files). The result
+        is kept per hash of the audio file content, so repeated requests with the same prompt skip it.
+        """
+        if not denoise or self.denoiser is None:
+            return self.tts_model.build_prompt_cache(prompt_wav_path=prompt_wav_path, prompt_text=prompt_text)
+
+        import torchaudio
+
+        with open(prompt_wav_path, "rb") as f:
+            data = f.read()
+        key = hashlib.sha256(data).hexdigest()
+        wav = self.denoised_prompts.get(key)
+        if wav is None:
+            audio, sr = torchaudio.load(io.BytesIO(data))
+            wav = self.denoiser.enhance_audio(audio, sr)
+            self.denoised_prompts[key] = wav
+            while len(self.denoised_prompts) > self.denoised_prompts_max:
+                self.denoised_prompts.popitem(last=False)
+        self.denoised_prompts.move_to_end(key)
+        return self.tts_model.build_prompt_cache(
+            prompt_text=prompt_text, prompt_wav=wav, prompt_sample_rate=self.denoiser.SAMPLE_RATE
+        )  
\ No newline at end of file
@@ -0,0 +1,266 @@
+"""
+Batched streaming decoding for VoxCPM.
+
+Several independent requests share every generation step: one batched call of the local DiT,
+the local encoder, the stop head and both language models instead of one call per request.
+Single-request decoding is dominated by the per-step fixed cost (reading the weights, launching
+many small ops), so a step over a few rows costs little more than a step over one.
+"""
+
+from contextlib import contextmanager
+from typing import Dict, List, Tuple, Union
+
+import torch
+from einops import rearrange
+
+from ..modules.locdit import DecodeProfile, resolve_decode_profile
+from .utils import get_dtype
+
+
+class _Sequence:
+    def __init__(self, handle: int, min_len: int, max_len: int, decode: DecodeProfile, cfg_value: float, streaming: bool):
+        self.handle = handle
+        self.min_len = min_len
+        self.max_len = max_len
+        self.decode = decode
+        self.cfg_value = cfg_value
+        self.streaming = streaming
+        self.steps = 0
+        # predicted patches, [p, d] each: the last three when streaming, all of them otherwise
+        self.feats: List[torch.Tensor] = []
+        # badcase retry of non-streaming requests, as in generate_with_prompt_cache
+        self.inputs = None  # prepared inputs, kept to prefill again
+        self.text_length = 0  # target text tokens
+        self.badcase_len = None  # steps at which the output counts as a badcase
+        self.retries = 0
+
+
+class BatchedGenerator:
+    """Continuous batching over one ``VoxCPMModel``.
+
+    ``add`` prefills a request on its own (batch size 1) and gives it a free row; ``step`` runs one
+    generation step for every active row and returns each row's new audio chunk. Finished and
+    cancelled rows leave between steps and new rows can join before any step, so a request neither
+    waits for a batch to form nor for the longest request of a batch to end. Non-streaming rows
+    return no chunks; their whole utterance is decoded at once when they finish.
+
+    Each row keeps its own KV cache length, minimum / maximum length, stop decision and CFG scale.
+    Rows with a different decode profile (diffusion steps, solver) run the local DiT in separate groups; everything
+    else is one call per step. The output of a streaming row matches ``generate_with_prompt_cache_streaming``
+    and that of a non-streaming row ``generate_with_prompt_cache`` up to sampling noise and floating point
+    rounding; ``scripts/voxcpm_batch_check.py`` checks this with the noise fixed.
+
+    The generator swaps its caches into the model's language models only for the duration of a step,
+    so the model's single-request methods keep working between steps. Use one generator per model.
+    """
+
+    def __init__(self, model, max_batch: int):
+        self.model = model
+        self.max_batch = max_batch
+        dtype = get_dtype(model.config.dtype)
+        max_length = model.config.max_length
+        self.base_cache = model.base_lm.batched_cache(max_batch, max_length, model.device, dtype)
+        self.residual_cache = model.residual_lm.batched_cache(max_batch, max_length, model.device, dtype)
+
+        # row order
+        self.seqs: List[_Sequence] = []
+        self.lm_hidden = None  # [rows, h]
+        self.residual_hidden = None  # [rows, h]
+        self.prefix_feat_cond = None  # [rows, p, d]
+        self.next_handle = 0
+
+    def __len__(self) -> int:
+        return len(self.seqs)
+
+    @torch.inference_mode()
+    def add(
+        self,
+        target_text: str,
+        prompt_cache: dict = None,
+        min_len: int = 2,
+        max_len: int = 2000,
+        inference_timesteps: int = 10,
+        cfg_value: float = 2.0,
+        decode_profile: Union[str, DecodeProfile, None] = None,
+        streaming: bool = True,
+        retry_badcase: bool = False,
+        retry_badcase_max_times: int = 3,
+        retry_badcase_ratio_threshold: float = 6.0,
+    ) -> int:
+        """Prefill a request and add it to the batch.
+
+        Args: as ``generate_with_prompt_cache_streaming``, or ``generate_with_prompt_cache`` when
+            ``streaming`` is False; ``max_len`` is capped so that the row fits in the KV cache.
+            ``retry_badcase`` only applies to non-streaming requests.
+        Returns:
+            Handle identifying the request in the results of ``step``.
+        """
+        if len(self.seqs) >= self.max_batch:
+            raise ValueError(f"batch is full ({self.max_batch} requests)")
+        if not target_text.strip():
+            raise ValueError("target text must be a non-empty string")
+        decode = resolve_decode_profile(decode_profile, inference_timesteps)
+
+        inputs = self.model._prepare_inputs(target_text, prompt_cache)[:4]
+        prefix_len = inputs[0].size(1)
+        if prefix_len >= self.base_cache.max_length:
+            raise ValueError(f"input of {prefix_len} tokens does not fit the KV cache")
+        seq = _Sequence(self.next_handle, min_len, max_len, decode, cfg_value, streaming)
+        if retry_badcase and not streaming:
+            target_text_length = len(self.model.text_tokenizer(target_text))
+            seq.inputs = inputs
+            seq.text_length = target_text_length
+            seq.badcase_len = target_text_length * retry_badcase_ratio_threshold
+            seq.retries = retry_badcase_max_times - 1
+            seq.max_len = int(target_text_length * retry_badcase_ratio_threshold + 10)
+        # every step but the last writes one position
+        seq.max_len = min(seq.max_len, self.base_cache.max_length - prefix_len)
+        self.next_handle += 1
+        self._join(seq, *inputs)
+        return seq.handle
+
+    def _join(self, seq: _Sequence, text, text_mask, feat, feat_mask):
+        """Prefill one sequence into the next free row."""
+        lm_hidden, residual_hidden, prefix_feat_cond, base_kv, residual_kv = self.model._prefill(
+            text, text_mask, feat, feat_mask
+        )
+        row = len(self.seqs)
+        self.base_cache.fill_row(row, base_kv)
+        self.residual_cache.fill_row(row, residual_kv)
+        self.base_cache.active = self.residual_cache.active = row + 1
+        self.seqs.append(seq)
+        if row == 0:
+            self.lm_hidden, self.residual_hidden, self.prefix_feat_cond = lm_hidden, residual_hidden, prefix_feat_cond
+        else:
+            self.lm_hidden = torch.cat([self.lm_hidden, lm_hidden])
+            self.residual_hidden = torch.cat([self.residual_hidden, residual_hidden])
+            self.prefix_feat_cond = torch.cat([self.prefix_feat_cond, prefix_feat_cond])
+
+    def cancel(self, handle: int):
+        """Drop a request; unknown or finished handles are ignored."""
+        self._retain([r for r, seq in enumerate(self.seqs) if seq.handle != handle])
+
+    @torch.inference_mode()
+    def step(self) -> List[Tuple[int, torch.Tensor, bool]]:
+        """Run one generation step for every active request.
+
+        Returns:
+            ``(handle, audio, finished)`` per request: the new audio chunk (Tensor(1, samples), float32 on
+            CPU) and whether the request has ended (stop head after ``min_len`` steps, or ``max_len`` steps).
+            For a non-streaming request ``audio`` is None until it ends and then the whole utterance.
+            Finished requests are released before returning; a non-streaming badcase that has retries left
+            is prefilled again instead and not reported.
+        """
+        if not self.seqs:
+            return []
+        m = self.model
+
+        dit_hidden = m.lm_to_dit_proj(self.lm_hidden) + m.res_to_dit_proj(self.residual_hidden)  # [rows, h_dit]
+        cond = self.prefix_feat_cond.transpose(1, 2).contiguous()
+        pred_feat = torch.empty_like(self.prefix_feat_cond)  # [rows, p, d]
+        for decode, rows in self._decode_groups().items():
+            idx = torch.tensor(rows, device=dit_hidden.device)
+            cfg_value = torch.tensor(
+                [self.seqs[r].cfg_value for r in rows], device=dit_hidden.device, dtype=dit_hidden.dtype
+            ).view(-1, 1, 1)
+            pred_feat[idx] = m.feat_decoder(
+                mu=dit_hidden[idx],
+                patch_size=m.patch_size,
+                cond=cond[idx],
+                n_timesteps=decode.inference_timesteps,
+                cfg_value=cfg_value,
+                **decode.solver_options(),
+            ).transpose(1, 2)
+
+        curr_embed = m.enc_to_lm_proj(m.feat_encoder_step(pred_feat.unsqueeze(1)))[:, 0, :]  # [rows, h]
+        stop_flags = m.stop_head(m.stop_actn(m.stop_proj(self.lm_hidden))).argmax(dim=-1).tolist()
+        self.prefix_feat_cond = pred_feat
+
+        finished = []
+        for r, seq in enumerate(self.seqs):
+            seq.feats = (seq.feats[-2:] if seq.streaming else seq.feats) + [pred_feat[r]]
+            seq.steps += 1
+            # as in _inference: step i ends the request when i > min_len and the stop head fires
+            finished.append((seq.steps - 1 > seq.min_len and stop_flags[r] == 1) or seq.steps >= seq.max_len)
+        # as in _generate_with_prompt_cache: a non-streaming output this long is generated again
+        retry = [
+            r
+            for r, seq in enumerate(self.seqs)
+            if finished[r] and seq.badcase_len is not None and seq.retries > 0 and seq.steps >= seq.badcase_len
+        ]
+        audio = self._decode([finished[r] and r not in retry for r in range(len(self.seqs))])
+        results = [(seq.handle, audio[r], finished[r]) for r, seq in enumerate(self.seqs) if r not in retry]
+        retry = [self.seqs[r] for r in retry]
+
+        keep = [r for r in range(len(self.seqs)) if not finished[r]]
+        curr_embed = curr_embed[keep]
+        self._retain(keep)
+        if self.seqs:
+            with self._caches():
+                position = torch.tensor(self.base_cache.step(), device=curr_embed.device)
+                lm_hidden = m.base_lm.forward_step(curr_embed, position).clone()
+                lm_hidden = m.fsq_layer(lm_hidden)
+                position = torch.tensor(self.residual_cache.step(), device=curr_embed.device)
+                self.residual_hidden = m.residual_lm.forward_step(lm_hidden + curr_embed, position).clone()
+            self.lm_hidden = lm_hidden
+        for seq in retry:
+            print(f"  Badcase detected, audio_text_ratio={seq.steps / seq.text_length}, retrying...")
+            seq.steps, seq.feats, seq.retries = 0, [], seq.retries - 1
+            self._join(seq, *seq.inputs)
+        return results
+
+    def _decode_groups(self) -> Dict[DecodeProfile, List[int]]:
+        groups: Dict[DecodeProfile, List[int]] = {}
+        for r, seq in enumerate(self.seqs):
+            groups.setdefault(seq.decode, []).append(r)
+        return groups
+
+    def _decode(self, complete: List[bool]) -> List[torch.Tensor]:
+        """Decode each streaming row's last three patches (fewer at the start) and keep the newest step's
+        samples; decode the whole sequence of each non-streaming row whose ``complete`` flag is set."""
+        m = self.model
+        patch_len = m.patch_size * m.chunk_size
+        audio: List[torch.Tensor] = [None] * len(self.seqs)
+        by_length: Dict[int, List[int]] = {}
+        for r, seq in enumerate(self.seqs):
+            if seq.streaming:
+                by_length.setdefault(len(seq.feats), []).append(r)
+            elif complete[r]:
+                feats = rearrange(torch.stack(seq.feats).unsqueeze(0), "b t p d -> b d (t p)", p=m.patch_size)
+                wav = m.audio_vae.decode(feats.to(torch.float32)).squeeze(1).cpu()
+                audio[r] = wav[..., 640:-640]  # trimmed as in _generate_with_prompt_cache
+        for rows in by_length.values():
+            feats = torch.stack([torch.stack(self.seqs[r].feats) for r in rows])  # [n, t, p, d]
+            feats = rearrange(feats, "b t p d -> b d (t p)", p=m.patch_size)
+            wav = m.audio_vae.decode(feats.to(torch.float32))[..., -patch_len:].squeeze(1).cpu()  # [n, samples]
+            for i, r in enumerate(rows):
+                audio[r] = wav[i : i + 1]
+        return audio
+
+    def _retain(self, keep: List[int]):
+        """Keep only the given rows (ascending), moving them down so the active rows stay contiguous."""
+        if keep == list(range(len(self.seqs))):
+            return
+        for dst, src in enumerate(keep):
+            if dst != src:
+                self.base_cache.move_row(src, dst)
+                self.residual_cache.move_row(src, dst)
+        self.base_cache.active = self.residual_cache.active = len(keep)
+        self.seqs = [self.seqs[r] for r in keep]
+        if not keep:
+            self.lm_hidden = self.residual_hidden = self.prefix_feat_cond = None
+            return
+        idx = torch.tensor(keep, device=self.lm_hidden.device)
+        self.lm_hidden = self.lm_hidden[idx]
+        self.residual_hidden = self.residual_hidden[idx]
+        self.prefix_feat_cond = self.prefix_feat_cond[idx]
+
+    @contextmanager
+    def _caches(self):
+        m = self.model
+        base, residual = m.base_lm.kv_cache, m.residual_lm.kv_cache
+        m.base_lm.kv_cache, m.residual_lm.kv_cache = self.base_cache, self.residual_cache
+        try:
+            yield
+        finally:
+            m.base_lm.kv_cache, m.residual_lm.kv_cache = base, residual
@@ -0,0 +1,81 @@
+"""
+Reuse of prefill KV states across requests that start with the same text tokens.
+
+The prefill input is ``[prompt text | target text | audio start | prompt audio]``. Attention is causal,
+so the keys and values of the first ``n`` positions depend only on those positions: requests with the
+same voice share the prompt text, and announcements often share a lead-in ("Attention please, ...").
+Those positions are taken from an earlier request instead of being run through both language models
+again. The prompt audio follows the target text and therefore cannot be shared.
+"""
+
+from collections import OrderedDict
+from typing import List, Optional, Tuple
+
+import torch
+
+KVTuple = List[Tuple[torch.Tensor, torch.Tensor]]
+
+
+def _common_prefix(a, b) -> int:
+    n = 0
+    for x, y in zip(a, b):
+        if x != y:
+            break
+        n += 1
+    return n
+
+
+def _slice(kv: KVTuple, length: int, copy: bool = False) -> KVTuple:
+    if copy:
+        return [(k[:, :, :length].clone(), v[:, :, :length].clone()) for k, v in kv]
+    return [(k[:, :, :length], v[:, :, :length]) for k, v in kv]
+
+
+class PrefixKVCache:
+    """LRU of the base / residual LM keys and values of the text positions of recent prefills.
+
+    ``lookup`` returns the longest prefix any entry shares with the new request (sliced from that
+    entry), ``store`` keeps the text positions of a finished prefill. An entry that is a prefix of a
+    new one is replaced by it, since the new entry serves every prefix the old one did.
+    """
+
+    def __init__(self, max_entries: int = 16, min_tokens: int = 4):
+        self.max_entries = max_entries
+        self.min_tokens = min_tokens
+        self.entries: "OrderedDict[Tuple[int, ...], Tuple[KVTuple, KVTuple]]" = OrderedDict()
+        self.lookups = 0
+        self.hits = 0
+        self.reused_tokens = 0
+
+    def lookup(self, tokens: List[int]) -> Tuple[int, Optional[KVTuple], Optional[KVTuple]]:
+        """Returns ``(length, base_kv, residual_kv)`` of the longest shared prefix, or ``(0, None, None)``."""
+        self.lookups += 1
+        best, best_key = 0, None
+        for key in self.entries:
+            n = _common_prefix(key, tokens)
+            if n > best:
+                best, best_key = n, key
+        if best < self.min_tokens:
+            return 0, None, None
+        self.entries.move_to_end(best_key)
+        self.hits += 1
+        self.reused_tokens += best
+        base_kv, residual_kv = self.entries[best_key]
+        return best, _slice(base_kv, best), _slice(residual_kv, best)
+
+    def store(self, tokens: List[int], base_kv: KVTuple, residual_kv: KVTuple):
+        """Keep the first ``len(tokens)`` positions of a prefill's per-layer keys and values."""
+        if len(tokens) < self.min_tokens:
+            return
+        key = tuple(tokens)
+        if key in self.entries:
+            self.entries.move_to_end(key)
+            return
+        for old in [k for k in self.entries if len(k) < len(key) and key[: len(k)] == k]:
+            del self.entries[old]
+        self.entries[key] = (_slice(base_kv, len(key), copy=True), _slice(residual_kv, len(key), copy=True))
+        while len(self.entries) > self.max_entries:
+            self.entries.popitem(last=False)
+
+    def clear(self):
+        self.entries.clear()
@@ -32,9 +32,10 @@ from transformers import LlamaTokenizerFast
 
 from ..modules.audiovae import AudioVAE
 from ..modules.layers import ScalarQuantizationLayer
-from ..modules.locdit import CfmConfig, UnifiedCFM, VoxCPMLocDiT
+from ..modules.locdit import CfmConfig, DecodeProfile, UnifiedCFM, VoxCPMLocDiT, resolve_decode_profile
 from ..modules.locenc import VoxCPMLocEnc
 from ..modules.minicpm4 import MiniCPM4Config, MiniCPMModel
+from ..modules.minicpm4.model import MiniCPMLongRoPE
 from .utils import get_dtype, mask_multichar_chinese_tokens
 
 
@@ -72,6 +73,16 @@ class VoxCPMConfig(BaseModel):
     dtype: str = "bfloat16"
 
 
+def cpu_supports_bf16() -> bool:
+    """Whether the CPU has native bf16 matmul (otherwise bf16 is emulated and slower than float32)."""
+    try:
+        with open("/proc/cpuinfo") as f:
+            flags = f.read()
+    except OSError:
+        return False
+    return "avx512_bf16" in flags or "amx_bf16" in flags
+
+
 class VoxCPMModel(nn.Module):
     def __init__(
         self,
@@ -98,6 +109,7 @@ class VoxCPMModel(nn.Module):
         self.text_tokenizer = mask_multichar_chinese_tokens(tokenizer)
         self.audio_start_token = 101
         self.audio_end_token = 102
+        self.prefix_cache = None  # see enable_prefix_cache
 
         # Residual Acoustic LM
         residual_lm_config = config.lm_config.model_copy(deep=True)
@@ -175,6 +187,98 @@ class VoxCPMModel(nn.Module):
             self.feat_decoder.estimator = self.feat_decoder.estimator
         return self
 
+    def optimize_cpu(
+        self,
+        quantize: bool = True,
+        compile: bool = True,
+        dtype: str = "auto",
+        num_threads: int = 0,
+    ):
+        """CPU inference fast path (``optimize`` only handles CUDA).
+
+        Args:
+            quantize: Dynamically quantize the ``nn.Linear`` layers of both LMs, the local encoder and the
+                local DiT to int8 (weights int8, activations quantized per call). The rest of the model runs
+                in float32; the stop head, projections and the audio VAE keep full precision.
+            compile: Compile ``forward_step`` of both LMs, the local encoder and the DiT estimator with the
+                inductor CPU backend. Compilation happens on the first call; ops inductor cannot handle fall
+                back to eager.
+            dtype: ``"auto"`` keeps bfloat16 only when the CPU has native bf16 matmul (AVX512-BF16 or AMX),
+                otherwise float32; ``"bfloat16"`` / ``"float32"`` force it. Ignored when ``quantize`` is set.
+            num_threads: Intra-op threads; 0 uses every CPU this process may run on. When several worker
+                processes share a machine, give each its share of the cores.
+        """
+        if self.device != "cpu":
+            raise ValueError(f"optimize_cpu requires the CPU device, model is on {self.device}")
+
+        if num_threads <= 0:
+            num_threads = len(os.sched_getaffinity(0)) if hasattr(os, "sched_getaffinity") else os.cpu_count()
+        torch.set_num_threads(max(1, num_threads))
+        try:
+            torch.set_num_interop_threads(1)  # generation is a sequential chain of small ops
+        except RuntimeError:
+            pass  # already set, or inter-op work already started
+
+        if quantize:
+            dtype = "float32"
+        elif dtype == "auto":
+            dtype = "bfloat16" if cpu_supports_bf16() else "float32"
+        target = get_dtype(dtype)
+        if target != get_dtype(self.config.dtype):
+            self.to(target)
+            self.audio_vae.to(torch.float32)
+            # RoPE tables and KV caches were created in the load dtype; rebuild instead of casting bf16 values up
+            for module in self.modules():
+                if isinstance(module, MiniCPMLongRoPE):
+                    module.inv_freq = 1.0 / (module.base ** (torch.arange(0, module.dim, 2).float() / module.dim))
+                    module._set_cos_sin_cache(module.max_position_embeddings, module.inv_freq.device, target)
+            self.config.dtype = dtype
+            self.base_lm.setup_cache(1, self.config.max_length, self.device, target)
+            self.residual_lm.setup_cache(1, self.config.max_length, self.device, target)
+
+        if quantize:
+            from torch.ao.quantization import quantize_dynamic
+
+            for module in (self.base_lm, self.residual_lm, self.feat_encoder, self.feat_decoder.estimator):
+                quantize_dynamic(module, {nn.Linear}, dtype=torch.qint8, inplace=True)
+
+        self.feat_encoder_step = self.feat_encoder
+        if compile:
+            import torch._dynamo
+
+            torch._dynamo.config.suppress_errors = True
+            self.base_lm.forward_step = torch.compile(self.base_lm.forward_step, backend="inductor", dynamic=False)
+            self.residual_lm.forward_step = torch.compile(self.residual_lm.forward_step, backend="inductor", dynamic=False)
+            self.feat_encoder_step = torch.compile(self.feat_encoder, backend="inductor", dynamic=False)
+            self.feat_decoder.estimator = torch.compile(self.feat_decoder.estimator, backend="inductor", dynamic=False)
+
+        if self.prefix_cache is not None:
+            self.prefix_cache.clear()  # computed with the previous weights / dtype
+        print(f"CPU optimized: dtype={dtype}, int8={quantize}, compile={compile}, threads={torch.get_num_threads()}")
+        return self
+
+    def enable_prefix_cache(self, max_entries: int = 16):
+        """Reuse the prefill keys and values of text tokens shared with recent requests.
+
+        Requests with the same voice share the prompt text, announcements often share a lead-in; those
+        positions are not run through the language models again (see ``voxcpm.model.prefix_cache``).
+        ``max_entries`` <= 0 disables the cache.
+        """
+        from .prefix_cache import PrefixKVCache
+
+        self.prefix_cache = PrefixKVCache(max_entries) if max_entries > 0 else None
+        return self
+
+
+    def batched_generator(self, max_batch: int):
+        """Streaming decoder that runs up to ``max_batch`` requests in the same generation steps.
+
+        See ``voxcpm.model.batching.BatchedGenerator``. Its KV caches take ``max_batch`` times the memory of
+        the single-request caches; compiled step functions are specialized once per batch size.
+        """
+        from .batching import BatchedGenerator
+
+        return BatchedGenerator(self, max_batch)
 
     def generate(self, *args, **kwargs) -> torch.Tensor:
         return next(self._generate(*args, streaming=False, **kwargs))
@@ -192,6 +296,7 @@ class VoxCPMModel(nn.Module):
         max_len: int = 2000,
         inference_timesteps: int = 10,
         cfg_value: float = 2.0,
+        decode_profile: Union[str, DecodeProfile, None] = None,
         retry_badcase: bool = False,
         retry_badcase_max_times: int = 3,
         retry_badcase_ratio_threshold: float = 6.0, # setting acceptable ratio of audio length to text length (for badcase detection)
@@ -291,6 +396,7 @@ class VoxCPMModel(nn.Module):
                 max_len=int(target_text_length * retry_badcase_ratio_threshold + 10) if retry_badcase else max_len,
                 inference_timesteps=inference_timesteps,
                 cfg_value=cfg_value,
+                decode_profile=decode_profile,
                 streaming=streaming,
             )
             if streaming:
@@ -321,26 +427,36 @@ class VoxCPMModel(nn.Module):
     def build_prompt_cache(
         self,
         prompt_text: str,
-        prompt_wav_path: str,
+        prompt_wav_path: str = None,
+        prompt_wav: torch.Tensor = None,
+        prompt_sample_rate: int = None,
     ):
         """
         Build prompt cache for subsequent fast generation.
         
         Args:
             prompt_text: prompt text (required)
-            prompt_wav_path: prompt audio path (required)
+            prompt_wav_path: prompt audio path (required unless ``prompt_wav`` is given)
+            prompt_wav: prompt waveform (channels, samples) already in memory, e.g. a denoised prompt
+            prompt_sample_rate: sample rate of ``prompt_wav``
             
         Returns:
             prompt_cache: dict with text tokens and audio features
         """
-        if not prompt_text or not prompt_wav_path:
+        if prompt_wav is not None:
+            if not prompt_text or not prompt_sample_rate:
+                raise ValueError("prompt_text and prompt_sample_rate are required with prompt_wav")
+        elif not prompt_text or not prompt_wav_path:
             raise ValueError("prompt_text and prompt_wav_path are required")
         
         # build text tokens
         text_token = torch.LongTensor(self.text_tokenizer(prompt_text))
 
         # load audio
-        audio, sr = torchaudio.load(prompt_wav_path)
+        if prompt_wav is not None:
+            audio, sr = prompt_wav.to(torch.float32), prompt_sample_rate
+        else:
+            audio, sr = torchaudio.load(prompt_wav_path)
         if audio.size(0) > 1:
             audio = audio.mean(dim=0, keepdim=True)
             
@@ -405,6 +521,56 @@ class VoxCPMModel(nn.Module):
         
         return merged_cache
 
+    def _prepare_inputs(
+        self, target_text: str, prompt_cache: dict
+    ) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor]:
+        """
+        Build the model inputs (prompt followed by the target text) for one sequence.
+
+        Returns:
+            Tuple of text tokens, text mask, audio features and audio mask (batch size 1, on the model
+            device) and the target text tokens.
+        """
+        if prompt_cache is None:
+            prompt_text_token = torch.empty(0, dtype=torch.int32)
+            prompt_audio_feat = torch.empty((0, self.patch_size, self.audio_vae.latent_dim), dtype=torch.float32)
+        else:
+            prompt_text_token = prompt_cache["text_token"]
+            prompt_audio_feat = prompt_cache["audio_feat"]
+        # build target text tokens
+        target_text_token = torch.LongTensor(self.text_tokenizer(target_text))
+        text_token = torch.cat([prompt_text_token, target_text_token], dim=0)
+        text_token = torch.cat(
+            [
+                text_token,
+                torch.tensor(
+                    [self.audio_start_token],
+                    dtype=torch.int32,
+                    device=text_token.device,
+                ),
+            ],
+            dim=-1,
+        )
+
+        audio_length = prompt_audio_feat.size(0)
+        text_length = text_token.shape[0]
+        text_pad_token = torch.zeros(audio_length, dtype=torch.int32, device=text_token.device)
+        audio_pad_feat = torch.zeros(
+            (text_token.shape[0], self.patch_size, self.audio_vae.latent_dim),
+            dtype=torch.float32,
+            device=text_token.device,
+        )
+        text_token = torch.cat([text_token, text_pad_token])
+        audio_feat = torch.cat([audio_pad_feat, prompt_audio_feat], dim=0)
+        text_mask = torch.cat([torch.ones(text_length), torch.zeros(audio_length)]).type(torch.int32).to(text_token.device)
+        audio_mask = torch.cat([torch.zeros(text_length), torch.ones(audio_length)]).type(torch.int32).to(text_token.device)
+
+        text_token = text_token.unsqueeze(0).to(self.device)
+        text_mask = text_mask.unsqueeze(0).to(self.device)
+        audio_feat = audio_feat.unsqueeze(0).to(self.device).to(get_dtype(self.config.dtype))
+        audio_mask = audio_mask.unsqueeze(0).to(self.device)
+        return text_token, text_mask, audio_feat, audio_mask, target_text_token
+
     def generate_with_prompt_cache(self, *args, **kwargs) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor]:
         return next(self._generate_with_prompt_cache(*args, streaming=False, **kwargs))
 
@@ -422,6 +588,7 @@ class VoxCPMModel(nn.Module):
         max_len: int = 2000,
         inference_timesteps: int = 10,
         cfg_value: float = 2.0,
+        decode_profile: Union[str, DecodeProfile, None] = None,
         retry_badcase: bool = False,
         retry_badcase_max_times: int = 3,
         retry_badcase_ratio_threshold: float = 6.0,
@@ -437,6 +604,7 @@ class VoxCPMModel(nn.Module):
             max_len: Maximum audio length
             inference_timesteps: Number of diffusion sampling steps
             cfg_value: Classifier-free guidance value
+            decode_profile: Name in ``DECODE_PROFILES`` or a ``DecodeProfile``; overrides ``inference_timesteps``
             retry_badcase: Whether to retry on bad cases
             retry_badcase_max_times: Maximum retry attempts
             retry_badcase_ratio_threshold: Threshold for audio-to-text ratio
@@ -451,46 +619,8 @@ class VoxCPMModel(nn.Module):
         if retry_badcase and streaming:
             warnings.warn("Retry on bad cases is not supported in streaming mode, setting retry_badcase=False.")
             retry_badcase = False
-        # get prompt from cache
-        if prompt_cache is None:
-            prompt_text_token = torch.empty(0, dtype=torch.int32)
-            prompt_audio_feat = torch.empty((0, self.patch_size, self.audio_vae.latent_dim), dtype=torch.float32)
-        else:
-            prompt_text_token = prompt_cache["text_token"]
-            prompt_audio_feat = prompt_cache["audio_feat"]
-        # build target text tokens
-        target_text_token = torch.LongTensor(self.text_tokenizer(target_text))
-        text_token = torch.cat([prompt_text_token, target_text_token], dim=0)
-        text_token = torch.cat(
-            [
-                text_token,
-                torch.tensor(
-                    [self.audio_start_token],
-                    dtype=torch.int32,
-                    device=text_token.device,
-                ),
-            ],
-            dim=-1,
-        )
-
-        audio_length = prompt_audio_feat.size(0)
-        text_length = text_token.shape[0]
-        text_pad_token = torch.zeros(audio_length, dtype=torch.int32, device=text_token.device)
-        audio_pad_feat = torch.zeros(
-            (text_token.shape[0], self.patch_size, self.audio_vae.latent_dim),
-            dtype=torch.float32,
-            device=text_token.device,
-        )
-        text_token = torch.cat([text_token, text_pad_token])
-        audio_feat = torch.cat([audio_pad_feat, prompt_audio_feat], dim=0)
-        text_mask = torch.cat([torch.ones(text_length), torch.zeros(audio_length)]).type(torch.int32).to(text_token.device)
-        audio_mask = torch.cat([torch.zeros(text_length), torch.ones(audio_length)]).type(torch.int32).to(text_token.device)
+        text_token, text_mask, audio_feat, audio_mask, target_text_token = self._prepare_inputs(target_text, prompt_cache)
 
-        text_token = text_token.unsqueeze(0).to(self.device)
-        text_mask = text_mask.unsqueeze(0).to(self.device)
-        audio_feat = audio_feat.unsqueeze(0).to(self.device).to(get_dtype(self.config.dtype))
-        audio_mask = audio_mask.unsqueeze(0).to(self.device)
-    
         # run inference
         target_text_length = len(self.text_tokenizer(target_text))
         retry_badcase_times = 0
@@ -504,6 +634,7 @@ class VoxCPMModel(nn.Module):
                 max_len=int(target_text_length * retry_badcase_ratio_threshold + 10) if retry_badcase else max_len,
                 inference_timesteps=inference_timesteps,
                 cfg_value=cfg_value,
+                decode_profile=decode_profile,
                 streaming=streaming,
             )
             if streaming:
@@ -555,6 +686,7 @@ class VoxCPMModel(nn.Module):
         max_len: int = 2000,
         inference_timesteps: int = 10,
         cfg_value: float = 2.0,
+        decode_profile: Union[str, DecodeProfile, None] = None,
         streaming: bool = False,
     ) -> Generator[Tuple[torch.Tensor, Union[torch.Tensor, List[torch.Tensor]]], None, None]:
         """Core inference method for audio generation.
@@ -571,6 +703,7 @@ class VoxCPMModel(nn.Module):
             max_len: Maximum generation length
             inference_timesteps: Number of diffusion steps
             cfg_value: Classifier-free guidance value
+            decode_profile: Name in ``DECODE_PROFILES`` or a ``DecodeProfile``; overrides ``inference_timesteps``
             streaming: Whether to yield each step latent feature or just the final result
             
         Returns:
@@ -579,38 +712,16 @@ class VoxCPMModel(nn.Module):
                 - Predicted audio feature sequence so far as a List if ``streaming=True``, else as a concatenated Tensor
         """
         B, T, P, D = feat.shape
+        decode = resolve_decode_profile(decode_profile, inference_timesteps)
 
-        feat_embed = self.feat_encoder(feat)  # [b, t, h_feat]
-        feat_embed = self.enc_to_lm_proj(feat_embed)
-        
-        if self.config.lm_config.use_mup:
-            scale_emb = self.config.lm_config.scale_emb
-        else:
-            scale_emb = 1.0
-       
-        text_embed = self.base_lm.embed_tokens(text) * scale_emb
-        combined_embed = text_mask.unsqueeze(-1) * text_embed + feat_mask.unsqueeze(-1) * feat_embed
-
-        prefix_feat_cond = feat[:, -1, ...]  # b, p, d
-        pred_feat_seq = []  # b, t, p, d
-        curr_embed = None
-
-        enc_outputs, kv_cache_tuple = self.base_lm(
-            inputs_embeds=combined_embed,
-            is_causal=True,
+        lm_hidden, residual_hidden, prefix_feat_cond, kv_cache_tuple, residual_kv_cache_tuple = self._prefill(
+            text, text_mask, feat, feat_mask
         )
         self.base_lm.kv_cache.fill_caches(kv_cache_tuple)
-        
-        enc_outputs = self.fsq_layer(enc_outputs) * feat_mask.unsqueeze(-1) + enc_outputs * text_mask.unsqueeze(-1)
-        lm_hidden = enc_outputs[:, -1, :]
-
-         
-        residual_enc_outputs, residual_kv_cache_tuple = self.residual_lm(
-            inputs_embeds=enc_outputs + feat_mask.unsqueeze(-1) * feat_embed,
-            is_causal=True,
-        )
         self.residual_lm.kv_cache.fill_caches(residual_kv_cache_tuple)
-        residual_hidden = residual_enc_outputs[:, -1, :]
+
+        pred_feat_seq = []  # b, t, p, d
+        curr_embed = None
 
 
         for i in tqdm(range(max_len)):
@@ -622,8 +733,9 @@ class VoxCPMModel(nn.Module):
                 mu=dit_hidden,
                 patch_size=self.patch_size,
                 cond=prefix_feat_cond.transpose(1, 2).contiguous(),
-                n_timesteps=inference_timesteps,
+                n_timesteps=decode.inference_timesteps,
                 cfg_value=cfg_value,
+                **decode.solver_options(),
             ).transpose(
                 1, 2
             )  # [b, p, d]
@@ -660,6 +772,60 @@ class VoxCPMModel(nn.Module):
             feat_pred = rearrange(pred_feat_seq, "b t p d -> b d (t p)", b=B, p=self.patch_size)
             yield feat_pred, pred_feat_seq.squeeze(0).cpu()
 
+    def _prefill(
+        self,
+        text: torch.Tensor,
+        text_mask: torch.Tensor,
+        feat: torch.Tensor,
+        feat_mask: torch.Tensor,
+    ):
+        """Run both language models over the whole input.
+
+        Returns:
+            Tuple of the last base / residual LM hidden states, the last input feature (the first
+            diffusion condition) and the per-layer KV tuples of both models for their caches.
+        """
+        prefix_cache = self.prefix_cache if text.size(0) == 1 else None
+        base_past = residual_past = None
+        if prefix_cache is not None:
+            # text positions before the audio start token; only these can be shared between requests
+            tokens = text[0, : int(text_mask[0].sum().item()) - 1].tolist()
+            prefix_len, base_past, residual_past = prefix_cache.lookup(tokens)
+            text, text_mask, feat, feat_mask = (x[:, prefix_len:] for x in (text, text_mask, feat, feat_mask))
+
+        feat_embed = self.feat_encoder(feat)  # [b, t, h_feat]
+        feat_embed = self.enc_to_lm_proj(feat_embed)
+        
+        if self.config.lm_config.use_mup:
+            scale_emb = self.config.lm_config.scale_emb
+        else:
+            scale_emb = 1.0
+       
+        text_embed = self.base_lm.embed_tokens(text) * scale_emb
+        combined_embed = text_mask.unsqueeze(-1) * text_embed + feat_mask.unsqueeze(-1) * feat_embed
+
+        prefix_feat_cond = feat[:, -1, ...]  # b, p, d
+
+        enc_outputs, kv_cache_tuple = self.base_lm(
+            inputs_embeds=combined_embed,
+            is_causal=True,
+            past_key_values=base_past,
+        )
+        
+        enc_outputs = self.fsq_layer(enc_outputs) * feat_mask.unsqueeze(-1) + enc_outputs * text_mask.unsqueeze(-1)
+        lm_hidden = enc_outputs[:, -1, :]
+
+         
+        residual_enc_outputs, residual_kv_cache_tuple = self.residual_lm(
+            inputs_embeds=enc_outputs + feat_mask.unsqueeze(-1) * feat_embed,
+            is_causal=True,
+            past_key_values=residual_past,
+        )
+        residual_hidden = residual_enc_outputs[:, -1, :]
+        if prefix_cache is not None:
+            prefix_cache.store(tokens, kv_cache_tuple, residual_kv_cache_tuple)
+        return lm_hidden, residual_hidden, prefix_feat_cond, kv_cache_tuple, residual_kv_cache_tuple
+
     @classmethod
     def from_local(cls, path: str, optimize: bool = True):
         config = VoxCPMConfig.model_validate_json(open(os.path.join(path, "config.json")).read())
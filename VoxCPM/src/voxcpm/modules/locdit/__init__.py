@@ -1,2 +1,2 @@
-from .unified_cfm import UnifiedCFM, CfmConfig
+from .unified_cfm import UnifiedCFM, CfmConfig, DecodeProfile, DECODE_PROFILES, resolve_decode_profile
 from .local_dit import VoxCPMLocDiT
@@ -1,8 +1,8 @@
 import torch
-from typing import List
+from typing import List, Optional, Union
 from .local_dit import VoxCPMLocDiT
 import math
-from pydantic import BaseModel
+from pydantic import BaseModel, ConfigDict
 
 
 class CfmConfig(BaseModel):
@@ -11,6 +11,50 @@ class CfmConfig(BaseModel):
     t_scheduler: str = "log-norm"
 
 
+class DecodeProfile(BaseModel):
+    """Flow-matching decode settings of a request: trades output quality for local DiT latency.
+
+    Attributes:
+        inference_timesteps: ODE steps per patch.
+        solver: ``"euler"`` (one estimator call per step) or ``"heun"`` (second order, two calls per
+            step; the last step is Euler).
+        cfg_refresh: Run the unconditional branch of classifier-free guidance on every ``cfg_refresh``-th
+            guided call and reuse its velocity in between, halving the estimator batch on the other calls.
+            1 runs it on every call; 0 only on the first guided call of a patch.
+        adaptive_tol: When > 0, stop refining a patch once the guided velocity changes by less than this
+            fraction between two steps and cover the remaining time with the last velocity.
+    """
+
+    model_config = ConfigDict(frozen=True)
+
+    inference_timesteps: int = 10
+    solver: str = "euler"
+    cfg_refresh: int = 1
+    adaptive_tol: float = 0.0
+
+    def solver_options(self) -> dict:
+        return dict(solver=self.solver, cfg_refresh=self.cfg_refresh, adaptive_tol=self.adaptive_tol)
+
+
+# "quality" is the original decoding (10 Euler steps, guidance on every step)
+DECODE_PROFILES = {
+    "quality": DecodeProfile(),
+    "balanced": DecodeProfile(inference_timesteps=6, cfg_refresh=2),
+    "fast": DecodeProfile(inference_timesteps=4, cfg_refresh=0, adaptive_tol=0.05),
+}
+
+
+def resolve_decode_profile(profile: Union[str, DecodeProfile, None], inference_timesteps: int = 10) -> DecodeProfile:
+    """``None`` keeps the original decoding with ``inference_timesteps`` steps; names refer to ``DECODE_PROFILES``."""
+    if profile is None or profile == "":
+        return DecodeProfile(inference_timesteps=inference_timesteps)
+    if isinstance(profile, DecodeProfile):
+        return profile
+    if profile not in DECODE_PROFILES:
+        raise ValueError(f"unknown decode profile {profile!r} (one of {', '.join(DECODE_PROFILES)})")
+    return DECODE_PROFILES[profile]
+
+
 class UnifiedCFM(torch.nn.Module):
     def __init__(
         self,
@@ -40,6 +84,9 @@ class UnifiedCFM(torch.nn.Module):
         cfg_value: float = 1.0,
         sway_sampling_coef: float = 1.0, 
         use_cfg_zero_star: bool = True,
+        solver: str = "euler",
+        cfg_refresh: int = 1,
+        adaptive_tol: float = 0.0,
     ):
         """Forward diffusion
 
@@ -49,6 +96,7 @@ class UnifiedCFM(torch.nn.Module):
             n_timesteps (int): number of diffusion steps
             cond: Not used but kept for future purposes
             temperature (float, optional): temperature for scaling noise. Defaults to 1.0.
+            solver, cfg_refresh, adaptive_tol: see ``DecodeProfile``; the defaults are the original decoding.
 
         Returns:
             sample: generated mel-spectrogram
@@ -62,7 +110,10 @@ class UnifiedCFM(torch.nn.Module):
         # Sway sampling strategy
         t_span = t_span + sway_sampling_coef * (torch.cos(torch.pi / 2 * t_span) - 1 + t_span)
 
-        return self.solve_euler(z, t_span=t_span, mu=mu, cond=cond, cfg_value=cfg_value, use_cfg_zero_star=use_cfg_zero_star)
+        return self.solve_euler(
+            z, t_span=t_span, mu=mu, cond=cond, cfg_value=cfg_value, use_cfg_zero_star=use_cfg_zero_star,
+            solver=solver, cfg_refresh=cfg_refresh, adaptive_tol=adaptive_tol,
+        )
 
     def optimized_scale(self, positive_flat, negative_flat):
         dot_product = torch.sum(positive_flat * negative_flat, dim=1, keepdim=True)
@@ -71,6 +122,29 @@ class UnifiedCFM(torch.nn.Module):
         st_star = dot_product / squared_norm
         return st_star
 
+    def estimate(self, x, t, dt, mu, cond, uncond: bool):
+        """Estimator velocities of the conditional rows, followed by the unconditional rows (``mu`` = 0) if ``uncond``."""
+        b = x.size(0)
+        n = 2 * b if uncond else b
+        x_in = torch.zeros([n, self.in_channels, x.size(2)], device=x.device, dtype=x.dtype)
+        mu_in = torch.zeros([n, mu.size(1)], device=x.device, dtype=x.dtype)
+        t_in = torch.zeros([n], device=x.device, dtype=x.dtype)
+        dt_in = torch.zeros([n], device=x.device, dtype=x.dtype)
+        cond_in = torch.zeros([n, self.in_channels, x.size(2)], device=x.device, dtype=x.dtype)
+        x_in[:b], x_in[b:] = x, x
+        mu_in[:b] = mu
+        t_in[:b], t_in[b:] = t.unsqueeze(0), t.unsqueeze(0)
+        dt_in[:b], dt_in[b:] = dt.unsqueeze(0), dt.unsqueeze(0)
+        # not used now
+        if not self.mean_mode:
+            dt_in = torch.zeros_like(dt_in)
+        cond_in[:b], cond_in[b:] = cond, cond
+
+        dphi_dt = self.estimator(x_in, mu_in, t_in, cond_in, dt_in)
+        if not uncond:
+            return dphi_dt, None
+        return torch.split(dphi_dt, [b, b], dim=0)
+
     def solve_euler(
         self,
         x: torch.Tensor,
@@ -79,9 +153,12 @@ class UnifiedCFM(torch.nn.Module):
         cond: torch.Tensor,
         cfg_value: float = 1.0,
         use_cfg_zero_star: bool = True,
+        solver: str = "euler",
+        cfg_refresh: int = 1,
+        adaptive_tol: float = 0.0,
     ):
         """
-        Fixed euler solver for ODEs.
+        Fixed-grid ODE solver (Euler, or Heun with ``solver="heun"``).
         Args:
             x (torch.Tensor): random noise
             t_span (torch.Tensor): n_timesteps interpolated
@@ -90,43 +167,56 @@ class UnifiedCFM(torch.nn.Module):
                 shape: (batch_size, n_feats)
             cond: condition -- prefix prompt
             cfg_value (float, optional): cfg value for guidance. Defaults to 1.0.
+            solver, cfg_refresh, adaptive_tol: see ``DecodeProfile``.
         """
+        if solver not in ("euler", "heun"):
+            raise ValueError(f"unknown solver {solver!r}")
         t, _, dt = t_span[0], t_span[-1], t_span[0] - t_span[1]
+        b = x.size(0)
+        # guidance 1 reduces to the conditional velocity: skip the unconditional branch
+        cfg_free = bool((cfg_value == 1).all()) if torch.is_tensor(cfg_value) else cfg_value == 1
+        calls = 0
+        uncond_v = None
+
+        def velocity(x, t, dt):
+            # Classifier-Free Guidance inference introduced in VoiceBox
+            nonlocal calls, uncond_v
+            refresh = uncond_v is None or (cfg_refresh > 0 and calls % cfg_refresh == 0)
+            calls += 1
+            dphi_dt, cfg_dphi_dt = self.estimate(x, t, dt, mu, cond, uncond=refresh and not cfg_free)
+            if cfg_free:
+                return dphi_dt
+            if refresh:
+                uncond_v = cfg_dphi_dt
+            cfg_dphi_dt = uncond_v
+
+            if use_cfg_zero_star:
+                positive_flat = dphi_dt.view(b, -1)
+                negative_flat = cfg_dphi_dt.view(b, -1)
+                st_star = self.optimized_scale(positive_flat, negative_flat)
+                st_star = st_star.view(b, *([1] * (len(dphi_dt.shape) - 1)))
+            else:
+                st_star = 1.0
+
+            return cfg_dphi_dt * st_star + cfg_value * (dphi_dt - cfg_dphi_dt * st_star)
 
         sol = []
+        prev = None
         zero_init_steps = max(1, int(len(t_span) * 0.04))
         for step in range(1, len(t_span)):
             if use_cfg_zero_star and step <= zero_init_steps:
                 dphi_dt = 0.
             else:
-                # Classifier-Free Guidance inference introduced in VoiceBox
-                b = x.size(0)
-                x_in = torch.zeros([2 * b, self.in_channels, x.size(2)], device=x.device, dtype=x.dtype)
-                mu_in = torch.zeros([2 * b, mu.size(1)], device=x.device, dtype=x.dtype)
-                t_in = torch.zeros([2 * b], device=x.device, dtype=x.dtype)
-                dt_in = torch.zeros([2 * b], device=x.device, dtype=x.dtype)
-                cond_in = torch.zeros([2 * b, self.in_channels, x.size(2)], device=x.device, dtype=x.dtype)
-                x_in[:b], x_in[b:] = x, x
-                mu_in[:b] = mu
-                t_in[:b], t_in[b:] = t.unsqueeze(0), t.unsqueeze(0)
-                dt_in[:b], dt_in[b:] = dt.unsqueeze(0), dt.unsqueeze(0)
-                # not used now
-                if not self.mean_mode:
-                    dt_in = torch.zeros_like(dt_in)
-                cond_in[:b], cond_in[b:] = cond, cond
-
-                dphi_dt = self.estimator(x_in, mu_in, t_in, cond_in, dt_in)
-                dphi_dt, cfg_dphi_dt = torch.split(dphi_dt, [x.size(0), x.size(0)], dim=0)
-                
-                if use_cfg_zero_star:
-                    positive_flat = dphi_dt.view(b, -1)
-                    negative_flat = cfg_dphi_dt.view(b, -1)
-                    st_star = self.optimized_scale(positive_flat, negative_flat)
-                    st_star = st_star.view(b, *([1] * (len(dphi_dt.shape) - 1)))
-                else:
-                    st_star = 1.0
-                
-                dphi_dt = cfg_dphi_dt * st_star + cfg_value * (dphi_dt - cfg_dphi_dt * st_star)
+                dphi_dt = velocity(x, t, dt)
+                if adaptive_tol > 0 and prev is not None:
+                    change = (dphi_dt - prev).flatten(1).norm(dim=1) / prev.flatten(1).norm(dim=1).clamp(min=1e-8)
+                    if change.max().item() < adaptive_tol:
+                        # trajectory is straight enough: cover the remaining time in one step
+                        sol.append(x - (t - t_span[-1]) * dphi_dt)
+                        break
+                prev = dphi_dt
+                if solver == "heun" and step < len(t_span) - 1:
+                    dphi_dt = 0.5 * (dphi_dt + velocity(x - dt * dphi_dt, t - dt, t_span[step] - t_span[step + 1]))
 
             x = x - dt * dphi_dt
             t = t - dt
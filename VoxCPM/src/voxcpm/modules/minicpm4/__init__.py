@@ -1,3 +1,3 @@
 from .config import MiniCPM4Config
 from .model import MiniCPMModel
-from .cache import StaticKVCache
+from .cache import BatchedKVCache, StaticKVCache
@@ -40,8 +40,47 @@ class StaticKVCache:
         return ret
 
     def fill_caches(self, kv_caches: List[Tuple[torch.Tensor, torch.Tensor]]):
+        # no need to clear the rest of the buffer: forward_step masks every position past the one it writes
         self.current_length = kv_caches[0][0].size(2)
-        self.kv_cache.zero_()
         for i in range(self.num_layers):
             self.kv_cache[0, i, :, :, : self.current_length, :] = kv_caches[i][0]
             self.kv_cache[1, i, :, :, : self.current_length, :] = kv_caches[i][1]
+
+
+class BatchedKVCache(StaticKVCache):
+    """Static KV cache whose rows hold independent sequences of different lengths.
+
+    Rows ``[0, active)`` are in use and row ``r`` holds ``lengths[r]`` positions. Sequences join
+    with ``fill_row`` and leave with ``move_row`` (the last row is moved into the freed one), so the
+    active rows stay contiguous and ``get_layer_cache`` can hand out a plain slice. Slots past a
+    row's length are never cleared; ``MiniCPMAttention.forward_step`` masks them per row.
+    """
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.lengths = [0] * self.kv_cache.size(2)
+        self.active = 0
+
+    def get_layer_cache(self, layer_idx: int) -> Tuple[torch.Tensor, torch.Tensor]:
+        return self.kv_cache[0, layer_idx, : self.active], self.kv_cache[1, layer_idx, : self.active]
+
+    def step(self) -> List[int]:
+        """Reserve the next position of every active row and return them in row order."""
+        positions = self.lengths[: self.active]
+        if max(positions, default=0) >= self.max_length:
+            raise ValueError("KV cache is full")
+        self.lengths[: self.active] = [p + 1 for p in positions]
+        return positions
+
+    def fill_row(self, row: int, kv_caches: List[Tuple[torch.Tensor, torch.Tensor]]):
+        """Copy a single-sequence prefill (batch size 1) into ``row``."""
+        length = kv_caches[0][0].size(2)
+        for i in range(self.num_layers):
+            self.kv_cache[0, i, row, :, :length, :] = kv_caches[i][0][0]
+            self.kv_cache[1, i, row, :, :length, :] = kv_caches[i][1][0]
+        self.lengths[row] = length
+
+    def move_row(self, src: int, dst: int):
+        length = self.lengths[src]
+        self.kv_cache[:, :, dst, :, :length, :] = self.kv_cache[:, :, src, :, :length, :]
+        self.lengths[dst] = length
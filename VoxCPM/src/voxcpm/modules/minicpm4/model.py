@@ -1,9 +1,9 @@
 from .config import MiniCPM4Config
 import torch
 import torch.nn as nn
-from typing import List, Tuple
+from typing import List, Optional, Tuple
 import math
-from .cache import StaticKVCache
+from .cache import BatchedKVCache, StaticKVCache
 
 
 def rms_layernorm(hidden: torch.Tensor, weight: torch.Tensor, eps: float):
@@ -139,6 +139,7 @@ class MiniCPMAttention(nn.Module):
         hidden_states: torch.Tensor,
         position_emb: Tuple[torch.Tensor, torch.Tensor],
         is_causal: bool,
+        past_key_value: Optional[Tuple[torch.Tensor, torch.Tensor]] = None,
     ) -> Tuple[torch.Tensor, Tuple[torch.Tensor, torch.Tensor]]:
         bsz, q_len, _ = hidden_states.size()
 
@@ -153,6 +154,18 @@ class MiniCPMAttention(nn.Module):
         cos, sin = position_emb
 
         query_states, key_states = apply_rotary_pos_emb(query_states, key_states, cos, sin)
+
+        attn_mask = None
+        if past_key_value is not None:
+            # continue after a cached prefix; SDPA's is_causal aligns the mask top-left, so offset it explicitly
+            past_len = past_key_value[0].size(2)
+            key_states = torch.cat([past_key_value[0], key_states], dim=2)
+            value_states = torch.cat([past_key_value[1], value_states], dim=2)
+            if is_causal:
+                kv_pos = torch.arange(key_states.size(2), device=key_states.device)
+                q_pos = torch.arange(past_len, past_len + q_len, device=key_states.device)
+                attn_mask = kv_pos[None, :] <= q_pos[:, None]
+                is_causal = False
         
         # ref: https://github.com/pytorch/pytorch/issues/163597
         # there is a bug in MPS for non-contiguous tensors, so we need to make them contiguous
@@ -163,6 +176,7 @@ class MiniCPMAttention(nn.Module):
             query_states,
             key_states,
             value_states,
+            attn_mask=attn_mask,
             is_causal=is_causal,
             enable_gqa=True,
         )
@@ -179,9 +193,15 @@ class MiniCPMAttention(nn.Module):
         self,
         hidden_states: torch.Tensor,
         position_emb: Tuple[torch.Tensor, torch.Tensor],
-        position_id: int,
+        position_id: torch.Tensor,
         kv_cache: Tuple[torch.Tensor, torch.Tensor],
     ) -> torch.Tensor:
+        """
+        Args:
+            hidden_states: Tensor(batch_size, hidden_size)
+            position_id: Tensor(1) shared by all rows, or Tensor(batch_size) with one position per row
+                (independent sequences decoded together, see voxcpm.model.batching)
+        """
         bsz, _ = hidden_states.size()
 
         query_states = self.q_proj(hidden_states)
@@ -193,15 +213,22 @@ class MiniCPMAttention(nn.Module):
         value_states = value_states.view(bsz, 1, self.num_key_value_heads, self.head_dim).transpose(1, 2)
 
         cos, sin = position_emb
+        # (1 | batch_size, 1, 1, head_dim): one rotation per row
+        cos = cos.view(-1, 1, 1, self.head_dim)
+        sin = sin.view(-1, 1, 1, self.head_dim)
 
         query_states, key_states = apply_rotary_pos_emb(query_states, key_states, cos, sin)
 
         key_cache, value_cache = kv_cache
 
-        key_cache[:, :, position_id, :] = key_states
-        value_cache[:, :, position_id, :] = value_states
+        position_id = position_id.expand(bsz)
+        rows = torch.arange(bsz, device=key_cache.device)
+        key_cache[rows, :, position_id, :] = key_states[:, :, 0, :]
+        value_cache[rows, :, position_id, :] = value_states[:, :, 0, :]
 
-        attn_mask = torch.arange(key_cache.size(2), device=key_cache.device) <= position_id
+        # each row attends to its own prefix; slots past it may hold another sequence's stale entries
+        attn_mask = torch.arange(key_cache.size(2), device=key_cache.device)[None, :] <= position_id[:, None]
+        attn_mask = attn_mask.view(bsz, 1, 1, -1)
 
         # ref: https://github.com/pytorch/pytorch/issues/163597
         # there is a bug in MPS for non-contiguous tensors, so we need to make them contiguous
@@ -257,12 +284,14 @@ class MiniCPMDecoderLayer(nn.Module):
         hidden_states: torch.Tensor,
         position_emb: Tuple[torch.Tensor, torch.Tensor],
         is_causal: bool,
+        past_key_value: Optional[Tuple[torch.Tensor, torch.Tensor]] = None,
     ) -> Tuple[torch.Tensor, Tuple[torch.Tensor, torch.Tensor]]:
         """
         Args:
             hidden_states (`torch.FloatTensor`): input to the layer of shape `(batch, seq_len, embed_dim)`
             position_ids (`torch.LongTensor`): position ids of shape `(batch_size, seq_len)`
             is_causal (`bool`): whether the attention mask is causal
+            past_key_value: keys and values of the positions before `hidden_states`, returned concatenated
         """
         residual = hidden_states
         hidden_states = self.input_layernorm(hidden_states)
@@ -271,6 +300,7 @@ class MiniCPMDecoderLayer(nn.Module):
             hidden_states=hidden_states,
             position_emb=position_emb,
             is_causal=is_causal,
+            past_key_value=past_key_value,
         )
 
         if self.use_mup:
@@ -356,27 +386,32 @@ class MiniCPMModel(nn.Module):
         self,
         inputs_embeds: torch.Tensor,
         is_causal: bool = True,
+        past_key_values: Optional[List[Tuple[torch.Tensor, torch.Tensor]]] = None,
     ) -> Tuple[torch.Tensor, List[Tuple[torch.Tensor, torch.Tensor]]]:
         """
         Args:
             inputs_embeds: Tensor(batch_size, seq_length, hidden_size)
             is_causal: bool, whether the attention mask is causal
+            past_key_values: per-layer keys and values of an already computed prefix; `inputs_embeds` then
+                starts at position `past_length` and only those positions are computed
         Returns:
             hidden_states: Tensor(batch_size, seq_length, hidden_size)
-            next_decoder_cache: List[(batch_size, num_heads, seq_length, head_dim), (batch_size, num_heads, seq_length, head_dim)]
+            next_decoder_cache: List[(batch_size, num_heads, past_length + seq_length, head_dim), (batch_size, num_heads, past_length + seq_length, head_dim)]
         """
-        position_ids = torch.arange(0, inputs_embeds.size(1), dtype=torch.long, device=inputs_embeds.device)
+        past_length = 0 if past_key_values is None else past_key_values[0][0].size(2)
+        position_ids = torch.arange(past_length, past_length + inputs_embeds.size(1), dtype=torch.long, device=inputs_embeds.device)
         position_emb = self.rope_emb(position_ids)
         hidden_states = inputs_embeds
 
         next_decoder_cache = []
 
-        for decoder_layer in self.layers:
+        for i, decoder_layer in enumerate(self.layers):
 
             hidden_states, this_cache = decoder_layer(
                 hidden_states,
                 position_emb,
                 is_causal,
+                None if past_key_values is None else past_key_values[i],
             )
             next_decoder_cache.append(this_cache)
         hidden_states = self.norm(hidden_states)
@@ -390,6 +425,7 @@ class MiniCPMModel(nn.Module):
         """
         Args:
             inputs_embeds: Tensor(batch_size, hidden_size)
+            position_id: Tensor(1), or Tensor(batch_size) when the rows are independent sequences
         Returns:
             hidden_states: Tensor(batch_size, hidden_size)
         """
@@ -419,3 +455,15 @@ class MiniCPMModel(nn.Module):
             dtype=dtype,
             max_length=max_length,
         )
+
+    def batched_cache(self, max_batch: int, max_length: int, device, dtype: torch.dtype) -> BatchedKVCache:
+        """A cache for up to ``max_batch`` independent sequences; swap it into ``kv_cache`` around forward_step."""
+        return BatchedKVCache(
+            num_layers=self.config.num_hidden_layers,
+            num_kv_heads=self.config.num_key_value_heads,
+            dim_kv_head=self.config.hidden_size // self.config.num_attention_heads if self.config.kv_channels is None else self.config.kv_channels,
+            batch_size=max_batch,
+            device=device,
+            dtype=dtype,
+            max_length=max_length,
+        )
@@ -1,5 +1,7 @@
 # some functions are copied from https://github.com/FunAudioLLM/CosyVoice/blob/main/cosyvoice/utils/frontend_utils.py
 import re
+import threading
+from collections import OrderedDict
 import regex
 import inflect
 from functools import partial
@@ -7,6 +9,39 @@ from wetext import Normalizer
 
 chinese_char_pattern = re.compile(r'[\u4e00-\u9fff]+')
 
+
+class LRUCache:
+    """Thread-safe bounded mapping that evicts the least recently used entry; ``maxsize`` 0 disables it."""
+
+    def __init__(self, maxsize=1024):
+        self.maxsize = maxsize
+        self.entries = OrderedDict()
+        self.lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+
+    def get(self, key):
+        with self.lock:
+            value = self.entries.get(key)
+            if value is None:
+                self.misses += 1
+                return None
+            self.entries.move_to_end(key)
+            self.hits += 1
+            return value
+
+    def put(self, key, value):
+        if self.maxsize <= 0:
+            return
+        with self.lock:
+            self.entries[key] = value
+            self.entries.move_to_end(key)
+            while len(self.entries) > self.maxsize:
+                self.entries.popitem(last=False)
+
+    def __len__(self):
+        return len(self.entries)
+
 # whether contain chinese character
 def contains_chinese(text):
     return bool(chinese_char_pattern.search(text))
@@ -31,31 +66,103 @@ def remove_bracket(text):
     return text
 
 
-# spell Arabic numerals
-def spell_out_number(text: str, inflect_parser):
-    new_text = []
-    st = None
-    for i, c in enumerate(text):
-        if not c.isdigit():
-            if st is not None:
-                num_str = inflect_parser.number_to_words(text[st: i])
-                new_text.append(num_str)
-                st = None
-            new_text.append(c)
-        else:
-            if st is None:
-                st = i
-    if st is not None and st < len(text):
-        num_str = inflect_parser.number_to_words(text[st:])
-        new_text.append(num_str)
-    return ''.join(new_text)
+_digits_pattern = re.compile(r'\d+')
+
+
+# spell Arabic numerals; ``number_to_words`` may be a cached wrapper of ``inflect_parser.number_to_words``
+def spell_out_number(text: str, inflect_parser, number_to_words=None):
+    number_to_words = number_to_words or inflect_parser.number_to_words
+    return _digits_pattern.sub(lambda m: number_to_words(m.group()), text)
+
+
+# Ward announcements are dominated by two number patterns, spelled here directly instead of by the
+# general normalizers: temperatures ("38.5℃", "37度", "38.5°C") and bed numbers ("12号床", "bed 12").
+_zh_digits = "零一二三四五六七八九"
+_zh_units = ["", "十", "百", "千"]
+
+
+def zh_integer(digits: str) -> str:
+    """Chinese reading of a non-negative integer below 10000 ("105" -> "一百零五", "12" -> "十二")."""
+    n = int(digits)
+    if n == 0:
+        return "零"
+    out = []
+    s = str(n)
+    zero = False
+    for i, d in enumerate(s):
+        unit = len(s) - 1 - i
+        if d == "0":
+            zero = True
+            continue
+        if zero:
+            out.append("零")
+            zero = False
+        out.append(_zh_digits[int(d)] + _zh_units[unit])
+    text = "".join(out)
+    return text[1:] if text.startswith("一十") else text
 
 
+def zh_decimal(number: str) -> str:
+    whole, _, frac = number.partition(".")
+    text = zh_integer(whole)
+    return text + "点" + "".join(_zh_digits[int(d)] for d in frac) if frac else text
+
+
+# A leading minus is the sign of the temperature unless it follows a digit or letter ("36-38度" is a range and "A-18"
+# an identifier; both are left to WeText as a whole). No number right after a minus, range or tilde is taken alone.
+_temperature_sign = r'(?:(?<![0-9A-Za-z.])([-−])|(?<![\d.\-−~～]))'
+_zh_temperature_pattern = re.compile(_temperature_sign + r'(\d{1,3}(?:\.\d{1,2})?)\s*(℃|°[Cc]|摄氏度|度)')
+_zh_bed_pattern = re.compile(r'(?<![\d.])([1-9]\d{0,3})\s*(号床|号病床|床)')
+_en_temperature_pattern = re.compile(_temperature_sign + r'(\d{1,3})(?:\.(\d{1,2}))?\s*(℃|°[Cc]|degrees? Celsius)')
+_en_bed_pattern = re.compile(r'\b([Bb]ed)\s+(?:[Nn]o\.?\s*)?([1-9]\d{0,3})\b')
+
+
+def _zh_temperature(m):
+    unit = m.group(3)
+    return ("零下" if m.group(1) else "") + zh_decimal(m.group(2)) + ("度" if unit == "度" else "摄氏度")
+
+
+def spell_out_ward_numbers(text: str, lang: str, number_to_words) -> str:
+    if not _digits_pattern.search(text):
+        return text
+    if lang == "zh":
+        text = _zh_temperature_pattern.sub(_zh_temperature, text)
+        return _zh_bed_pattern.sub(lambda m: zh_integer(m.group(1)) + m.group(2), text)
+
+    def temperature(m):
+        words = number_to_words(m.group(2))
+        if m.group(3):
+            words += " point " + " ".join(number_to_words(d) for d in m.group(3))
+        return ("minus " if m.group(1) else "") + words + " degrees Celsius"
+
+    text = _en_temperature_pattern.sub(temperature, text)
+    return _en_bed_pattern.sub(lambda m: m.group(1) + " " + number_to_words(m.group(2)), text)
+
+
+_split_punctuation = {
+    (True, False): frozenset('。？！；：、.?!;'),
+    (True, True): frozenset('。？！；：、.?!;，,'),
+    (False, False): frozenset('.?!;:'),
+    (False, True): frozenset('.?!;:，,'),
+}
+# sentence splits keyed on the text, the language, the splitting parameters and the tokenizer
+_split_cache = LRUCache(1024)
+
 # split paragrah logic：
 # 1. per sentence max len token_max_n, min len token_min_n, merge if last sentence len less than merge_len
 # 2. cal sentence len according to lang
 # 3. split sentence according to puncatation
 def split_paragraph(text: str, tokenize, lang="zh", token_max_n=80, token_min_n=60, merge_len=20, comma_split=False):
+    key = (lang, text, token_max_n, token_min_n, merge_len, comma_split, None if lang == "zh" else tokenize)
+    cached = _split_cache.get(key)
+    if cached is not None:
+        return list(cached)
+    final_utts = _split_paragraph(text, tokenize, lang, token_max_n, token_min_n, merge_len, comma_split)
+    _split_cache.put(key, tuple(final_utts))
+    return final_utts
+
+
+def _split_paragraph(text, tokenize, lang, token_max_n, token_min_n, merge_len, comma_split):
     def calc_utt_length(_text: str):
         if lang == "zh":
             return len(_text)
@@ -68,12 +175,7 @@ def split_paragraph(text: str, tokenize, lang="zh", token_max_n=80, token_min_n=
         else:
             return len(tokenize(_text)) < merge_len
 
-    if lang == "zh":
-        pounc = ['。', '？', '！', '；', '：', '、', '.', '?', '!', ';']
-    else:
-        pounc = ['.', '?', '!', ';', ':']
-    if comma_split:
-        pounc.extend(['，', ','])
+    pounc = _split_punctuation[lang == "zh", comma_split]
     st = 0
     utts = []
     for i, c in enumerate(text):
@@ -107,79 +209,105 @@ def split_paragraph(text: str, tokenize, lang="zh", token_max_n=80, token_min_n=
     return final_utts
 
 
+# a space is kept only between two non-space ASCII characters
+_blank_pattern = re.compile(r' (?![\x00-\x1f\x21-\x7f])|(?<![\x00-\x1f\x21-\x7f]) ')
+
+
 # remove blank between chinese character
 def replace_blank(text: str):
-    out_str = []
-    for i, c in enumerate(text):
-        if c == " ":
-            if ((text[i + 1].isascii() and text[i + 1] != " ") and
-                    (text[i - 1].isascii() and text[i - 1] != " ")):
-                out_str.append(c)
-        else:
-            out_str.append(c)
-    return "".join(out_str)
+    return _blank_pattern.sub("", text)
 
-def clean_markdown(md_text: str) -> str:
-    # 去除代码块 ``` ```（包括多行）
-    md_text = re.sub(r"```.*?```", "", md_text, flags=re.DOTALL)
 
+_markdown_rules = [
+    # 去除代码块 ``` ```（包括多行）
+    (re.compile(r"```.*?```", flags=re.DOTALL), ""),
     # 去除内联代码 `code`
-    md_text = re.sub(r"`[^`]*`", "", md_text)
-
+    (re.compile(r"`[^`]*`"), ""),
     # 去除图片语法 ![alt](url)
-    md_text = re.sub(r"!\[[^\]]*\]\([^\)]+\)", "", md_text)
-
+    (re.compile(r"!\[[^\]]*\]\([^\)]+\)"), ""),
     # 去除链接但保留文本 [text](url) -> text
-    md_text = re.sub(r"\[([^\]]+)\]\([^)]+\)", r"\1", md_text)
-    
+    (re.compile(r"\[([^\]]+)\]\([^)]+\)"), r"\1"),
     # 替换无序列表符号
-    md_text = re.sub(r'^(\s*)-\s+', r'\1', md_text, flags=re.MULTILINE)
-
+    (re.compile(r'^(\s*)-\s+', flags=re.MULTILINE), r"\1"),
     # 去除HTML标签
-    md_text = re.sub(r"<[^>]+>", "", md_text)
-
+    (re.compile(r"<[^>]+>"), ""),
     # 去除标题符号（#）
-    md_text = re.sub(r"^#{1,6}\s*", "", md_text, flags=re.MULTILINE)
-
+    (re.compile(r"^#{1,6}\s*", flags=re.MULTILINE), ""),
     # 去除多余空格和空行
-    md_text = re.sub(r"\n\s*\n", "\n", md_text)  # 多余空行
-    md_text = md_text.strip()
+    (re.compile(r"\n\s*\n"), "\n"),
+]
+# 只含这些字符之外内容的文本不会被任何规则改动
+_markdown_chars = re.compile(r"[`!\[<#\n-]")
+
+_emoji_pattern = regex.compile(r'\p{Emoji_Presentation}|\p{Emoji}\uFE0F', flags=regex.UNICODE)
+_whitespace_table = str.maketrans({"\n": " ", "\t": " ", '"': "\“"})
 
-    return md_text
+
+def clean_markdown(md_text: str) -> str:
+    if _markdown_chars.search(md_text):
+        for pattern, repl in _markdown_rules:
+            md_text = pattern.sub(repl, md_text)
+    return md_text.strip()
 
 
 def clean_text(text):
     # 去除 Markdown 语法
     text = clean_markdown(text)
     # 匹配并移除表情符号
-    text = regex.compile(r'\p{Emoji_Presentation}|\p{Emoji}\uFE0F', flags=regex.UNICODE).sub("",text)
+    text = _emoji_pattern.sub("", text)
     # 去除换行符
-    text = text.replace("\n", " ")
-    text = text.replace("\t", " ")
-    text = text.replace('"', "\“")
-    return text
+    return text.translate(_whitespace_table)
+
+_math_symbol_pattern = re.compile(r'([\d$%^*_+≥≤≠×÷?=])')
+_minus_pattern = re.compile(r'(?<=[a-zA-Z0-9])-(?=\d)')
+
 
 class TextNormalizer:
-    def __init__(self, tokenizer=None):
+    """Text normalization for synthesis.
+
+    Results are cached per (language, input text) in an LRU of ``cache_size`` entries (0 disables it), so
+    repeated announcement templates skip the regex rules and the WeText FST normalizers entirely.
+    Number words from ``inflect`` are cached separately.
+    """
+
+    def __init__(self, tokenizer=None, cache_size=1024):
         self.tokenizer = tokenizer
         self.zh_tn_model = Normalizer(lang="zh", operator="tn", remove_erhua=True)
         self.en_tn_model = Normalizer(lang="en", operator="tn")
         self.inflect_parser = inflect.engine()
+        self.cache = LRUCache(cache_size)
+        self.number_words = LRUCache(4096)
+
+    def number_to_words(self, digits):
+        words = self.number_words.get(digits)
+        if words is None:
+            words = self.inflect_parser.number_to_words(digits)
+            self.number_words.put(digits, words)
+        return words
     
     def normalize(self, text, split=False):
         # 去除 Markdown 语法，去除表情符号，去除换行符
         lang = "zh" if contains_chinese(text) else "en"
+        key = (lang, text)
+        normalized = self.cache.get(key)
+        if normalized is None:
+            normalized = self._normalize(text, lang)
+            self.cache.put(key, normalized)
+        if split is False:
+            return normalized
+
+    def _normalize(self, text, lang):
         text = clean_text(text)
+        text = spell_out_ward_numbers(text, lang, self.number_to_words)
         if lang == "zh":
             text = text.replace("=", "等于") # 修复 ”550 + 320 等于 870 千卡。“ 被错误正则为 ”五百五十加三百二十等于八七十千卡.“
-            if re.search(r'([\d$%^*_+≥≤≠×÷?=])', text): # 避免 英文连字符被错误正则为减
-                text = re.sub(r'(?<=[a-zA-Z0-9])-(?=\d)', ' - ', text) # 修复 x-2 被正则为 x负2
+            if _math_symbol_pattern.search(text): # 避免 英文连字符被错误正则为减
+                text = _minus_pattern.sub(' - ', text) # 修复 x-2 被正则为 x负2
             text = self.zh_tn_model.normalize(text)
             text = replace_blank(text)
             text = replace_corner_mark(text)
             text = remove_bracket(text)
         else:
             text = self.en_tn_model.normalize(text)
-            text = spell_out_number(text, self.inflect_parser)
-        if split is False:
-            return text
\ No newline at end of file
+            text = spell_out_number(text, self.inflect_parser, self.number_to_words)
+        return text
\ No newline at end of file
@@ -5,17 +5,34 @@ Provides on-demand import ZipEnhancer functionality for audio denoising processi
 Related dependencies are imported only when denoising functionality is needed.
 """
 
+import io
 import os
 import tempfile
-from typing import Optional, Union
+from typing import Generator, Optional, Union
+import numpy as np
+import soundfile as sf
 import torchaudio
 import torch
+from modelscope.outputs import OutputKeys
 from modelscope.pipelines import pipeline
+from modelscope.utils.audio.audio_utils import audio_norm
 from modelscope.utils.constant import Tasks
 
 
+def _norm_gain(x: np.ndarray) -> float:
+    """Gain the ModelScope ANS pipeline applies to its input, measured with the pipeline's own ``audio_norm``
+    (a linear scaling to -25 dBFS). Silent or degenerate windows get a gain of 1."""
+    if not np.any(x):
+        return 1.0
+    with np.errstate(divide="ignore", invalid="ignore"):
+        gain = float(np.linalg.norm(audio_norm(x)) / np.linalg.norm(x))
+    return gain if np.isfinite(gain) and gain > 0 else 1.0
+
+
 class ZipEnhancer:
     """ZipEnhancer Audio Denoising Enhancer"""
+
+    SAMPLE_RATE = 16000
     def __init__(self, model_path: str = "./model/speech_zipenhancer_ans_multiloss_16k_base"):
         """
         Initialize ZipEnhancer
@@ -36,9 +53,12 @@ class ZipEnhancer:
             wav_path: Audio file path
         """
         audio, sr = torchaudio.load(wav_path)
-        loudness = torchaudio.functional.loudness(audio, sr)
-        normalized_audio = torchaudio.functional.gain(audio, -20-loudness)
-        torchaudio.save(wav_path, normalized_audio, sr)
+        torchaudio.save(wav_path, self._loudness_normalized(audio, sr), sr)
+
+    @staticmethod
+    def _loudness_normalized(audio: torch.Tensor, sample_rate: int) -> torch.Tensor:
+        loudness = torchaudio.functional.loudness(audio, sample_rate)
+        return torchaudio.functional.gain(audio, -20-loudness)
     
     def enhance(self, input_path: str, output_path: Optional[str] = None, 
                 normalize_loudness: bool = True) -> str:
@@ -73,4 +93,69 @@ class ZipEnhancer:
                     os.unlink(output_path)
                 except OSError:
                     pass
-            raise RuntimeError(f"Audio denoising processing failed: {e}")
\ No newline at end of file
+            raise RuntimeError(f"Audio denoising processing failed: {e}")
+
+    def enhance_stream(self, audio: torch.Tensor, sample_rate: int, chunk_seconds: float = 6.0,
+                       overlap_seconds: float = 0.5) -> Generator[np.ndarray, None, None]:
+        """
+        Denoise in memory, window by window, with linear cross-fades over the overlaps
+        Args:
+            audio: waveform, (channels, samples) or (samples,); channels are averaged
+            sample_rate: sample rate of ``audio``; the output is 16 kHz
+            chunk_seconds: window length; up to 6 s the pipeline processes a window in one pass
+            overlap_seconds: overlap between consecutive windows
+        Returns:
+            Generator of float32 16 kHz segments, yielded as soon as each is final; together they
+            cover the input exactly (nothing for empty input). Only one window is held at a time and
+            no file is written.
+        """
+        if audio.dim() > 1:
+            audio = audio.mean(dim=0)
+        if audio.numel() == 0:
+            return
+        if sample_rate != self.SAMPLE_RATE:
+            audio = torchaudio.functional.resample(audio, sample_rate, self.SAMPLE_RATE)
+        audio = audio.to(torch.float32).cpu().numpy()
+        window = int(chunk_seconds * self.SAMPLE_RATE)
+        overlap = int(overlap_seconds * self.SAMPLE_RATE)
+        if not 0 <= overlap < window:
+            raise ValueError("overlap_seconds must be shorter than chunk_seconds")
+        fade_in = np.linspace(0.0, 1.0, overlap, dtype=np.float32)
+
+        start, tail = 0, None
+        while True:
+            out = self._denoise_window(audio[start:start + window])
+            if tail is not None:
+                out[:overlap] = tail * (1.0 - fade_in) + out[:overlap] * fade_in
+            if start + window >= audio.shape[0]:
+                yield out
+                return
+            yield out[:window - overlap]
+            tail = out[window - overlap:]
+            start += window - overlap
+
+    def enhance_audio(self, audio: torch.Tensor, sample_rate: int, normalize_loudness: bool = True,
+                      **kwargs) -> torch.Tensor:
+        """
+        In-memory counterpart of ``enhance``: denoise ``audio`` with ``enhance_stream``
+        Returns:
+            torch.Tensor: (1, samples) float32 waveform at 16 kHz; (1, 0) for empty input
+        """
+        segments = list(self.enhance_stream(audio, sample_rate, **kwargs))
+        if not segments:
+            return torch.zeros(1, 0)
+        wav = torch.from_numpy(np.concatenate(segments)).unsqueeze(0)
+        if normalize_loudness:
+            wav = self._loudness_normalized(wav, self.SAMPLE_RATE)
+        return wav
+
+    def _denoise_window(self, x: np.ndarray) -> np.ndarray:
+        """Run the pipeline on one window passed as in-memory WAV bytes, undoing its input normalization"""
+        buf = io.BytesIO()
+        sf.write(buf, x, self.SAMPLE_RATE, format="WAV", subtype="FLOAT")
+        result = self._pipeline(buf.getvalue())
+        out = np.frombuffer(result[OutputKeys.OUTPUT_PCM], dtype="<i2").astype(np.float32) / 32768.0
+        if out.shape[0] < x.shape[0]:
+            out = np.pad(out, (0, x.shape[0] - out.shape[0]))
+        # the pipeline normalizes every window to -25 dBFS; restore the window's own level so windows match
+        return out[:x.shape[0]] / _norm_gain(x.astype(np.float64))